@@ -1,913 +1,1361 @@
-
-// LoggerStatistics Arduino Sketch
-//  enables datalogging of sensor data with arbitrary number of sensor
-//    and recording events (integers representing states of various buttons or thresholds)
-//
-//  INSTRUCTIONS:
-//  ********************** FOR ADDING A NEW DATA STREAM ****************************
-//  (could come directly from a sensor or be a calculated value)
-//  STEPS or adding a new data stream:
-//  DATA_1 - define pins, device parameters, and compiler macro definitions in "deviceConfig[NAME].h" file
-//  DATA_2 - include any libraries needed for sensors (or other devices) with suitable macro logic as needed
-//  DATA_3 - declare int variable (i[SHORTNAME]) for storing index of each data stream
-//  DATA_4 - initialize and configure data streams and initialize sensors
-//  DATA_5 - update data stream with current sensor or calculated values
-//  data stream statistics are automatically output to Serial or written to SD File periodically through settings
-//
-//  ********************** FOR ADDING A NEW EVENT *********************************
-//  STEPS for adding a new event:
-//  EVENT_1 - define event pins, event parameters, and compiler macro definitions in "deviceConfig[NAME].h" file
-//  EVENT_2 - include any libraries related to event with suitable macro logic as needed
-//  EVENT_3 - declare int variable (j[SHORTNAME]) for storing index of each event
-//  EVENT_4 - initialize and configure event
-//  EVENT_5 - update event
-//  EVENT_6 - EVENT if event relates to an EVENT, output event to Serial and/or Event log SD File
-//  EVENT_7 - ACTION if event and event can cause an action, implement action
-//
-// comment out next line to eliminate debug messages
-#define ENABLEDEBUG
-#include "quickDebugMessages.h"
-// use DEBUG_LEVEL to control how verbose debugging messages are
-#define DEBUG_LEVEL 4
-
-// *************************************
-// include files that define device configuration
-#include "secretsGeneric.h"
-// choose correct device configuration
-//#include "deviceConfigGeneric.h"
-#include "deviceConfigAAdalogger.h"
-//#include "deviceConfigBEInk.h"
-
-// *************** DATA_2: SENSOR LIBRARIES ********************************************
-// * INCLUDE sensor library include files below (with suitable macro logic as needed)
-// * also declare variables if needed for using the sensor
-// * ***********************************************************************************
-// sensor LIBRARIES for ADAFRUIT FEATHER BLUEFRUIT SENSE
-//#include <Adafruit_APDS9960.h>
-#ifdef ENABLE_SENSE_ALTIM
-#include <Adafruit_BMP280.h>
-#endif
-#ifdef ENABLE_SENSE_MAG
-#include <Adafruit_LIS3MDL.h>
-#endif
-#ifdef ENABLE_SENSE_ACCEL
-#include <Adafruit_LSM6DS33.h>
-#endif
-#ifdef ENABLE_SENSE_HUMID
-#include <Adafruit_SHT31.h>
-#endif
-#include <Adafruit_Sensor.h>
-//#include <PDM.h>
-// VARIABLES Adafruit Feather Sense Sensors:
-//Adafruit_APDS9960 apds9960; // proximity, light, color, gesture
-#ifdef ENABLE_SENSE_ALTIM
-Adafruit_BMP280 bmp280; // temperature, barometric pressure
-#endif
-#ifdef ENABLE_SENSE_MAG
-Adafruit_LIS3MDL lis3mdl; // magnetometer
-#endif
-#ifdef ENABLE_SENSE_ACCEL
-Adafruit_LSM6DS33 lsm6ds33; // accelerometer, gyroscope
-#endif
-#ifdef ENABLE_SENSE_HUMID
-Adafruit_SHT31 sht30; // humidity
-#endif
-//float temperature, pressure, altitude;
-//float altitudeBaseline, altitudeBaselineStDev;
-//float magnetic_x, magnetic_y, magnetic_z;
-//float accel_x, accel_y, accel_z;
-//float gyro_x, gyro_y, gyro_z;
-//float humidity;
-
-// *************** EVENT_2: EVENT LIBRARIES ********************************************
-// * INCLUDE library include files below (with suitable macro logic as needed)
-// * also declare variables if needed for using the event
-// * ***********************************************************************************
-#ifdef ENABLE_NEOPIXEL
-#include <Adafruit_NeoPixel.h>
-Adafruit_NeoPixel pixels(1, SENSE_NEO, NEO_GRB + NEO_KHZ800);
-int mode = 0;
-int pixModeMax = 7;
-#endif
-
-// include routines for datalogging to SD card
-#include "logSD.h"
-
-// ********************************************************************
-// data structure for storing data samples and calculating statistics
-#include "sampleStats.h"
-// array of data structures for storing data from sensors
-
-// *************** DATA_3: DATA STREAM INDICES ********************************************
-// * DECLARE int variables for storing index of each data stream (it is OK if it is not used)
-// * ***********************************************************************************
-// sensor indices to store where sensor data is stored in the array
-// FAST sensors are probed every time through the loop() function
-int iTime = -1;     // time at which data values are recorded (store in seconds)
-int iLoopTime = -1; // time spent during one pass through loop() function (store in ms)
-int iSimX = -1;     // simulated data value
-int iSimY = -1;     // simulated data value (sine function)
-int iAx = -1;       // acceleration in x direction (long dimension of feather)
-int iAy = -1;       // acceleration in y direction (short dimension of feather)
-int iAz = -1;       // acceleration in z direction (perpendicular to feather surface)
-int iGx = -1;       // gyro in x direction (long dimension of feather)
-int iGy = -1;       // gyro in y direction (short dimension of feather)
-int iGz = -1;       // gyro in z direction (perpendicular to feather surface)
-int iMx = -1;       // magnetic field in x direction (long dimension of feather)
-int iMy = -1;       // magnetic field in y direction (short dimension of feather)
-int iMz = -1;       // magnetic field in z direction (perpendicular to feather surface)
-int iAlt = -1;      // altitude from barometric pressure
-int iTemp = -1;     // temperature (from humidity sensor)
-int iHumid = -1;    // humidity
-
-// data structure for tracking control events (from buttons, thresholds of data values, etc)
-#include "eventTracker.h"
-// *************** EVENT_3: EVENT STREAM INDICES ********************************************
-// * DECLARE int variables for storing index of each event (it is OK if it is not used)
-// * ***********************************************************************************
-// define events to be used by the code for controlling various actions
-int jUserButton = -1; // user button on Adafruit Sense
-int jTopSwitch = -1;  // top switch on ling climber
-int jBotSwitch = -1;  // bottom switch on line climber
-int jPitch = -1;      // threshold on Ax
-int jRoll = -1;       // threshold on Ay
-int jTimer = -1;      // labels on CPU time
-//int jNoseUp = -1;     // threshold on Ax
-//int jNoseDown = -1;   // threshold on Ax
-#ifdef ENABLE_NEOPIXEL
-int jNeoPixel = -1; // neopixel state
-#endif
-
-int countSDLine = 0; // number of lines in SD data file
-int countEvents = 0; // number of lines in SD event file
-
-// ********************************************************************
-// functions that simulate sensors with randomness
-#include "simulatedSensor.h"
-// *****************************
-
-// variables for tracking time spent in functions
-unsigned long endTime = 0;
-unsigned long lastEndTime = 0;
-unsigned long startTime = 0;
-unsigned long startTimeMicros = 0;
-
-unsigned long serialInterval = SERIAL_OUTPUT_INTERVAL; // time interval between serial output
-unsigned long nextSerialOutput = 0;                    // time at which to end sampling and write out data
-unsigned long samplingInterval = SAMPLING_PERIOD;      // time interval for collecting samples before next SampleOutput
-unsigned long nextSampleOutput = 0;                    // time at which to end sampling and write out data
-unsigned long slowDataInterval = SLOW_DATA_INTERVAL;   // time interval between updating slow data streams
-unsigned long nextSlowDataUpdate = 0;                  // time at which next set of slow data streams will be updated
-
-// varibales for controlling LED signals
-unsigned long LEDPhaseInterval = 2000; // long toggle between colors to indicate phase of operation and signal status
-unsigned long LEDSDInterval = 100;     // blink quickly to indicate that SD was accessed
-int LEDPhaseState = 0;                 // toggle 0 or 1
-int LEDPhaseUp = 1;                    // code for color when in active state (1)
-int LEDPhaseDown = -1;                 // code for color when in passive state (0)
-int LEDSDActive = 0;
-int LEDSDColor = 5; // code for color when SD is activated
-int LEDLevel = 40;  // brightness of LED
-unsigned long nextLEDPhaseChange = 0;
-unsigned long nextSDPhaseChange = 0;
-
-// timing variables for calculating trendline slope
-unsigned long timeReference = 0; // for trendline, subtract this time to calculate relative time
-unsigned long timeRelative = 0;  // relative time (in millis) for calculating trendline
-
-// **************************************************************************
-// **************************************************************************
-// * SETUP: start of setup() function
-// **************************************************************************
-void setup()
-{
-
-#ifdef ENABLE_NEOPIXEL
-  pixels.begin();                 // INITIALIZE NeoPixel strip object (REQUIRED)
-  pixelSet(LEDPhaseUp, LEDLevel); // SET to red LED for startup Stage
-#endif
-
-  Serial.begin(115200);
-  // remove following while block for field testing!!
-#ifdef WAIT_FOR_SERIAL
-  while (!Serial)
-  {
-    delay(10); // wait for serial monitor to open
-  }
-#endif
-
-  Serial.println("Starting DataloggerStats test program");
-  Serial.print("Filename = ");
-  Serial.println(__FILE__);
-  Serial.print("Date and Time Compiled = ");
-  Serial.print(__DATE__);
-  Serial.print(" : ");
-  Serial.println(__TIME__);
-
-  // -----------------------------------------------------------
-  // - setup the files for output to SD cards
-  // -----------------------------------------------------------
-#ifdef USE_SD
-  // determine a directory for storing files by date using "dYYMMDD"
-  // e.g. "d201222" for December 22, 2020
-  initializeSDFileDirectory();
-
-  // naming convention for files = "Dtype##.suffix" where "D" is the device code (1 char),
-  //    "type" is the type of file (3-4 char), "##" is the file number, and ".suffix" is the appropriate file suffix
-  // Zlog01.txt = create a log file (for mirroring messages to serial)
-  int statusSD = setup_SD_file(deviceCode, "log", ".txt", logFileName);
-  statusSD = setup_SD_file(deviceCode, "data", ".csv", dataFileName);
-  statusSD = setup_SD_file(deviceCode, "evnt", ".csv", eventFileName);
-
-  pinMode(SENSE_BLUE, OUTPUT);
-  digitalWrite(SENSE_BLUE, LOW);
-  if (statusSD == 1)
-  {
-    LEDSDActive = 1;
-    // update neopixel LED
-    nextSDPhaseChange = millis() + LEDSDInterval;
-    pixelSet(LEDSDColor, LEDLevel);
-
-    // update status LED
-    //pinMode(SENSE_BLUE, OUTPUT);
-    digitalWrite(SENSE_BLUE, HIGH);
-  }
-  else
-  {
-    LEDSDActive = 1;
-    // update neopixel LED
-    nextSDPhaseChange = millis() + LEDSDInterval;
-    pixelSet(1, LEDLevel); // turn to red
-  }
-
-  // Zdata01.csv = create a data file (streaming sample data at regular time intervals)
-
-  // Zevnt01.txt = create an event file (recording time and messages for specific events to guide data analysis)
-
-#endif
-  // ---END of SD setup---------------------------------------------------
-
-  // *************** DATA_4: INITIALIZE DATA STREAMS ********************************************
-  // * INITIALIZE and configure each data stream
-  // * also make sure to initialize the sensor if needed
-  // * ***********************************************************************************
-  // ----------------------------------------------------------------
-  // -  INITIALIZE data streams that will be collected and recorded
-  // -  should also initialize the sensors as needed
-  // ----------------------------------------------------------------
-  // initialize a new data source (*** need to move this to a function to automate)
-  // iTime is index for the time of data point collection increments (n increments make the interval for the sample)
-  // variable indicating what stats to output to spreadsheets
-  // -1 = no output (just a variable for internal calculations)
-  // 0  = only output current value (no statistics)
-  // 1  = only output average
-  // 2  = output average and current
-  // 3  = output average and sample size
-  // 4  = output average and standard deviation
-  // 5  = output all info (including current and sample size)
-
-  iTime = addDataStream(data, &nSamples, "CPUTimeInms", "CPUt", "s", 2);
-  DEBUG(iTime)
-
-  // iLoopTime is index for the time spent in the loop function
-  iLoopTime = addDataStream(data, &nSamples, "LoopTimeInterval", "loopt", "ms", 5);
-  DEBUG(iLoopTime)
-
-#ifdef ENABLE_SIMULATED_DATA
-  // iSimX is index for the simulated sensor variable
-  iSimX = addDataStream(data, &nSamples, "SimulatedSensor", "xSim", "arb", 4);
-  data[iSimX].calcTrendline = 1;
-  DEBUG(iSimX)
-
-  // iSimY is index for the simulated sensor variable
-  iSimY = addDataStream(data, &nSamples, "SimulatedSensorSine", "ySim", "arb", 4);
-  data[iSimY].calcTrendline = 1;
-  DEBUG(iSimY)
-#endif
-
-#ifdef ENABLE_SENSE_ACCEL
-  // iAx, iAy, iAz accelerometer sensor readings
-  lsm6ds33.begin_I2C(); // initialize accelerometer / gyro
-  iAx = addDataStream(data, &nSamples, "Accel in x", "Ax", "m/s^2", 4);
-  //data[iAx].calcTrendline = 1;
-  DEBUG(iAx)
-  iAy = addDataStream(data, &nSamples, "Accel in y", "Ay", "m/s^2", 4);
-  //data[iAy].calcTrendline = 1;
-  DEBUG(iAy)
-  iAz = addDataStream(data, &nSamples, "Accel in z", "Az", "m/s^2", 4);
-  DEBUG(iAz)
-  //data[iAz].calcTrendline = 1;
-#ifdef ENABLE_SENSE_GYRO
-  iGx = addDataStream(data, &nSamples, "Gyro in x", "Gx", "rad/s", 4);
-  DEBUG(iGx)
-  iGy = addDataStream(data, &nSamples, "Gyro in y", "Gy", "rad/s", 4);
-  DEBUG(iGy)
-  iGz = addDataStream(data, &nSamples, "Gyro in z", "Gz", "rad/s", 4);
-  DEBUG(iGz)
-#endif
-#endif
-
-#ifdef ENABLE_SENSE_HUMID
-  // humidity and temperature
-  sht30.begin();
-  iTemp = addDataStream(data, &nSamples, "Temperature in C from humid sensor", "TC", "C", 0);
-  DEBUG(iTemp)
-  iHumid = addDataStream(data, &nSamples, "Humidity", "RH", "percent", 0);
-  DEBUG(iHumid)
-#endif
-
-#ifdef ENABLE_SENSE_ALTIM
-  bmp280.begin(); // altitude, temp, pressure
-  // NOTE altimeter varies slowly; so do not collect statistics
-  iAlt = addDataStream(data, &nSamples, "Altitude barometric", "AOG", "m", 0);
-  //data[iAlt].calcTrendline = 1;
-  data[iAlt].baselineType = 2; // calculate baseline and subtract from data
-  DEBUG(iAlt)
-#endif
-
-#ifdef ENABLE_SENSE_MAG
-  lis3mdl.begin_I2C(); // magnetometer
-  iMx = addDataStream(data, &nSamples, "Magnetic Field in x", "Mx", "uT", 4);
-  DEBUG(iGx)
-  iMy = addDataStream(data, &nSamples, "Magnetic Field in y", "My", "uT", 4);
-  DEBUG(iGy)
-  iMz = addDataStream(data, &nSamples, "Magnetic Field in z", "Mz", "uT", 4);
-  DEBUG(iGz)
-#endif
-
-  timeReference = millis(); // initialize the reference time for trendline calculations
-
-  MESSAGE("Number of data streams ", nSamples)
-
-  //
-  // ********************* Need to add function for printing data stream summary to log file
-  //
-
-  // print headers to file for spreadsheet datalogging
-  int status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ",", countSDLine, 1); // use commas to separate columns in table (8 char width)
-
-  // *************** EVENT_4: INITIALIZE EVENTS ********************************************
-  // * INITIALIZE and configure each event
-  // * also make sure to initialize any devices or libraries if needed
-  // * event types:
-  // *  0 = button or switch (boolean: 0 = passive and 1 = active) associated with a pin
-  // *  1 = threshold indicator (boolean: 0 = inside of threshold limit and 1 = outside of threshold limit)
-  // *  2 = state (integer correponding to preset states) using some other type of user-coded logic
-  // * ***********************************************************************************
-#ifdef SENSE_BUTTON
-  //char eventStatesTemp[EVENT_STATES_MAX] [EVENT_NAME_SHORT] = {"PRESS", "RELEASE"};
-  //jUserButton = addEvent(events, &nEvents, "Sense User Button", "ButS", 2, eventStatesTemp, 0, 1);
-  jUserButton = addEvent(events, &nEvents, "Sense User Button", "ButS", 0, 1, 2, "PRESS", "RELEASE");
-  // note the User Button on the Adafruit Sense is 0 when pressed
-  linkEventToPin(events, jUserButton, SENSE_BUTTON);
-  DEBUG(jUserButton)
-#endif
-
-  if (iAx != -1) // create thresholds indicating that the device is pitched nose up or nose down
-  {
-    jPitch = addEvent(events, &nEvents, "Pitch Angle States", "Pitch", 1, 1, 3, "NOSEDWN", "NOSELVL", "NOSEUP");
-    setEventBreakpoints(events, jPitch, iAx, -8.0, 8.0);
-    jRoll = addEvent(events, &nEvents, "Roll Angle States", "Roll", 1, 1, 3, "LEFTUP", "ROLLLVL", "RIGHTUP");
-    setEventBreakpoints(events, jRoll, iAy, -8.0, 8.0);
-  }
-
-  if (iTime != -1) // create thresholds for time periods
-  {
-    jTimer = addEvent(events, &nEvents, "Timer for session", "Timer", 1, 0, 4, "INIT", "BASELN", "COLLECT", "SHUTDOWN");
-    setEventBreakpoints(events, jTimer, iTime, 5., 35., 3600.);
-  }
-
-  status = reportEventToFile(eventFileName, events, nEvents, 0, ",", countEvents, 1); // print event header
-
-  //
-  // ********************* Need to add function for printing event tracker summary to log file
-  //
-
-  // initialize LED signals
-  nextLEDPhaseChange = millis() + LEDPhaseInterval;
-  LEDPhaseState = 1;
-  pixelSet(LEDPhaseUp, LEDLevel); // SET to red LED for startup Stage
-
-  // ---------------------------------------------------------------------
-  // - set up timing variables
-  // ---------------------------------------------------------------------
-  endTime = millis(); // time at end of setup function in millis
-  lastEndTime = endTime;
-  nextSerialOutput = endTime + serialInterval;
-  nextSampleOutput = endTime + samplingInterval;
-  nextSlowDataUpdate = endTime + slowDataInterval;
-  startTime = millis(); // time at start of loop function in millis
-  DEBUG(startTimeMicros)
-  startTimeMicros = micros(); // time at start of loop function in millis
-  DEBUG(startTimeMicros)
-}
-// ** end of SETUP function
-// **************************************************************************
-
-// **************************************************************************
-// * LOOP: start of loop function
-// **************************************************************************
-void loop()
-{
-  unsigned long loopStartTime = millis();
-
-  // *************** DATA_5: UPDATE DATA STREAM ********************************************
-  // * UPDATE each data stream with sensor values or calculated values
-  // * ***********************************************************************************
-  // ---------------------------------------------------------------------
-  // - UPDATE data streams
-  // -      FAST data streams update on every pass through loop()
-  // -      SLOW data streams update when the appropriate time increment has passes
-  // -  ** NOTE: the updating actions should be moved to a function to simplify this section
-  // ---------------------------------------------------------------------
-
-  // FAST DATA update values of all data that is collected as fast as possible
-  // current time
-  float currentTime = ((float)millis()) / 1000.;
-  timeRelative = millis() - timeReference;            // find relative time for trendline slope
-  float relativeTime = ((float)timeRelative) / 1000.; // time used for trendline slope
-
-  int status = updateDataSample(data, iTime, currentTime); // current CPU time in seconds
-
-  // simulated data
-  float currentSimX = simulatedSensor(1., 5., 1.);                   // simulated sensor with mean 10.0, range 2.0 and slope = 1
-  status = updateDataSample(data, iSimX, currentSimX, relativeTime); // current simulated data
-
-  // simulated data
-  float currentSimY = simulatedSensorSine(0., 0., 1., 10., 10.);     // simulated sensor
-  status = updateDataSample(data, iSimY, currentSimY, relativeTime); // current simulated data
-
-#ifdef ENABLE_SENSE_ACCEL
-  // Accelerometer data
-  sensors_event_t accel;
-  sensors_event_t gyro;
-  sensors_event_t temp;
-  lsm6ds33.getEvent(&accel, &gyro, &temp);
-  // accel_x = accel.acceleration.x;
-  // accel_y = accel.acceleration.y;
-  // accel_z = accel.acceleration.z;
-  //gyro_x = gyro.gyro.x;
-  //gyro_y = gyro.gyro.y;
-  //gyro_z = gyro.gyro.z;
-  status = updateDataSample(data, iAx, accel.acceleration.x, relativeTime);
-  status = updateDataSample(data, iAy, accel.acceleration.y, relativeTime);
-  status = updateDataSample(data, iAz, accel.acceleration.z, relativeTime);
-#ifdef ENABLE_SENSE_GYRO
-  status = updateDataSample(data, iGx, gyro.gyro.x, relativeTime);
-  status = updateDataSample(data, iGy, gyro.gyro.y, relativeTime);
-  status = updateDataSample(data, iGz, gyro.gyro.z, relativeTime);
-#endif
-#endif
-
-  // #ifdef ENABLE_SENSE_ALTIM
-  //   float altitude = bmp280.readAltitude(1013.25);
-  //   status = updateDataSample(data, iAlt, altitude, relativeTime);
-  // #endif
-
-#ifdef ENABLE_SENSE_MAG
-  lis3mdl.read();
-  status = updateDataSample(data, iMx, lis3mdl.x, relativeTime);
-  status = updateDataSample(data, iMy, lis3mdl.y, relativeTime);
-  status = updateDataSample(data, iMz, lis3mdl.z, relativeTime);
-#endif
-
-#ifdef ENABLE_RANDOM_DELAY
-  // add short random delay here to avoid serendipitous synchronization of sensor variations
-  delayMicroseconds(random(10, 2000)); // random delay of 0.01 to 2 ms
-#endif
-  //delay(5);
-  unsigned long currentTimeMicros = micros();
-  float currentLoopTime = ((float)(currentTimeMicros - startTimeMicros)) / 1000.; // convert to ms
-  if (currentTimeMicros >= startTimeMicros)
-  {
-    // do nothing
-  }
-  else
-  {
-    // unsigned long int has rolled over
-    unsigned long deltaTime = (unsigned long) - 1;
-    WARN("unsigned long Micros() has rolled over! ", currentTimeMicros)
-    deltaTime = deltaTime - startTimeMicros + currentTimeMicros;
-    currentLoopTime = ((float)deltaTime) / 1000.; // convert to ms
-  }
-  status = updateDataSample(data, iLoopTime, currentLoopTime); // current loop time in ms
-
-  // SLOW DATA update values of data if sufficient time has passed to probe the sensor again
-  if (millis() > nextSlowDataUpdate)
-  {
-    // time to update the slow data sources
-    // humidity and temperature from sht30
-    //humidity = sht30.readHumidity();
-    //temperatureSHT = sht30.readTemperature();
-#ifdef ENABLE_SENSE_HUMID
-    status = updateDataSample(data, iTemp, sht30.readTemperature()); // current loop time in ms
-    status = updateDataSample(data, iHumid, sht30.readHumidity());   // current loop time in ms
-#endif
-
-#ifdef ENABLE_SENSE_ALTIM
-    float altitude = bmp280.readAltitude(1013.25);
-    status = updateDataSample(data, iAlt, altitude, relativeTime);
-#endif
-
-    nextSlowDataUpdate = millis() + slowDataInterval;
-  }
-
-  // *************** EVENT_5: UPDATE EVENTS ********************************************
-  // * UPDATE each event
-  // * ***********************************************************************************
-  // ---------------------------------------------------------------------
-  // - CHECK for state events (button press, switch change, thresholds)
-  // -   to control change of
-  // -       - STATE of the program (e.g. initialization, baseline, calibration, collection, shutdown, sleep, etc.)
-  // -       - STATUS (warnings and error messages)
-  // -       - MODE (e.g. standby, climb, descent, idle, etc.)
-  // ---------------------------------------------------------------------
-  // FAST UPDATES to events (checked on every pass through loop)
-  // move to function: checkDigitalPins();
-  for (int j = 0; j < nEvents; j++)
-  {
-    int stype = events[j].eventType;
-    if (stype == 0)
-    {
-      // this event is a digital button/switch
-      int pinState = digitalRead(events[j].pin);
-      if (pinState != events[j].state)
-      {
-        // pin State has changed!
-        updateEventState(events, j, pinState, loopStartTime);
-
-        reportEventToSerial(events, nEvents, j);
-
-        countEvents++;
-#ifdef USE_SD
-        reportEventToFile(eventFileName, events, nEvents, j, ",", countEvents, 0); // print event as CSV file
-#endif
-      }
-      else
-      {
-        // pin State has not changed
-        events[j].priorState = pinState;
-        events[j].justUpdated = 0; // indicates a repeated state
-      }
-    }
-    else if (stype == 1)
-    {
-      // this event is a threshold indicator
-      // do nothing here - only evaluate thresholds after sample is complete (based on averages)
-    }
-    else
-    {
-      // this event is a state indicator
-    }
-  }
-
-  // SLOW UPDATES to events (checked only when sampling time or other indicator is complete)
-  if (millis() > nextSampleOutput)
-  {
-
-    //
-    // calculate sample statistics from current data for specific variables as needed
-    //
-    updateSampleStats(data, nSamples); // already has been updated in prior block
-
-    // loop through event and check their status
-    for (int j = 0; j < nEvents; j++)
-    {
-      int stype = events[j].eventType;
-      if (stype == 0)
-      {
-        // this event is a digital button/switch - do nothing here - digital pins are checked in the fast section
-      }
-      else if (stype == 1)
-      {
-        // this event is a threshold indicator: get the corresponding data(sensor) value
-        int iThreshold = events[j].thresholdDataIndex;
-        float dataValue = data[iThreshold].currentVal;
-        if (data[iThreshold].n > 1)
-        {
-          dataValue = data[iThreshold].sumX / ((float)data[iThreshold].n); // use average if available
-        }
-
-        // check breakpoint thresholds
-        int currentState = 0; // determine the state = less than one of the breakpoints
-        // if (dataValue > events[j].breakpointValue[events[j].numStates])
-        // {
-        //   currentState = events[j].numStates; // currently data is in the highest state
-        // }
-        // else
-        // {
-        for (int k = 0; k < events[j].numStates - 1; k++)
-        {
-          if (dataValue < events[j].breakpointValue[k])
-          {
-            // currentState = k;
-            // do nothing, current state is correct
-          }
-          else
-          {
-            currentState = k + 1; // update current state
-          }
-        }
-
-        if (currentState != events[j].state)
-        {
-          // threshold State has changed!
-          updateEventState(events, j, currentState, loopStartTime);
-
-          reportEventToSerial(events, nEvents, j);
-
-          countEvents++;
-          reportEventToFile(eventFileName, events, nEvents, j, ",", countEvents, 0); // print event as CSV file
-        }
-        else
-        {
-          // pin State has not changed
-          events[j].priorState = currentState;
-          events[j].justUpdated = 0; // indicates a repeated value
-        }
-      }
-      else
-      {
-        // this event is a state indicator
-      }
-    } // DO NOT RESET nextSampleOutput time here! It is updated when the sample data is
-    //    communicated to Serial and/or File in later section
-
-    if (events[jTimer].justUpdated == 1)
-    {
-      if (events[jTimer].state == 1)
-      {
-        LEDPhaseUp = 2; // yellow
-      }
-      else if (events[jTimer].state == 2)
-      {
-        LEDPhaseUp = 3; // green
-      }
-      else if (events[jTimer].state == 3)
-      {
-        LEDPhaseUp = 1; // red
-      }
-    }
-
-    // handle baseline collection
-    if (events[jTimer].state == 1)
-    {
-      // add current sample averages into baseline
-      MESSAGE("Adding samples into baseline", events[jTimer].state)
-      MESSAGE("Adding samples into baseline", events[jTimer].eventStateName[events[jTimer].state])
-
-      for (int i = 0; i < nSamples; i++)
-      {
-        if (data[i].n > 0) // only add info into baseline if sample size is 1 or more
-        {
-          data[i].baselineCount++;
-          data[i].baselineSum += data[i].average;
-          data[i].baselineSumX2 += data[i].average * data[i].average;
-        }
-      }
-    }
-    else if ((events[jTimer].state == 2) && (events[jTimer].justUpdated == 1))
-    {
-      // calculate baseline and print to serial and log file
-      MESSAGE("Done calculating Baselines", events[jTimer].state)
-      for (int i = 0; i < nSamples; i++)
-      {
-        float average = 0.;
-        float variance = 0.;
-        float standardDeviation = 0.;
-        float sampleSize = (float)data[i].baselineCount;
-
-        if (data[i].baselineCount == 0)
-        {
-          WARN("BASELINE SAMPLE EMPTY!", data[i].baselineCount)
-        }
-        else
-        {
-          average = data[i].baselineSum / sampleSize;
-          variance = (data[i].baselineSumX2 - data[i].baselineSum * data[i].baselineSum / sampleSize) / (sampleSize - 1.);
-          if (variance < 0.)
-          {
-            WARN("negative variance in baseline var = ", variance)
-            WARN("negative variance in baseline data = ", i)
-            standardDeviation = 0.;
-          }
-          else
-          {
-            standardDeviation = sqrt(variance);
-          }
-
-          if (data[i].baselineType == 2)
-          {
-            MESSAGE("updating baseline for variable", i)
-            MESSAGE("updated baseline = ", average)
-            data[i].baseline = average;
-          }
-          // print out baseline stats
-          Serial.print("BASELINE evaluated for variable: ");
-          Serial.print(data[i].dataNickName);
-          Serial.print(" avg = ");
-          Serial.print(average);
-          Serial.print(" stdev = ");
-          Serial.print(standardDeviation);
-          Serial.print(" size n = ");
-          Serial.print(data[i].baselineCount);
-          Serial.print(" baseline = ");
-          Serial.println(data[i].baseline);
-
-#ifdef USE_SD
-          File tmpFile;
-          tmpFile = SD.open(logFileName, FILE_WRITE);
-          if (tmpFile)
-          {
-            // print out baseline stats to log file
-            tmpFile.print("BASELINE evaluated for variable: ");
-            tmpFile.print(data[i].dataNickName);
-            tmpFile.print(" avg = ");
-            tmpFile.print(average);
-            tmpFile.print(" stdev = ");
-            tmpFile.print(standardDeviation);
-            tmpFile.print(" size n = ");
-            tmpFile.print(data[i].baselineCount);
-            tmpFile.print(" baseline = ");
-            tmpFile.println(data[i].baseline);
-            tmpFile.close();
-          }
-#endif
-        }
-      }
-    }
-  }
-
-  // ---------------------------------------------------------------------
-  // - ACTIONS (some actions may have been taken in the UPDATE section)
-  // -
-  // ---------------------------------------------------------------------
-
-  // ---------------------------------------------------------------------
-  // -  COMMUNICATION (if sufficient time has passed, prepare data for output and write it out)
-  // ---------------------------------------------------------------------
-  if (millis() > nextSampleOutput)
-  {
-    //
-    // calculate sample statistics from current data for all data streams
-    //
-    // updateSampleStats(data, nSamples); // already has been updated in prior block
-
-    if (millis() > nextSerialOutput) // if sufficient time has passed also write data to serial (and log file)
-    {
-      unsigned long startOutputTime = millis();
-      //MESSAGE("time to write out data", nextSampleOutput)
-      // create function call to automatically print out data in suitable formats
-      //   - to Serial monitor (for debugging) which should be mirrored to a log file when using SD card
-      //   - to CSV or JSON file on SC
-      //   - messages transmitted via LoRa radio, BlueTooth, Meshtastic, etc.
-      int status = printSampleStatTableToSerial(data, nSamples, "\t"); // use tabs to separate columns in table (8 char width)
-#ifdef USE_SD
-      status = printSampleStatTableToFile(logFileName, data, nSamples, "\t"); // use commas to separate columns in table (8 char width)
-#endif
-      //countSDLine++;                                                                                // increment counter on number of lines printed to SD data file
-      //status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ",", countSDLine, 0); // use commas to separate columns in table (8 char width)
-
-      // RESET samples!
-      //resetSampleStats(data, nSamples);
-
-      //   nextSampleOutput += samplingInterval;
-      nextSerialOutput = millis() + serialInterval;
-      //    DEBUG(nextSampleOutput)
-
-      unsigned long endOutputTime = millis();
-      Serial.print("Time Spent on Serial Output Communication = ");
-      Serial.print(endOutputTime - startOutputTime);
-      Serial.println(" ms");
-    }
-
-    unsigned long startOutputTime = millis();
-    //MESSAGE("time to write out data", nextSampleOutput)
-    // create function call to automatically print out data in suitable formats
-    //   - to Serial monitor (for debugging) which should be mirrored to a log file when using SD card
-    //   - to CSV or JSON file on SC
-    //   - messages transmitted via LoRa radio, BlueTooth, Meshtastic, etc.
-    //int status = printSampleStatTableToSerial(data, nSamples, "\t");                              // use tabs to separate columns in table (8 char width)
-    //status = printSampleStatTableToFile(logFileName, data, nSamples, "\t");                       // use commas to separate columns in table (8 char width)
-#ifdef USE_SD
-    countSDLine++;                                                                                     // increment counter on number of lines printed to SD data file
-    int status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ", ", countSDLine, 0); // use commas to separate columns in table (8 char width)
-    if (status == 1)
-    {
-      // update neopixel LED
-      LEDSDActive = 1;
-      nextSDPhaseChange = millis() + LEDSDInterval;
-      pixelSet(LEDSDColor, LEDLevel);
-
-      // update status LED
-      pinMode(SENSE_BLUE, OUTPUT);
-      digitalWrite(SENSE_BLUE, HIGH);
-    }
-    else
-    {
-      LEDSDActive = 1;
-      // update neopixel LED
-      nextSDPhaseChange = millis() + LEDSDInterval;
-      pixelSet(1, LEDLevel); // turn to red
-    }
-#endif
-    // RESET samples!
-    resetSampleStats(data, nSamples);
-    timeReference = millis(); // initialize the reference time for trendline calculations
-
-    //   nextSampleOutput += samplingInterval;
-    nextSampleOutput = millis() + samplingInterval;
-    //    DEBUG(nextSampleOutput)
-
-    unsigned long endOutputTime = millis();
-    Serial.print("Time Spent on DataFile Output Communication = ");
-    Serial.print(endOutputTime - startOutputTime);
-    Serial.println(" ms");
-  }
-
-  // ouput chunks of raw data if needed
-
-  // update LED
-  if (LEDSDActive && (millis() > nextSDPhaseChange))
-  {
-    //MESSAGE("Turn off blue SD LED", LEDSDActive)
-    LEDSDActive = 0;
-    digitalWrite(SENSE_BLUE, LOW);
-    if (LEDPhaseState == 0)
-    {
-      pixelSet(LEDPhaseDown, LEDLevel);
-    }
-    else
-    {
-      pixelSet(LEDPhaseUp, LEDLevel);
-    }
-  }
-
-#ifdef ENABLE_NEOPIXEL
-  if (millis() > nextLEDPhaseChange)
-  {
-    nextLEDPhaseChange = millis() + LEDPhaseInterval;
-    if (LEDPhaseState == 0)
-    {
-      LEDPhaseState = 1;
-      pixelSet(LEDPhaseUp, LEDLevel);
-    }
-    else
-    {
-      LEDPhaseState = 0;
-      pixelSet(LEDPhaseDown, LEDLevel);
-    }
-  }
-#endif
-
-  // ---------------------------------------------------------------------
-  // - update some of the timing variables
-  endTime = millis(); // time at end of loop function in millis
-  lastEndTime = endTime;
-  unsigned long int loopTime = endTime - startTime;
-  // DEBUG(loopTime)
-
-  startTime = millis();       // time at start of loop function in millis
-  startTimeMicros = micros(); // time at start of loop function in millis
-}
-// ************************************************************************
-// * end of LOOP
-// ************************************************************************
-
-
-#ifdef ENABLE_NEOPIXEL
-
-void pixelSet(int pixMode, int pixLevel)
-{
-  pixels.clear(); // Set all pixel colors to 'off'
-  switch (pixMode)
-  { // Start the new animation...
-    case 0:
-      pixels.setPixelColor(0, pixels.Color(pixLevel, pixLevel, pixLevel)); // Blue-Red
-      break;
-    case 1:
-      pixels.setPixelColor(0, pixels.Color(pixLevel, 0, 0)); // Red
-      break;
-    case 2:
-      pixels.setPixelColor(0, pixels.Color(pixLevel, pixLevel, 0)); // Red-Green
-      break;
-    case 3:
-      pixels.setPixelColor(0, pixels.Color(0, pixLevel, 0)); // Green
-      break;
-    case 4:
-      pixels.setPixelColor(0, pixels.Color(0, pixLevel, pixLevel)); // Green-Blue
-      break;
-    case 5:
-      pixels.setPixelColor(0, pixels.Color(0, 0, pixLevel)); // Blue
-      break;
-    case 6:
-      pixels.setPixelColor(0, pixels.Color(pixLevel, 0, pixLevel)); // Blue-Red
-      break;
-    default:
-      pixels.setPixelColor(0, pixels.Color(0, 0, 0)); // Black/off
-      break;
-  }
-
-  pixels.show(); // Send the updated pixel colors to the hardware.
-}
-#endif
+
+// LoggerStatistics Arduino Sketch
+//  enables datalogging of sensor data with arbitrary number of sensor
+//    and recording events (integers representing states of various buttons or thresholds)
+//
+//  INSTRUCTIONS:
+//  ********************** FOR ADDING A NEW DATA STREAM ****************************
+//  (could come directly from a sensor or be a calculated value)
+//  STEPS or adding a new data stream:
+//  DATA_1 - define pins, device parameters, and compiler macro definitions in "deviceConfig[NAME].h" file
+//  DATA_2 - include any libraries needed for sensors (or other devices) with suitable macro logic as needed
+//  DATA_3 - declare int variable (i[SHORTNAME]) for storing index of each data stream
+//  DATA_4 - initialize and configure data streams and initialize sensors
+//  DATA_5 - update data stream with current sensor or calculated values
+//  data stream statistics are automatically output to Serial or written to SD File periodically through settings
+//
+//  ********************** FOR ADDING A NEW EVENT *********************************
+//  STEPS for adding a new event:
+//  EVENT_1 - define event pins, event parameters, and compiler macro definitions in "deviceConfig[NAME].h" file
+//  EVENT_2 - include any libraries related to event with suitable macro logic as needed
+//  EVENT_3 - declare int variable (j[SHORTNAME]) for storing index of each event
+//  EVENT_4 - initialize and configure event
+//  EVENT_5 - update event
+//  EVENT_6 - EVENT if event relates to an EVENT, output event to Serial and/or Event log SD File
+//  EVENT_7 - ACTION if event and event can cause an action, implement action
+//
+// comment out next line to eliminate debug messages
+#define ENABLEDEBUG
+// uncomment to record debug messages as tokens in RAM and write them out when loop() is idle (debugLog.h)
+//#define ENABLE_DEFERRED_DEBUG
+//#define DEBUG_LOG_TO_SD // with ENABLE_DEFERRED_DEBUG: write them to the SD log file instead of Serial
+// use DEBUG_LEVEL to control how verbose debugging messages are (DEBUG1..DEBUG4 above it are not compiled)
+#define DEBUG_LEVEL 4
+#include "quickDebugMessages.h"
+
+// *************************************
+// include files that define device configuration
+#include "secretsGeneric.h"
+// choose correct device configuration
+//#include "deviceConfigGeneric.h"
+#include "deviceConfigAAdalogger.h"
+//#include "deviceConfigBEInk.h"
+
+// *************** DATA_2: SENSOR LIBRARIES ********************************************
+// * INCLUDE sensor library include files below (with suitable macro logic as needed)
+// * also declare variables if needed for using the sensor
+// * ***********************************************************************************
+// sensor LIBRARIES for ADAFRUIT FEATHER BLUEFRUIT SENSE
+//#include <Adafruit_APDS9960.h>
+#ifdef ENABLE_SENSE_ALTIM
+#include <Adafruit_BMP280.h>
+#endif
+#ifdef ENABLE_SENSE_MAG
+#include <Adafruit_LIS3MDL.h>
+#endif
+#ifdef ENABLE_SENSE_ACCEL
+#include <Adafruit_LSM6DS33.h>
+#endif
+#ifdef ENABLE_SENSE_HUMID
+#include <Adafruit_SHT31.h>
+#endif
+#include <Adafruit_Sensor.h>
+//#include <PDM.h>
+// VARIABLES Adafruit Feather Sense Sensors:
+//Adafruit_APDS9960 apds9960; // proximity, light, color, gesture
+#ifdef ENABLE_SENSE_ALTIM
+Adafruit_BMP280 bmp280; // temperature, barometric pressure
+#endif
+#ifdef ENABLE_SENSE_MAG
+Adafruit_LIS3MDL lis3mdl; // magnetometer
+#endif
+#ifdef ENABLE_SENSE_ACCEL
+Adafruit_LSM6DS33 lsm6ds33; // accelerometer, gyroscope
+#endif
+#ifdef ENABLE_SENSE_HUMID
+Adafruit_SHT31 sht30; // humidity
+#endif
+//float temperature, pressure, altitude;
+//float altitudeBaseline, altitudeBaselineStDev;
+//float magnetic_x, magnetic_y, magnetic_z;
+//float accel_x, accel_y, accel_z;
+//float gyro_x, gyro_y, gyro_z;
+//float humidity;
+
+// *************** EVENT_2: EVENT LIBRARIES ********************************************
+// * INCLUDE library include files below (with suitable macro logic as needed)
+// * also declare variables if needed for using the event
+// * ***********************************************************************************
+#ifdef ENABLE_NEOPIXEL
+#include <Adafruit_NeoPixel.h>
+Adafruit_NeoPixel pixels(1, SENSE_NEO, NEO_GRB + NEO_KHZ800);
+int mode = 0;
+int pixModeMax = 7;
+#endif
+
+// include routines for datalogging to SD card
+#include "logSD.h"
+
+// 64 bit monotonic clock and RTC-anchored absolute timestamps (columns added with ENABLE_ABSOLUTE_TIME)
+#include "timeBase.h"
+
+// instrumentation of loop() jitter and latency (compiled out unless ENABLE_LOOP_TIMING)
+#include "loopTiming.h"
+
+// scoped timers for regions of code, recorded as data streams (compiled out unless ENABLE_PROFILER)
+#include "profiler.h"
+
+// lossless compression of the rows of the data file (when ENABLE_COMPRESSED_DATA is defined)
+#include "dataCompress.h"
+
+// sidecar index of the data and event files for seeking by time or count (when ENABLE_TIME_INDEX is defined)
+#include "timeIndex.h"
+
+// bounded RAM queue between the output rows and the SD card (when ENABLE_OUTPUT_QUEUE is defined)
+#include "outputQueue.h"
+
+// new SD files by size or on the wall-clock period (when ENABLE_LOG_ROTATION is defined)
+#include "logRotation.h"
+
+// fast sqrt, sine and division by n for the statistics (when ENABLE_FAST_MATH is defined)
+#include "fastMath.h"
+
+// ********************************************************************
+// data structure for storing data samples and calculating statistics
+#include "sampleStats.h"
+// array of data structures for storing data from sensors
+
+// data streams computed from other data streams when they are output (when ENABLE_DERIVED_STREAMS is defined)
+#include "derivedStreams.h"
+
+// separate acquisition and output rates for groups of data streams (when ENABLE_RATE_GROUPS is defined)
+#include "rateGroups.h"
+int gMain = -1; // main rate group (data file, every SAMPLING_PERIOD)
+int gSlow = -1; // slowly varying streams (temperature, humidity, altitude)
+int gImu = -1;  // accel, gyro and magnetometer summarized on a shorter interval (if IMU_OUTPUT_INTERVAL is defined)
+
+// burst reads of the accelerometer / gyro FIFO (when ENABLE_IMU_FIFO is defined)
+#include "imuFifo.h"
+
+// output intervals that follow the activity of a data stream (when ENABLE_ADAPTIVE_RATE is defined)
+#include "adaptiveRate.h"
+int kMotion = -1; // adaptive rate controller watching Az (climber motion)
+
+// *************** DATA_3: DATA STREAM INDICES ********************************************
+// * DECLARE int variables for storing index of each data stream (it is OK if it is not used)
+// * ***********************************************************************************
+// sensor indices to store where sensor data is stored in the array
+// FAST sensors are probed every time through the loop() function
+int iTime = -1;     // time at which data values are recorded (store in seconds)
+int iLoopTime = -1; // time spent during one pass through loop() function (store in ms)
+int iSimX = -1;     // simulated data value
+int iSimY = -1;     // simulated data value (sine function)
+int iSimTrace = -1; // simulated data value (replay of a data file)
+int iAx = -1;       // acceleration in x direction (long dimension of feather)
+int iAy = -1;       // acceleration in y direction (short dimension of feather)
+int iAz = -1;       // acceleration in z direction (perpendicular to feather surface)
+int iGx = -1;       // gyro in x direction (long dimension of feather)
+int iGy = -1;       // gyro in y direction (short dimension of feather)
+int iGz = -1;       // gyro in z direction (perpendicular to feather surface)
+int iMx = -1;       // magnetic field in x direction (long dimension of feather)
+int iMy = -1;       // magnetic field in y direction (short dimension of feather)
+int iMz = -1;       // magnetic field in z direction (perpendicular to feather surface)
+int iAlt = -1;      // altitude from barometric pressure
+int iTemp = -1;     // temperature (from humidity sensor)
+int iHumid = -1;    // humidity
+int iJitP99 = -1;   // 99th percentile of time between samples (ms) from loop timing
+int iJitMax = -1;   // maximum time between samples (ms) from loop timing
+int iWorstLoop = -1;  // longest pass through loop() (ms) from loop timing
+int iWorstPhase = -1; // phase of loop() that dominated the longest pass (LOOP_PHASE_ code)
+int iQueueUsed = -1;  // bytes waiting in the SD output queue
+int iQueueHigh = -1;  // most bytes that have been waiting in the SD output queue
+int iQueueDrop = -1;  // records dropped by the SD output queue
+int iAmag = -1;       // magnitude of the acceleration (derived stream)
+int iPitch = -1;      // pitch angle from Ax and Az (derived stream)
+int iDewPoint = -1;   // dew point from temperature and humidity (derived stream)
+
+// data structure for tracking control events (from buttons, thresholds of data values, etc)
+#include "eventTracker.h"
+// *************** EVENT_3: EVENT STREAM INDICES ********************************************
+// * DECLARE int variables for storing index of each event (it is OK if it is not used)
+// * ***********************************************************************************
+// define events to be used by the code for controlling various actions
+int jUserButton = -1; // user button on Adafruit Sense
+int jTopSwitch = -1;  // top switch on ling climber
+int jBotSwitch = -1;  // bottom switch on line climber
+int jPitch = -1;      // threshold on Ax
+int jRoll = -1;       // threshold on Ay
+int jTimer = -1;      // labels on CPU time
+//int jNoseUp = -1;     // threshold on Ax
+//int jNoseDown = -1;   // threshold on Ax
+#ifdef ENABLE_NEOPIXEL
+int jNeoPixel = -1; // neopixel state
+#endif
+
+// binary framed statistics and events on Serial (when ENABLE_SERIAL_TELEMETRY is defined)
+#include "serialTelemetry.h"
+
+// deferred debug messages written out when loop() is idle (when ENABLE_DEFERRED_DEBUG is defined)
+#include "debugLog.h"
+
+// event changes written to the event file in batches (when ENABLE_EVENT_QUEUE is defined)
+#include "eventQueue.h"
+
+// raw samples around trigger events written to a capture file (when ENABLE_CAPTURE is defined)
+#include "eventCapture.h"
+
+// ********************************************************************
+// functions that simulate sensors with randomness (seeded signals and replay of recorded data)
+#include "simulatedSensor.h"
+// *****************************
+
+// microbenchmarks of the hot paths, run from setup() when ENABLE_BENCHMARK is defined
+#include "benchmarkStats.h"
+
+int countSDLine = 0; // number of lines in SD data file
+int countEvents = 0; // number of lines in SD event file
+
+// variables for tracking time spent in functions
+unsigned long endTime = 0;
+unsigned long lastEndTime = 0;
+unsigned long startTime = 0;
+uint64_t startTimeMicros = 0; // monotonic time (us) at the start of the loop function
+
+unsigned long serialInterval = SERIAL_OUTPUT_INTERVAL; // time interval between serial output
+unsigned long nextSerialOutput = 0;                    // time at which to end sampling and write out data
+unsigned long samplingInterval = SAMPLING_PERIOD;      // time interval for collecting samples before next SampleOutput
+unsigned long nextSampleOutput = 0;                    // time at which to end sampling and write out data
+unsigned long slowDataInterval = SLOW_DATA_INTERVAL;   // time interval between updating slow data streams
+unsigned long nextSlowDataUpdate = 0;                  // time at which next set of slow data streams will be updated
+
+// varibales for controlling LED signals
+unsigned long LEDPhaseInterval = 2000; // long toggle between colors to indicate phase of operation and signal status
+unsigned long LEDSDInterval = 100;     // blink quickly to indicate that SD was accessed
+int LEDPhaseState = 0;                 // toggle 0 or 1
+int LEDPhaseUp = 1;                    // code for color when in active state (1)
+int LEDPhaseDown = -1;                 // code for color when in passive state (0)
+int LEDSDActive = 0;
+int LEDSDColor = 5; // code for color when SD is activated
+int LEDLevel = 40;  // brightness of LED
+unsigned long nextLEDPhaseChange = 0;
+unsigned long nextSDPhaseChange = 0;
+
+// timing variables for calculating trendline slope
+unsigned long timeReference = 0; // for trendline, subtract this time to calculate relative time
+unsigned long timeRelative = 0;  // relative time (in millis) for calculating trendline
+
+// **************************************************************************
+// **************************************************************************
+// * SETUP: start of setup() function
+// **************************************************************************
+void setup()
+{
+
+#ifdef ENABLE_NEOPIXEL
+  pixels.begin();                 // INITIALIZE NeoPixel strip object (REQUIRED)
+  pixelSet(LEDPhaseUp, LEDLevel); // SET to red LED for startup Stage
+#endif
+
+  Serial.begin(115200);
+  // remove following while block for field testing!!
+#ifdef WAIT_FOR_SERIAL
+  while (!Serial)
+  {
+    delay(10); // wait for serial monitor to open
+  }
+#endif
+
+  Serial.println("Starting DataloggerStats test program");
+  Serial.print("Filename = ");
+  Serial.println(__FILE__);
+  Serial.print("Date and Time Compiled = ");
+  Serial.print(__DATE__);
+  Serial.print(" : ");
+  Serial.println(__TIME__);
+
+  // -----------------------------------------------------------
+  // - setup the files for output to SD cards
+  // -----------------------------------------------------------
+#ifdef USE_SD
+  // determine a directory for storing files by date using "dYYMMDD"
+  // e.g. "d201222" for December 22, 2020
+  int statusDir = initializeSDFileDirectory();
+
+  // naming convention for files = "Dtype###.suffix" where "D" is the device code (1 char),
+  //    "type" is the type of file (3-4 char), "###" is the file number (next number kept in "Dtype.nxt"), and ".suffix" is the appropriate file suffix
+  // Zlog001.txt = create a log file (for mirroring messages to serial)
+  // the files are preallocated when ENABLE_LOG_PREALLOCATE is defined
+  int statusSD = setup_SD_file(deviceCode, "log", ".txt", logFileName, LOG_PREALLOCATE_BYTES);
+  statusSD = setup_SD_file(deviceCode, "data", DATA_FILE_SUFFIX, dataFileName, LOG_PREALLOCATE_BYTES);
+  statusSD = setup_SD_file(deviceCode, "evnt", ".csv", eventFileName, LOG_PREALLOCATE_BYTES);
+
+#ifdef ENABLE_OUTPUT_QUEUE
+  // rows are queued in RAM and written by outputQueueService(); files that could not be created
+  // because the card is missing are created when it comes back
+  outputQueueBegin(&sdQueue, OUTPUT_QUEUE_POLICY, statusDir == 1 && statusSD == 1);
+  outputQueueAddFile(&sdQueue, logFileName, "log", ".txt");
+  outputQueueAddFile(&sdQueue, dataFileName, "data", DATA_FILE_SUFFIX);
+  outputQueueAddFile(&sdQueue, eventFileName, "evnt", ".csv");
+#else
+  (void)statusDir; // setup_SD_file() reports a missing card
+#endif
+#ifdef ENABLE_TIME_INDEX
+  // e.g. Zdata000.idx next to Zdata000.csv, read by host/timeQuery
+#ifndef ENABLE_COMPRESSED_DATA
+  addTimeIndex(dataFileName);
+#endif
+  addTimeIndex(eventFileName);
+#endif
+#ifdef ENABLE_CAPTURE
+  // e.g. Zcapt000.bin: windows of raw samples around trigger events, read by host/decodeCapture
+  setup_SD_file(deviceCode, "capt", ".bin", captureFileName);
+#endif
+
+  pinMode(SENSE_BLUE, OUTPUT);
+  digitalWrite(SENSE_BLUE, LOW);
+  if (statusSD == 1)
+  {
+    LEDSDActive = 1;
+    // update neopixel LED
+    nextSDPhaseChange = millis() + LEDSDInterval;
+    pixelSet(LEDSDColor, LEDLevel);
+
+    // update status LED
+    //pinMode(SENSE_BLUE, OUTPUT);
+    digitalWrite(SENSE_BLUE, HIGH);
+  }
+  else
+  {
+    LEDSDActive = 1;
+    // update neopixel LED
+    nextSDPhaseChange = millis() + LEDSDInterval;
+    pixelSet(1, LEDLevel); // turn to red
+  }
+
+  // Zdata001.csv = create a data file (streaming sample data at regular time intervals)
+
+  // Zevnt001.txt = create an event file (recording time and messages for specific events to guide data analysis)
+
+#endif
+  // ---END of SD setup---------------------------------------------------
+
+  // *************** DATA_4: INITIALIZE DATA STREAMS ********************************************
+  // * INITIALIZE and configure each data stream
+  // * also make sure to initialize the sensor if needed
+  // * ***********************************************************************************
+  // ----------------------------------------------------------------
+  // -  INITIALIZE data streams that will be collected and recorded
+  // -  should also initialize the sensors as needed
+  // ----------------------------------------------------------------
+  // initialize a new data source (*** need to move this to a function to automate)
+  // iTime is index for the time of data point collection increments (n increments make the interval for the sample)
+  // variable indicating what stats to output to spreadsheets
+  // -1 = no output (just a variable for internal calculations)
+  // 0  = only output current value (no statistics)
+  // 1  = only output average
+  // 2  = output average and current
+  // 3  = output average and sample size
+  // 4  = output average and standard deviation
+  // 5  = output all info (including current and sample size)
+
+#ifdef ENABLE_RATE_GROUPS
+  // rate groups: streams are in the main group unless moved with setRateGroup()
+  gMain = addRateGroup(groups, &nGroups, "data", 0, SAMPLING_PERIOD);
+  gSlow = addRateGroup(groups, &nGroups, "slow", SLOW_DATA_INTERVAL, SLOW_OUTPUT_INTERVAL);
+#ifdef IMU_OUTPUT_INTERVAL
+  gImu = addRateGroup(groups, &nGroups, "imu", 0, IMU_OUTPUT_INTERVAL);
+#endif
+#endif
+
+  iTime = addDataStream(data, &nSamples, "CPUTimeInms", "CPUt", "s", 2);
+  DEBUG(iTime)
+
+  // iLoopTime is index for the time spent in the loop function
+  iLoopTime = addDataStream(data, &nSamples, "LoopTimeInterval", "loopt", "ms", 5);
+  DEBUG(iLoopTime)
+
+#ifdef ENABLE_SIMULATED_DATA
+  // iSimX is index for the simulated sensor variable
+  iSimX = addDataStream(data, &nSamples, "SimulatedSensor", "xSim", "arb", 4);
+  data[iSimX].calcTrendline = 1;
+  DEBUG(iSimX)
+
+  // iSimY is index for the simulated sensor variable
+  iSimY = addDataStream(data, &nSamples, "SimulatedSensorSine", "ySim", "arb", 4);
+  data[iSimY].calcTrendline = 1;
+  DEBUG(iSimY)
+
+  // the signals (see simulatedSensor.h): xSim = 1 + 5 t, ySim = 10 sin(2 pi t / 10 s), each +- 1 of noise
+  simulationBegin(simulationSeed);
+  int sig = addSimSignal(iSimX);
+  addSimComponent(sig, SIM_CONSTANT, 1., 0., 0.);
+  addSimComponent(sig, SIM_RAMP, 5., 0., 0.);
+  addSimComponent(sig, SIM_UNIFORM, 1., 0., 0.);
+  sig = addSimSignal(iSimY);
+  addSimComponent(sig, SIM_SINE, 10., 10., 0.);
+  addSimComponent(sig, SIM_UNIFORM, 1., 0., 0.);
+#ifdef USE_SD
+  if (simTraceColumn[0] != 0)
+  {
+    // replay a column of a data file recorded earlier
+    iSimTrace = addDataStream(data, &nSamples, "SimulatedTrace", "tSim", "arb", 4);
+    addSimTrace(addSimSignal(iSimTrace), SIM_TRACE_FILE, simTraceColumn, 1.);
+    DEBUG(iSimTrace)
+  }
+#endif
+#endif
+
+#ifdef ENABLE_SENSE_ACCEL
+  // iAx, iAy, iAz accelerometer sensor readings
+  lsm6ds33.begin_I2C(); // initialize accelerometer / gyro
+#ifdef ENABLE_IMU_FIFO
+  imuFifoBegin(&imuFifoLSM, &imuWireDriver, IMU_FIFO_ODR_CODE); // sample into the FIFO at a fixed rate
+#endif
+  iAx = addDataStream(data, &nSamples, "Accel in x", "Ax", "m/s^2", 4);
+  //data[iAx].calcTrendline = 1;
+  DEBUG(iAx)
+  iAy = addDataStream(data, &nSamples, "Accel in y", "Ay", "m/s^2", 4);
+  //data[iAy].calcTrendline = 1;
+  DEBUG(iAy)
+  iAz = addDataStream(data, &nSamples, "Accel in z", "Az", "m/s^2", 4);
+  DEBUG(iAz)
+  //data[iAz].calcTrendline = 1;
+#ifdef ENABLE_SENSE_GYRO
+  iGx = addDataStream(data, &nSamples, "Gyro in x", "Gx", "rad/s", 4);
+  DEBUG(iGx)
+  iGy = addDataStream(data, &nSamples, "Gyro in y", "Gy", "rad/s", 4);
+  DEBUG(iGy)
+  iGz = addDataStream(data, &nSamples, "Gyro in z", "Gz", "rad/s", 4);
+  DEBUG(iGz)
+#endif
+  setRateGroup(data, iAx, gImu);
+  setRateGroup(data, iAy, gImu);
+  setRateGroup(data, iAz, gImu);
+  setRateGroup(data, iGx, gImu);
+  setRateGroup(data, iGy, gImu);
+  setRateGroup(data, iGz, gImu);
+#endif
+
+#ifdef ENABLE_SENSE_HUMID
+  // humidity and temperature
+  sht30.begin();
+  iTemp = addDataStream(data, &nSamples, "Temperature in C from humid sensor", "TC", "C", 0);
+  DEBUG(iTemp)
+  iHumid = addDataStream(data, &nSamples, "Humidity", "RH", "percent", 0);
+  DEBUG(iHumid)
+  setRateGroup(data, iTemp, gSlow);
+  setRateGroup(data, iHumid, gSlow);
+#endif
+
+#ifdef ENABLE_SENSE_ALTIM
+  bmp280.begin(); // altitude, temp, pressure
+  // NOTE altimeter varies slowly; so do not collect statistics
+  iAlt = addDataStream(data, &nSamples, "Altitude barometric", "AOG", "m", 0);
+  //data[iAlt].calcTrendline = 1;
+  data[iAlt].baselineType = 2; // calculate baseline and subtract from data
+  DEBUG(iAlt)
+  setRateGroup(data, iAlt, gSlow);
+#endif
+
+#ifdef ENABLE_SENSE_MAG
+  lis3mdl.begin_I2C(); // magnetometer
+  iMx = addDataStream(data, &nSamples, "Magnetic Field in x", "Mx", "uT", 4);
+  DEBUG(iGx)
+  iMy = addDataStream(data, &nSamples, "Magnetic Field in y", "My", "uT", 4);
+  DEBUG(iGy)
+  iMz = addDataStream(data, &nSamples, "Magnetic Field in z", "Mz", "uT", 4);
+  DEBUG(iGz)
+  setRateGroup(data, iMx, gImu);
+  setRateGroup(data, iMy, gImu);
+  setRateGroup(data, iMz, gImu);
+#endif
+
+#ifdef ENABLE_DERIVED_STREAMS
+  // streams computed from the averages of the streams above when the sample is output, instead of
+  // on every pass through loop() (see derivedStreams.h)
+#ifdef ENABLE_SENSE_ACCEL
+  iAmag = addDerivedStream(data, &nSamples, "Accel magnitude", "Amag", "m/s^2", 1, "sqrt(Ax^2 + Ay^2 + Az^2)");
+  DEBUG(iAmag)
+  iPitch = addDerivedStream(data, &nSamples, "Pitch angle", "pitch", "deg", 1, "atan2(Ax, Az) * 180 / pi");
+  DEBUG(iPitch)
+#endif
+#ifdef ENABLE_SENSE_HUMID
+  // Magnus formula: g = ln(RH / 100) + 17.62 TC / (243.12 + TC), dew point = 243.12 g / (17.62 - g)
+  iDewPoint = addDerivedStream(data, &nSamples, "Dew point", "DP", "C", 0,
+                               "243.12 * (log(RH / 100) + 17.62 * TC / (243.12 + TC)) / (17.62 - log(RH / 100) - 17.62 * TC / (243.12 + TC))");
+  DEBUG(iDewPoint)
+#endif
+#endif
+
+#if defined(ENABLE_ADAPTIVE_RATE) && defined(ENABLE_SENSE_ACCEL)
+  // the rate group of Az (the main group, or gImu) is output every ADAPTIVE_FAST_PERIOD while the
+  // climber moves and decays to ADAPTIVE_SLOW_PERIOD at rest; rateMs records the interval of each row
+  kMotion = addAdaptiveRate(data, &nSamples, iAz, ADAPTIVE_THRESHOLD, ADAPTIVE_FAST_PERIOD, ADAPTIVE_SLOW_PERIOD, 0, 0, "rateMs");
+  DEBUG(kMotion)
+#endif
+
+#ifdef ENABLE_LOOP_TIMING
+  // loop timing diagnostics are written once per sample, so only output the current value
+  iJitP99 = addDataStream(data, &nSamples, "Sample interval 99th percentile", "jitP99", "ms", 0);
+  DEBUG(iJitP99)
+  iJitMax = addDataStream(data, &nSamples, "Sample interval maximum", "jitMax", "ms", 0);
+  DEBUG(iJitMax)
+  iWorstLoop = addDataStream(data, &nSamples, "Longest loop pass", "wLoop", "ms", 0);
+  DEBUG(iWorstLoop)
+  iWorstPhase = addDataStream(data, &nSamples, "Phase dominating longest loop pass", "wPhase", "code", 0);
+  DEBUG(iWorstPhase)
+#endif
+
+#ifdef ENABLE_OUTPUT_QUEUE
+  // state of the SD output queue at the end of each sample (current value only)
+  iQueueUsed = addDataStream(data, &nSamples, "Output queue bytes waiting", "qUsed", "bytes", 0);
+  DEBUG(iQueueUsed)
+  iQueueHigh = addDataStream(data, &nSamples, "Output queue high-water mark", "qHigh", "bytes", 0);
+  DEBUG(iQueueHigh)
+  iQueueDrop = addDataStream(data, &nSamples, "Output queue records dropped", "qDrop", "rows", 0);
+  DEBUG(iQueueDrop)
+#endif
+
+#ifdef ENABLE_PROFILER
+  // each profiled region is a data stream of its durations in us
+  initProfiler(data);
+  iProfSensor = addDataStream(data, &nSamples, "Profile sensor reads", "pSens", "us", 5);
+  DEBUG(iProfSensor)
+  iProfUpdate = addDataStream(data, &nSamples, "Profile updateDataSample", "pUpd", "us", 5);
+  DEBUG(iProfUpdate)
+  iProfEvents = addDataStream(data, &nSamples, "Profile event evaluation", "pEvt", "us", 5);
+  DEBUG(iProfEvents)
+  iProfFormat = addDataStream(data, &nSamples, "Profile CSV formatting", "pFmt", "us", 5);
+  DEBUG(iProfFormat)
+  iProfSDWrite = addDataStream(data, &nSamples, "Profile SD writes", "pSD", "us", 5);
+  DEBUG(iProfSDWrite)
+  iProfSerial = addDataStream(data, &nSamples, "Profile Serial writes", "pSer", "us", 5);
+  DEBUG(iProfSerial)
+#endif
+
+  timeReference = millis(); // initialize the reference time for trendline calculations
+
+  MESSAGE("Number of data streams ", nSamples)
+
+  //
+  // ********************* Need to add function for printing data stream summary to log file
+  //
+
+  // print headers to file for spreadsheet datalogging
+  int status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ",", countSDLine, 1, MAIN_RATE_GROUP); // use commas to separate columns in table (8 char width)
+
+#ifdef ENABLE_RATE_GROUPS
+  // each of the other rate groups gets its own spreadsheet file, e.g. Zslow000.csv
+  countRateGroupStreams(data, nSamples, groups, nGroups);
+#ifdef USE_SD
+  for (int g = 0; g < nGroups; g++)
+  {
+    if (g != gMain && groups[g].nStreams > 0)
+    {
+      setup_SD_file(deviceCode, groups[g].fileType, DATA_FILE_SUFFIX, groups[g].fileName, LOG_PREALLOCATE_BYTES);
+#ifdef ENABLE_OUTPUT_QUEUE
+      outputQueueAddFile(&sdQueue, groups[g].fileName, groups[g].fileType, DATA_FILE_SUFFIX);
+#endif
+#if defined(ENABLE_TIME_INDEX) && !defined(ENABLE_COMPRESSED_DATA)
+      addTimeIndex(groups[g].fileName);
+#endif
+#ifdef ENABLE_LOG_ROTATION
+      logRotationBegin(&groups[g].rotation, groups[g].fileName, groups[g].fileType, DATA_FILE_SUFFIX, LOG_ROTATE_BYTES, LOG_ROTATE_PERIOD);
+#endif
+      status = printSampleStatSpreadsheetToFile(groups[g].fileName, data, nSamples, ",", groups[g].countLine, 1, g);
+    }
+  }
+#endif
+#endif
+
+  // *************** EVENT_4: INITIALIZE EVENTS ********************************************
+  // * INITIALIZE and configure each event
+  // * also make sure to initialize any devices or libraries if needed
+  // * event types:
+  // *  0 = button or switch (boolean: 0 = passive and 1 = active) associated with a pin
+  // *  1 = threshold indicator (boolean: 0 = inside of threshold limit and 1 = outside of threshold limit)
+  // *  2 = state (integer correponding to preset states) using some other type of user-coded logic
+  // * ***********************************************************************************
+#ifdef SENSE_BUTTON
+  //char eventStatesTemp[EVENT_STATES_MAX] [EVENT_NAME_SHORT] = {"PRESS", "RELEASE"};
+  //jUserButton = addEvent(events, &nEvents, "Sense User Button", "ButS", 2, eventStatesTemp, 0, 1);
+  jUserButton = addEvent(events, &nEvents, "Sense User Button", "ButS", 0, 1, 2, "PRESS", "RELEASE");
+  // note the User Button on the Adafruit Sense is 0 when pressed
+  linkEventToPin(events, jUserButton, SENSE_BUTTON);
+  DEBUG(jUserButton)
+#endif
+
+  if (iAx != -1) // create thresholds indicating that the device is pitched nose up or nose down
+  {
+    jPitch = addEvent(events, &nEvents, "Pitch Angle States", "Pitch", 1, 1, 3, "NOSEDWN", "NOSELVL", "NOSEUP");
+    setEventBreakpoints(events, jPitch, iAx, -8.0, 8.0);
+    jRoll = addEvent(events, &nEvents, "Roll Angle States", "Roll", 1, 1, 3, "LEFTUP", "ROLLLVL", "RIGHTUP");
+    setEventBreakpoints(events, jRoll, iAy, -8.0, 8.0);
+  }
+
+  if (iTime != -1) // create thresholds for time periods
+  {
+    jTimer = addEvent(events, &nEvents, "Timer for session", "Timer", 1, 0, 4, "INIT", "BASELN", "COLLECT", "SHUTDOWN");
+    setEventBreakpoints(events, jTimer, iTime, 5., 35., 3600.);
+  }
+
+#ifdef ENABLE_CAPTURE
+  // the raw accelerations around a hit of the top switch (once its event is linked to
+  // SENSE_TOPSWITCH) or a change of the pitch state
+  addCaptureStream(data, iAx, CAPTURE_PRE_SAMPLES, CAPTURE_POST_SAMPLES);
+  addCaptureStream(data, iAy, CAPTURE_PRE_SAMPLES, CAPTURE_POST_SAMPLES);
+  addCaptureStream(data, iAz, CAPTURE_PRE_SAMPLES, CAPTURE_POST_SAMPLES);
+  addCaptureTrigger(events, jTopSwitch);
+  addCaptureTrigger(events, jPitch);
+#endif
+
+  status = reportEventToFile(eventFileName, events, nEvents, 0, ",", countEvents, 1); // print event header
+
+#ifdef ENABLE_LOG_ROTATION
+  // data and event files move on to the next file number by size or period (see logRotation.h)
+  logRotationBegin(&dataRotation, dataFileName, "data", DATA_FILE_SUFFIX, LOG_ROTATE_BYTES, LOG_ROTATE_PERIOD);
+  logRotationBegin(&eventRotation, eventFileName, "evnt", ".csv", LOG_ROTATE_BYTES, LOG_ROTATE_PERIOD);
+#endif
+
+  //
+  // ********************* Need to add function for printing event tracker summary to log file
+  //
+
+  // initialize LED signals
+  nextLEDPhaseChange = millis() + LEDPhaseInterval;
+  LEDPhaseState = 1;
+  pixelSet(LEDPhaseUp, LEDLevel); // SET to red LED for startup Stage
+
+#ifdef ENABLE_BENCHMARK
+  // print benchmark results to Serial before logging starts
+  runBenchmarks(Serial, BENCH_ITERATIONS);
+#endif
+#ifdef ENABLE_SERIAL_TELEMETRY
+  requestTelemetrySchema(); // the streams and events are all defined: send their names once
+#endif
+
+  // ---------------------------------------------------------------------
+  // - set up timing variables
+  // ---------------------------------------------------------------------
+  endTime = millis(); // time at end of setup function in millis
+  lastEndTime = endTime;
+  nextSerialOutput = endTime + serialInterval;
+  nextSampleOutput = endTime + samplingInterval;
+  nextSlowDataUpdate = endTime + slowDataInterval;
+  startTime = millis(); // time at start of loop function in millis
+#ifdef ENABLE_ABSOLUTE_TIME
+  timeBaseBegin(&clockBase); // anchor absolute time to the RTC (waits up to 1 s for the RTC seconds to change)
+#ifdef ENABLE_LOG_ROTATION
+  // the period boundaries are on the wall clock only now
+  logRotationStartPeriod(&dataRotation);
+  logRotationStartPeriod(&eventRotation);
+#if defined(ENABLE_RATE_GROUPS) && defined(USE_SD)
+  for (int g = 0; g < nGroups; g++)
+  {
+    if (g != gMain && groups[g].nStreams > 0)
+    {
+      logRotationStartPeriod(&groups[g].rotation);
+    }
+  }
+#endif
+#endif
+#endif
+  startTimeMicros = monoMicros(); // time at start of loop function in us
+  DEBUG((unsigned long)startTimeMicros)
+  LOOP_TIMING_INIT()
+  (void)status; // the calls above report their own errors
+}
+// ** end of SETUP function
+// **************************************************************************
+
+// **************************************************************************
+// * LOOP: start of loop function
+// **************************************************************************
+void loop()
+{
+  unsigned long loopStartTime = millis();
+  LOOP_TIMING_START()
+
+  // *************** DATA_5: UPDATE DATA STREAM ********************************************
+  // * UPDATE each data stream with sensor values or calculated values
+  // * ***********************************************************************************
+  // ---------------------------------------------------------------------
+  // - UPDATE data streams
+  // -      FAST data streams update on every pass through loop()
+  // -      SLOW data streams update when the appropriate time increment has passes
+  // -  ** NOTE: the updating actions should be moved to a function to simplify this section
+  // ---------------------------------------------------------------------
+
+  // FAST DATA update values of all data that is collected as fast as possible
+  // current time
+  uint64_t loopMonoMicros = monoMicros(); // monotonic time of this pass
+  float currentTime = (float)(((double)loopMonoMicros) / 1000000.);
+#ifdef ENABLE_ABSOLUTE_TIME
+  timeBaseService(&clockBase, loopMonoMicros); // re-anchors to the RTC every TIME_BASE_REFRESH_INTERVAL
+#endif
+  timeRelative = millis() - timeReference;            // find relative time for trendline slope
+  float relativeTime = ((float)timeRelative) / 1000.; // time used for trendline slope
+
+  int status = updateDataSample(data, iTime, currentTime); // current CPU time in seconds
+
+#ifdef ENABLE_SIMULATED_DATA
+  // simulated data (the signals are defined in setup())
+  updateSimulatedStreams(data, loopMonoMicros, relativeTime);
+#endif
+
+#ifdef ENABLE_SENSE_ACCEL
+#ifdef ENABLE_IMU_FIFO
+  // Accelerometer and gyro data: drain the FIFO on its own interval and before each sample is output
+  if (millis() > nextImuFifoDrain || millis() > nextSampleOutput)
+  {
+    PROFILE_REGION(iProfSensor)
+    status = imuFifoUpdateDataStreams(&imuFifoLSM, data, iAx, iAy, iAz, iGx, iGy, iGz, relativeTime);
+    nextImuFifoDrain = millis() + IMU_FIFO_DRAIN_INTERVAL;
+  }
+#else
+  // Accelerometer data
+  sensors_event_t accel;
+  sensors_event_t gyro;
+  sensors_event_t temp;
+  {
+    PROFILE_REGION(iProfSensor)
+    lsm6ds33.getEvent(&accel, &gyro, &temp);
+  }
+  // accel_x = accel.acceleration.x;
+  // accel_y = accel.acceleration.y;
+  // accel_z = accel.acceleration.z;
+  //gyro_x = gyro.gyro.x;
+  //gyro_y = gyro.gyro.y;
+  //gyro_z = gyro.gyro.z;
+  status = updateDataSample(data, iAx, accel.acceleration.x, relativeTime);
+  status = updateDataSample(data, iAy, accel.acceleration.y, relativeTime);
+  status = updateDataSample(data, iAz, accel.acceleration.z, relativeTime);
+#ifdef ENABLE_SENSE_GYRO
+  status = updateDataSample(data, iGx, gyro.gyro.x, relativeTime);
+  status = updateDataSample(data, iGy, gyro.gyro.y, relativeTime);
+  status = updateDataSample(data, iGz, gyro.gyro.z, relativeTime);
+#endif
+#endif
+#endif
+
+  // #ifdef ENABLE_SENSE_ALTIM
+  //   float altitude = bmp280.readAltitude(1013.25);
+  //   status = updateDataSample(data, iAlt, altitude, relativeTime);
+  // #endif
+
+#ifdef ENABLE_SENSE_MAG
+  {
+    PROFILE_REGION(iProfSensor)
+    lis3mdl.read();
+  }
+  status = updateDataSample(data, iMx, lis3mdl.x, relativeTime);
+  status = updateDataSample(data, iMy, lis3mdl.y, relativeTime);
+  status = updateDataSample(data, iMz, lis3mdl.z, relativeTime);
+#endif
+  LOOP_TIMING_PHASE(LOOP_PHASE_SENSOR)
+
+#ifdef ENABLE_RANDOM_DELAY
+  // add short random delay here to avoid serendipitous synchronization of sensor variations
+  delayMicroseconds(random(10, 2000)); // random delay of 0.01 to 2 ms
+#endif
+  //delay(5);
+  float currentLoopTime = ((float)(monoMicros() - startTimeMicros)) / 1000.; // convert to ms (monoMicros() does not roll over)
+  status = updateDataSample(data, iLoopTime, currentLoopTime); // current loop time in ms
+  LOOP_TIMING_PHASE(LOOP_PHASE_OTHER)
+
+  // SLOW DATA update values of data if sufficient time has passed to probe the sensor again
+#ifdef ENABLE_RATE_GROUPS
+  if (rateGroupAcquireDue(groups, gSlow, millis()))
+#else
+  if (millis() > nextSlowDataUpdate)
+#endif
+  {
+#ifdef ENABLE_RATE_GROUPS
+    relativeTime = rateGroupRelativeTime(groups, gSlow, millis()); // trendlines are relative to the start of the group's sample
+#endif
+    // time to update the slow data sources
+    // humidity and temperature from sht30
+    //humidity = sht30.readHumidity();
+    //temperatureSHT = sht30.readTemperature();
+#ifdef ENABLE_SENSE_HUMID
+    float temperatureSHT;
+    float humiditySHT;
+    {
+      PROFILE_REGION(iProfSensor)
+      temperatureSHT = sht30.readTemperature();
+      humiditySHT = sht30.readHumidity();
+    }
+    status = updateDataSample(data, iTemp, temperatureSHT); // current loop time in ms
+    status = updateDataSample(data, iHumid, humiditySHT);   // current loop time in ms
+#endif
+
+#ifdef ENABLE_SENSE_ALTIM
+    float altitude;
+    {
+      PROFILE_REGION(iProfSensor)
+      altitude = bmp280.readAltitude(1013.25);
+    }
+    status = updateDataSample(data, iAlt, altitude, relativeTime);
+#endif
+
+    nextSlowDataUpdate = millis() + slowDataInterval;
+  }
+  LOOP_TIMING_PHASE(LOOP_PHASE_SENSOR)
+
+  // *************** EVENT_5: UPDATE EVENTS ********************************************
+  // * UPDATE each event
+  // * ***********************************************************************************
+  // ---------------------------------------------------------------------
+  // - CHECK for state events (button press, switch change, thresholds)
+  // -   to control change of
+  // -       - STATE of the program (e.g. initialization, baseline, calibration, collection, shutdown, sleep, etc.)
+  // -       - STATUS (warnings and error messages)
+  // -       - MODE (e.g. standby, climb, descent, idle, etc.)
+  // ---------------------------------------------------------------------
+  // FAST UPDATES to events (checked on every pass through loop)
+  // move to function: checkDigitalPins();
+  PROFILE_REGION_NAMED(fastEventTimer, iProfEvents)
+  for (int j = 0; j < nEvents; j++)
+  {
+    int stype = events[j].eventType;
+    if (stype == 0)
+    {
+      // this event is a digital button/switch
+      int pinState = digitalRead(events[j].pin);
+      if (pinState != events[j].state)
+      {
+        // pin State has changed!
+        updateEventState(events, j, pinState, loopStartTime);
+
+        reportEventToSerial(events, nEvents, j);
+
+        countEvents++;
+#ifdef USE_SD
+        reportEventToFile(eventFileName, events, nEvents, j, ",", countEvents, 0); // print event as CSV file
+#endif
+      }
+      else
+      {
+        // pin State has not changed
+        events[j].priorState = pinState;
+        events[j].justUpdated = 0; // indicates a repeated state
+      }
+    }
+    else if (stype == 1)
+    {
+      // this event is a threshold indicator
+      // do nothing here - only evaluate thresholds after sample is complete (based on averages)
+    }
+    else
+    {
+      // this event is a state indicator
+    }
+  }
+  PROFILE_STOP(fastEventTimer)
+
+#ifdef ENABLE_ADAPTIVE_RATE
+  if (adaptiveRateTriggered(data, MAIN_RATE_GROUP))
+  {
+    nextSampleOutput = millis() - 1; // activity: end the sample now rather than wait out a slow interval
+  }
+#endif
+
+  // SLOW UPDATES to events (checked only when sampling time or other indicator is complete)
+  if (millis() > nextSampleOutput)
+  {
+    PROFILE_REGION_NAMED(slowEventTimer, iProfEvents)
+
+    //
+    // calculate sample statistics from current data for specific variables as needed
+    //
+    updateSampleStats(data, nSamples, MAIN_RATE_GROUP); // streams in other rate groups keep the statistics of their last output
+
+    // loop through event and check their status
+    for (int j = 0; j < nEvents; j++)
+    {
+      int stype = events[j].eventType;
+      if (stype == 0)
+      {
+        // this event is a digital button/switch - do nothing here - digital pins are checked in the fast section
+      }
+      else if (stype == 1)
+      {
+#ifdef ENABLE_RATE_GROUPS
+        if (data[events[j].thresholdDataIndex].rateGroup != gMain)
+        {
+          continue; // evaluated when the rate group of its stream is output (below)
+        }
+#endif
+        // this event is a threshold indicator: find the state from the corresponding data(sensor) value
+        int currentState = evaluateEventBreakpoints(events, j, data);
+
+        if (currentState != events[j].state)
+        {
+          // threshold State has changed!
+          updateEventState(events, j, currentState, loopStartTime);
+
+          reportEventToSerial(events, nEvents, j);
+
+          countEvents++;
+          reportEventToFile(eventFileName, events, nEvents, j, ",", countEvents, 0); // print event as CSV file
+        }
+        else
+        {
+          // pin State has not changed
+          events[j].priorState = currentState;
+          events[j].justUpdated = 0; // indicates a repeated value
+        }
+      }
+      else
+      {
+        // this event is a state indicator
+      }
+    } // DO NOT RESET nextSampleOutput time here! It is updated when the sample data is
+    //    communicated to Serial and/or File in later section
+
+    if (events[jTimer].justUpdated == 1)
+    {
+      if (events[jTimer].state == 1)
+      {
+        LEDPhaseUp = 2; // yellow
+      }
+      else if (events[jTimer].state == 2)
+      {
+        LEDPhaseUp = 3; // green
+      }
+      else if (events[jTimer].state == 3)
+      {
+        LEDPhaseUp = 1; // red
+      }
+    }
+
+    PROFILE_STOP(slowEventTimer)
+
+    // handle baseline collection
+    if (events[jTimer].state == 1)
+    {
+      // add current sample averages into baseline
+      MESSAGE("Adding samples into baseline", events[jTimer].state)
+      MESSAGE("Adding samples into baseline", events[jTimer].eventStateName[events[jTimer].state])
+
+      addSamplesToBaseline(data, nSamples, MAIN_RATE_GROUP);
+    }
+    else if ((events[jTimer].state == 2) && (events[jTimer].justUpdated == 1))
+    {
+      // calculate baseline and print to serial and log file
+      MESSAGE("Done calculating Baselines", events[jTimer].state)
+      for (int i = 0; i < nSamples; i++)
+      {
+        float average = 0.;
+        float variance = 0.;
+        float standardDeviation = 0.;
+        float sampleSize = (float)data[i].baselineCount;
+
+        if (data[i].baselineCount == 0)
+        {
+          WARN("BASELINE SAMPLE EMPTY!", data[i].baselineCount)
+        }
+        else
+        {
+          average = data[i].baselineSum / sampleSize;
+          variance = (data[i].baselineSumX2 - data[i].baselineSum * data[i].baselineSum / sampleSize) / (sampleSize - 1.);
+          if (variance < 0.)
+          {
+            WARN("negative variance in baseline var = ", variance)
+            WARN("negative variance in baseline data = ", i)
+            standardDeviation = 0.;
+          }
+          else
+          {
+            standardDeviation = mathSqrt(variance);
+          }
+
+          if (data[i].baselineType == 2)
+          {
+            MESSAGE("updating baseline for variable", i)
+            MESSAGE("updated baseline = ", average)
+            data[i].baseline = average;
+          }
+          // print out baseline stats
+          Serial.print("BASELINE evaluated for variable: ");
+          Serial.print(data[i].dataNickName);
+          Serial.print(" avg = ");
+          Serial.print(average);
+          Serial.print(" stdev = ");
+          Serial.print(standardDeviation);
+          Serial.print(" size n = ");
+          Serial.print(data[i].baselineCount);
+          Serial.print(" baseline = ");
+          Serial.println(data[i].baseline);
+
+#ifdef USE_SD
+          File tmpFile;
+          tmpFile = openLogFile(logFileName);
+          if (tmpFile)
+          {
+            // print out baseline stats to log file
+            tmpFile.print("BASELINE evaluated for variable: ");
+            tmpFile.print(data[i].dataNickName);
+            tmpFile.print(" avg = ");
+            tmpFile.print(average);
+            tmpFile.print(" stdev = ");
+            tmpFile.print(standardDeviation);
+            tmpFile.print(" size n = ");
+            tmpFile.print(data[i].baselineCount);
+            tmpFile.print(" baseline = ");
+            tmpFile.println(data[i].baseline);
+            closeLogFile(tmpFile, logFileName);
+          }
+#endif
+        }
+      }
+    }
+  }
+  LOOP_TIMING_PHASE(LOOP_PHASE_EVENTS)
+
+  // ---------------------------------------------------------------------
+  // - ACTIONS (some actions may have been taken in the UPDATE section)
+  // -
+  // ---------------------------------------------------------------------
+
+  // ---------------------------------------------------------------------
+  // -  COMMUNICATION (if sufficient time has passed, prepare data for output and write it out)
+  // ---------------------------------------------------------------------
+  if (millis() > nextSampleOutput)
+  {
+    //
+    // calculate sample statistics from current data for all data streams
+    //
+    // updateSampleStats(data, nSamples); // already has been updated in prior block
+
+    if (millis() > nextSerialOutput) // if sufficient time has passed also write data to serial (and log file)
+    {
+      unsigned long startOutputTime = millis();
+      //MESSAGE("time to write out data", nextSampleOutput)
+      // create function call to automatically print out data in suitable formats
+      //   - to Serial monitor (for debugging) which should be mirrored to a log file when using SD card
+      //   - to CSV or JSON file on SC
+      //   - messages transmitted via LoRa radio, BlueTooth, Meshtastic, etc.
+      printSampleStatTableToSerial(data, nSamples, "\t"); // use tabs to separate columns in table (8 char width)
+#ifdef USE_SD
+      printSampleStatTableToFile(logFileName, data, nSamples, "\t"); // use commas to separate columns in table (8 char width)
+#endif
+      //countSDLine++;                                                                                // increment counter on number of lines printed to SD data file
+      //status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ",", countSDLine, 0); // use commas to separate columns in table (8 char width)
+
+      // RESET samples!
+      //resetSampleStats(data, nSamples);
+
+      //   nextSampleOutput += samplingInterval;
+      nextSerialOutput = millis() + serialInterval;
+      //    DEBUG(nextSampleOutput)
+
+#ifdef ENABLE_SERIAL_TELEMETRY
+      // loop timing, output queue and profiler results are data streams, so they are in the statistics frame
+      sendTelemetryDiagnostics(millis() - startOutputTime);
+#else
+#ifdef ENABLE_PROFILER
+      printProfileReport(Serial, data, millis() - timeReference); // replaces the hand timing of output
+      (void)startOutputTime; // the profiler times the output
+#else
+      unsigned long endOutputTime = millis();
+      Serial.print("Time Spent on Serial Output Communication = ");
+      Serial.print(endOutputTime - startOutputTime);
+      Serial.println(" ms");
+#endif
+#ifdef ENABLE_LOOP_TIMING
+      printLoopTiming(Serial, &loopTimer);
+#endif
+#ifdef ENABLE_OUTPUT_QUEUE
+      printOutputQueueStatus(Serial, &sdQueue);
+#endif
+#ifdef ENABLE_COMPRESSED_DATA
+      printDataCodecStatus(Serial);
+#endif
+#ifdef ENABLE_EVENT_QUEUE
+      printEventQueueStatus(Serial);
+#endif
+#ifdef ENABLE_TIME_INDEX
+      printTimeIndexStatus(Serial);
+#endif
+#ifdef ENABLE_CAPTURE
+      printCaptureStatus(Serial);
+#endif
+#ifdef ENABLE_DEFERRED_DEBUG
+      printDebugLogStatus(Serial);
+#endif
+#endif
+      LOOP_TIMING_PHASE(LOOP_PHASE_SERIAL)
+    }
+
+#ifdef ENABLE_LOOP_TIMING
+    // copy loop timing diagnostics for this sample into their data streams (converted to ms)
+    status = updateDataSample(data, iJitP99, ((float)loopTimingPercentile(&loopTimer, 99.)) / 1000.);
+    status = updateDataSample(data, iJitMax, ((float)loopTimer.maxInterval) / 1000.);
+    status = updateDataSample(data, iWorstLoop, ((float)loopTimer.worstLoop) / 1000.);
+    status = updateDataSample(data, iWorstPhase, (float)loopTimer.worstPhase);
+#endif
+#ifdef ENABLE_OUTPUT_QUEUE
+    status = updateDataSample(data, iQueueUsed, (float)sdQueue.used);
+    status = updateDataSample(data, iQueueHigh, (float)sdQueue.highWater);
+    status = updateDataSample(data, iQueueDrop, (float)sdQueue.dropped);
+#endif
+
+#ifdef ENABLE_ADAPTIVE_RATE
+    samplingInterval = adaptRateGroup(data, MAIN_RATE_GROUP, samplingInterval); // records the interval of this row, then follows the activity
+#endif
+
+    unsigned long startOutputTime = millis();
+    //MESSAGE("time to write out data", nextSampleOutput)
+    // create function call to automatically print out data in suitable formats
+    //   - to Serial monitor (for debugging) which should be mirrored to a log file when using SD card
+    //   - to CSV or JSON file on SC
+    //   - messages transmitted via LoRa radio, BlueTooth, Meshtastic, etc.
+    //int status = printSampleStatTableToSerial(data, nSamples, "\t");                              // use tabs to separate columns in table (8 char width)
+    //status = printSampleStatTableToFile(logFileName, data, nSamples, "\t");                       // use commas to separate columns in table (8 char width)
+    int rolledUp = 0;
+#ifdef USE_SD
+#ifdef ENABLE_LOG_ROTATION
+    // each new file starts with the preamble and header, so it can be read on its own
+    if (logRotationDue(&dataRotation) && rotateLogFile(&dataRotation) == 1)
+    {
+      printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ",", countSDLine, 1, MAIN_RATE_GROUP);
+    }
+    if (logRotationDue(&eventRotation) && rotateLogFile(&eventRotation) == 1)
+    {
+      reportEventToFile(eventFileName, events, nEvents, 0, ",", countEvents, 1);
+    }
+#endif
+    countSDLine++;                                                                                     // increment counter on number of lines printed to SD data file
+    int status = printSampleStatSpreadsheetToFile(dataFileName, data, nSamples, ", ", countSDLine, 0, MAIN_RATE_GROUP); // use commas to separate columns in table (8 char width)
+    if (status == OUTPUT_ROLLED_UP)
+    {
+      // the output queue is backed up: keep accumulating, the next row covers this sample too
+      // (the skipped line number in the count column marks the rollup)
+      rolledUp = 1;
+    }
+    else if (status == 1)
+    {
+      // update neopixel LED
+      LEDSDActive = 1;
+      nextSDPhaseChange = millis() + LEDSDInterval;
+      pixelSet(LEDSDColor, LEDLevel);
+
+      // update status LED
+      pinMode(SENSE_BLUE, OUTPUT);
+      digitalWrite(SENSE_BLUE, HIGH);
+    }
+    else
+    {
+      LEDSDActive = 1;
+      // update neopixel LED
+      nextSDPhaseChange = millis() + LEDSDInterval;
+      pixelSet(1, LEDLevel); // turn to red
+    }
+#endif
+    // RESET samples!
+    if (!rolledUp)
+    {
+      resetSampleStats(data, nSamples, MAIN_RATE_GROUP);
+      timeReference = millis(); // initialize the reference time for trendline calculations
+    }
+
+    //   nextSampleOutput += samplingInterval;
+    nextSampleOutput = millis() + samplingInterval;
+    //    DEBUG(nextSampleOutput)
+
+#if defined(ENABLE_SERIAL_TELEMETRY)
+    telemetryDataFileMillis = millis() - startOutputTime; // sent with the next diagnostics frame
+#elif !defined(ENABLE_PROFILER)
+    unsigned long endOutputTime = millis();
+    Serial.print("Time Spent on DataFile Output Communication = ");
+    Serial.print(endOutputTime - startOutputTime);
+    Serial.println(" ms");
+#else
+    (void)startOutputTime; // the profiler times the output
+#endif
+    LOOP_TIMING_PHASE(LOOP_PHASE_SD)
+    LOOP_TIMING_RESET() // start collecting loop timing for the next sample when this pass ends
+  }
+
+#ifdef ENABLE_RATE_GROUPS
+  // finalize, write and reset each of the other rate groups on its own output interval
+  for (int g = 0; g < nGroups; g++)
+  {
+#ifdef ENABLE_ADAPTIVE_RATE
+    if (g != gMain && adaptiveRateTriggered(data, g))
+    {
+      groups[g].nextOutput = millis() - 1; // activity: output the group now
+    }
+#endif
+    if (g != gMain && rateGroupOutputDue(groups, g, millis()))
+    {
+      updateSampleStats(data, nSamples, g);
+      // threshold events on the streams of the group see the statistics of its own interval
+      for (int j = 0; j < nEvents; j++)
+      {
+        if (events[j].eventType != 1 || data[events[j].thresholdDataIndex].rateGroup != g)
+        {
+          continue;
+        }
+        int currentState = evaluateEventBreakpoints(events, j, data);
+        if (currentState != events[j].state)
+        {
+          updateEventState(events, j, currentState, loopStartTime);
+          reportEventToSerial(events, nEvents, j);
+          countEvents++;
+          reportEventToFile(eventFileName, events, nEvents, j, ",", countEvents, 0);
+        }
+        else
+        {
+          events[j].priorState = currentState;
+          events[j].justUpdated = 0; // indicates a repeated value
+        }
+      }
+#ifdef ENABLE_ADAPTIVE_RATE
+      groups[g].outputInterval = adaptRateGroup(data, g, groups[g].outputInterval);
+      groups[g].acquireInterval = adaptiveAcquireInterval(data, g, groups[g].acquireInterval);
+      groups[g].nextOutput = millis() + groups[g].outputInterval;
+#endif
+      if (events[jTimer].state == 1)
+      {
+        addSamplesToBaseline(data, nSamples, g);
+      }
+#ifdef USE_SD
+#ifdef ENABLE_LOG_ROTATION
+      if (logRotationDue(&groups[g].rotation) && rotateLogFile(&groups[g].rotation) == 1)
+      {
+        printSampleStatSpreadsheetToFile(groups[g].fileName, data, nSamples, ",", groups[g].countLine, 1, g);
+      }
+#endif
+      groups[g].countLine++;
+      status = printSampleStatSpreadsheetToFile(groups[g].fileName, data, nSamples, ", ", groups[g].countLine, 0, g);
+      if (status == OUTPUT_ROLLED_UP)
+      {
+        continue; // keep accumulating until the output queue has room
+      }
+#endif
+      resetSampleStats(data, nSamples, g);
+      groups[g].timeReference = millis();
+    }
+  }
+  LOOP_TIMING_PHASE(LOOP_PHASE_SD)
+#endif
+
+#ifdef ENABLE_EVENT_QUEUE
+  // write the event changes that have waited EVENT_QUEUE_INTERVAL
+  serviceEventQueue(events);
+  LOOP_TIMING_PHASE(LOOP_PHASE_SD)
+#endif
+#ifdef ENABLE_OUTPUT_QUEUE
+  // write part of the queued output to the SD card (or retry a missing card)
+  outputQueueService(&sdQueue);
+  LOOP_TIMING_PHASE(LOOP_PHASE_SD)
+#endif
+#ifdef ENABLE_GROUP_COMMIT
+  serviceLogFiles(); // sync files whose rows have waited LOG_COMMIT_INTERVAL
+#endif
+#ifdef ENABLE_TIME_INDEX
+  serviceTimeIndex(); // append the index entries of rows already written
+#endif
+#ifdef ENABLE_CAPTURE
+  serviceEventCapture(CAPTURE_WRITE_BYTES); // complete a triggered window and write part of it
+  LOOP_TIMING_PHASE(LOOP_PHASE_SD)
+#endif
+#ifdef ENABLE_SERIAL_TELEMETRY
+  serviceTelemetry(); // pass queued telemetry frames to Serial without blocking
+  LOOP_TIMING_PHASE(LOOP_PHASE_SERIAL)
+#endif
+#ifdef ENABLE_DEFERRED_DEBUG
+  // write the recorded debug messages while there is time before the next output
+  serviceDebugLog(nextSampleOutput < nextSerialOutput ? nextSampleOutput : nextSerialOutput);
+  LOOP_TIMING_PHASE(LOOP_PHASE_SERIAL)
+#endif
+
+  // ouput chunks of raw data if needed
+
+  // update LED
+  if (LEDSDActive && (millis() > nextSDPhaseChange))
+  {
+    //MESSAGE("Turn off blue SD LED", LEDSDActive)
+    LEDSDActive = 0;
+    digitalWrite(SENSE_BLUE, LOW);
+    if (LEDPhaseState == 0)
+    {
+      pixelSet(LEDPhaseDown, LEDLevel);
+    }
+    else
+    {
+      pixelSet(LEDPhaseUp, LEDLevel);
+    }
+  }
+
+#ifdef ENABLE_NEOPIXEL
+  if (millis() > nextLEDPhaseChange)
+  {
+    nextLEDPhaseChange = millis() + LEDPhaseInterval;
+    if (LEDPhaseState == 0)
+    {
+      LEDPhaseState = 1;
+      pixelSet(LEDPhaseUp, LEDLevel);
+    }
+    else
+    {
+      LEDPhaseState = 0;
+      pixelSet(LEDPhaseDown, LEDLevel);
+    }
+  }
+#endif
+
+  // ---------------------------------------------------------------------
+  // - update some of the timing variables
+  endTime = millis(); // time at end of loop function in millis
+  lastEndTime = endTime;
+  // DEBUG(endTime - startTime) // loop time
+
+  startTime = millis();       // time at start of loop function in millis
+  startTimeMicros = monoMicros(); // time at start of loop function in us
+  LOOP_TIMING_END()
+  (void)status; // the calls above report their own errors
+}
+// ************************************************************************
+// * end of LOOP
+// ************************************************************************
+
+
+#ifdef ENABLE_NEOPIXEL
+
+void pixelSet(int pixMode, int pixLevel)
+{
+  pixels.clear(); // Set all pixel colors to 'off'
+  switch (pixMode)
+  { // Start the new animation...
+    case 0:
+      pixels.setPixelColor(0, pixels.Color(pixLevel, pixLevel, pixLevel)); // Blue-Red
+      break;
+    case 1:
+      pixels.setPixelColor(0, pixels.Color(pixLevel, 0, 0)); // Red
+      break;
+    case 2:
+      pixels.setPixelColor(0, pixels.Color(pixLevel, pixLevel, 0)); // Red-Green
+      break;
+    case 3:
+      pixels.setPixelColor(0, pixels.Color(0, pixLevel, 0)); // Green
+      break;
+    case 4:
+      pixels.setPixelColor(0, pixels.Color(0, pixLevel, pixLevel)); // Green-Blue
+      break;
+    case 5:
+      pixels.setPixelColor(0, pixels.Color(0, 0, pixLevel)); // Blue
+      break;
+    case 6:
+      pixels.setPixelColor(0, pixels.Color(pixLevel, 0, pixLevel)); // Blue-Red
+      break;
+    default:
+      pixels.setPixelColor(0, pixels.Color(0, 0, 0)); // Black/off
+      break;
+  }
+
+  pixels.show(); // Send the updated pixel colors to the hardware.
+}
+#endif
@@ -0,0 +1,220 @@
+// adaptiveRate.h
+// output and acquisition intervals that follow the activity of a watched data stream
+//  a controller watches one stream (e.g. Az for climber motion, RH for a gust) and sets the
+//  intervals of the stream's rate group between a fast and a slow bound:
+//    - activity is the standard deviation of the watched stream within the sample, or the change
+//      of its average since the last sample, whichever is larger
+//    - when the activity reaches the threshold the group goes to the fast intervals at once; while
+//      the sample is still being collected, adaptiveRateTriggered() sees the activity in the sums
+//      so far and lets the caller end the sample early instead of waiting out a slow interval
+//    - below ADAPTIVE_QUIET times the threshold the intervals grow by ADAPTIVE_DECAY each sample
+//      until they are back at the slow bound (in between they are held)
+//  the output interval in effect for each row is recorded in a data stream of the group (current
+//  value, in ms), so the statistics of every row can be read with the sample period they cover (a
+//  sample ended early by adaptiveRateTriggered() is shorter: its n shows how much shorter)
+//
+//  in setup(), after the watched stream is added (and moved to its rate group):
+//    kMotion = addAdaptiveRate(data, &nSamples, iAz, 0.5, 100, 2000, 0, 0, "rateMs");
+//  in loop(), when a group is output (after updateSampleStats, before its row is written):
+//    samplingInterval = adaptRateGroup(data, MAIN_RATE_GROUP, samplingInterval);
+//  and on every pass:
+//    if (adaptiveRateTriggered(data, MAIN_RATE_GROUP)) ... end the sample now
+//  the group is a rate group as for updateSampleStats(): MAIN_RATE_GROUP is -1 (every controller)
+//  without ENABLE_RATE_GROUPS
+//  the acquisition interval (adaptiveAcquireInterval) is scaled with the output interval between
+//  its own bounds; it only matters for groups whose reads are gated by rateGroupAcquireDue()
+//
+//  host/testHost (ADAPTIVE) runs bursts of a simulated signal through fixed fast, fixed slow and
+//  adaptive intervals and checks the bursts resolved against the samples and bytes spent
+//
+//  enable with ENABLE_ADAPTIVE_RATE (and ADAPTIVE_THRESHOLD, ADAPTIVE_FAST_PERIOD,
+//  ADAPTIVE_SLOW_PERIOD) in the deviceConfig file
+
+#ifdef ENABLE_ADAPTIVE_RATE
+
+#define ADAPTIVE_MAX_CONTROLLERS 4
+#ifndef ADAPTIVE_THRESHOLD
+#define ADAPTIVE_THRESHOLD 0.5 // activity that raises the rate (units of the watched stream)
+#endif
+#ifndef ADAPTIVE_FAST_PERIOD
+#define ADAPTIVE_FAST_PERIOD 100 // ms, output interval while active
+#endif
+#ifndef ADAPTIVE_SLOW_PERIOD
+#define ADAPTIVE_SLOW_PERIOD 2000 // ms, output interval when quiet
+#endif
+#ifndef ADAPTIVE_DECAY
+#define ADAPTIVE_DECAY 2. // growth of the intervals per quiet sample
+#endif
+#ifndef ADAPTIVE_QUIET
+#define ADAPTIVE_QUIET 0.5 // activity below this fraction of the threshold is quiet
+#endif
+#define ADAPTIVE_MIN_SAMPLES 4 // samples before adaptiveRateTriggered() trusts the sums
+
+struct adaptiveRate
+{
+  sampleStats *streams;        // the array of data streams it belongs to
+  int stream;                  // watched data stream
+  int group;                   // its rate group
+  int rateStream;              // data stream recording the output interval in effect
+  float threshold;             // activity that raises the rate
+  unsigned long fastOutput;    // bounds of the output interval (ms)
+  unsigned long slowOutput;
+  unsigned long fastAcquire;   // bounds of the acquisition interval (ms, 0 = not adapted)
+  unsigned long slowAcquire;
+  unsigned long outputInterval; // in effect
+  float lastAverage;           // average of the watched stream in the last sample
+  int hasAverage;
+  float activity;              // of the last sample
+  unsigned long raised;        // times the rate was raised
+};
+
+adaptiveRate adaptiveRates[ADAPTIVE_MAX_CONTROLLERS];
+int nAdaptiveRates = 0;
+
+// addAdaptiveRate: creates a controller of the rate group of stream iWatch and the data stream that
+//   records its output interval (named rateNickName); returns its index (-1 if the watched stream
+//   was not created or there is no room). the group starts at the slow intervals
+int addAdaptiveRate(sampleStats *localData, int *numSamples, int iWatch, float threshold, unsigned long fastOutput, unsigned long slowOutput, unsigned long fastAcquire, unsigned long slowAcquire, char *rateNickName)
+{
+  if (iWatch < 0)
+  {
+    return -1; // the watched stream was not created (e.g. its sensor is disabled)
+  }
+  if (nAdaptiveRates == ADAPTIVE_MAX_CONTROLLERS)
+  {
+    WARN("too many adaptive rate controllers", nAdaptiveRates)
+    return -1;
+  }
+  int k = nAdaptiveRates;
+  int rateStream = addDataStream(localData, numSamples, "Output interval in effect", rateNickName, "ms", 0);
+  if (rateStream < 0)
+  {
+    return -1;
+  }
+  nAdaptiveRates++;
+  localData[rateStream].rateGroup = localData[iWatch].rateGroup;
+  localData[rateStream].currentVal = (float)slowOutput;
+  adaptiveRates[k].streams = localData;
+  adaptiveRates[k].stream = iWatch;
+  adaptiveRates[k].group = localData[iWatch].rateGroup;
+  adaptiveRates[k].rateStream = rateStream;
+  adaptiveRates[k].threshold = threshold;
+  adaptiveRates[k].fastOutput = fastOutput;
+  adaptiveRates[k].slowOutput = slowOutput;
+  adaptiveRates[k].fastAcquire = fastAcquire;
+  adaptiveRates[k].slowAcquire = slowAcquire;
+  adaptiveRates[k].outputInterval = slowOutput;
+  adaptiveRates[k].lastAverage = 0.;
+  adaptiveRates[k].hasAverage = 0;
+  adaptiveRates[k].activity = 0.;
+  adaptiveRates[k].raised = 0;
+  return k;
+}
+
+// activity of the watched stream in the sample so far (the larger of its standard deviation and
+// the change of its average)
+float adaptiveActivity(adaptiveRate *controller)
+{
+  sampleStats *stream = &controller->streams[controller->stream];
+  if (stream->n == 0)
+  {
+    return 0.;
+  }
+  float average = mathDivideN(stream->sumX, stream->n);
+  float activity = controller->hasAverage ? fabs(average - controller->lastAverage) : 0.;
+  if (stream->n > 1)
+  {
+    float variance = mathDivideN(stream->sumX2 - mathDivideN(stream->sumX * stream->sumX, stream->n), stream->n - 1);
+    float standardDeviation = variance > 0. ? mathSqrt(variance) : 0.;
+    activity = standardDeviation > activity ? standardDeviation : activity;
+  }
+  return activity;
+}
+
+// called when a group is output, after updateSampleStats() and before its row is written: records
+// the interval of this row and sets the next one from the activity; returns the output interval to
+// use for the group (the shortest asked for by its controllers, interval if it has none)
+unsigned long adaptRateGroup(sampleStats *dataStream, int group, unsigned long interval)
+{
+  unsigned long next = 0;
+  for (int k = 0; k < nAdaptiveRates; k++)
+  {
+    adaptiveRate *controller = &adaptiveRates[k];
+    if (controller->streams != dataStream || (group != -1 && controller->group != group))
+    {
+      continue;
+    }
+    sampleStats *rate = &dataStream[controller->rateStream];
+    rate->currentVal = (float)controller->outputInterval; // the row shows the interval it covers
+    rate->average = rate->currentVal;
+
+    controller->activity = adaptiveActivity(controller);
+    if (controller->activity >= controller->threshold)
+    {
+      if (controller->outputInterval != controller->fastOutput)
+      {
+        controller->raised++;
+      }
+      controller->outputInterval = controller->fastOutput;
+    }
+    else if (controller->activity < ADAPTIVE_QUIET * controller->threshold)
+    {
+      float longer = ADAPTIVE_DECAY * (float)controller->outputInterval;
+      controller->outputInterval = longer < (float)controller->slowOutput ? (unsigned long)longer : controller->slowOutput;
+    }
+    sampleStats *watched = &dataStream[controller->stream];
+    if (watched->n > 0)
+    {
+      controller->lastAverage = mathDivideN(watched->sumX, watched->n);
+      controller->hasAverage = 1;
+    }
+    next = (next == 0 || controller->outputInterval < next) ? controller->outputInterval : next;
+  }
+  return next == 0 ? interval : next;
+}
+
+// the acquisition interval of a group for its output interval in effect (interval if none of its
+// controllers adapts acquisition)
+unsigned long adaptiveAcquireInterval(sampleStats *dataStream, int group, unsigned long interval)
+{
+  int adapted = 0;
+  unsigned long shortest = 0;
+  for (int k = 0; k < nAdaptiveRates; k++)
+  {
+    adaptiveRate *controller = &adaptiveRates[k];
+    if (controller->streams != dataStream || (group != -1 && controller->group != group) || controller->slowAcquire == 0)
+    {
+      continue;
+    }
+    float position = 0.; // 0 at the fast output interval, 1 at the slow one
+    if (controller->slowOutput > controller->fastOutput)
+    {
+      position = ((float)(controller->outputInterval - controller->fastOutput)) / ((float)(controller->slowOutput - controller->fastOutput));
+    }
+    unsigned long acquire = controller->fastAcquire + (unsigned long)(position * (float)(controller->slowAcquire - controller->fastAcquire));
+    shortest = (!adapted || acquire < shortest) ? acquire : shortest;
+    adapted = 1;
+  }
+  return adapted ? shortest : interval;
+}
+
+// on every pass: 1 if a controller of the group that is not already fast sees activity in the
+// sample so far (the caller then ends the sample, and adaptRateGroup() raises the rate)
+int adaptiveRateTriggered(sampleStats *dataStream, int group)
+{
+  for (int k = 0; k < nAdaptiveRates; k++)
+  {
+    adaptiveRate *controller = &adaptiveRates[k];
+    if (controller->streams != dataStream || (group != -1 && controller->group != group) || controller->outputInterval == controller->fastOutput)
+    {
+      continue;
+    }
+    if (dataStream[controller->stream].n >= ADAPTIVE_MIN_SAMPLES && adaptiveActivity(controller) >= controller->threshold)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#endif
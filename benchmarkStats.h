@@ -0,0 +1,617 @@
+// benchmarkStats.h
+// microbenchmarks of the statistics, event and output hot paths
+//  - updateDataSample (plain, with trendline, with baseline)
+//  - updateSampleStats and resetSampleStats
+//  - breakpoint evaluation of threshold events (evaluateEventBreakpoints)
+//  - formatting the Serial table (printSampleStatTable) and, with ENABLE_SERIAL_TELEMETRY, encoding
+//    the same statistics as a telemetry frame
+//  - simulated samples (simulatedSensor.h) through updateDataSample, the statistics and a data row
+//  - formatting and writing a data row (printSampleStatSpreadsheetToFile)
+//  - encoding a compressed data row without writing it (with ENABLE_COMPRESSED_DATA)
+//  - writing an event (reportEventToFile) and, with ENABLE_EVENT_QUEUE, writing queued events in a batch
+//  - timestamps (monoMicros and the RTC-anchored absolute time)
+//  - the fast sqrt, sine and division by n of fastMath.h against the libm calls they replace
+//  - derived streams (derivedStreams.h) evaluated when the row is output against computing them on
+//    every pass
+//  - a DEBUG message printed as text, recorded by the deferred macro and formatted from the record
+//    later (with ENABLE_DEFERRED_DEBUG)
+// each benchmark is run for several numbers of data streams and reports ns per operation and
+// operations (samples) per second as machine-readable lines:
+//    BENCH,name,streams,iterations,ns_per_op,ops_per_sec
+//
+// the same code runs on the board (define ENABLE_BENCHMARK in the deviceConfig file and the
+// results are printed to Serial from setup()) and on the host (host/benchmarkHost.cpp, which
+// also checks the results against a baseline file)
+//
+// the benchmarks use their own arrays of data streams and events so that running them does not
+// change the state of the logger
+
+#ifdef ENABLE_BENCHMARK
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 200 // passes over all streams for each benchmark (keep small on the board)
+#endif
+#define BENCH_BLOCK 64       // passes timed together (keeps each timing well inside the clock rollover)
+#define BENCH_STREAM_COUNTS 5
+
+int benchStreamCounts[BENCH_STREAM_COUNTS] = {1, 4, 8, 16, MAX_SAMPLES};
+char benchFileName[] = "/bench.csv";
+
+sampleStats benchData[MAX_SAMPLES];
+eventTracker benchEvents[MAX_EVENTS];
+int benchSamples = 0;
+int benchNumEvents = 0;
+volatile int benchSink = 0; // keeps results of evaluated functions from being optimized away
+
+// create nStreams data streams (and one threshold event per stream, up to MAX_EVENTS) for a benchmark
+void setupBenchStreams(int nStreams, int trendline, float baseline)
+{
+  benchSamples = 0;
+  benchNumEvents = 0;
+  for (int i = 0; i < nStreams; i++)
+  {
+    int iData = addDataStream(benchData, &benchSamples, "Benchmark stream", "bench", "arb", 5);
+    benchData[iData].calcTrendline = trendline;
+    benchData[iData].baseline = baseline;
+    benchData[iData].currentVal = 0.;
+    if (benchNumEvents < MAX_EVENTS)
+    {
+      int jEvent = addEvent(benchEvents, &benchNumEvents, "Benchmark threshold", "bench", 1, 1, 3, "LOW", "MID", "HIGH");
+      setEventBreakpoints(benchEvents, jEvent, iData, -0.5, 0.5);
+    }
+  }
+}
+
+// fill every stream with a few samples so statistics have something to work on
+void fillBenchStreams()
+{
+  for (int k = 0; k < 16; k++)
+  {
+    for (int i = 0; i < benchSamples; i++)
+    {
+      updateDataSample(benchData, i, ((float)((k * 7 + i) % 11)) / 10. - 0.5, ((float)k) / 100.);
+    }
+  }
+}
+
+void printBenchResult(Print &out, const char *name, int nStreams, unsigned long operations, float elapsedMicros)
+{
+  float nsPerOp = 1000. * elapsedMicros / ((float)operations);
+  out.print("BENCH,");
+  out.print(name);
+  out.print(",");
+  out.print(nStreams);
+  out.print(",");
+  out.print(operations);
+  out.print(",");
+  out.print(nsPerOp, 1);
+  out.print(",");
+  out.println(nsPerOp > 0. ? 1.0e9 / nsPerOp : 0., 0);
+}
+
+// each benchmark times `iterations` passes and returns the elapsed time in us
+// operations per pass are counted by the caller (usually one per stream)
+#define BENCH_TIME(iterations, ...)                      \
+  float elapsedMicros = 0.;                              \
+  for (int done = 0; done < (iterations);)               \
+  {                                                      \
+    int block = (iterations) - done;                     \
+    if (block > BENCH_BLOCK)                             \
+      block = BENCH_BLOCK;                               \
+    uint32_t startTicks = profileTicks();                \
+    for (int pass = 0; pass < block; pass++)             \
+    {                                                    \
+      __VA_ARGS__                                        \
+    }                                                    \
+    elapsedMicros += ((float)(profileTicks() - startTicks)) / profileTicksPerMicro(); \
+    done += block;                                       \
+  }
+
+float benchUpdateDataSample(int nStreams, int iterations, int trendline, float baseline)
+{
+  setupBenchStreams(nStreams, trendline, baseline);
+  BENCH_TIME(iterations,
+             for (int i = 0; i < nStreams; i++) {
+               benchSink += updateDataSample(benchData, i, (float)(pass & 15), ((float)pass) / 1000.);
+             })
+  return elapsedMicros;
+}
+
+float benchUpdateSampleStats(int nStreams, int iterations)
+{
+  setupBenchStreams(nStreams, 0, 0.);
+  fillBenchStreams();
+  BENCH_TIME(iterations,
+             updateSampleStats(benchData, nStreams);
+             benchSink += benchData[0].n;)
+  return elapsedMicros;
+}
+
+float benchResetSampleStats(int nStreams, int iterations)
+{
+  setupBenchStreams(nStreams, 0, 0.);
+  BENCH_TIME(iterations,
+             benchData[0].n = pass;
+             benchSink += resetSampleStats(benchData, nStreams);)
+  return elapsedMicros;
+}
+
+float benchEventBreakpoints(int nStreams, int iterations)
+{
+  setupBenchStreams(nStreams, 0, 0.);
+  fillBenchStreams();
+  BENCH_TIME(iterations,
+             for (int j = 0; j < benchNumEvents; j++) {
+               benchSink += evaluateEventBreakpoints(benchEvents, j, benchData);
+             })
+  return elapsedMicros;
+}
+
+float benchMonoMicros(int iterations)
+{
+  BENCH_TIME(iterations,
+             benchSink += (int)monoMicros();)
+  return elapsedMicros;
+}
+
+float benchAbsoluteTime(int iterations)
+{
+  timeBase benchClock;
+  benchClock.anchors = 0;
+  benchClock.driftPPB = 0;
+  timeBaseAnchor(&benchClock, monoMicros(), 1610928000UL);
+  benchClock.driftPPB = 25000; // 25 ppm
+  BENCH_TIME(iterations,
+             benchSink += (int)absoluteMicros(&benchClock, monoMicros());)
+  return elapsedMicros;
+}
+
+// the kernels of fastMath.h against the libm calls they replace, over a table of arguments (the
+// caller counts BENCH_MATH_VALUES operations per pass)
+#define BENCH_MATH_VALUES 64
+float benchMathValues[BENCH_MATH_VALUES];
+volatile float benchMathSink = 0.; // keeps the results of the math from being optimized away
+
+void setupBenchMath(float low, float high)
+{
+  for (int k = 0; k < BENCH_MATH_VALUES; k++)
+  {
+    benchMathValues[k] = low + (high - low) * ((float)k) / ((float)BENCH_MATH_VALUES);
+  }
+}
+
+float benchLibmSqrt(int iterations)
+{
+  setupBenchMath(0.001, 1000.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += sqrt(benchMathValues[k]);
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+float benchFastSqrt(int iterations)
+{
+  setupBenchMath(0.001, 1000.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += fastSqrt<FAST_MATH_SQRT_STEPS>(benchMathValues[k]);
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+float benchLibmSin(int iterations)
+{
+  setupBenchMath(0., 100.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += sin(2 * PI * benchMathValues[k] / 7.);
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+float benchFastSin(int iterations)
+{
+  setupBenchMath(0., 100.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += fastSinTurns<FAST_MATH_SINE_BITS>(benchMathValues[k] / 7.f);
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+float benchDivideN(int iterations)
+{
+  setupBenchMath(-50., 50.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += benchMathValues[k] / ((float)(k + 2));
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+float benchReciprocalN(int iterations)
+{
+  setupBenchMath(-50., 50.);
+  float sum = 0.;
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_MATH_VALUES; k++) {
+               sum += benchMathValues[k] * fastReciprocal(k + 2);
+             })
+  benchMathSink = sum;
+  return elapsedMicros;
+}
+
+// discards what is written, so only the formatting or encoding is timed
+class benchNullPrint : public Print
+{
+public:
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t *, size_t size) { return size; }
+  using Print::write;
+};
+
+float benchSerialTable(int nStreams, int iterations)
+{
+  benchNullPrint nullOut;
+  setupBenchStreams(nStreams, 0, 0.);
+  fillBenchStreams();
+  BENCH_TIME(iterations,
+             benchSink += printSampleStatTable(nullOut, benchData, nStreams, "\t");)
+  return elapsedMicros;
+}
+
+// sustained throughput of simulated samples through updateDataSample and, every BENCH_SIM_ROW
+// samples of each stream, the statistics and a formatted data row (the caller counts samples)
+#define BENCH_SIM_ROW 100
+#define BENCH_SIM_SIGNALS 4
+float benchSimulatedPipeline(int nStreams, int iterations)
+{
+  benchNullPrint nullOut;
+  setupBenchStreams(nStreams, 1, 0.);
+  // signals of our own after those of the logger, removed again at the end
+  int firstSignal = nSimSignals;
+  for (int k = 0; k < BENCH_SIM_SIGNALS && nSimSignals < SIM_MAX_SIGNALS; k++)
+  {
+    int sig = addSimSignal(-1);
+    addSimComponent(sig, SIM_SINE, 1., 0.5 + k, 0.);
+    addSimComponent(sig, SIM_GAUSSIAN, 0.1, 0., 0.);
+    addSimComponent(sig, SIM_SPIKES, 0.5, 5., 0.);
+  }
+  int nSignals = nSimSignals - firstSignal;
+  if (nSignals == 0)
+  {
+    return 0.;
+  }
+  uint64_t nowMicros = simulationStartMicros;
+  int rowSamples = 0;
+  BENCH_TIME(iterations,
+             nowMicros += 1000; // 1 kHz of simulated time, however fast it runs
+             for (int i = 0; i < nStreams; i++) {
+               updateDataSample(benchData, i, simulatedValue(firstSignal + i % nSignals, nowMicros), ((float)rowSamples) / 1000.);
+             } if (++rowSamples == BENCH_SIM_ROW) {
+               updateSampleStats(benchData, nStreams);
+               printSampleStatSpreadsheetRow(nullOut, benchData, nStreams, ", ", pass, 0);
+               resetSampleStats(benchData, nStreams);
+               rowSamples = 0;
+             })
+  nSimSignals = firstSignal;
+  return elapsedMicros;
+}
+
+#ifdef ENABLE_DERIVED_STREAMS
+// |A|, pitch and dew point computed from five input streams, as in the sketch: eagerly (computed
+// and added with updateDataSample on every pass, as DATA_5 did) or as derived streams evaluated
+// when the row is output. one operation is one pass (the five inputs updated); every
+// BENCH_SIM_ROW passes the statistics are finalized and a data row is formatted
+#define BENCH_DERIVED_INPUTS 5
+#define BENCH_DERIVED_OUTPUTS 3
+const char *benchDerivedNames[BENCH_DERIVED_INPUTS] = {"Ax", "Ay", "Az", "TC", "RH"};
+const char *benchDerivedExpressions[BENCH_DERIVED_OUTPUTS] = {
+    "sqrt(Ax^2 + Ay^2 + Az^2)",
+    "atan2(Ax, Az) * 180 / pi",
+    "243.12 * (log(RH / 100) + 17.62 * TC / (243.12 + TC)) / (17.62 - log(RH / 100) - 17.62 * TC / (243.12 + TC))"};
+
+// the inputs, then the three outputs as derived streams (lazy) or plain streams (eager)
+void setupBenchDerived(int lazy)
+{
+  benchSamples = 0;
+  benchNumEvents = 0;
+  for (int k = 0; k < BENCH_DERIVED_INPUTS; k++)
+  {
+    addDataStream(benchData, &benchSamples, "Benchmark input", (char *)benchDerivedNames[k], "arb", 4);
+  }
+  for (int k = 0; k < BENCH_DERIVED_OUTPUTS; k++)
+  {
+    if (lazy)
+      addDerivedStream(benchData, &benchSamples, "Benchmark derived", "bench", "arb", 1, benchDerivedExpressions[k]);
+    else
+      addDataStream(benchData, &benchSamples, "Benchmark derived", "bench", "arb", 1);
+  }
+}
+
+float benchDerived(int iterations, int lazy)
+{
+  benchNullPrint nullOut;
+  int firstDerived = nDerived;
+  int firstOp = nDerivedOps;
+  setupBenchDerived(lazy);
+  int rowSamples = 0;
+  BENCH_TIME(iterations,
+             float ax = 0.1 * (pass & 7);
+             float ay = 0.2 - 0.05 * (pass & 3);
+             float az = 9.8 + 0.01 * (pass & 15);
+             float tc = 21. + 0.1 * (pass & 1);
+             float rh = 40. + 0.5 * (pass & 3);
+             updateDataSample(benchData, 0, ax);
+             updateDataSample(benchData, 1, ay);
+             updateDataSample(benchData, 2, az);
+             updateDataSample(benchData, 3, tc);
+             updateDataSample(benchData, 4, rh);
+             if (!lazy) {
+               float g = log(rh / 100.) + 17.62 * tc / (243.12 + tc);
+               updateDataSample(benchData, 5, mathSqrt(ax * ax + ay * ay + az * az));
+               updateDataSample(benchData, 6, atan2(ax, az) * 180. / PI);
+               updateDataSample(benchData, 7, 243.12 * g / (17.62 - g));
+             } if (++rowSamples == BENCH_SIM_ROW) {
+               updateSampleStats(benchData, benchSamples);
+               printSampleStatSpreadsheetRow(nullOut, benchData, benchSamples, ", ", pass, 0);
+               resetSampleStats(benchData, benchSamples);
+               rowSamples = 0;
+             })
+  nDerived = firstDerived;
+  nDerivedOps = firstOp;
+  return elapsedMicros;
+}
+
+#endif
+
+#ifdef ENABLE_SERIAL_TELEMETRY
+// encodes the statistics frame into the ring and then discards it, so nothing reaches Serial
+float benchTelemetryStats(int nStreams, int iterations)
+{
+  setupBenchStreams(nStreams, 0, 0.);
+  fillBenchStreams();
+  int ringUsed = telemetryUsed;
+  BENCH_TIME(iterations,
+             benchSink += sendTelemetryStats(benchData, nStreams);
+             telemetryUsed = ringUsed;)
+  return elapsedMicros;
+}
+#endif
+
+#ifdef ENABLE_DEFERRED_DEBUG
+// the DEBUG message in updateEventState as the text macro prints it (only the formatting: on the
+// board Serial.print also waits for the UART once its buffer is full)
+#define BENCH_DEBUG_NAME "localEvent[jEvent].stateDuration"
+float benchDebugText(int iterations)
+{
+  benchNullPrint nullOut;
+  BENCH_TIME(iterations,
+             nullOut.print("DEBUG: var: ");
+             nullOut.print(BENCH_DEBUG_NAME);
+             nullOut.print(" = ");
+             benchSink += nullOut.println((unsigned long)pass);)
+  return elapsedMicros;
+}
+
+// the same message recorded by the deferred macro (the ring is rewound so it never fills)
+float benchDebugDeferred(int iterations)
+{
+  unsigned int ringUsed = debugLogUsed;
+  unsigned long ringRecorded = debugLogRecorded;
+  BENCH_TIME(iterations,
+             DEBUG_RECORD("DEBUG|" BENCH_DEBUG_NAME, (unsigned long)pass)
+             debugLogUsed = ringUsed;)
+  debugLogRecorded = ringRecorded;
+  return elapsedMicros;
+}
+
+// turning the recorded message into its line when loop() is idle
+float benchDebugFormat(int iterations)
+{
+  debugLogLine line;
+  unsigned int ringHead = debugLogHead;
+  unsigned int ringUsed = debugLogUsed;
+  unsigned long ringRecorded = debugLogRecorded;
+  debugLogHead = (debugLogHead + debugLogUsed) % DEBUG_LOG_BYTES; // format a record of our own
+  debugLogUsed = 0;
+  DEBUG_RECORD("DEBUG|" BENCH_DEBUG_NAME, 123456UL)
+  BENCH_TIME(iterations,
+             benchSink += formatDebugLogRecord(line);)
+  debugLogHead = ringHead;
+  debugLogUsed = ringUsed;
+  debugLogRecorded = ringRecorded;
+  return elapsedMicros;
+}
+#endif
+
+#ifdef USE_SD
+float benchSpreadsheetRow(int nStreams, int iterations)
+{
+  setupBenchStreams(nStreams, 1, 0.);
+  fillBenchStreams();
+  SD.remove(benchFileName);
+  printSampleStatSpreadsheetToFile(benchFileName, benchData, nStreams, ",", 0, 1);
+  BENCH_TIME(iterations,
+             benchSink += printSampleStatSpreadsheetToFile(benchFileName, benchData, nStreams, ", ", pass, 0);)
+  releaseLogFile(benchFileName); // group commit keeps the file open
+  SD.remove(benchFileName);
+  return elapsedMicros;
+}
+
+#ifdef ENABLE_COMPRESSED_DATA
+float benchCompressedRow(int nStreams, int iterations)
+{
+  benchNullPrint nullOut;
+  setupBenchStreams(nStreams, 1, 0.);
+  fillBenchStreams();
+  dataCodec *codec = findDataCodec(benchFileName, 1);
+  if (codec == NULL)
+  {
+    return 0.;
+  }
+  resetDataCodec(codec);
+  BENCH_TIME(iterations,
+             updateDataSample(benchData, pass % nStreams, (float)(pass & 15), ((float)pass) / 1000.);
+             benchSink += printSampleStatCompressedRow(nullOut, codec, benchData, nStreams, pass);)
+  return elapsedMicros;
+}
+#endif
+
+float benchReportEvent(int iterations)
+{
+  setupBenchStreams(1, 0, 0.);
+  updateEventState(benchEvents, 0, 2, millis());
+  SD.remove(benchFileName);
+#ifdef ENABLE_EVENT_QUEUE
+  // each change is written on its own, as it is without the queue
+  BENCH_TIME(iterations,
+             benchSink += reportEventToFile(benchFileName, benchEvents, benchNumEvents, 0, ",", pass, 0);
+             benchSink += drainEventQueue(benchEvents, 1);)
+#else
+  BENCH_TIME(iterations,
+             benchSink += reportEventToFile(benchFileName, benchEvents, benchNumEvents, 0, ",", pass, 0);)
+#endif
+  releaseLogFile(benchFileName); // group commit keeps the file open
+  SD.remove(benchFileName);
+  return elapsedMicros;
+}
+
+#ifdef ENABLE_EVENT_QUEUE
+// half a queue of changes written with one drain (with EVENT_COALESCE_MS they are merged, as a
+// storm of changes would be); the caller counts batch changes per pass
+#define BENCH_EVENT_BATCH (EVENT_QUEUE_RECORDS / 2)
+float benchEventQueueBatch(int iterations)
+{
+  setupBenchStreams(1, 0, 0.);
+  updateEventState(benchEvents, 0, 2, millis());
+  SD.remove(benchFileName);
+  BENCH_TIME(iterations,
+             for (int k = 0; k < BENCH_EVENT_BATCH; k++) {
+               benchSink += reportEventToFile(benchFileName, benchEvents, benchNumEvents, 0, ",", pass * BENCH_EVENT_BATCH + k, 0);
+             } benchSink += drainEventQueue(benchEvents, 1);)
+  releaseLogFile(benchFileName);
+  SD.remove(benchFileName);
+  return elapsedMicros;
+}
+#endif
+
+#ifdef ENABLE_CAPTURE
+// the logger's captured streams and triggers are put aside while a benchmark captures its own
+// (host/benchmarkHost times the passes of loop() during a dump)
+char benchCaptureName[] = "/bcapt.bin";
+captureStream benchSavedStreams[CAPTURE_MAX_STREAMS];
+captureTrigger benchSavedTriggers[CAPTURE_MAX_TRIGGERS];
+int benchSavedCaptureCounts[3];
+char benchSavedCaptureName[40];
+
+void benchCaptureBegin()
+{
+  memcpy(benchSavedStreams, captureStreams, sizeof(captureStreams));
+  memcpy(benchSavedTriggers, captureTriggers, sizeof(captureTriggers));
+  benchSavedCaptureCounts[0] = nCaptureStreams;
+  benchSavedCaptureCounts[1] = nCaptureTriggers;
+  benchSavedCaptureCounts[2] = captureArenaUsed;
+  memcpy(benchSavedCaptureName, captureFileName, sizeof(captureFileName));
+  nCaptureStreams = 0;
+  nCaptureTriggers = 0;
+  captureArenaUsed = 0;
+  captureState = CAPTURE_ARMED;
+  strcpy(captureFileName, benchCaptureName);
+  SD.remove(captureFileName);
+  benchSamples = 0;
+  benchNumEvents = 0;
+}
+
+void benchCaptureEnd()
+{
+  releaseLogFile(captureFileName); // group commit keeps the file open
+  SD.remove(captureFileName);
+  for (int k = 0; k < nCaptureStreams; k++)
+  {
+    captureStreams[k].streams[captureStreams[k].stream].captureIndex = -1;
+  }
+  memcpy(captureStreams, benchSavedStreams, sizeof(captureStreams));
+  memcpy(captureTriggers, benchSavedTriggers, sizeof(captureTriggers));
+  nCaptureStreams = benchSavedCaptureCounts[0];
+  nCaptureTriggers = benchSavedCaptureCounts[1];
+  captureArenaUsed = benchSavedCaptureCounts[2];
+  memcpy(captureFileName, benchSavedCaptureName, sizeof(captureFileName));
+  captureState = CAPTURE_ARMED;
+  captureNextWrite = 0;
+  captureWindows = 0;
+  captureMissed = 0;
+  captureMissedBlock = 0;
+  captureBytes = 0;
+  captureWrites = 0;
+  captureFailures = 0;
+}
+#endif
+#endif
+
+// run all benchmarks and print the results
+void runBenchmarks(Print &out, int iterations)
+{
+  initProfileClock();
+  out.println("BENCH,name,streams,iterations,ns_per_op,ops_per_sec");
+  for (int k = 0; k < BENCH_STREAM_COUNTS; k++)
+  {
+    int nStreams = benchStreamCounts[k];
+    unsigned long sampleOps = (unsigned long)iterations * nStreams;
+    printBenchResult(out, "updateDataSample", nStreams, sampleOps, benchUpdateDataSample(nStreams, iterations, 0, 0.));
+    printBenchResult(out, "updateDataSampleTrend", nStreams, sampleOps, benchUpdateDataSample(nStreams, iterations, 1, 0.));
+    printBenchResult(out, "updateDataSampleBaseline", nStreams, sampleOps, benchUpdateDataSample(nStreams, iterations, 0, 1.5));
+    printBenchResult(out, "updateSampleStats", nStreams, (unsigned long)iterations, benchUpdateSampleStats(nStreams, iterations));
+    printBenchResult(out, "resetSampleStats", nStreams, (unsigned long)iterations, benchResetSampleStats(nStreams, iterations));
+    int nBenchEvents = nStreams < MAX_EVENTS ? nStreams : MAX_EVENTS;
+    printBenchResult(out, "eventBreakpoints", nBenchEvents, (unsigned long)iterations * nBenchEvents, benchEventBreakpoints(nStreams, iterations));
+    printBenchResult(out, "serialTable", nStreams, (unsigned long)iterations, benchSerialTable(nStreams, iterations));
+    printBenchResult(out, "simulatedPipeline", nStreams, sampleOps, benchSimulatedPipeline(nStreams, iterations));
+#ifdef ENABLE_SERIAL_TELEMETRY
+    printBenchResult(out, "telemetryStats", nStreams, (unsigned long)iterations, benchTelemetryStats(nStreams, iterations));
+#endif
+#ifdef USE_SD
+    printBenchResult(out, "spreadsheetRow", nStreams, (unsigned long)iterations, benchSpreadsheetRow(nStreams, iterations));
+#ifdef ENABLE_COMPRESSED_DATA
+    printBenchResult(out, "compressedRow", nStreams, (unsigned long)iterations, benchCompressedRow(nStreams, iterations));
+#endif
+#endif
+  }
+  printBenchResult(out, "monoMicros", 1, (unsigned long)iterations, benchMonoMicros(iterations));
+  printBenchResult(out, "absoluteTime", 1, (unsigned long)iterations, benchAbsoluteTime(iterations));
+  unsigned long mathOps = (unsigned long)iterations * BENCH_MATH_VALUES;
+  printBenchResult(out, "libmSqrt", 1, mathOps, benchLibmSqrt(iterations));
+  printBenchResult(out, "fastSqrt", 1, mathOps, benchFastSqrt(iterations));
+  printBenchResult(out, "libmSin", 1, mathOps, benchLibmSin(iterations));
+  printBenchResult(out, "fastSin", 1, mathOps, benchFastSin(iterations));
+  printBenchResult(out, "divideN", 1, mathOps, benchDivideN(iterations));
+  printBenchResult(out, "reciprocalN", 1, mathOps, benchReciprocalN(iterations));
+#ifdef ENABLE_DERIVED_STREAMS
+  printBenchResult(out, "derivedEager", BENCH_DERIVED_OUTPUTS, (unsigned long)iterations, benchDerived(iterations, 0));
+  printBenchResult(out, "derivedLazy", BENCH_DERIVED_OUTPUTS, (unsigned long)iterations, benchDerived(iterations, 1));
+#endif
+#ifdef ENABLE_DEFERRED_DEBUG
+  printBenchResult(out, "debugText", 1, (unsigned long)iterations, benchDebugText(iterations));
+  printBenchResult(out, "debugDeferred", 1, (unsigned long)iterations, benchDebugDeferred(iterations));
+  printBenchResult(out, "debugFormat", 1, (unsigned long)iterations, benchDebugFormat(iterations));
+#endif
+#ifdef USE_SD
+  printBenchResult(out, "reportEventToFile", 1, (unsigned long)iterations, benchReportEvent(iterations));
+#ifdef ENABLE_EVENT_QUEUE
+  printBenchResult(out, "eventQueueBatch", 1, (unsigned long)iterations * BENCH_EVENT_BATCH, benchEventQueueBatch(iterations));
+#endif
+#endif
+}
+
+#endif
@@ -0,0 +1,336 @@
+// dataCompress.h
+// lossless compression of the rows of the data file (and rate group files)
+//  consecutive rows of most streams differ only in their low-order bits, so each column is encoded
+//  against its value in the previous row of the same file, as the row is produced:
+//    float columns      XOR with the previous value: a 0 bit when nothing changed, otherwise the
+//                       changed bits between the leading and trailing zeros of the XOR (reusing the
+//                       previous column's window when they fit inside it)
+//    count and _n       delta-of-delta as a zigzag varint (a single 0 bit when the delta is unchanged)
+//    unixTime           the same in ms (with ENABLE_ABSOLUTE_TIME)
+//  the state is DATA_CODEC_COLUMNS columns per file (10 bytes each); further columns are written
+//  without reference to the previous row (floats as 32 raw bits, integers as zigzag varints)
+//
+//  the file keeps its text preamble and header row, preceded by a line describing the codec
+//  ("Kite Datlogger Data Codec: xor-dod,columns=64,crc=0"). each row after it is a frame:
+//    [tag][sequence][payload length (varint)][payload bits, padded to a byte][CRC-16 of the payload]
+//  tag DATA_CODEC_FRAME continues from the previous row, DATA_CODEC_KEYFRAME starts from a reset
+//  state; the sequence counts rows (mod 256) so the decoder can see a row that is missing. the
+//  CRC is only written with ENABLE_GROUP_COMMIT (without it, damage inside a row is not detected
+//  and decodes to wrong values up to the next keyframe). a keyframe is written every DATA_CODEC_KEYFRAME_ROWS
+//  rows and after a row of the file is dropped by the output queue, so a lost or damaged row
+//  costs at most the rows up to the next keyframe
+//
+//  host/decodeData turns a compressed file back into the CSV the logger writes without compression
+//  and reports the compression of each row. rows, bytes and encode time are counted here and printed
+//  with printDataCodecStatus()
+//
+//  enable with ENABLE_COMPRESSED_DATA in the deviceConfig file
+
+#ifdef ENABLE_COMPRESSED_DATA
+
+#define DATA_FILE_SUFFIX ".kcd"
+#define DATA_CODEC_FILES 5           // data file, rate group files and the benchmark file
+#define DATA_CODEC_COLUMNS 64        // columns of each file that are encoded against the previous row
+#define DATA_CODEC_ROW_BYTES 1400    // longest encoded row (all columns of MAX_SAMPLES streams at 44 bits)
+#define DATA_CODEC_KEYFRAME_ROWS 256 // rows between keyframes
+#define DATA_CODEC_FRAME 0xC5
+#define DATA_CODEC_KEYFRAME 0xC6
+#define DATA_CODEC_NO_WINDOW 0xFF // no XOR window yet (first changed value of a column)
+
+struct dataCodecColumn
+{
+  uint32_t previous; // bits of the previous float, or the previous integer
+  int32_t delta;     // previous delta (integer columns)
+  uint8_t leading;   // window of the previous XOR (float columns)
+  uint8_t trailing;
+};
+
+struct dataCodec
+{
+  char *fullFileName; // buffer holding the name of the file (the key of the codec)
+  dataCodecColumn column[DATA_CODEC_COLUMNS];
+  uint64_t previousTime; // unixTime column (ms)
+  int64_t timeDelta;
+  int columns;            // columns written so far in the current row
+  uint8_t sequence;       // sequence number of the next row
+  int rowsSinceKeyframe;
+  int keyframe;           // 1 when the next row must start from a reset state
+};
+
+dataCodec dataCodecs[DATA_CODEC_FILES];
+int nDataCodecs = 0;
+
+// the row being encoded (rows are encoded one at a time)
+uint8_t dataCodecRow[DATA_CODEC_ROW_BYTES];
+int dataCodecBits = 0;
+
+// counters for printDataCodecStatus()
+unsigned long dataCodecRows = 0;
+unsigned long dataCodecBytes = 0;    // bytes of the frames written
+unsigned long dataCodecRawBytes = 0; // bytes the same rows take as raw 4-byte values (8 for unixTime)
+unsigned long dataCodecKeyframes = 0;
+float dataCodecMicros = 0.; // time spent encoding
+
+// codec of the file (claimed when the file gets its first header); NULL if none is free
+dataCodec *findDataCodec(char *fullFileName, int claim)
+{
+  for (int k = 0; k < nDataCodecs; k++)
+  {
+    if (dataCodecs[k].fullFileName == fullFileName)
+    {
+      return &dataCodecs[k];
+    }
+  }
+  if (!claim || nDataCodecs >= DATA_CODEC_FILES)
+  {
+    return NULL;
+  }
+  if (nDataCodecs == 0)
+  {
+    initProfileClock(); // encode time is measured on the profiler's clock
+  }
+  dataCodec *codec = &dataCodecs[nDataCodecs++];
+  codec->fullFileName = fullFileName;
+  codec->sequence = 0;
+  codec->keyframe = 1;
+  return codec;
+}
+
+// forget the previous row: the next row is a keyframe
+void resetDataCodec(dataCodec *codec)
+{
+  for (int k = 0; k < DATA_CODEC_COLUMNS; k++)
+  {
+    codec->column[k].previous = 0;
+    codec->column[k].delta = 0;
+    codec->column[k].leading = DATA_CODEC_NO_WINDOW;
+    codec->column[k].trailing = 0;
+  }
+  codec->previousTime = 0;
+  codec->timeDelta = 0;
+  codec->rowsSinceKeyframe = 0;
+  codec->keyframe = 1;
+}
+
+// line written before the header row of a compressed file (resets the codec: the file starts again)
+void printDataCodecHeader(Print &out, dataCodec *codec)
+{
+  resetDataCodec(codec);
+  out.print("Kite Datlogger Data Codec: xor-dod,columns=");
+  out.print(DATA_CODEC_COLUMNS);
+#ifdef ENABLE_GROUP_COMMIT
+  out.println(",crc=1");
+#else
+  out.println(",crc=0");
+#endif
+}
+
+// append the low nBits bits of value (1 to 32) to the row, most significant first
+void dataCodecPutBits(uint32_t value, int nBits)
+{
+  while (nBits > 0)
+  {
+    int byte = dataCodecBits >> 3;
+    int room = 8 - (dataCodecBits & 7);
+    int take = nBits < room ? nBits : room;
+    if (byte >= DATA_CODEC_ROW_BYTES)
+    {
+      dataCodecBits += nBits; // counted so the caller sees the overflow
+      return;
+    }
+    if (room == 8)
+    {
+      dataCodecRow[byte] = 0;
+    }
+    dataCodecRow[byte] |= ((value >> (nBits - take)) & ((1UL << take) - 1)) << (room - take);
+    dataCodecBits += take;
+    nBits -= take;
+  }
+}
+
+// zigzag varint: 7 bits per byte, least significant group first, high bit set on all but the last
+void dataCodecPutVarint(int64_t value)
+{
+  uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  while (zigzag >= 0x80)
+  {
+    dataCodecPutBits((uint32_t)(zigzag & 0x7F) | 0x80, 8);
+    zigzag >>= 7;
+  }
+  dataCodecPutBits((uint32_t)zigzag, 8);
+}
+
+// delta-of-delta: a 0 bit when the delta is unchanged, otherwise a 1 bit and the change as a varint
+void dataCodecPutDelta(int64_t deltaOfDelta)
+{
+  if (deltaOfDelta == 0)
+  {
+    dataCodecPutBits(0, 1);
+  }
+  else
+  {
+    dataCodecPutBits(1, 1);
+    dataCodecPutVarint(deltaOfDelta);
+  }
+}
+
+void dataCodecPutFloat(dataCodec *codec, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int k = codec->columns++;
+  dataCodecRawBytes += 4;
+  if (k >= DATA_CODEC_COLUMNS)
+  {
+    dataCodecPutBits(bits, 32);
+    return;
+  }
+  dataCodecColumn *column = &codec->column[k];
+  uint32_t xorBits = bits ^ column->previous;
+  column->previous = bits;
+  if (xorBits == 0)
+  {
+    dataCodecPutBits(0, 1);
+    return;
+  }
+  int leading = __builtin_clz(xorBits);
+  int trailing = __builtin_ctz(xorBits);
+  if (column->leading != DATA_CODEC_NO_WINDOW && leading >= column->leading && trailing >= column->trailing)
+  {
+    // the changed bits fit in the previous window
+    dataCodecPutBits(2, 2);
+    dataCodecPutBits(xorBits >> column->trailing, 32 - column->leading - column->trailing);
+  }
+  else
+  {
+    int meaningful = 32 - leading - trailing;
+    dataCodecPutBits(3, 2);
+    dataCodecPutBits(leading, 5);
+    dataCodecPutBits(meaningful - 1, 5);
+    dataCodecPutBits(xorBits >> trailing, meaningful);
+    column->leading = leading;
+    column->trailing = trailing;
+  }
+}
+
+void dataCodecPutInt(dataCodec *codec, int32_t value)
+{
+  int k = codec->columns++;
+  dataCodecRawBytes += 4;
+  if (k >= DATA_CODEC_COLUMNS)
+  {
+    dataCodecPutVarint(value);
+    return;
+  }
+  dataCodecColumn *column = &codec->column[k];
+  int32_t delta = value - (int32_t)column->previous;
+  dataCodecPutDelta((int64_t)delta - column->delta);
+  column->previous = (uint32_t)value;
+  column->delta = delta;
+}
+
+// unixTime column (absolute time in ms)
+void dataCodecPutTime(dataCodec *codec, uint64_t millisecond)
+{
+  codec->columns++;
+  dataCodecRawBytes += 8;
+  int64_t delta = (int64_t)(millisecond - codec->previousTime);
+  dataCodecPutDelta(delta - codec->timeDelta);
+  codec->previousTime = millisecond;
+  codec->timeDelta = delta;
+}
+
+// start encoding a row of the file
+void dataCodecBeginRow(dataCodec *codec)
+{
+  if (codec->rowsSinceKeyframe >= DATA_CODEC_KEYFRAME_ROWS)
+  {
+    codec->keyframe = 1;
+  }
+  if (codec->keyframe)
+  {
+    resetDataCodec(codec);
+  }
+  codec->columns = 0;
+  dataCodecBits = 0;
+}
+
+// write the encoded row to out as a frame; returns the bytes written (0 if the row was too long)
+int dataCodecFinishRow(dataCodec *codec, Print &out)
+{
+  int payloadBytes = (dataCodecBits + 7) >> 3;
+  if (payloadBytes > DATA_CODEC_ROW_BYTES)
+  {
+    WARN("compressed row too long", payloadBytes)
+    codec->keyframe = 1; // the row is lost: the next row cannot refer to it
+    return 0;
+  }
+  uint8_t frame[2 + 5];
+  int frameBytes = 0;
+  frame[frameBytes++] = codec->keyframe ? DATA_CODEC_KEYFRAME : DATA_CODEC_FRAME;
+  frame[frameBytes++] = codec->sequence;
+  uint32_t length = payloadBytes;
+  while (length >= 0x80)
+  {
+    frame[frameBytes++] = (uint8_t)(length & 0x7F) | 0x80;
+    length >>= 7;
+  }
+  frame[frameBytes++] = (uint8_t)length;
+  out.write(frame, frameBytes);
+  out.write(dataCodecRow, payloadBytes);
+  frameBytes += payloadBytes;
+#ifdef ENABLE_GROUP_COMMIT
+  uint16_t crc = 0xFFFF;
+  for (int k = 0; k < payloadBytes; k++)
+  {
+    crc = crc16Update(crc, dataCodecRow[k]);
+  }
+  out.write((uint8_t)(crc >> 8));
+  out.write((uint8_t)(crc & 0xFF));
+  frameBytes += 2;
+#endif
+  if (codec->keyframe)
+  {
+    dataCodecKeyframes++;
+  }
+  codec->keyframe = 0;
+  codec->sequence++;
+  codec->rowsSinceKeyframe++;
+  dataCodecRows++;
+  dataCodecBytes += frameBytes;
+  return frameBytes;
+}
+
+void printDataCodecStatus(Print &out)
+{
+  out.print("compressed rows: ");
+  out.print(dataCodecRows);
+  out.print(" rows, ");
+  out.print(dataCodecKeyframes);
+  out.print(" keyframes, ");
+  out.print(dataCodecRows > 0 ? ((float)dataCodecBytes) / ((float)dataCodecRows) : 0., 1);
+  out.print(" bytes/row (");
+  out.print(dataCodecRawBytes > 0 ? 100. * ((float)dataCodecBytes) / ((float)dataCodecRawBytes) : 0., 1);
+  out.print("% of raw values), ");
+  out.print(dataCodecRows > 0 ? dataCodecMicros / ((float)dataCodecRows) : 0., 1);
+  out.println(" us/row to encode");
+}
+
+#else
+#define DATA_FILE_SUFFIX ".csv"
+#endif
+
+// called when the output queue drops a row of the file: with ENABLE_COMPRESSED_DATA the next row
+// of the file is a keyframe, since later rows may have been encoded against the one dropped
+void dataCodecDropped(char *fullFileName)
+{
+#ifdef ENABLE_COMPRESSED_DATA
+  dataCodec *codec = findDataCodec(fullFileName, 0);
+  if (codec)
+  {
+    codec->keyframe = 1;
+  }
+#else
+  (void)fullFileName; // rows are not encoded against each other
+#endif
+}
@@ -0,0 +1,202 @@
+// debugLog.h
+// writes out the deferred debug records (ENABLE_DEFERRED_DEBUG in quickDebugMessages.h) when loop() is idle
+//  the DEBUG, WARN and MESSAGE macros only record a token, millis() and the value into debugLogRing.
+//  serviceDebugLog() turns the waiting records into lines
+//    $TTTTTTTT,millis,value
+//  (the token in hex, then the value printed as Serial.print would print it) once there are at least
+//  DEBUG_LOG_IDLE_MS before the next output is due, or when the ring is 3/4 full. host/detokenize
+//  replaces each line with the text of the macro that recorded it
+//
+//  the lines go to Serial, only as many as availableForWrite() says will not block (and, with
+//  ENABLE_SERIAL_TELEMETRY, only between telemetry frames), or with DEBUG_LOG_TO_SD to the SD log
+//  file (logFileName) in one write, through the output queue with ENABLE_OUTPUT_QUEUE
+//
+//  enable with ENABLE_DEFERRED_DEBUG next to ENABLEDEBUG in LoggerStatisticsVersion2.ino
+
+#ifdef ENABLE_DEFERRED_DEBUG
+
+#ifndef DEBUG_LOG_IDLE_MS
+#define DEBUG_LOG_IDLE_MS 5 // ms that must be left before the next output for loop() to count as idle
+#endif
+#define DEBUG_LOG_LINE_BYTES 64 // longest line: $, 8 hex digits, millis, a 24 character string
+
+unsigned long debugLogWritten = 0; // lines written
+unsigned long debugLogMicros = 0;  // time spent writing them
+
+// a line being formatted
+class debugLogLine : public Print
+{
+public:
+  char text[DEBUG_LOG_LINE_BYTES];
+  size_t length = 0;
+  size_t write(uint8_t c)
+  {
+    if (length >= sizeof(text))
+    {
+      return 0;
+    }
+    text[length++] = c;
+    return 1;
+  }
+  using Print::write;
+};
+
+uint8_t debugLogGet(unsigned int k)
+{
+  return debugLogRing[(debugLogHead + k) % DEBUG_LOG_BYTES];
+}
+
+uint32_t debugLogGet32(unsigned int k)
+{
+  uint32_t value = 0;
+  for (int b = 0; b < 4; b++)
+  {
+    value |= ((uint32_t)debugLogGet(k + b)) << (8 * b);
+  }
+  return value;
+}
+
+// format the oldest record as a line; returns the bytes the record takes in the ring
+int formatDebugLogRecord(debugLogLine &line)
+{
+  static const char hexDigits[] = "0123456789ABCDEF";
+  uint32_t token = debugLogGet32(0);
+  line.length = 0;
+  line.print('$');
+  for (int shift = 28; shift >= 0; shift -= 4)
+  {
+    line.print(hexDigits[(token >> shift) & 0xF]);
+  }
+  line.print(',');
+  line.print((unsigned long)debugLogGet32(4));
+  line.print(',');
+  char type = (char)debugLogGet(8);
+  int size = DEBUG_LOG_RECORD_BYTES + 4;
+  if (type == 'i')
+  {
+    line.print((long)(int32_t)debugLogGet32(DEBUG_LOG_RECORD_BYTES));
+  }
+  else if (type == 'u')
+  {
+    line.print((unsigned long)debugLogGet32(DEBUG_LOG_RECORD_BYTES));
+  }
+  else if (type == 'f')
+  {
+    uint32_t bits = debugLogGet32(DEBUG_LOG_RECORD_BYTES);
+    float value;
+    memcpy(&value, &bits, 4);
+    line.print(value);
+  }
+  else if (type == 'c')
+  {
+    line.print((char)debugLogGet(DEBUG_LOG_RECORD_BYTES));
+    size = DEBUG_LOG_RECORD_BYTES + 1;
+  }
+  else // 's'
+  {
+    int length = debugLogGet(DEBUG_LOG_RECORD_BYTES);
+    for (int k = 0; k < length; k++)
+    {
+      line.print((char)debugLogGet(DEBUG_LOG_RECORD_BYTES + 1 + k));
+    }
+    size = DEBUG_LOG_RECORD_BYTES + 1 + length;
+  }
+  line.print("\r\n");
+  return size;
+}
+
+void popDebugLogRecord(int size)
+{
+  debugLogHead = (debugLogHead + size) % DEBUG_LOG_BYTES;
+  debugLogUsed -= size;
+  debugLogWritten++;
+}
+
+// write the waiting records; returns the number of lines written
+int drainDebugLog()
+{
+  unsigned long startMicros = micros();
+  int written = 0;
+  debugLogLine line;
+#if defined(DEBUG_LOG_TO_SD) && defined(USE_SD)
+  PROFILE_REGION(iProfSDWrite)
+#ifdef ENABLE_OUTPUT_QUEUE
+  while (debugLogUsed > 0)
+  {
+    int size = formatDebugLogRecord(line);
+    outputQueueStartRecord(&sdQueue, logFileName, OUTPUT_PRIORITY_STATS).write((const uint8_t *)line.text, line.length);
+    outputQueueFinishRecord(&sdQueue); // a dropped line is counted by the queue
+    popDebugLogRecord(size);
+    written++;
+  }
+#else
+  File tmpFile = openLogFile(logFileName);
+  if (!tmpFile)
+  {
+    return 0; // the records stay in the ring until the card is back (or they are pushed out)
+  }
+  while (debugLogUsed > 0)
+  {
+    int size = formatDebugLogRecord(line);
+    tmpFile.write((const uint8_t *)line.text, line.length);
+    popDebugLogRecord(size);
+    written++;
+  }
+  closeLogFile(tmpFile, logFileName);
+#endif
+#else
+  PROFILE_REGION(iProfSerial)
+#ifdef ENABLE_SERIAL_TELEMETRY
+  if (telemetryUsed > 0)
+  {
+    return 0; // a frame is still going out: a line now would land inside it
+  }
+#endif
+  while (debugLogUsed > 0)
+  {
+    int size = formatDebugLogRecord(line);
+    if (Serial.availableForWrite() < (int)line.length)
+    {
+      break;
+    }
+    Serial.write((const uint8_t *)line.text, line.length);
+    popDebugLogRecord(size);
+    written++;
+  }
+#endif
+  debugLogMicros += micros() - startMicros;
+  return written;
+}
+
+// called every pass through loop() with the time the next output is due
+void serviceDebugLog(unsigned long nextOutput)
+{
+  if (debugLogUsed == 0)
+  {
+    return;
+  }
+  int nearlyFull = debugLogUsed * 4 >= DEBUG_LOG_BYTES * 3;
+  if (nearlyFull || (long)(nextOutput - millis()) >= DEBUG_LOG_IDLE_MS)
+  {
+    drainDebugLog();
+  }
+}
+
+void printDebugLogStatus(Print &out)
+{
+  out.print("debug log: ");
+  out.print(debugLogRecorded);
+  out.print(" records, ");
+  out.print(debugLogWritten);
+  out.print(" written, ");
+  out.print(debugLogDropped);
+  out.print(" dropped, high ");
+  out.print(debugLogHigh);
+  out.print(" of ");
+  out.print(DEBUG_LOG_BYTES);
+  out.print(" bytes, ");
+  out.print(((float)debugLogMicros) / 1000., 1);
+  out.println(" ms writing");
+}
+
+#endif
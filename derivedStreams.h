@@ -0,0 +1,548 @@
+// derivedStreams.h
+// data streams computed from other data streams, evaluated only when their value is used
+//  a derived stream is declared with an expression over the statistics of streams declared before
+//  it, e.g. the magnitude of the acceleration, the pitch angle or the dew point:
+//    iAmag = addDerivedStream(data, &nSamples, "Accel magnitude", "Amag", "m/s^2", 1, "sqrt(Ax^2 + Ay^2 + Az^2)");
+//    iPitch = addDerivedStream(data, &nSamples, "Pitch angle", "pitch", "deg", 1, "atan2(Ax, Az) * 180 / pi");
+//  instead of computing the value in loop() and adding it with updateDataSample() on every pass
+//
+//  expressions: numbers, pi, + - * / ^ (power), unary -, parentheses, the functions sqrt abs log
+//  exp sin cos atan atan2 min max, and streams by their short name with the statistic to use:
+//    Ax.cv current value, Ax.av average of the sample (Ax alone is the same), Ax.sd standard
+//    deviation, Ax.n sample size, Ax.dt trendline slope (the stream needs calcTrendline = 1)
+//  the statistics are taken from the sums of the sample as it stands, so they do not depend on
+//  the order in which the rate groups are finalized
+//
+//  each expression is compiled once into a plan (a list of operations on a small stack). a derived
+//  stream is evaluated when its sample is finalized (updateSampleStats of its rate group) and only
+//  if something uses it: it is output (outputStats != -1), a threshold event evaluates it, or another
+//  derived stream being evaluated refers to it. a value is computed at most once per finalize
+//  (derivedTick), however many streams refer to it. the derived stream then holds one value for
+//  the sample (n = 1), so its outputStats should be 0 or 1. it is in the rate group of the first
+//  stream its expression uses (setRateGroup() moves it)
+//
+//  enable with ENABLE_DERIVED_STREAMS in the deviceConfig file
+
+#ifdef ENABLE_DERIVED_STREAMS
+
+#define DERIVED_MAX_STREAMS 12 // derived streams
+#define DERIVED_MAX_OPS 128    // operations of all plans together
+#define DERIVED_STACK 8        // deepest stack a plan may use
+
+// operations of a plan
+#define DERIVED_CONST 0 // push value
+#define DERIVED_CV 1    // push a statistic of stream
+#define DERIVED_AV 2
+#define DERIVED_SD 3
+#define DERIVED_N 4
+#define DERIVED_DT 5
+#define DERIVED_ADD 6 // two values to one
+#define DERIVED_SUB 7
+#define DERIVED_MUL 8
+#define DERIVED_DIV 9
+#define DERIVED_POW 10
+#define DERIVED_ATAN2 11
+#define DERIVED_MIN 12
+#define DERIVED_MAX 13
+#define DERIVED_NEG 14 // one value to one
+#define DERIVED_SQRT 15
+#define DERIVED_ABS 16
+#define DERIVED_LOG 17
+#define DERIVED_EXP 18
+#define DERIVED_SIN 19
+#define DERIVED_COS 20
+#define DERIVED_ATAN 21
+
+struct derivedOp
+{
+  uint8_t code;
+  uint8_t stream; // for the statistics
+  float value;    // for DERIVED_CONST
+};
+
+struct derivedStream
+{
+  sampleStats *streams; // the array of data streams it belongs to
+  int index;            // its data stream
+  int firstOp;          // its plan in derivedOps
+  int nOps;
+  unsigned long tick; // derivedTick of its value
+};
+
+derivedOp derivedOps[DERIVED_MAX_OPS];
+int nDerivedOps = 0;
+derivedStream derived[DERIVED_MAX_STREAMS];
+int nDerived = 0;
+unsigned long derivedTick = 0;        // counts the finalizes of samples
+unsigned long derivedEvaluations = 0; // plans run (for the checks in host/testHost.cpp)
+
+// the functions an expression may call, with the number of arguments
+struct derivedFunction
+{
+  const char *name;
+  uint8_t code;
+  uint8_t nArgs;
+};
+
+const derivedFunction derivedFunctions[] = {
+    {"sqrt", DERIVED_SQRT, 1}, {"abs", DERIVED_ABS, 1}, {"log", DERIVED_LOG, 1}, {"exp", DERIVED_EXP, 1}, {"sin", DERIVED_SIN, 1}, {"cos", DERIVED_COS, 1}, {"atan", DERIVED_ATAN, 1}, {"atan2", DERIVED_ATAN2, 2}, {"min", DERIVED_MIN, 2}, {"max", DERIVED_MAX, 2}};
+
+// ---------------------------------------------------------------------------------------------
+// compiling an expression (recursive descent, emitting the plan in postfix order)
+
+struct derivedParser
+{
+  const char *p;
+  sampleStats *streams;
+  int nStreams;
+  int firstStream; // stream of the first statistic used (for the rate group)
+  int depth;       // stack depth at this point of the plan
+  int maxDepth;
+  const char *error;
+};
+
+void derivedEmit(derivedParser *parser, uint8_t code, uint8_t stream = 0, float value = 0.)
+{
+  if (nDerivedOps == DERIVED_MAX_OPS)
+  {
+    parser->error = "too many operations";
+    return;
+  }
+  derivedOps[nDerivedOps].code = code;
+  derivedOps[nDerivedOps].stream = stream;
+  derivedOps[nDerivedOps].value = value;
+  nDerivedOps++;
+  if (code <= DERIVED_DT)
+  {
+    parser->depth++;
+    parser->maxDepth = parser->depth > parser->maxDepth ? parser->depth : parser->maxDepth;
+  }
+  else if (code < DERIVED_NEG)
+  {
+    parser->depth--;
+  }
+}
+
+void derivedSkipSpaces(derivedParser *parser)
+{
+  while (*parser->p == ' ')
+  {
+    parser->p++;
+  }
+}
+
+int derivedIsNameChar(char c, int first)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!first && c >= '0' && c <= '9');
+}
+
+void derivedExpression(derivedParser *parser);
+
+// a number, pi, a stream statistic, a function call or a parenthesized expression
+void derivedPrimary(derivedParser *parser)
+{
+  derivedSkipSpaces(parser);
+  const char *start = parser->p;
+  if ((*start >= '0' && *start <= '9') || *start == '.')
+  {
+    char *end;
+    float value = strtod(start, &end);
+    parser->p = end;
+    derivedEmit(parser, DERIVED_CONST, 0, value);
+    return;
+  }
+  if (*start == '(')
+  {
+    parser->p++;
+    derivedExpression(parser);
+    derivedSkipSpaces(parser);
+    if (*parser->p != ')')
+    {
+      parser->error = "missing )";
+      return;
+    }
+    parser->p++;
+    return;
+  }
+  if (!derivedIsNameChar(*start, 1))
+  {
+    parser->error = "expected a value";
+    return;
+  }
+  while (derivedIsNameChar(*parser->p, 0))
+  {
+    parser->p++;
+  }
+  int length = parser->p - start;
+  derivedSkipSpaces(parser);
+
+  if (*parser->p == '(')
+  {
+    // function call
+    for (unsigned int f = 0; f < sizeof(derivedFunctions) / sizeof(derivedFunctions[0]); f++)
+    {
+      if ((int)strlen(derivedFunctions[f].name) == length && !strncmp(start, derivedFunctions[f].name, length))
+      {
+        parser->p++;
+        for (int arg = 0; arg < derivedFunctions[f].nArgs && !parser->error; arg++)
+        {
+          if (arg > 0)
+          {
+            derivedSkipSpaces(parser);
+            if (*parser->p != ',')
+            {
+              parser->error = "missing argument";
+              return;
+            }
+            parser->p++;
+          }
+          derivedExpression(parser);
+        }
+        derivedSkipSpaces(parser);
+        if (parser->error || *parser->p != ')')
+        {
+          parser->error = parser->error ? parser->error : "missing )";
+          return;
+        }
+        parser->p++;
+        derivedEmit(parser, derivedFunctions[f].code);
+        return;
+      }
+    }
+    parser->error = "unknown function";
+    return;
+  }
+  if (length == 2 && !strncmp(start, "pi", 2))
+  {
+    derivedEmit(parser, DERIVED_CONST, 0, PI);
+    return;
+  }
+
+  // a stream by its short name, with an optional statistic
+  int stream = -1;
+  for (int i = 0; i < parser->nStreams; i++)
+  {
+    if ((int)strlen(parser->streams[i].dataNickName) == length && !strncmp(start, parser->streams[i].dataNickName, length))
+    {
+      stream = i;
+    }
+  }
+  if (stream == -1)
+  {
+    parser->error = "unknown stream";
+    return;
+  }
+  uint8_t code = DERIVED_AV;
+  if (*parser->p == '.')
+  {
+    const char *stats[] = {"cv", "av", "sd", "n", "dt"};
+    const uint8_t codes[] = {DERIVED_CV, DERIVED_AV, DERIVED_SD, DERIVED_N, DERIVED_DT};
+    const char *stat = ++parser->p;
+    while (derivedIsNameChar(*parser->p, 0))
+    {
+      parser->p++;
+    }
+    code = 255;
+    for (int k = 0; k < 5; k++)
+    {
+      if ((int)strlen(stats[k]) == parser->p - stat && !strncmp(stat, stats[k], parser->p - stat))
+      {
+        code = codes[k];
+      }
+    }
+    if (code == 255)
+    {
+      parser->error = "unknown statistic";
+      return;
+    }
+  }
+  if (parser->firstStream == -1)
+  {
+    parser->firstStream = stream;
+  }
+  derivedEmit(parser, code, stream);
+}
+
+// unary minus and ^ (right to left: -a^b = -(a^b), a^b^c = a^(b^c))
+void derivedPower(derivedParser *parser)
+{
+  derivedSkipSpaces(parser);
+  if (*parser->p == '-')
+  {
+    parser->p++;
+    derivedPower(parser);
+    derivedEmit(parser, DERIVED_NEG);
+    return;
+  }
+  derivedPrimary(parser);
+  derivedSkipSpaces(parser);
+  if (!parser->error && *parser->p == '^')
+  {
+    parser->p++;
+    derivedPower(parser);
+    derivedEmit(parser, DERIVED_POW);
+  }
+}
+
+void derivedTerm(derivedParser *parser)
+{
+  derivedPower(parser);
+  derivedSkipSpaces(parser);
+  while (!parser->error && (*parser->p == '*' || *parser->p == '/'))
+  {
+    uint8_t code = *parser->p == '*' ? DERIVED_MUL : DERIVED_DIV;
+    parser->p++;
+    derivedPower(parser);
+    derivedEmit(parser, code);
+    derivedSkipSpaces(parser);
+  }
+}
+
+void derivedExpression(derivedParser *parser)
+{
+  derivedTerm(parser);
+  derivedSkipSpaces(parser);
+  while (!parser->error && (*parser->p == '+' || *parser->p == '-'))
+  {
+    uint8_t code = *parser->p == '+' ? DERIVED_ADD : DERIVED_SUB;
+    parser->p++;
+    derivedTerm(parser);
+    derivedEmit(parser, code);
+    derivedSkipSpaces(parser);
+  }
+}
+
+// addDerivedStream: creates a data stream computed from the expression and returns its index
+//   (-1 if the expression cannot be compiled or there is no room)
+int addDerivedStream(sampleStats *localData, int *numSamples, char *dataName, char *dataNickName, char *dataUnits, int outputType, const char *expression)
+{
+  if (nDerived == DERIVED_MAX_STREAMS)
+  {
+    WARN("too many derived streams", nDerived)
+    return -1;
+  }
+  derivedParser parser;
+  parser.p = expression;
+  parser.streams = localData;
+  parser.nStreams = *numSamples; // only streams declared before it, so plans never form a cycle
+  parser.firstStream = -1;
+  parser.depth = 0;
+  parser.maxDepth = 0;
+  parser.error = NULL;
+  int firstOp = nDerivedOps;
+  derivedExpression(&parser);
+  if (!parser.error && *parser.p != 0)
+  {
+    parser.error = "unexpected text";
+  }
+  if (!parser.error && parser.maxDepth > DERIVED_STACK)
+  {
+    parser.error = "expression too deep";
+  }
+  if (parser.error)
+  {
+    MESSAGE("derived stream", dataNickName)
+    WARN("cannot compile the expression at character", (int)(parser.p - expression))
+    nDerivedOps = firstOp;
+    return -1;
+  }
+
+  int index = addDataStream(localData, numSamples, dataName, dataNickName, dataUnits, outputType);
+  if (index < 0)
+  {
+    nDerivedOps = firstOp;
+    return -1;
+  }
+  if (parser.firstStream != -1)
+  {
+    localData[index].rateGroup = localData[parser.firstStream].rateGroup;
+  }
+  derived[nDerived].streams = localData;
+  derived[nDerived].index = index;
+  derived[nDerived].firstOp = firstOp;
+  derived[nDerived].nOps = nDerivedOps - firstOp;
+  derived[nDerived].tick = derivedTick - 1; // not evaluated yet
+  nDerived++;
+  return index;
+}
+
+// ---------------------------------------------------------------------------------------------
+// evaluating the plans
+
+// the derived stream of a data stream (-1 if it is measured)
+int derivedOf(sampleStats *dataStream, int index)
+{
+  for (int k = 0; k < nDerived; k++)
+  {
+    if (derived[k].streams == dataStream && derived[k].index == index)
+    {
+      return k;
+    }
+  }
+  return -1;
+}
+
+float derivedStreamValue(sampleStats *dataStream, int index);
+
+// a statistic of the sample of a stream as it stands
+float derivedStatistic(sampleStats *dataStream, int i, uint8_t code)
+{
+  if (derivedOf(dataStream, i) != -1)
+  {
+    derivedStreamValue(dataStream, i); // a derived stream it refers to is brought up to date first
+  }
+  sampleStats *stream = &dataStream[i];
+  float n = (float)stream->n;
+  switch (code)
+  {
+  case DERIVED_CV:
+    return stream->currentVal;
+  case DERIVED_AV:
+    return stream->n == 0 ? stream->currentVal : mathDivideN(stream->sumX, stream->n);
+  case DERIVED_SD:
+  {
+    if (stream->n < 2)
+    {
+      return 0.;
+    }
+    float variance = mathDivideN(stream->sumX2 - mathDivideN(stream->sumX * stream->sumX, stream->n), stream->n - 1);
+    return variance > 0. ? mathSqrt(variance) : 0.;
+  }
+  case DERIVED_N:
+    return n;
+  default: // DERIVED_DT
+  {
+    if (stream->calcTrendline != 1 || stream->n < 2)
+    {
+      return 0.;
+    }
+    float Sxt = stream->sumXT - mathDivideN(stream->sumX * stream->sumT, stream->n);
+    float Stt = stream->sumT2 - mathDivideN(stream->sumT * stream->sumT, stream->n);
+    return Stt > 0. ? Sxt / Stt : 0.;
+  }
+  }
+}
+
+float runDerivedPlan(sampleStats *dataStream, derivedStream *stream)
+{
+  float stack[DERIVED_STACK];
+  int top = -1;
+  const derivedOp *op = &derivedOps[stream->firstOp];
+  for (int k = 0; k < stream->nOps; k++, op++)
+  {
+    switch (op->code)
+    {
+    case DERIVED_CONST:
+      stack[++top] = op->value;
+      break;
+    case DERIVED_CV:
+    case DERIVED_AV:
+    case DERIVED_SD:
+    case DERIVED_N:
+    case DERIVED_DT:
+      stack[++top] = derivedStatistic(dataStream, op->stream, op->code);
+      break;
+    case DERIVED_ADD:
+      top--;
+      stack[top] += stack[top + 1];
+      break;
+    case DERIVED_SUB:
+      top--;
+      stack[top] -= stack[top + 1];
+      break;
+    case DERIVED_MUL:
+      top--;
+      stack[top] *= stack[top + 1];
+      break;
+    case DERIVED_DIV:
+      top--;
+      stack[top] /= stack[top + 1];
+      break;
+    case DERIVED_POW:
+      top--;
+      stack[top] = stack[top + 1] == 2. ? stack[top] * stack[top] : pow(stack[top], stack[top + 1]);
+      break;
+    case DERIVED_ATAN2:
+      top--;
+      stack[top] = atan2(stack[top], stack[top + 1]);
+      break;
+    case DERIVED_MIN:
+      top--;
+      stack[top] = stack[top + 1] < stack[top] ? stack[top + 1] : stack[top];
+      break;
+    case DERIVED_MAX:
+      top--;
+      stack[top] = stack[top + 1] > stack[top] ? stack[top + 1] : stack[top];
+      break;
+    case DERIVED_NEG:
+      stack[top] = -stack[top];
+      break;
+    case DERIVED_SQRT:
+      stack[top] = stack[top] > 0. ? mathSqrt(stack[top]) : 0.;
+      break;
+    case DERIVED_ABS:
+      stack[top] = fabs(stack[top]);
+      break;
+    case DERIVED_LOG:
+      stack[top] = log(stack[top]);
+      break;
+    case DERIVED_EXP:
+      stack[top] = exp(stack[top]);
+      break;
+    case DERIVED_SIN:
+      stack[top] = sin(stack[top]);
+      break;
+    case DERIVED_COS:
+      stack[top] = cos(stack[top]);
+      break;
+    case DERIVED_ATAN:
+      stack[top] = atan(stack[top]);
+      break;
+    }
+  }
+  derivedEvaluations++;
+  return stack[0];
+}
+
+// the value of a derived stream for this finalize: its plan is run the first time it is asked for
+// and the value is kept in the data stream as a sample of one value
+float derivedStreamValue(sampleStats *dataStream, int index)
+{
+  int k = derivedOf(dataStream, index);
+  if (k == -1)
+  {
+    return dataStream[index].currentVal;
+  }
+  if (derived[k].tick != derivedTick)
+  {
+    derived[k].tick = derivedTick; // set first: the plan reads only streams declared before it
+    float value = runDerivedPlan(dataStream, &derived[k]);
+    dataStream[index].currentVal = value;
+    dataStream[index].n = 1;
+    dataStream[index].sumX = value;
+    dataStream[index].sumX2 = value * value;
+  }
+  return dataStream[index].currentVal;
+}
+
+// called by updateSampleStats() before the statistics of a group are calculated: the derived
+// streams of the group that are output are evaluated (evaluateEventBreakpoints() asks for the
+// ones that threshold events watch)
+void evaluateDerivedStreams(sampleStats *dataStream, int nSamp, int group)
+{
+  derivedTick++;
+  for (int k = 0; k < nDerived; k++)
+  {
+    int i = derived[k].index;
+    if (derived[k].streams != dataStream || i >= nSamp || (group != -1 && dataStream[i].rateGroup != group))
+    {
+      continue;
+    }
+    if (dataStream[i].outputStats != -1)
+    {
+      derivedStreamValue(dataStream, i);
+    }
+  }
+}
+
+#endif
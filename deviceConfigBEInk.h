@@ -1,75 +1,133 @@
-// ************************************************************
-// * this file includes static variables that define the 
-// * current device configuration
-// ************************************************************
-
-// name for the device
-char deviceName[] = "B Generic Adafruite Sense with E-Ink SD";
-// code is single-character letter (capital) used as brief identification of device (e.g. in file names)
-char deviceCode[] = "B";
-
-// use compiler macros to turn on various sensors and peripherals
-#define USE_SD
-// USE_SD: enable to allow writing information to the SD card
-
-// if there is a real-time clock available
-//#define USE_RTC
-char dataFolder[] = "210118"; // this is the string to use for the folder storing data if the RTC is not present
-
-#define SERIAL_OUTPUT_INTERVAL 2000
-#define SAMPLING_PERIOD 400
-#define SLOW_DATA_INTERVAL 500
-#define ENABLE_RANDOM_DELAY
-
-// uncomment this line for debugging
-#define WAIT_FOR_SERIAL
-
-// *************** DATA_1: DEFINE PINS AND DEVICE PARAMETERS ********************************************
-// * DEFINE any needed I/O pins or devide parameters and macro definitions as needed      *
-// * ***********************************************************************************
-
-// use data simulator to test analytics
-//#define ENABLE_SIMULATED_DATA
-
-// ADAFRUIT FEATHER BLUEFRUIT SENSE Pins -------------------------------------------
-#define SENSE_BUTTON 7
-// LED's
-#define SENSE_NEO 8
-//#define ENABLE_NEOPIXEL
-#define SENSE_RED 13
-#define SENSE_BLUE 4
-// other Digital pins 11, 12, 13
-//        NOTE 5, 6, 9, 10, used for CS with Featherwing
-// Analog pins A0-A5 available
-// battery sensor on A6
-#define SENSE_BAT A6
-// AREF on A7
-
-#define ENABLE_SENSE_ACCEL
-// note: to use the gyro, accel must also be enabled
-#define ENABLE_SENSE_GYRO
-#define ENABLE_SENSE_MAG
-#define ENABLE_SENSE_ALTIM
-#define ENABLE_SENSE_HUMID
-
-// END OF ADAFRUIT FEATHER BLUEFRUIT SENSE info
-
-// Pins used with line climber
-#define SENSE_MOTOR 11
-#define SENSE_TOPSWITCH 12
-#define SENSE_BOTSWITCH 13
-
-// E-INK FEATHERWING
-//#define EPD_RESET   -1 // can set to -1 and share with microcontroller Reset!
-//#define EPD_BUSY    -1 // can set to -1 to not use a pin (will wait a fixed delay)
-//#define EPD_CS     9
-//#define EPD_DC     10
-//#define SRAM_CS     6
-#define SD_CS     5
-
-// ADALOGGER FEATHERWING 
-// SD chip select is pin 10 on adalogger featherwing!
-//#define SD_CS 10
-
-// to enable recording chunks of raw data uncomment the following line
-//#define ENABLE_DATA_CHUNKS
+// ************************************************************
+// * this file includes static variables that define the 
+// * current device configuration
+// ************************************************************
+
+// name for the device
+char deviceName[] = "B Generic Adafruite Sense with E-Ink SD";
+// code is single-character letter (capital) used as brief identification of device (e.g. in file names)
+char deviceCode[] = "B";
+
+// use compiler macros to turn on various sensors and peripherals
+#define USE_SD
+// USE_SD: enable to allow writing information to the SD card
+
+// if there is a real-time clock available
+//#define USE_RTC
+char dataFolder[] = "210118"; // this is the string to use for the folder storing data if the RTC is not present
+
+#define SERIAL_OUTPUT_INTERVAL 2000
+#define SAMPLING_PERIOD 400
+#define SLOW_DATA_INTERVAL 500
+#define SLOW_OUTPUT_INTERVAL 10000 // output interval of the slow streams when ENABLE_RATE_GROUPS is defined
+//#define IMU_OUTPUT_INTERVAL 100   // uncomment to summarize accel, gyro and mag on their own interval (with ENABLE_RATE_GROUPS)
+#define ENABLE_RANDOM_DELAY
+
+// uncomment to record loop() jitter and worst-case latency (with the phase responsible) in the data file
+//#define ENABLE_LOOP_TIMING
+// uncomment to time regions of the code (sensor reads, formatting, SD, Serial) as extra data streams
+//#define ENABLE_PROFILER
+// uncomment to print microbenchmarks of the statistics, event and output code to Serial at startup
+//#define ENABLE_BENCHMARK
+// uncomment to output slow streams (TC, RH, AOG) to their own file on their own interval (see rateGroups.h)
+//#define ENABLE_RATE_GROUPS
+// uncomment to add an absolute (unix) time column, anchored to the RTC, to data and event rows
+//#define ENABLE_ABSOLUTE_TIME
+// uncomment to queue SD output in RAM and write it in the background, surviving a missing or slow card (see outputQueue.h)
+//#define ENABLE_OUTPUT_QUEUE
+//#define OUTPUT_QUEUE_POLICY OUTPUT_POLICY_ROLLUP // what to do when the queue is full: BLOCK, DROP_OLDEST, DROP_LOW_PRIORITY or ROLLUP
+// uncomment to start new data and event files by size or every period (see logRotation.h)
+//#define ENABLE_LOG_ROTATION
+//#define LOG_ROTATE_BYTES 4000000 // bytes (0 = no limit)
+//#define LOG_ROTATE_PERIOD 3600   // s, on the hour with ENABLE_ABSOLUTE_TIME (0 = never)
+// uncomment to preallocate the log, data and event files so appending rows never allocates clusters (see logSD.h)
+//#define ENABLE_LOG_PREALLOCATE
+//#define LOG_PREALLOCATE_BYTES 1048576 // size of each preallocated file
+// uncomment to keep files open and sync them every few rows, with a CRC on each data and event row (see logSD.h)
+//#define ENABLE_GROUP_COMMIT
+//#define LOG_COMMIT_RECORDS 10   // rows between syncs
+//#define LOG_COMMIT_INTERVAL 5000 // ms, longest wait for a sync
+// uncomment to write the data file as compressed binary rows, decoded with host/decodeData (see dataCompress.h)
+//#define ENABLE_COMPRESSED_DATA
+// uncomment to send statistics and events on Serial as binary frames, read with host/telemetryView (see serialTelemetry.h)
+//#define ENABLE_SERIAL_TELEMETRY
+// uncomment to queue event changes in RAM and write them to the event file in batches (see eventQueue.h)
+//#define ENABLE_EVENT_QUEUE
+//#define EVENT_QUEUE_INTERVAL 1000 // ms between writes of the queued changes
+//#define EVENT_COALESCE_MS 50      // ms within which changes of one event are merged (0 = never)
+// uncomment to write an index (time, count, offset every few rows) next to the data and event files, read by host/timeQuery (see timeIndex.h)
+//#define ENABLE_TIME_INDEX
+//#define TIME_INDEX_ROWS 16        // rows between entries
+//#define TIME_INDEX_INTERVAL 10000 // ms, longest time between entries
+// uncomment to use fast sqrt, sine and division by n in the statistics and simulated signals (see fastMath.h)
+//#define ENABLE_FAST_MATH
+//#define FAST_MATH_SQRT_STEPS 2 // Newton steps of the square root, 0 to 3 (more is closer to sqrt)
+//#define FAST_MATH_SINE_BITS 8  // 2^bits steps per quarter wave of the sine table, 4 to 9
+// uncomment to add streams computed from other streams when they are output: |A|, pitch, dew point (see derivedStreams.h)
+//#define ENABLE_DERIVED_STREAMS
+// uncomment to output the rate group of Az faster while it is active and slower at rest, with the interval recorded as rateMs (see adaptiveRate.h)
+//#define ENABLE_ADAPTIVE_RATE
+//#define ADAPTIVE_THRESHOLD 0.5    // m/s^2, standard deviation (or change of the average) of Az that raises the rate
+//#define ADAPTIVE_FAST_PERIOD 100  // ms, output interval while active
+//#define ADAPTIVE_SLOW_PERIOD 2000 // ms, output interval at rest
+// uncomment to write the raw Ax, Ay, Az around a top switch hit or a pitch change to a capture file (see eventCapture.h)
+//#define ENABLE_CAPTURE
+//#define CAPTURE_PRE_SAMPLES 64  // samples of each stream kept from before the trigger
+//#define CAPTURE_POST_SAMPLES 64 // samples of each stream recorded after the trigger
+
+// uncomment this line for debugging
+#define WAIT_FOR_SERIAL
+
+// *************** DATA_1: DEFINE PINS AND DEVICE PARAMETERS ********************************************
+// * DEFINE any needed I/O pins or devide parameters and macro definitions as needed      *
+// * ***********************************************************************************
+
+// use data simulator to test analytics
+//#define ENABLE_SIMULATED_DATA
+//#define SIMULATION_SEED 1       // seed of the simulated noise (the same seed gives the same data)
+//#define SIM_TRACE_COLUMN "Ax_av" // also replay this column of the data file /trace.csv on the card as stream tSim
+
+// ADAFRUIT FEATHER BLUEFRUIT SENSE Pins -------------------------------------------
+#define SENSE_BUTTON 7
+// LED's
+#define SENSE_NEO 8
+//#define ENABLE_NEOPIXEL
+#define SENSE_RED 13
+#define SENSE_BLUE 4
+// other Digital pins 11, 12, 13
+//        NOTE 5, 6, 9, 10, used for CS with Featherwing
+// Analog pins A0-A5 available
+// battery sensor on A6
+#define SENSE_BAT A6
+// AREF on A7
+
+#define ENABLE_SENSE_ACCEL
+// note: to use the gyro, accel must also be enabled
+#define ENABLE_SENSE_GYRO
+// uncomment to read accel and gyro from the IMU FIFO in bursts at a fixed rate (instead of once per loop)
+//#define ENABLE_IMU_FIFO
+#define ENABLE_SENSE_MAG
+#define ENABLE_SENSE_ALTIM
+#define ENABLE_SENSE_HUMID
+
+// END OF ADAFRUIT FEATHER BLUEFRUIT SENSE info
+
+// Pins used with line climber
+#define SENSE_MOTOR 11
+#define SENSE_TOPSWITCH 12
+#define SENSE_BOTSWITCH 13
+
+// E-INK FEATHERWING
+//#define EPD_RESET   -1 // can set to -1 and share with microcontroller Reset!
+//#define EPD_BUSY    -1 // can set to -1 to not use a pin (will wait a fixed delay)
+//#define EPD_CS     9
+//#define EPD_DC     10
+//#define SRAM_CS     6
+#define SD_CS     5
+
+// ADALOGGER FEATHERWING 
+// SD chip select is pin 10 on adalogger featherwing!
+//#define SD_CS 10
+
+// to enable recording chunks of raw data uncomment the following line
+//#define ENABLE_DATA_CHUNKS
@@ -0,0 +1,411 @@
+// eventCapture.h
+// raw samples around an event (oscilloscope mode): the waveform of a few data streams just before
+// and after a switch is hit or a threshold is crossed, which the statistics of a sample average away
+//  each captured stream has a ring of its latest raw values (before the baseline is subtracted) in
+//  one shared arena of CAPTURE_ARENA_SAMPLES (time, value) pairs, room for pre samples before the
+//  trigger and post samples after it (addCaptureStream). updateDataSample() puts every value of a
+//  captured stream in its ring, with the time from monoMicros()
+//
+//  when a trigger event changes state (addCaptureTrigger, seen by updateEventState()) the rings go
+//  on recording until each has its post samples (or CAPTURE_POST_TIMEOUT ms have passed) and then
+//  stop: the window is complete. serviceEventCapture() (once per pass through loop()) writes it to
+//  the capture file as one binary block, at most maxBytes per pass, so a dump costs each pass one
+//  short write instead of stalling loop() for the whole window. each ring records again as soon as
+//  its own samples are written. a trigger while a window is being captured or written is missed
+//  (counted, and noted in the next block)
+//
+//  the capture file ("/d210118/Zcapt000.bin") has the usual text preamble, then one block per
+//  window, binary, little endian:
+//    header   "KCAP", version (uint16), header bytes (uint16), block bytes (uint32), window number
+//             (uint32), millis() at the trigger (uint32), monoMicros() at the trigger (low 32 bits),
+//             event index (uint16), its new state (uint16), streams (uint16), triggers missed
+//             since the last header (uint16), event nickname (16 bytes, zero padded)        48 bytes
+//    stream   nickname (10 bytes, zero padded), samples before the trigger (uint16), samples
+//             after it (uint16), 0 (uint16)                                                16 bytes
+//             then each sample, oldest first: us from the trigger (int32), value (float32)
+//    trailer  CRC-16 of the block before it (uint16), 0 (uint16)
+//  host/decodeCapture prints the windows as CSV. host/testHost (CAPTURE) checks windows captured on
+//  scripted triggers against the file and host/benchmarkHost times the passes of loop() during a dump
+//
+//  enable with ENABLE_CAPTURE (and CAPTURE_PRE_SAMPLES, CAPTURE_POST_SAMPLES) in the deviceConfig
+//  file (requires USE_SD)
+
+#ifdef ENABLE_CAPTURE
+
+#ifndef CAPTURE_ARENA_SAMPLES
+#define CAPTURE_ARENA_SAMPLES 1024 // (time, value) pairs shared by the rings (8 bytes each)
+#endif
+#ifndef CAPTURE_PRE_SAMPLES
+#define CAPTURE_PRE_SAMPLES 64 // samples of each stream kept from before the trigger
+#endif
+#ifndef CAPTURE_POST_SAMPLES
+#define CAPTURE_POST_SAMPLES 64 // samples of each stream recorded after the trigger
+#endif
+#ifndef CAPTURE_POST_TIMEOUT
+#define CAPTURE_POST_TIMEOUT 5000 // ms after the trigger at which a window is complete anyway
+#endif
+#ifndef CAPTURE_WRITE_BYTES
+#define CAPTURE_WRITE_BYTES 512 // most bytes of a window written in one pass through loop()
+#endif
+#define CAPTURE_RETRY_INTERVAL 1000 // ms between attempts to open the capture file
+#define CAPTURE_MAX_STREAMS 8
+#define CAPTURE_MAX_TRIGGERS 4
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_BYTES 48
+#define CAPTURE_STREAM_BYTES 16
+#define CAPTURE_SAMPLE_BYTES 8
+#define CAPTURE_TRAILER_BYTES 4
+#define CAPTURE_EVENT_NAME 16
+
+#define CAPTURE_ARMED 0   // recording into the rings, waiting for a trigger
+#define CAPTURE_POST 1    // triggered: recording the samples after the trigger
+#define CAPTURE_WRITING 2 // the window is complete and being written
+
+struct captureSample
+{
+  uint32_t micros; // monoMicros() (low 32 bits)
+  float value;
+};
+
+struct captureStream
+{
+  sampleStats *streams; // the array of data streams it belongs to
+  int stream;           // captured data stream
+  int start;            // first pair of its ring in the arena
+  int size;             // pairs in the ring (pre + post)
+  int pre;              // samples kept from before the trigger
+  int post;             // samples recorded after it
+  int head;             // where the next value goes
+  int count;            // values in the ring
+  int preCount;         // values of the window from before the trigger
+  int postCount;        // values of the window from after it
+  int recording;        // 0 from the end of its window until it is written
+};
+
+struct captureTrigger
+{
+  eventTracker *events;
+  int event;
+  int state; // new state that triggers (-1 = any change)
+};
+
+captureSample captureArena[CAPTURE_ARENA_SAMPLES];
+int captureArenaUsed = 0;
+captureStream captureStreams[CAPTURE_MAX_STREAMS];
+int nCaptureStreams = 0;
+captureTrigger captureTriggers[CAPTURE_MAX_TRIGGERS];
+int nCaptureTriggers = 0;
+char captureFileName[40]; // buffer holding the name of the capture file
+
+// the window being captured or written
+int captureState = CAPTURE_ARMED;
+int captureWaiting = 0; // streams still recording their post samples
+uint32_t captureTriggerMillis = 0;
+uint32_t captureTriggerMicros = 0;
+int captureEvent = 0;
+int captureEventState = 0;
+char captureEventName[CAPTURE_EVENT_NAME];
+unsigned long captureBlockBytes = 0;
+unsigned long captureWritten = 0; // bytes of the block written
+int captureCursorStream = -1;     // -1 = header, nCaptureStreams = trailer
+int captureCursorSample = -1;     // -1 = stream header
+uint16_t captureCRC = 0xFFFF;
+unsigned long captureNextWrite = 0; // millis() of the next attempt after a failed open
+
+// counters for printCaptureStatus()
+unsigned long captureWindows = 0;     // windows written
+unsigned long captureMissed = 0;      // triggers while a window was being captured or written
+unsigned long captureMissedBlock = 0; // of those, since the last block header
+unsigned long captureBytes = 0;       // bytes written to the capture file
+unsigned long captureWrites = 0;      // passes that wrote part of a window
+unsigned long captureFailures = 0;    // opens of the capture file that failed
+
+// capture the raw values of data stream iData: pre samples before a trigger and post after it;
+// returns its index, or -1 if the stream was not created or the arena is full
+int addCaptureStream(sampleStats *localData, int iData, int pre, int post)
+{
+  if (iData < 0)
+  {
+    return -1; // the data stream was not created (e.g. its sensor is disabled)
+  }
+  if (nCaptureStreams == CAPTURE_MAX_STREAMS)
+  {
+    WARN("too many captured streams", nCaptureStreams)
+    return -1;
+  }
+  if (pre < 0 || post < 1 || captureArenaUsed + pre + post > CAPTURE_ARENA_SAMPLES)
+  {
+    WARN("no room in the capture arena", captureArenaUsed)
+    return -1;
+  }
+  int k = nCaptureStreams;
+  captureStream *ring = &captureStreams[k];
+  ring->streams = localData;
+  ring->stream = iData;
+  ring->start = captureArenaUsed;
+  ring->size = pre + post;
+  ring->pre = pre;
+  ring->post = post;
+  ring->head = 0;
+  ring->count = 0;
+  ring->preCount = 0;
+  ring->postCount = 0;
+  ring->recording = 1;
+  captureArenaUsed += pre + post;
+  localData[iData].captureIndex = k;
+  nCaptureStreams++;
+  return k;
+}
+
+// capture a window when event jEvent changes to state (-1 = any change); returns its index or -1
+int addCaptureTrigger(eventTracker *localEvents, int jEvent, int state = -1)
+{
+  if (jEvent < 0)
+  {
+    return -1; // the event was not created
+  }
+  if (nCaptureTriggers == CAPTURE_MAX_TRIGGERS)
+  {
+    WARN("too many capture triggers", nCaptureTriggers)
+    return -1;
+  }
+  captureTriggers[nCaptureTriggers].events = localEvents;
+  captureTriggers[nCaptureTriggers].event = jEvent;
+  captureTriggers[nCaptureTriggers].state = state;
+  nCaptureTriggers++;
+  return nCaptureTriggers - 1;
+}
+
+// called by updateDataSample() with each raw value of a captured stream
+void captureDataSample(int k, float value, uint32_t micros)
+{
+  captureStream *ring = &captureStreams[k];
+  if (!ring->recording)
+  {
+    return;
+  }
+  captureSample *slot = &captureArena[ring->start + ring->head];
+  slot->micros = micros;
+  slot->value = value;
+  ring->head = (ring->head + 1 == ring->size) ? 0 : ring->head + 1;
+  if (ring->count < ring->size)
+  {
+    ring->count++;
+  }
+  if (captureState == CAPTURE_POST && ++ring->postCount == ring->post)
+  {
+    ring->recording = 0; // the window of this stream is complete
+    captureWaiting--;
+  }
+}
+
+// start a window: the rings keep what they hold as the samples before the trigger
+void triggerCapture(eventTracker *localEvents, int jEvent, int newState)
+{
+  if (captureState != CAPTURE_ARMED || nCaptureStreams == 0)
+  {
+    captureMissed++;
+    captureMissedBlock++;
+    return;
+  }
+  captureState = CAPTURE_POST;
+  captureTriggerMillis = millis();
+  captureTriggerMicros = (uint32_t)monoMicros();
+  captureEvent = jEvent;
+  captureEventState = newState;
+  memset(captureEventName, 0, CAPTURE_EVENT_NAME);
+  strncpy(captureEventName, localEvents[jEvent].eventNickName, CAPTURE_EVENT_NAME - 1);
+  captureWaiting = 0;
+  for (int k = 0; k < nCaptureStreams; k++)
+  {
+    captureStream *ring = &captureStreams[k];
+    ring->preCount = ring->count < ring->pre ? ring->count : ring->pre;
+    ring->postCount = 0;
+    if (ring->recording)
+    {
+      captureWaiting++;
+    }
+  }
+}
+
+// called by updateEventState() when an event changes state
+void captureEventChanged(eventTracker *localEvents, int jEvent, int newState)
+{
+  for (int t = 0; t < nCaptureTriggers; t++)
+  {
+    captureTrigger *trigger = &captureTriggers[t];
+    if (trigger->events == localEvents && trigger->event == jEvent && (trigger->state < 0 || trigger->state == newState))
+    {
+      triggerCapture(localEvents, jEvent, newState);
+      return;
+    }
+  }
+}
+
+void putCaptureWord(uint8_t *bytes, uint32_t value, int size)
+{
+  for (int k = 0; k < size; k++)
+  {
+    bytes[k] = (uint8_t)(value >> (8 * k));
+  }
+}
+
+// bytes of the next part of the block (0 when it is all written)
+int captureNextBytes()
+{
+  if (captureCursorStream < 0)
+    return CAPTURE_HEADER_BYTES;
+  if (captureCursorStream == nCaptureStreams)
+    return captureWritten < captureBlockBytes ? CAPTURE_TRAILER_BYTES : 0;
+  return captureCursorSample < 0 ? CAPTURE_STREAM_BYTES : CAPTURE_SAMPLE_BYTES;
+}
+
+// the next part of the block (header, stream header, sample or trailer) into bytes; moves on
+void captureMakeNext(uint8_t *bytes)
+{
+  if (captureCursorStream < 0)
+  {
+    memcpy(bytes, "KCAP", 4);
+    putCaptureWord(bytes + 4, CAPTURE_VERSION, 2);
+    putCaptureWord(bytes + 6, CAPTURE_HEADER_BYTES, 2);
+    putCaptureWord(bytes + 8, captureBlockBytes, 4);
+    putCaptureWord(bytes + 12, captureWindows, 4);
+    putCaptureWord(bytes + 16, captureTriggerMillis, 4);
+    putCaptureWord(bytes + 20, captureTriggerMicros, 4);
+    putCaptureWord(bytes + 24, captureEvent, 2);
+    putCaptureWord(bytes + 26, captureEventState, 2);
+    putCaptureWord(bytes + 28, nCaptureStreams, 2);
+    putCaptureWord(bytes + 30, captureMissedBlock < 0xFFFF ? captureMissedBlock : 0xFFFF, 2);
+    memcpy(bytes + 32, captureEventName, CAPTURE_EVENT_NAME);
+    captureMissedBlock = 0; // the next block notes those missed while this one is written
+    captureCursorStream = 0;
+    captureCursorSample = -1;
+    return;
+  }
+  if (captureCursorStream == nCaptureStreams)
+  {
+    putCaptureWord(bytes, captureCRC, 2);
+    putCaptureWord(bytes + 2, 0, 2);
+    return;
+  }
+  captureStream *ring = &captureStreams[captureCursorStream];
+  if (captureCursorSample < 0)
+  {
+    memset(bytes, 0, CAPTURE_STREAM_BYTES);
+    strncpy((char *)bytes, ring->streams[ring->stream].dataNickName, DATA_NAME_SHORT);
+    putCaptureWord(bytes + 10, ring->preCount, 2);
+    putCaptureWord(bytes + 12, ring->postCount, 2);
+    putCaptureWord(bytes + 14, 0, 2);
+  }
+  else
+  {
+    // the samples run from preCount before the end of the window to its end
+    int at = (ring->head - ring->preCount - ring->postCount + captureCursorSample + ring->size) % ring->size;
+    captureSample *sample = &captureArena[ring->start + at];
+    uint32_t valueBits;
+    memcpy(&valueBits, &sample->value, 4);
+    putCaptureWord(bytes, sample->micros - captureTriggerMicros, 4);
+    putCaptureWord(bytes + 4, valueBits, 4);
+  }
+  captureCursorSample++;
+  if (captureCursorSample == ring->preCount + ring->postCount)
+  {
+    // all of the stream is in the block: its ring starts over
+    ring->count = 0;
+    ring->recording = 1;
+    captureCursorStream++;
+    captureCursorSample = -1;
+  }
+}
+
+// the window is complete: stop the rings and size the block
+void finishCaptureWindow()
+{
+  captureBlockBytes = CAPTURE_HEADER_BYTES + CAPTURE_TRAILER_BYTES;
+  for (int k = 0; k < nCaptureStreams; k++)
+  {
+    captureStream *ring = &captureStreams[k];
+    if (ring->recording)
+    {
+      ring->recording = 0; // timed out with fewer samples
+      ring->count = ring->preCount + ring->postCount;
+    }
+    captureBlockBytes += CAPTURE_STREAM_BYTES + CAPTURE_SAMPLE_BYTES * (ring->preCount + ring->postCount);
+  }
+  captureState = CAPTURE_WRITING;
+  captureWritten = 0;
+  captureCursorStream = -1;
+  captureCursorSample = -1;
+  captureCRC = 0xFFFF;
+}
+
+// call on every pass through loop(): completes a window when its post samples are in and writes
+// up to maxBytes of it to the capture file. returns the bytes written, or -1 if the file could not
+// be opened (the window waits and the open is retried after CAPTURE_RETRY_INTERVAL)
+long serviceEventCapture(unsigned long maxBytes)
+{
+  if (captureState == CAPTURE_POST && (captureWaiting <= 0 || millis() - captureTriggerMillis >= CAPTURE_POST_TIMEOUT))
+  {
+    finishCaptureWindow();
+  }
+  if (captureState != CAPTURE_WRITING || (captureNextWrite != 0 && millis() < captureNextWrite))
+  {
+    return 0;
+  }
+  File captureFile = openLogFile(captureFileName);
+  if (!captureFile)
+  {
+    captureFailures++;
+    captureNextWrite = millis() + CAPTURE_RETRY_INTERVAL;
+    return -1;
+  }
+  captureNextWrite = 0;
+  uint8_t staging[64];
+  unsigned long written = 0;
+  int staged = 0;
+  for (int length = captureNextBytes(); length > 0 && (written + staged + length <= maxBytes || written + staged == 0); length = captureNextBytes())
+  {
+    if (staged + length > (int)sizeof(staging))
+    {
+      captureFile.write(staging, staged);
+      written += staged;
+      staged = 0;
+    }
+    int trailer = (captureCursorStream == nCaptureStreams);
+    captureMakeNext(staging + staged);
+    for (int k = 0; !trailer && k < length; k++)
+    {
+      captureCRC = crc16Update(captureCRC, staging[staged + k]);
+    }
+    staged += length;
+    captureWritten += length;
+  }
+  captureFile.write(staging, staged);
+  written += staged;
+  closeLogFile(captureFile, captureFileName);
+  captureBytes += written;
+  captureWrites++;
+  if (captureWritten == captureBlockBytes)
+  {
+    captureWindows++;
+    captureState = CAPTURE_ARMED;
+  }
+  return (long)written;
+}
+
+void printCaptureStatus(Print &out)
+{
+  out.print("capture: ");
+  out.print(captureWindows);
+  out.print(" windows, ");
+  out.print(captureBytes);
+  out.print(" bytes in ");
+  out.print(captureWrites);
+  out.print(" writes, ");
+  out.print(captureMissed);
+  out.print(" triggers missed, ");
+  out.print(captureFailures);
+  out.println(" failed opens");
+}
+
+#endif
@@ -0,0 +1,223 @@
+// eventQueue.h
+// batched writing of event changes to the event file
+//  without it every change opens the event file, writes its FROM and TO rows and closes it again,
+//  inline in loop() at the moment the change is found, so a bouncing button or a threshold
+//  chattering around its breakpoint turns into a storm of opens and closes. here each change is
+//  copied into a fixed array of eventRecord (eventTracker.h) and serviceEventQueue() writes the
+//  waiting records every EVENT_QUEUE_INTERVAL ms (or when the queue is 3/4 full) with one open of
+//  the file (or into the output queue with ENABLE_OUTPUT_QUEUE). the rows are the same as before
+//
+//  with EVENT_COALESCE_MS > 0 a change of an event that comes within EVENT_COALESCE_MS of its
+//  previous change, while that one is still waiting, is merged into it: the record keeps where it
+//  started and gets the new end state, end time and count. a bounce that ends back in the state it
+//  started from is not written at all. records are held back for EVENT_COALESCE_MS so that a storm
+//  is merged before it is written. merged changes leave a gap in the count column (as rows
+//  rolled up by the output queue do), and the Count columns of the next row still count them
+//
+//  when the queue is full the new change is dropped and counted; the card failing or going
+//  missing keeps the records queued (without the output queue) until a write succeeds
+//
+//  enable with ENABLE_EVENT_QUEUE in the deviceConfig file
+
+#ifdef ENABLE_EVENT_QUEUE
+
+#ifndef EVENT_QUEUE_RECORDS
+#define EVENT_QUEUE_RECORDS 32 // changes waiting to be written
+#endif
+#ifndef EVENT_QUEUE_INTERVAL
+#define EVENT_QUEUE_INTERVAL 1000 // ms between writes of the waiting changes
+#endif
+#ifndef EVENT_COALESCE_MS
+#define EVENT_COALESCE_MS 0 // ms within which changes of one event are merged (0 = never merge)
+#endif
+
+eventRecord eventQueue[EVENT_QUEUE_RECORDS];
+int eventQueueHead = 0; // oldest waiting record
+int eventQueueUsed = 0;
+unsigned long nextEventQueueWrite = 0;
+
+// counters for printEventQueueStatus()
+unsigned long eventQueueQueued = 0;    // changes queued (including those merged)
+unsigned long eventQueueWritten = 0;   // records written
+unsigned long eventQueueCoalesced = 0; // changes merged into a waiting record
+unsigned long eventQueueCancelled = 0; // records not written because their bounce came back
+unsigned long eventQueueDropped = 0;   // changes lost because the queue was full
+unsigned long eventQueueBatches = 0;   // writes (opens of the file)
+unsigned long eventQueueFailures = 0;  // writes that could not open the file
+int eventQueueHigh = 0;                // most records waiting
+unsigned long eventQueueMicros = 0;    // time spent writing the records
+
+eventRecord *eventQueueAt(int k)
+{
+  return &eventQueue[(eventQueueHead + k) % EVENT_QUEUE_RECORDS];
+}
+
+// queue the latest change of the event (called in place of writing it); returns 1, or -1 if the
+// queue was full and the change was dropped
+int queueEventToFile(char *fullFileName, eventTracker *localEvents, int jEvent, char *separator, int count)
+{
+  eventQueueQueued++;
+#if EVENT_COALESCE_MS > 0
+  // the last waiting record of the same event
+  for (int k = eventQueueUsed - 1; k >= 0; k--)
+  {
+    eventRecord *previous = eventQueueAt(k);
+    if (previous->jEvent != jEvent || previous->fullFileName != fullFileName)
+    {
+      continue;
+    }
+    uint32_t changeTime = localEvents[jEvent].stateTimeStarted[localEvents[jEvent].state];
+    if (changeTime - previous->tEnd < EVENT_COALESCE_MS)
+    {
+      previous->toState = (uint8_t)localEvents[jEvent].state;
+      previous->tEnd = changeTime;
+      previous->duration = previous->tEnd - previous->tStart;
+      previous->toCount = localEvents[jEvent].stateCount[localEvents[jEvent].state];
+      previous->cancelled = previous->toState == previous->fromState;
+      eventQueueCoalesced++;
+      return 1;
+    }
+    break;
+  }
+#endif
+  if (eventQueueUsed >= EVENT_QUEUE_RECORDS)
+  {
+    eventQueueDropped++;
+    return -1;
+  }
+  eventRecord *record = eventQueueAt(eventQueueUsed);
+  captureEventRecord(record, localEvents, jEvent, separator, count);
+  record->fullFileName = fullFileName;
+  eventQueueUsed++;
+  if (eventQueueUsed > eventQueueHigh)
+  {
+    eventQueueHigh = eventQueueUsed;
+  }
+  return 1;
+}
+
+// a record that a later change of its event may still be merged into
+#if EVENT_COALESCE_MS > 0
+#define eventRecordHeld(record) ((uint32_t)millis() - (record)->tEnd < EVENT_COALESCE_MS)
+#else
+#define eventRecordHeld(record) 0
+#endif
+
+// write the waiting records (all of them when force = 1, otherwise those that can no longer be
+// merged); returns the number written, or -1 if the file could not be opened
+int drainEventQueue(eventTracker *localEvents, int force)
+{
+  PROFILE_REGION(iProfSDWrite)
+  unsigned long startMicros = micros();
+  int written = 0;
+  int status = 0;
+  while (eventQueueUsed > 0)
+  {
+    char *fullFileName = eventQueueAt(0)->fullFileName;
+    // records ready to go to this file
+    int ready = 0;
+    while (ready < eventQueueUsed && eventQueueAt(ready)->fullFileName == fullFileName &&
+           (force || !eventRecordHeld(eventQueueAt(ready))))
+    {
+      ready++;
+    }
+    if (ready == 0)
+    {
+      break;
+    }
+#ifdef ENABLE_OUTPUT_QUEUE
+    for (int k = 0; k < ready; k++)
+    {
+      eventRecord *record = eventQueueAt(k);
+      if (!record->cancelled)
+      {
+        printEventRecord(outputQueueStartRecord(&sdQueue, fullFileName, OUTPUT_PRIORITY_EVENT), localEvents, record);
+        outputQueueFinishRecord(&sdQueue);
+      }
+    }
+#else
+    File tmpFile = openLogFile(fullFileName);
+    if (!tmpFile)
+    {
+      eventQueueFailures++;
+      status = -1; // the records stay queued for the next write
+      break;
+    }
+    for (int k = 0; k < ready; k++)
+    {
+      eventRecord *record = eventQueueAt(k);
+      if (!record->cancelled)
+      {
+#ifdef ENABLE_TIME_INDEX
+        unsigned long offset = logFileEnd(tmpFile, fullFileName);
+#endif
+        printEventRecord(tmpFile, localEvents, record);
+#ifdef ENABLE_TIME_INDEX
+        timeIndexRowWritten(fullFileName, record->count, offset);
+#endif
+      }
+    }
+    closeLogFile(tmpFile, fullFileName);
+#endif
+    eventQueueBatches++;
+    for (int k = 0; k < ready; k++)
+    {
+      if (eventQueueAt(k)->cancelled)
+      {
+        eventQueueCancelled++;
+      }
+      else
+      {
+        eventQueueWritten++;
+        written++;
+      }
+    }
+    eventQueueHead = (eventQueueHead + ready) % EVENT_QUEUE_RECORDS;
+    eventQueueUsed -= ready;
+  }
+  eventQueueMicros += micros() - startMicros;
+  return status < 0 ? status : written;
+}
+
+// called every pass through loop(): writes the waiting records every EVENT_QUEUE_INTERVAL ms, or
+// sooner when the queue is 3/4 full
+void serviceEventQueue(eventTracker *localEvents)
+{
+  if (eventQueueUsed == 0)
+  {
+    return;
+  }
+  int nearlyFull = eventQueueUsed * 4 >= EVENT_QUEUE_RECORDS * 3;
+  if (millis() >= nextEventQueueWrite || nearlyFull)
+  {
+    drainEventQueue(localEvents, nearlyFull);
+    nextEventQueueWrite = millis() + EVENT_QUEUE_INTERVAL;
+  }
+}
+
+void printEventQueueStatus(Print &out)
+{
+  out.print("event queue: ");
+  out.print(eventQueueQueued);
+  out.print(" changes, ");
+  out.print(eventQueueWritten);
+  out.print(" written in ");
+  out.print(eventQueueBatches);
+  out.print(" writes, ");
+  out.print(eventQueueCoalesced);
+  out.print(" merged, ");
+  out.print(eventQueueCancelled);
+  out.print(" bounces not written, ");
+  out.print(eventQueueDropped);
+  out.print(" dropped, ");
+  out.print(eventQueueFailures);
+  out.print(" failed writes, high ");
+  out.print(eventQueueHigh);
+  out.print(" of ");
+  out.print(EVENT_QUEUE_RECORDS);
+  out.print(", ");
+  out.print(((float)eventQueueMicros) / 1000., 1);
+  out.println(" ms writing");
+}
+
+#endif
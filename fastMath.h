@@ -0,0 +1,180 @@
+// fastMath.h
+// fast square roots, sines and divisions by a sample size for the statistics and sensor hot paths
+// (updateSampleStats, the row printers, the trendline and the simulated signals): on a board
+// without an FPU (the SAMD21 of the M0 Feathers) each libm call is a software routine of hundreds
+// of cycles
+//
+//  the code calls them through these macros:
+//    mathSqrt(x)               sqrt(x)
+//    mathSqrtOfRatio(a, b)     sqrt(a / b)
+//    mathDivideN(x, n)         x / (float)n, for a sample size n >= 1
+//    mathSinPeriod(t, period)  sin(2 PI t / period)
+//    mathCosPeriod(t, period)  cos(2 PI t / period)
+//  without ENABLE_FAST_MATH they are exactly those expressions. with it they use the kernels
+//  below, whose precision is a template parameter chosen for the build:
+//    fastInvSqrt<steps>(x), fastSqrt<steps>(x)   FAST_MATH_SQRT_STEPS (0 to 3, default 2)
+//      a first guess from the bits of the float, refined by Newton steps; largest relative error
+//      fastSqrtError[steps]: 3.5e-2, 1.8e-3, 4.8e-6, 2.5e-7 (x normal; fastSqrt(x) is 0 for x <= 0)
+//    fastSinTurns<bits>(t), fastCosTurns<bits>(t)   FAST_MATH_SINE_BITS (4 to 9, default 8)
+//      sin and cos of t turns (2 PI t radians) by linear interpolation in a table of a quarter
+//      wave in 2^bits steps, made by the compiler; largest absolute error fastSineError[bits]:
+//      bits 4 1.3e-3, 5 3.1e-4, 6 7.7e-5, 7 2.0e-5, 8 4.9e-6, 9 1.3e-6, for t rounded to a float
+//      (so the argument itself is good to about 2 PI |t| 6e-8 radians)
+//    fastReciprocal(n)   1 / n from a table of FAST_MATH_RECIPROCALS entries (default 256) made by
+//      the compiler, a division above it; x * fastReciprocal(n) is within 1 ulp of x / n
+//  host/testHost checks every precision against libm (ACCURACY), and host/benchmarkHost (and
+//  ENABLE_BENCHMARK on the board) times the kernels against the libm calls
+//
+//  enable with ENABLE_FAST_MATH in the deviceConfig file
+
+#ifndef FAST_MATH_SQRT_STEPS
+#define FAST_MATH_SQRT_STEPS 2
+#endif
+#ifndef FAST_MATH_SINE_BITS
+#define FAST_MATH_SINE_BITS 8
+#endif
+#ifndef FAST_MATH_RECIPROCALS
+#define FAST_MATH_RECIPROCALS 256
+#endif
+
+// largest errors of each precision (checked by host/testHost.cpp)
+const float fastSqrtError[4] = {3.5e-2, 1.8e-3, 4.8e-6, 2.5e-7}; // relative, by steps
+const float fastSineError[10] = {0, 0, 0, 0, 1.3e-3, 3.1e-4, 7.7e-5, 2.0e-5, 4.9e-6, 1.3e-6}; // absolute, by bits
+
+// lists of indices for the tables made by the compiler (C++11 has no std::index_sequence)
+template <int... k>
+struct fastMathIndices
+{
+};
+template <int n, int... k>
+struct fastMathRange : fastMathRange<n - 1, n - 1, k...>
+{
+};
+template <int... k>
+struct fastMathRange<0, k...>
+{
+  typedef fastMathIndices<k...> type;
+};
+
+// sin(x) for the tables: its Taylor series, in double
+constexpr double fastMathSinSeries(double x2, double term, int k, double sum)
+{
+  return k > 12 ? sum : fastMathSinSeries(x2, -term * x2 / ((2 * k) * (2 * k + 1)), k + 1, sum + term);
+}
+
+constexpr double fastMathSin(double x)
+{
+  return fastMathSinSeries(x * x, x, 1, 0.);
+}
+
+// sin of 0 to PI / 2 in 2^bits steps
+template <int bits, typename indices = typename fastMathRange<(1 << bits) + 1>::type>
+struct fastMathSineTable;
+template <int bits, int... k>
+struct fastMathSineTable<bits, fastMathIndices<k...> >
+{
+  static constexpr float value[sizeof...(k)] = {(float)fastMathSin(k * (PI / 2.) / (1 << bits))...};
+};
+template <int bits, int... k>
+constexpr float fastMathSineTable<bits, fastMathIndices<k...> >::value[sizeof...(k)];
+
+// 1 / n (0 for n = 0)
+template <typename indices = typename fastMathRange<FAST_MATH_RECIPROCALS>::type>
+struct fastMathReciprocalTable;
+template <int... k>
+struct fastMathReciprocalTable<fastMathIndices<k...> >
+{
+  static constexpr float value[sizeof...(k)] = {(float)(k ? 1. / k : 0.)...};
+};
+template <int... k>
+constexpr float fastMathReciprocalTable<fastMathIndices<k...> >::value[sizeof...(k)];
+
+template <int steps>
+inline float fastInvSqrt(float x)
+{
+  union
+  {
+    float f;
+    uint32_t i;
+  } bits;
+  bits.f = x;
+  bits.i = 0x5F375A86UL - (bits.i >> 1); // within 3.5% of 1 / sqrt(x)
+  float y = bits.f;
+  for (int k = 0; k < steps; k++)
+  {
+    y = y * (1.5f - 0.5f * x * y * y);
+  }
+  return y;
+}
+
+template <int steps>
+inline float fastSqrt(float x)
+{
+  return x > 0.f ? x * fastInvSqrt<steps>(x) : 0.f;
+}
+
+// sin of t turns, with quarter more quarter waves added (1 = cos)
+template <int bits>
+inline float fastMathSineAt(float turns, int quarter)
+{
+  const float *table = fastMathSineTable<bits>::value;
+  if (turns >= 8388608.f || turns <= -8388608.f)
+  {
+    turns = 0.f; // a float this large is a whole number of turns
+  }
+  turns -= (float)(int32_t)turns;
+  float position = turns * (float)(4 << bits); // in steps of the table, -4 to 4 quarter waves
+  int32_t step = (int32_t)position;
+  if (position < (float)step)
+  {
+    step--;
+  }
+  float fraction = position - (float)step;
+  step += quarter << bits;
+  int wave = (step >> bits) & 3;
+  int index = step & ((1 << bits) - 1);
+  float low, high;
+  if (wave & 1)
+  {
+    low = table[(1 << bits) - index]; // the second quarter runs back down the table
+    high = table[(1 << bits) - index - 1];
+  }
+  else
+  {
+    low = table[index];
+    high = table[index + 1];
+  }
+  float value = low + fraction * (high - low);
+  return (wave & 2) ? -value : value;
+}
+
+template <int bits>
+inline float fastSinTurns(float turns)
+{
+  return fastMathSineAt<bits>(turns, 0);
+}
+
+template <int bits>
+inline float fastCosTurns(float turns)
+{
+  return fastMathSineAt<bits>(turns, 1);
+}
+
+inline float fastReciprocal(unsigned long n)
+{
+  return n < FAST_MATH_RECIPROCALS ? fastMathReciprocalTable<>::value[n] : 1.f / (float)n;
+}
+
+#ifdef ENABLE_FAST_MATH
+#define mathSqrt(x) fastSqrt<FAST_MATH_SQRT_STEPS>(x)
+#define mathSqrtOfRatio(a, b) (fastSqrt<FAST_MATH_SQRT_STEPS>(a) * fastInvSqrt<FAST_MATH_SQRT_STEPS>(b))
+#define mathDivideN(x, n) ((x) * fastReciprocal(n))
+#define mathSinPeriod(t, period) fastSinTurns<FAST_MATH_SINE_BITS>((t) / (period))
+#define mathCosPeriod(t, period) fastCosTurns<FAST_MATH_SINE_BITS>((t) / (period))
+#else
+#define mathSqrt(x) sqrt(x)
+#define mathSqrtOfRatio(a, b) sqrt((a) / (b))
+#define mathDivideN(x, n) ((x) / ((float)(n)))
+#define mathSinPeriod(t, period) sin(2 * PI * (t) / (period))
+#define mathCosPeriod(t, period) cos(2 * PI * (t) / (period))
+#endif
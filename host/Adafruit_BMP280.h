@@ -0,0 +1,15 @@
+// Adafruit_BMP280.h (host stand-in)
+#ifndef HOST_ADAFRUIT_BMP280_H
+#define HOST_ADAFRUIT_BMP280_H
+
+#include "Adafruit_Sensor.h"
+
+class Adafruit_BMP280
+{
+public:
+  bool begin() { return true; }
+  float readAltitude(float /* seaLevelhPa */) { return hostSensorValue(HOST_ALTITUDE); }
+  float readTemperature() { return hostSensorValue(HOST_TEMPERATURE); }
+};
+
+#endif
@@ -0,0 +1,20 @@
+// Adafruit_LIS3MDL.h (host stand-in)
+#ifndef HOST_ADAFRUIT_LIS3MDL_H
+#define HOST_ADAFRUIT_LIS3MDL_H
+
+#include "Adafruit_Sensor.h"
+
+class Adafruit_LIS3MDL
+{
+public:
+  int16_t x, y, z; // raw readings, as in the library
+  bool begin_I2C() { return true; }
+  void read()
+  {
+    x = (int16_t)hostSensorValue(HOST_MAG_X);
+    y = (int16_t)hostSensorValue(HOST_MAG_Y);
+    z = (int16_t)hostSensorValue(HOST_MAG_Z);
+  }
+};
+
+#endif
@@ -0,0 +1,28 @@
+// Adafruit_LSM6DS33.h (host stand-in)
+#ifndef HOST_ADAFRUIT_LSM6DS33_H
+#define HOST_ADAFRUIT_LSM6DS33_H
+
+#include "Adafruit_Sensor.h"
+#include "Wire.h"
+
+class Adafruit_LSM6DS33
+{
+public:
+  bool begin_I2C() { return true; }
+  bool getEvent(sensors_event_t *accel, sensors_event_t *gyro, sensors_event_t *temp)
+  {
+    // one register read of temperature, gyro and accel (14 bytes) on the bus
+    hostI2CCharge(2);
+    hostI2CCharge(15);
+    accel->acceleration.x = hostSensorValue(HOST_ACCEL_X);
+    accel->acceleration.y = hostSensorValue(HOST_ACCEL_Y);
+    accel->acceleration.z = hostSensorValue(HOST_ACCEL_Z);
+    gyro->gyro.x = hostSensorValue(HOST_GYRO_X);
+    gyro->gyro.y = hostSensorValue(HOST_GYRO_Y);
+    gyro->gyro.z = hostSensorValue(HOST_GYRO_Z);
+    temp->temperature = hostSensorValue(HOST_TEMPERATURE);
+    return true;
+  }
+};
+
+#endif
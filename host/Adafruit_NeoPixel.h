@@ -0,0 +1,24 @@
+// Adafruit_NeoPixel.h (host stand-in)
+// keeps the last color shown so a host run can check the LED signals
+#ifndef HOST_ADAFRUIT_NEOPIXEL_H
+#define HOST_ADAFRUIT_NEOPIXEL_H
+
+#include "Arduino.h"
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel
+{
+public:
+  uint32_t color = 0; // color set with setPixelColor
+  uint32_t shown = 0; // color most recently sent with show()
+  Adafruit_NeoPixel(uint16_t /* n */, int16_t /* pin */, uint16_t /* type */) {}
+  void begin() {}
+  void clear() { color = 0; }
+  void setPixelColor(uint16_t /* n */, uint32_t c) { color = c; }
+  void show() { shown = color; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+};
+
+#endif
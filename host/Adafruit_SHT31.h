@@ -0,0 +1,15 @@
+// Adafruit_SHT31.h (host stand-in)
+#ifndef HOST_ADAFRUIT_SHT31_H
+#define HOST_ADAFRUIT_SHT31_H
+
+#include "Adafruit_Sensor.h"
+
+class Adafruit_SHT31
+{
+public:
+  bool begin(uint8_t /* address */ = 0x44) { return true; }
+  float readTemperature() { return hostSensorValue(HOST_TEMPERATURE); }
+  float readHumidity() { return hostSensorValue(HOST_HUMIDITY); }
+};
+
+#endif
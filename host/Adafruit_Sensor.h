@@ -0,0 +1,76 @@
+// Adafruit_Sensor.h (host stand-in)
+// sensor values on the host come from hostSensorValue(): by default a device lying still
+// (gravity on z, no rotation, constant field/temperature/humidity/altitude) with a little noise,
+// replace hostSensorModel with another function to drive the sketch with other signals
+
+#ifndef HOST_ADAFRUIT_SENSOR_H
+#define HOST_ADAFRUIT_SENSOR_H
+
+#include "Arduino.h"
+
+// channels of data provided by the sensor stand-ins
+#define HOST_ACCEL_X 0
+#define HOST_ACCEL_Y 1
+#define HOST_ACCEL_Z 2
+#define HOST_GYRO_X 3
+#define HOST_GYRO_Y 4
+#define HOST_GYRO_Z 5
+#define HOST_MAG_X 6
+#define HOST_MAG_Y 7
+#define HOST_MAG_Z 8
+#define HOST_TEMPERATURE 9
+#define HOST_HUMIDITY 10
+#define HOST_ALTITUDE 11
+#define HOST_SENSOR_CHANNELS 12
+
+float hostDefaultSensorModel(int channel, float /* timeSec */)
+{
+  float noise = ((float)random(-1000, 1001)) / 100000.; // +- 0.01
+  switch (channel)
+  {
+  case HOST_ACCEL_Z:
+    return 9.81 + noise;
+  case HOST_MAG_X:
+    return 2000. + 100. * noise;
+  case HOST_TEMPERATURE:
+    return 21.5 + noise;
+  case HOST_HUMIDITY:
+    return 40. + noise;
+  case HOST_ALTITUDE:
+    return 120. + noise;
+  default:
+    return noise;
+  }
+}
+
+float (*hostSensorModel)(int channel, float timeSec) = hostDefaultSensorModel;
+unsigned long hostSensorReadMicros = 0; // virtual time charged for each sensor transaction
+
+float hostSensorValue(int channel)
+{
+  hostAdvanceMicros(hostSensorReadMicros);
+  return hostSensorModel(channel, ((float)hostClockMicros) / 1000000.);
+}
+
+struct sensors_vec_t
+{
+  float x;
+  float y;
+  float z;
+};
+
+struct sensors_event_t
+{
+  int32_t sensor_id;
+  int32_t type;
+  int32_t timestamp;
+  union
+  {
+    sensors_vec_t acceleration;
+    sensors_vec_t gyro;
+    sensors_vec_t magnetic;
+    float temperature;
+  };
+};
+
+#endif
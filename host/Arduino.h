@@ -0,0 +1,466 @@
+// Arduino.h (host stand-in)
+// stand-in for the Arduino core so that the logger sketch can be compiled and run on Linux
+//  - time comes from a virtual clock (hostClockMicros) that only advances when told to
+//    (delay(), delayMicroseconds(), hostAdvanceMicros()) so a run can go faster than real time
+//  - Serial writes to stdout (or any FILE* set with hostSerialOutput); with hostSerialBaud set, the
+//    UART is modelled: writes wait (on the virtual clock) while the TX buffer is full
+//  - digitalRead() is driven by a script of pin changes (see hostLoadGpioScript)
+//  - random() uses a seeded generator so runs are reproducible
+//
+//  everything is defined in this header: each host program is built as a single translation unit
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define F(s) (s)
+#define PROGMEM
+
+// ---------------------------------------------------------------------
+// - virtual clock
+// ---------------------------------------------------------------------
+uint64_t hostClockMicros = 0; // microseconds since the virtual program start
+
+void hostAdvanceMicros(uint64_t us)
+{
+  hostClockMicros += us;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)((uint32_t)(hostClockMicros / 1000));
+}
+
+unsigned long micros()
+{
+  return (unsigned long)((uint32_t)hostClockMicros);
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvanceMicros((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  hostAdvanceMicros(us);
+}
+
+// ---------------------------------------------------------------------
+// - reproducible random numbers
+// ---------------------------------------------------------------------
+uint32_t hostRandomState = 12345;
+
+void randomSeed(unsigned long seed)
+{
+  hostRandomState = (uint32_t)seed;
+  if (hostRandomState == 0)
+  {
+    hostRandomState = 1;
+  }
+}
+
+long random(long howBig)
+{
+  if (howBig <= 0)
+  {
+    return 0;
+  }
+  // xorshift32
+  hostRandomState ^= hostRandomState << 13;
+  hostRandomState ^= hostRandomState >> 17;
+  hostRandomState ^= hostRandomState << 5;
+  return (long)(hostRandomState % (uint32_t)howBig);
+}
+
+long random(long howSmall, long howBig)
+{
+  if (howSmall >= howBig)
+  {
+    return howSmall;
+  }
+  return howSmall + random(howBig - howSmall);
+}
+
+// ---------------------------------------------------------------------
+// - scripted GPIO
+// ---------------------------------------------------------------------
+#define HOST_MAX_PINS 64
+#define HOST_GPIO_SCRIPT_MAX 4096
+
+struct hostGpioChange
+{
+  unsigned long timeMs; // virtual time at which the pin takes the new value
+  int pin;
+  int value;
+};
+
+int hostPinValue[HOST_MAX_PINS];   // value returned when no script entry applies
+int hostPinMode[HOST_MAX_PINS];
+hostGpioChange hostGpioScript[HOST_GPIO_SCRIPT_MAX]; // must be sorted by time
+int hostGpioScriptLength = 0;
+int hostGpioScriptNext = 0;
+
+void hostSetPin(int pin, int value)
+{
+  if (pin >= 0 && pin < HOST_MAX_PINS)
+  {
+    hostPinValue[pin] = value;
+  }
+}
+
+int hostAddGpioChange(unsigned long timeMs, int pin, int value)
+{
+  if (hostGpioScriptLength == HOST_GPIO_SCRIPT_MAX)
+  {
+    return -1;
+  }
+  hostGpioScript[hostGpioScriptLength].timeMs = timeMs;
+  hostGpioScript[hostGpioScriptLength].pin = pin;
+  hostGpioScript[hostGpioScriptLength].value = value;
+  hostGpioScriptLength++;
+  return 1;
+}
+
+// load a GPIO script: one "timeMs pin value" entry per line, sorted by time, '#' starts a comment
+int hostLoadGpioScript(const char *fileName)
+{
+  FILE *in = fopen(fileName, "r");
+  if (!in)
+  {
+    return -1;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), in))
+  {
+    unsigned long timeMs;
+    int pin, value;
+    if (line[0] != '#' && sscanf(line, "%lu %d %d", &timeMs, &pin, &value) == 3)
+    {
+      hostAddGpioChange(timeMs, pin, value);
+    }
+  }
+  fclose(in);
+  return hostGpioScriptLength;
+}
+
+void pinMode(int pin, int mode)
+{
+  if (pin >= 0 && pin < HOST_MAX_PINS)
+  {
+    hostPinMode[pin] = mode;
+  }
+}
+
+int digitalRead(int pin)
+{
+  // apply every scripted change that is due
+  while (hostGpioScriptNext < hostGpioScriptLength && hostGpioScript[hostGpioScriptNext].timeMs <= millis())
+  {
+    hostSetPin(hostGpioScript[hostGpioScriptNext].pin, hostGpioScript[hostGpioScriptNext].value);
+    hostGpioScriptNext++;
+  }
+  if (pin < 0 || pin >= HOST_MAX_PINS)
+  {
+    return LOW;
+  }
+  return hostPinValue[pin];
+}
+
+void digitalWrite(int pin, int value)
+{
+  hostSetPin(pin, value);
+}
+
+int analogRead(int /* pin */)
+{
+  return 0;
+}
+
+char *itoa(int value, char *str, int base)
+{
+  if (base == 16)
+  {
+    sprintf(str, "%x", value);
+  }
+  else
+  {
+    sprintf(str, "%d", value);
+  }
+  return str;
+}
+
+// ---------------------------------------------------------------------
+// - String (only the parts used by the sketch)
+// ---------------------------------------------------------------------
+class String
+{
+public:
+  String(const char *s = "") { set(s); }
+  String(const String &s) { set(s.buf); }
+  explicit String(int value)
+  {
+    char tmp[16];
+    sprintf(tmp, "%d", value);
+    set(tmp);
+  }
+  ~String() { free(buf); }
+  String &operator=(const String &s)
+  {
+    if (this != &s)
+    {
+      free(buf);
+      set(s.buf);
+    }
+    return *this;
+  }
+  String &operator+=(const String &s) { return append(s.buf); }
+  String &operator+=(const char *s) { return append(s); }
+  void toCharArray(char *out, unsigned int len) const
+  {
+    strncpy(out, buf, len);
+    if (len > 0)
+    {
+      out[len - 1] = 0;
+    }
+  }
+  const char *c_str() const { return buf; }
+  unsigned int length() const { return strlen(buf); }
+
+private:
+  char *buf;
+  void set(const char *s)
+  {
+    buf = (char *)malloc(strlen(s) + 1);
+    strcpy(buf, s);
+  }
+  String &append(const char *s)
+  {
+    size_t n = strlen(buf);
+    buf = (char *)realloc(buf, n + strlen(s) + 1);
+    strcpy(buf + n, s);
+    return *this;
+  }
+};
+
+// ---------------------------------------------------------------------
+// - Print: formatting shared by Serial and File (matches Arduino output, e.g. floats with 2 decimals)
+// ---------------------------------------------------------------------
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+  virtual int availableForWrite() { return 0x7fff; }
+  virtual void flush() {}
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n, int base = 10) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = 10) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = 10)
+  {
+    char tmp[24];
+    if (base == 16)
+      sprintf(tmp, "%lx", n);
+    else
+      sprintf(tmp, "%ld", n);
+    return write(tmp);
+  }
+  size_t print(unsigned long n, int base = 10)
+  {
+    char tmp[24];
+    if (base == 16)
+      sprintf(tmp, "%lx", n);
+    else
+      sprintf(tmp, "%lu", n);
+    return write(tmp);
+  }
+  size_t print(double value, int digits = 2)
+  {
+    char tmp[64];
+    if (isnan(value))
+      return write("nan");
+    if (isinf(value))
+      return write("inf");
+    if (value > 4294967040.0 || value < -4294967040.0)
+      return write("ovf"); // same limit as the Arduino core
+    snprintf(tmp, sizeof(tmp), "%.*f", digits, value);
+    return write(tmp);
+  }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(T value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(T value, int format)
+  {
+    size_t n = print(value, format);
+    return n + println();
+  }
+};
+
+// UART model: bytes leave the TX buffer at hostSerialBaud / 10 bytes per second (0 = no limit)
+unsigned long hostSerialBaud = 0;
+int hostSerialTxBufferBytes = 64;
+uint64_t hostSerialBlockedMicros = 0; // virtual time spent waiting for room in the TX buffer
+uint64_t hostSerialWorstBlock = 0;    // longest wait in one write
+
+// Serial stand-in: output goes to stdout unless redirected, input can be fed from a FILE*
+class HostSerial : public Print
+{
+public:
+  FILE *out = stdout;
+  FILE *in = NULL;
+  unsigned long bytesWritten = 0;
+
+  void begin(unsigned long /* baud */) {}
+  operator bool() { return true; }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    uint64_t waited = 0;
+    for (size_t k = 0; k < size; k++)
+    {
+      if (hostSerialBaud > 0)
+      {
+        drain();
+        if (txQueued >= hostSerialTxBufferBytes)
+        {
+          uint64_t wait = byteMicros() - (hostClockMicros - txLastDrain);
+          hostAdvanceMicros(wait);
+          waited += wait;
+          drain();
+        }
+        txQueued++;
+      }
+    }
+    hostSerialBlockedMicros += waited;
+    if (waited > hostSerialWorstBlock)
+    {
+      hostSerialWorstBlock = waited;
+    }
+    bytesWritten += size;
+    if (out)
+    {
+      fwrite(buffer, 1, size, out);
+    }
+    return size;
+  }
+  using Print::write;
+  int availableForWrite()
+  {
+    if (hostSerialBaud == 0)
+    {
+      return hostSerialTxBufferBytes;
+    }
+    drain();
+    return hostSerialTxBufferBytes - txQueued;
+  }
+  int available()
+  {
+    if (!in)
+    {
+      return 0;
+    }
+    int c = fgetc(in);
+    if (c == EOF)
+    {
+      return 0;
+    }
+    ungetc(c, in);
+    return 1;
+  }
+  int read()
+  {
+    if (!in)
+    {
+      return -1;
+    }
+    int c = fgetc(in);
+    return c == EOF ? -1 : c;
+  }
+
+private:
+  int txQueued = 0;          // bytes in the TX buffer
+  uint64_t txLastDrain = 0;  // virtual time the first of them started to go out
+
+  uint64_t byteMicros() { return (10000000ULL + hostSerialBaud - 1) / hostSerialBaud; }
+  void drain()
+  {
+    if (txQueued == 0)
+    {
+      txLastDrain = hostClockMicros;
+      return;
+    }
+    uint64_t sent = (hostClockMicros - txLastDrain) / byteMicros();
+    if (sent >= (uint64_t)txQueued)
+    {
+      txQueued = 0;
+      txLastDrain = hostClockMicros;
+    }
+    else
+    {
+      txQueued -= (int)sent;
+      txLastDrain += sent * byteMicros();
+    }
+  }
+};
+
+HostSerial Serial;
+
+void hostSerialOutput(FILE *out)
+{
+  Serial.out = out;
+}
+
+// bytes the host sends to the board are read from a FILE*
+void hostSerialInput(FILE *in)
+{
+  Serial.in = in;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// RTClib.h (host stand-in)
+// real time clock that follows the virtual clock from an adjustable start time
+//  - hostRtcStartUnix: unix time (seconds) of the RTC at virtual time 0
+//  - hostRtcDriftPPM: rate error of the RTC relative to the virtual clock (parts per million)
+//  - hostRtcFailBegin: when set rtc.begin() fails
+//  - hostRtcReads: number of calls to now() (each is an I2C transaction on the board and is
+//    charged as one on the virtual clock, see Wire.h)
+
+#ifndef HOST_RTCLIB_H
+#define HOST_RTCLIB_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+uint32_t hostRtcStartUnix = 1610928000UL; // 2021-01-18 00:00:00 (matches dataFolder)
+double hostRtcDriftPPM = 0.;
+int hostRtcFailBegin = 0;
+unsigned long hostRtcReads = 0;
+
+class DateTime
+{
+public:
+  DateTime(uint32_t t = 0) : unixTime(t)
+  {
+    time_t tt = (time_t)t;
+    struct tm parts;
+    gmtime_r(&tt, &parts);
+    y = parts.tm_year + 1900;
+    m = parts.tm_mon + 1;
+    d = parts.tm_mday;
+    hh = parts.tm_hour;
+    mm = parts.tm_min;
+    ss = parts.tm_sec;
+  }
+  uint16_t year() const { return y; }
+  uint8_t month() const { return m; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return hh; }
+  uint8_t minute() const { return mm; }
+  uint8_t second() const { return ss; }
+  uint32_t unixtime() const { return unixTime; }
+
+private:
+  uint32_t unixTime;
+  uint16_t y;
+  uint8_t m, d, hh, mm, ss;
+};
+
+class RTC_PCF8523
+{
+public:
+  bool begin() { return !hostRtcFailBegin; }
+  DateTime now()
+  {
+    hostRtcReads++;
+    hostI2CCharge(2); // address + register
+    hostI2CCharge(8); // address + 7 time registers
+    double elapsed = ((double)hostClockMicros) / 1000000. * (1. + hostRtcDriftPPM / 1000000.);
+    return DateTime(hostRtcStartUnix + (uint32_t)elapsed);
+  }
+};
+
+typedef RTC_PCF8523 RTC_DS1307;
+
+#endif
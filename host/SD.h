@@ -0,0 +1,292 @@
+// SD.h (host stand-in)
+// SD card backed by a directory on the host (hostSdRoot, "sdcard" by default)
+//  - failures can be injected (hostSdFailBegin, hostSdFailOpen) to exercise error handling
+//  - every open/write can be charged a latency on the virtual clock to model a slow card
+//  - looking up a path (exists, open) can be charged per directory entry, to model the linear
+//    scan of a FAT directory: a miss reads the whole directory, a hit half of it on average
+//  - a write that extends a file into a new cluster can be charged the FAT allocation (finding a
+//    free cluster and updating both FAT copies), so appends show the periodic stalls of a real card
+
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+#include "Arduino.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#define O_READ 0x01
+#define O_RDONLY O_READ
+#define O_WRITE 0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_CREAT 0x10
+#define O_TRUNC 0x40
+
+#define FILE_READ O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+char hostSdRoot[256] = "sdcard";  // host directory used as the root of the card
+int hostSdFailBegin = 0;          // when set SD.begin() fails
+int hostSdFailOpen = 0;           // when set SD.open() fails
+unsigned long hostSdOpenMicros = 0;  // virtual time charged for each open (and close or flush)
+unsigned long hostSdWriteMicros = 0; // virtual time charged for each write call
+unsigned long hostSdOpenCount = 0;   // number of successful opens
+unsigned long hostSdBytesWritten = 0;
+unsigned long hostSdEntryMicros = 0; // virtual time charged for each directory entry read in a lookup
+unsigned long hostSdLookups = 0;     // number of path lookups (exists and open)
+unsigned long hostSdClusterBytes = 32768;   // cluster size of the card (32 KB on cards of 2 GB and up)
+unsigned long hostSdClusterMicros = 0;      // virtual time charged for each cluster allocated
+unsigned long hostSdClustersAllocated = 0;
+unsigned long hostSdEntriesRead = 0; // directory entries read by the lookups
+uint64_t hostSdMicros = 0;           // virtual time charged for card operations in all
+
+// advance the virtual clock by the time a card operation takes
+void hostSdCharge(uint64_t us)
+{
+  hostSdMicros += us;
+  hostAdvanceMicros(us);
+}
+
+void hostSdPath(const char *path, char *fullPath, size_t len)
+{
+  snprintf(fullPath, len, "%s%s%s", hostSdRoot, (path[0] == '/') ? "" : "/", path);
+}
+
+// charge the scan of the directory holding fullPath (found = the entry exists)
+void hostSdChargeLookup(const char *fullPath, int found)
+{
+  hostSdLookups++;
+  if (hostSdEntryMicros == 0)
+  {
+    return;
+  }
+  char dirPath[512];
+  snprintf(dirPath, sizeof(dirPath), "%s", fullPath);
+  DIR *dir = opendir(dirname(dirPath));
+  if (!dir)
+  {
+    return;
+  }
+  unsigned long entries = 0;
+  while (readdir(dir))
+  {
+    entries++;
+  }
+  closedir(dir);
+  if (found)
+  {
+    entries = (entries + 1) / 2;
+  }
+  hostSdEntriesRead += entries;
+  hostSdCharge((uint64_t)entries * hostSdEntryMicros);
+}
+
+class File : public Print
+{
+public:
+  File() : fp(NULL), appendMode(0) { fileName[0] = 0; }
+  File(FILE *f, const char *path, int append = 0) : fp(f), appendMode(append)
+  {
+    strncpy(fileName, path, sizeof(fileName) - 1);
+    fileName[sizeof(fileName) - 1] = 0;
+  }
+  operator bool() const { return fp != NULL; }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    if (!fp)
+    {
+      return 0;
+    }
+    hostSdCharge(hostSdWriteMicros);
+    hostSdBytesWritten += size;
+    // clusters allocated when the write goes past the end of the file (copies of a File share
+    // the open file, so the end is read from it rather than kept in this copy)
+    uint32_t fileEnd = this->size();
+    uint32_t start = appendMode ? fileEnd : (uint32_t)ftell(fp);
+    if (start + size > fileEnd)
+    {
+      unsigned long clustersBefore = (fileEnd + hostSdClusterBytes - 1) / hostSdClusterBytes;
+      unsigned long clustersAfter = (start + size + hostSdClusterBytes - 1) / hostSdClusterBytes;
+      hostSdClustersAllocated += clustersAfter - clustersBefore;
+      hostSdCharge((uint64_t)(clustersAfter - clustersBefore) * hostSdClusterMicros);
+    }
+    return fwrite(buffer, 1, size, fp);
+  }
+  using Print::write;
+  int read()
+  {
+    if (!fp)
+    {
+      return -1;
+    }
+    int c = fgetc(fp);
+    return c == EOF ? -1 : c;
+  }
+  int read(void *buffer, size_t size)
+  {
+    if (!fp)
+    {
+      return -1;
+    }
+    return fread(buffer, 1, size, fp);
+  }
+  int available()
+  {
+    if (!fp)
+    {
+      return 0;
+    }
+    long pos = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long end = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+    return (int)(end - pos);
+  }
+  bool seek(uint32_t pos) { return fp && fseek(fp, pos, SEEK_SET) == 0; }
+  uint32_t position() { return fp ? ftell(fp) : 0; }
+  uint32_t size()
+  {
+    if (!fp)
+    {
+      return 0;
+    }
+    long pos = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long end = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+    return end;
+  }
+  void flush()
+  {
+    if (fp)
+    {
+      hostSdCharge(hostSdOpenMicros); // a sync writes the block and the directory entry, like a close
+      fflush(fp);
+    }
+  }
+  void close()
+  {
+    if (fp)
+    {
+      hostSdCharge(hostSdOpenMicros);
+      fclose(fp);
+      fp = NULL;
+    }
+  }
+  char *name() { return fileName; }
+
+private:
+  FILE *fp;
+  int appendMode; // writes go to the end of the file
+  char fileName[64];
+};
+
+class SDClass
+{
+public:
+  bool begin(int /* csPin */)
+  {
+    if (hostSdFailBegin)
+    {
+      return false;
+    }
+    ::mkdir(hostSdRoot, 0755);
+    return true;
+  }
+  bool exists(const char *path)
+  {
+    char fullPath[512];
+    hostSdPath(path, fullPath, sizeof(fullPath));
+    struct stat st;
+    int found = stat(fullPath, &st) == 0;
+    hostSdChargeLookup(fullPath, found);
+    return found;
+  }
+  bool mkdir(const char *path)
+  {
+    char fullPath[512];
+    hostSdPath(path, fullPath, sizeof(fullPath));
+    return ::mkdir(fullPath, 0755) == 0;
+  }
+  bool remove(const char *path)
+  {
+    char fullPath[512];
+    hostSdPath(path, fullPath, sizeof(fullPath));
+    return ::unlink(fullPath) == 0;
+  }
+  File open(const char *path, uint8_t mode = FILE_READ)
+  {
+    if (hostSdFailOpen)
+    {
+      return File();
+    }
+    char fullPath[512];
+    hostSdPath(path, fullPath, sizeof(fullPath));
+    hostSdCharge(hostSdOpenMicros);
+    FILE *fp = NULL;
+    if (mode & O_WRITE)
+    {
+      if (mode & O_TRUNC)
+      {
+        fp = fopen(fullPath, "w+b");
+      }
+      else if (mode & O_APPEND)
+      {
+        fp = fopen(fullPath, "a+b");
+      }
+      else
+      {
+        fp = fopen(fullPath, "r+b");
+        if (!fp && (mode & O_CREAT))
+        {
+          fp = fopen(fullPath, "w+b");
+        }
+      }
+    }
+    else
+    {
+      fp = fopen(fullPath, "rb");
+    }
+    hostSdChargeLookup(fullPath, fp != NULL);
+    if (fp)
+    {
+      hostSdOpenCount++;
+    }
+    return File(fp, path, (mode & O_WRITE) && (mode & O_APPEND) && !(mode & O_TRUNC));
+  }
+};
+
+SDClass SD;
+
+// put a copy of the host file hostName on the card as path (e.g. a trace to replay); returns -1 on failure
+int hostSdCopyIn(const char *hostName, const char *path)
+{
+  char fullPath[512];
+  hostSdPath(path, fullPath, sizeof(fullPath));
+  ::mkdir(hostSdRoot, 0755);
+  FILE *in = fopen(hostName, "rb");
+  FILE *out = in ? fopen(fullPath, "wb") : NULL;
+  int status = out ? 1 : -1;
+  char buffer[4096];
+  size_t n;
+  while (out && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+  {
+    if (fwrite(buffer, 1, n, out) != n)
+    {
+      status = -1;
+    }
+  }
+  if (in)
+    fclose(in);
+  if (out)
+    fclose(out);
+  return status;
+}
+
+#endif
@@ -0,0 +1,2 @@
+// SPI.h (host stand-in)
+// nothing is needed from SPI on the host: the SD stand-in does not use a bus
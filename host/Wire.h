@@ -0,0 +1,215 @@
+// Wire.h (host stand-in)
+// I2C bus with a model of the LSM6DS33 FIFO behind it, so the FIFO acquisition path (imuFifo.h)
+// runs on the host:
+//  - once the FIFO is in continuous mode, samples from hostSensorValue() are pushed into it at the
+//    configured ODR of the virtual clock (6 words per sample: gyro x, y, z, accel x, y, z)
+//  - the FIFO holds 4096 words; older data is lost (and the overrun flag set) when it is full
+//  - every transaction is charged bus time on the virtual clock (hostI2CByteMicros per byte,
+//    including the address and register bytes) and counted in hostI2CTransactions / hostI2CMicros
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Adafruit_Sensor.h"
+
+float hostI2CByteMicros = 22.5; // 9 bits per byte at 400 kHz
+unsigned long hostI2CTransactions = 0;
+double hostI2CMicros = 0.;
+
+void hostI2CCharge(int bytes)
+{
+  hostI2CTransactions++;
+  double us = bytes * hostI2CByteMicros;
+  hostI2CMicros += us;
+  hostAdvanceMicros((uint64_t)us);
+}
+
+#define HOST_IMU_ADDRESS 0x6A
+#define HOST_IMU_FIFO_WORDS 4096
+
+class HostImuModel
+{
+public:
+  uint8_t reg[128];
+  int16_t fifo[HOST_IMU_FIFO_WORDS];
+  int head = 0;  // next word to read
+  int count = 0; // unread words
+  int pattern = 0; // pattern index of the next word to read
+  int overrun = 0;
+  uint64_t nextSampleMicros = 0;
+
+  float odrHz()
+  {
+    int code = (reg[0x0A] >> 3) & 0x0F;
+    if (code == 0)
+      return 0.;
+    if (code == 1)
+      return 12.5;
+    return 13. * (float)(1 << (code - 1));
+  }
+
+  void push(int16_t word)
+  {
+    if (count == HOST_IMU_FIFO_WORDS)
+    {
+      // continuous mode: the oldest word is overwritten
+      head = (head + 1) % HOST_IMU_FIFO_WORDS;
+      count--;
+      pattern = (pattern + 1) % 6;
+      overrun = 1;
+    }
+    fifo[(head + count) % HOST_IMU_FIFO_WORDS] = word;
+    count++;
+  }
+
+  // add the samples that the sensor has taken since the last update
+  void update()
+  {
+    float odr = odrHz();
+    if ((reg[0x0A] & 0x07) != 0x06 || odr <= 0.)
+    {
+      nextSampleMicros = hostClockMicros;
+      return;
+    }
+    uint64_t period = (uint64_t)(1000000. / odr);
+    while (nextSampleMicros <= hostClockMicros)
+    {
+      float accelLSB = 1. / (0.122e-3 * 9.80665);
+      float gyroLSB = 1. / (70.e-3 * 3.14159265 / 180.);
+      float t = ((float)nextSampleMicros) / 1000000.;
+      push((int16_t)(hostSensorModel(HOST_GYRO_X, t) * gyroLSB));
+      push((int16_t)(hostSensorModel(HOST_GYRO_Y, t) * gyroLSB));
+      push((int16_t)(hostSensorModel(HOST_GYRO_Z, t) * gyroLSB));
+      push((int16_t)(hostSensorModel(HOST_ACCEL_X, t) * accelLSB));
+      push((int16_t)(hostSensorModel(HOST_ACCEL_Y, t) * accelLSB));
+      push((int16_t)(hostSensorModel(HOST_ACCEL_Z, t) * accelLSB));
+      nextSampleMicros += period;
+    }
+  }
+
+  void writeRegister(uint8_t address, uint8_t value)
+  {
+    update();
+    reg[address & 0x7F] = value;
+    if (address == 0x0A && (value & 0x07) == 0)
+    {
+      // bypass mode empties the FIFO
+      head = count = pattern = overrun = 0;
+      nextSampleMicros = hostClockMicros;
+    }
+  }
+
+  uint8_t readRegister(uint8_t address)
+  {
+    int16_t word;
+    switch (address)
+    {
+    case 0x3A:
+      update();
+      return count & 0xFF;
+    case 0x3B:
+      return ((count >> 8) & 0x0F) | (overrun ? 0x40 : 0) | (count == 0 ? 0x10 : 0);
+    case 0x3C:
+      return pattern & 0xFF;
+    case 0x3D:
+      overrun = 0;
+      return (pattern >> 8) & 0x03;
+    case 0x3E:
+    case 0x3F:
+      // one word is taken from the FIFO when its low byte is read
+      if (address == 0x3E)
+      {
+        word = count > 0 ? fifo[head] : 0;
+        lastWord = word;
+        if (count > 0)
+        {
+          head = (head + 1) % HOST_IMU_FIFO_WORDS;
+          count--;
+          pattern = (pattern + 1) % 6;
+        }
+        return word & 0xFF;
+      }
+      return (lastWord >> 8) & 0xFF;
+    default:
+      return reg[address & 0x7F];
+    }
+  }
+
+private:
+  int16_t lastWord = 0;
+};
+
+HostImuModel hostImu;
+
+class TwoWire
+{
+public:
+  void begin() {}
+  void setClock(uint32_t hz) { hostI2CByteMicros = 9.e6 / (float)hz; }
+  void beginTransmission(int address)
+  {
+    txAddress = address;
+    txLength = 0;
+  }
+  size_t write(uint8_t value)
+  {
+    if (txLength < (int)sizeof(txBuffer))
+    {
+      txBuffer[txLength++] = value;
+    }
+    return 1;
+  }
+  uint8_t endTransmission(bool /* sendStop */ = true)
+  {
+    if (txAddress != HOST_IMU_ADDRESS || txLength == 0)
+    {
+      return 2; // no device acknowledged
+    }
+    registerPointer = txBuffer[0];
+    hostI2CCharge(1 + txLength); // address + data
+    if (txLength > 1)
+    {
+      for (int k = 1; k < txLength; k++)
+      {
+        hostImu.writeRegister(registerPointer++, txBuffer[k]);
+      }
+    }
+    return 0;
+  }
+  uint8_t requestFrom(int address, int length)
+  {
+    if (address != HOST_IMU_ADDRESS)
+    {
+      return 0;
+    }
+    if (length > (int)sizeof(rxBuffer))
+    {
+      length = sizeof(rxBuffer);
+    }
+    for (int k = 0; k < length; k++)
+    {
+      rxBuffer[k] = hostImu.readRegister(registerPointer);
+      // burst reads of the FIFO output wrap from 0x3F back to 0x3E
+      registerPointer = (registerPointer == 0x3F) ? 0x3E : registerPointer + 1;
+    }
+    rxLength = length;
+    rxIndex = 0;
+    hostI2CCharge(1 + length); // address + data
+    return length;
+  }
+  int read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+  int available() { return rxLength - rxIndex; }
+
+private:
+  int txAddress = 0;
+  uint8_t txBuffer[64];
+  int txLength = 0;
+  uint8_t rxBuffer[64]; // same size as the Wire buffer on the board
+  int rxLength = 0;
+  int rxIndex = 0;
+  uint8_t registerPointer = 0;
+};
+
+TwoWire Wire;
+
+#endif
@@ -0,0 +1,853 @@
+// aggregate.cpp
+// combines the data files of many loggers (told apart by the deviceCode in column one) into fleet
+// statistics per time bucket: for each stream, the number of data points, their average and their
+// standard deviation over every device that logged it during the bucket
+//
+//  the statistics of each row are merged exactly (n, mean and the sum of squared deviations, with the
+//  pairwise update of Chan, Golub and LeVeque), not by averaging the averages: a row counts with the n
+//  of its _n column and the spread of its _sd column (outputStats 5; with 3 there is no spread in the
+//  row, and without an _n column a row counts as one data point of its _av or _cv)
+//
+//  a row's time is its unixTime column (ENABLE_ABSOLUTE_TIME), or the time the file was created
+//  (the RTC lines of the preamble) plus its count times --interval-ms. the files are read in windows
+//  of WINDOW_BUCKETS buckets: the devices are shared among --threads workers, each file is mapped
+//  only while the window reaches it and is scanned in place, and each window is written out before
+//  the next is read, so memory does not grow with the number of files or the length of the logs.
+//  rows that come before the window (the clock of a device went back) are counted and left out
+//
+//  build:  host/build.sh
+//  usage:  host/aggregate [options] PATH...
+//    PATH is a data file, a day directory, an SD card directory or a directory of cards (see reprocess)
+//    --bucket-s S      length of a bucket in seconds (default 60)
+//    --interval-ms MS  time of one row of a file without a unixTime column (default SAMPLING_PERIOD)
+//    --threads N       worker threads (default: processors online)
+//    --out FILE        write the buckets to FILE (default stdout): code, count, unixTime (start of the
+//                      bucket), devices, rows, then n, _av and _sd of each stream
+//    --code C          code in the first column of the output (default F)
+//    --bench           time the aggregation (output discarded) of the first 1, 2, 4 ... devices with
+//                      1, 2, 4 ... --threads workers and print rows/s and GB/s of input
+//  synthetic fleet (to check the merge and for the benchmark):
+//    --synthesize DIR  write DIR/cardK/d210118/<code>data000.csv for --devices loggers of --rows rows
+//                      each (half of them with a unixTime column, from clocks that are offset from
+//                      each other and of which some run 0.2 % fast or slow), and DIR/expected.csv:
+//                      the buckets computed from the raw data points, which aggregate DIR should
+//                      reproduce
+//    --devices N       (default 8)   --rows N  (default 9000)   --seed N  (default 1)
+
+#include "Arduino.h"
+#include <pthread.h>
+#include "dataScan.h"
+#include "../deviceConfigGeneric.h"
+
+#define MAX_INPUTS 4096
+#define MAX_DEVICES 1024
+#define MAX_FLEET_STREAMS 128
+#define MAX_COLUMNS 256
+#define MAX_THREADS 64
+#define WINDOW_BUCKETS 256
+#define FLEET_NAME_MAX 16
+
+// what a column of a data file holds
+#define ROLE_NONE 0
+#define ROLE_AVERAGE 1 // _av, or _cv of a stream without _av
+#define ROLE_SPREAD 2  // _sd
+#define ROLE_COUNT 3   // _n
+#define ROLE_TIME 4    // unixTime
+
+// n, mean and sum of squared deviations from the mean of a set of data points
+struct fleetStat
+{
+  double n;
+  double mean;
+  double m2;
+};
+
+// add a set of n points with this mean and m2 (the pairwise update: exact, and stable in rounding)
+void mergeFleetStat(fleetStat *into, double n, double mean, double m2)
+{
+  if (n <= 0.)
+  {
+    return;
+  }
+  double total = into->n + n;
+  double delta = mean - into->mean;
+  into->mean += delta * n / total;
+  into->m2 += m2 + delta * delta * into->n * n / total;
+  into->n = total;
+}
+
+char fleetStream[MAX_FLEET_STREAMS][FLEET_NAME_MAX]; // nicknames of the streams of every file
+int nFleetStreams = 0;
+
+struct inputFile
+{
+  char name[DATA_SCAN_PATH_MAX];
+  int device;
+  off_t bytes;
+  long created;   // unix seconds from the preamble (0 if the logger had no RTC)
+  double firstTime;
+  int nSlots;     // streams of this file
+  uint8_t role[MAX_COLUMNS];
+  uint8_t slot[MAX_COLUMNS];
+  uint8_t slotStream[MAX_FLEET_STREAMS]; // fleet stream of each slot
+  // reading position
+  int opened;
+  int done;
+  dataFileMap map;
+  const char *row; // the next row, and its time
+  const char *rowEnd;
+  double rowTime;
+};
+
+struct fleetDevice
+{
+  char code[DATA_SCAN_CODE_MAX];
+  double bytes;
+  int worker;
+  uint8_t inBucket[WINDOW_BUCKETS]; // the device has added a row to the bucket of the window
+};
+
+inputFile files[MAX_INPUTS];
+int nFiles = 0;
+fleetDevice devices[MAX_DEVICES];
+int nDevices = 0;
+int activeDevices = 0; // devices 0 to activeDevices - 1 are aggregated
+
+double bucketSeconds = 60.;
+unsigned long intervalMillis = SAMPLING_PERIOD;
+char outputCode[DATA_SCAN_CODE_MAX] = "F";
+
+// what one worker adds up for a window
+struct fleetWorker
+{
+  pthread_t thread;
+  int id;
+  long windowFirst; // first bucket of the window
+  unsigned long rows;
+  unsigned long late;
+  double bytes;
+  fleetStat stats[WINDOW_BUCKETS][MAX_FLEET_STREAMS];
+  unsigned long bucketRows[WINDOW_BUCKETS];
+  int bucketDevices[WINDOW_BUCKETS];
+};
+
+fleetWorker workers[MAX_THREADS];
+int nWorkers = 1;
+double startTime; // start of bucket 0
+
+// ---------------------------------------------------------------------------------------------
+// files
+
+int fleetStreamIndex(const char *text, int length)
+{
+  for (int s = 0; s < nFleetStreams; s++)
+  {
+    if ((int)strlen(fleetStream[s]) == length && !memcmp(fleetStream[s], text, length))
+    {
+      return s;
+    }
+  }
+  if (nFleetStreams == MAX_FLEET_STREAMS || length >= FLEET_NAME_MAX)
+  {
+    return -1;
+  }
+  memcpy(fleetStream[nFleetStreams], text, length);
+  fleetStream[nFleetStreams][length] = 0;
+  return nFleetStreams++;
+}
+
+int hasColumn(csvField *names, int nColumns, csvField *name, const char *suffix)
+{
+  int length = name->length - 3;
+  for (int k = 2; k < nColumns; k++)
+  {
+    if (names[k].length == length + 3 && !memcmp(names[k].text, name->text, length) && !memcmp(names[k].text + length, suffix, 3))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// the role and stream of each column of the header
+void mapColumns(inputFile *f)
+{
+  csvField names[MAX_COLUMNS];
+  int nColumns = 0;
+  for (const char *p = f->map.header; p && nColumns < MAX_COLUMNS;)
+  {
+    p = nextField(p, f->map.headerEnd, &names[nColumns++]);
+  }
+  f->nSlots = 0;
+  for (int k = 0; k < MAX_COLUMNS; k++)
+  {
+    f->role[k] = ROLE_NONE;
+  }
+  for (int k = 2; k < nColumns; k++)
+  {
+    csvField *name = &names[k];
+    if (fieldIs(name, "unixTime"))
+    {
+      f->role[k] = ROLE_TIME;
+      continue;
+    }
+    if (name->length < 3)
+    {
+      continue;
+    }
+    const char *suffix = name->text + name->length - 3;
+    int role = ROLE_NONE;
+    if (!memcmp(suffix, "_av", 3) || (!memcmp(suffix, "_cv", 3) && !hasColumn(names, nColumns, name, "_av")))
+      role = ROLE_AVERAGE;
+    else if (!memcmp(suffix, "_sd", 3))
+      role = ROLE_SPREAD;
+    else if (name->length >= 2 && !memcmp(name->text + name->length - 2, "_n", 2))
+      role = ROLE_COUNT;
+    if (role == ROLE_NONE)
+    {
+      continue;
+    }
+    int length = name->length - (role == ROLE_COUNT ? 2 : 3);
+    int s = fleetStreamIndex(name->text, length);
+    if (s < 0)
+    {
+      continue;
+    }
+    int slot = 0;
+    while (slot < f->nSlots && f->slotStream[slot] != s)
+    {
+      slot++;
+    }
+    if (slot == f->nSlots)
+    {
+      f->slotStream[f->nSlots++] = s;
+    }
+    f->role[k] = role;
+    f->slot[k] = slot;
+  }
+}
+
+// the time of the row at f->row (returns 0 if the line is not a row of the file)
+int readRowTime(inputFile *f)
+{
+  csvField field;
+  const char *next = nextField(f->row, f->rowEnd, &field);
+  if (!next || !fieldIs(&field, f->map.deviceCode))
+  {
+    return 0;
+  }
+  next = nextField(next, f->rowEnd, &field);
+  double count;
+  if (!next || !scanDouble(&field, &count) || count == 0.)
+  {
+    return 0; // a torn row, or the header written again
+  }
+  for (int k = 2; next && k < MAX_COLUMNS; k++)
+  {
+    next = nextField(next, f->rowEnd, &field);
+    if (f->role[k] == ROLE_TIME)
+    {
+      return scanDouble(&field, &f->rowTime);
+    }
+  }
+  f->rowTime = f->created + count * intervalMillis / 1000.;
+  return 1;
+}
+
+// move to the next row; at the end of the file, unmap it
+void nextRow(inputFile *f, const char *p)
+{
+  while (p < f->map.end)
+  {
+    f->row = p;
+    f->rowEnd = lineEndOf(p, f->map.end);
+    p = f->rowEnd + 1;
+    if (readRowTime(f))
+    {
+      return;
+    }
+  }
+  closeDataFile(&f->map);
+  f->done = 1;
+}
+
+// map the file and read from its first row
+int openInput(inputFile *f)
+{
+  f->done = 0;
+  if (openDataFile(f->name, &f->map))
+  {
+    f->done = 1;
+    return 0;
+  }
+  f->opened = 1;
+  nextRow(f, f->map.headerEnd + 1);
+  return 1;
+}
+
+// the header and first row of a file, and its device
+void addInput(const char *fileName)
+{
+  if (nFiles == MAX_INPUTS)
+  {
+    fprintf(stderr, "aggregate: more than %d files, %s left out\n", MAX_INPUTS, fileName);
+    return;
+  }
+  inputFile *f = &files[nFiles];
+  snprintf(f->name, sizeof(f->name), "%s", fileName);
+  const char *error = openDataFile(f->name, &f->map);
+  if (error)
+  {
+    fprintf(stderr, "aggregate: %s: %s\n", fileName, error);
+    return;
+  }
+  f->bytes = f->map.size;
+  f->created = dataFileCreated(&f->map);
+  if (f->created < 0)
+    f->created = 0;
+  mapColumns(f);
+  f->opened = 1;
+  f->done = 0;
+  nextRow(f, f->map.headerEnd + 1);
+  if (f->done)
+  {
+    return; // no rows
+  }
+  f->firstTime = f->rowTime;
+  closeDataFile(&f->map);
+  f->opened = 0;
+
+  int d = 0;
+  while (d < nDevices && strcmp(devices[d].code, f->map.deviceCode))
+  {
+    d++;
+  }
+  if (d == nDevices)
+  {
+    if (nDevices == MAX_DEVICES)
+    {
+      fprintf(stderr, "aggregate: more than %d devices, %s left out\n", MAX_DEVICES, fileName);
+      return;
+    }
+    snprintf(devices[d].code, sizeof(devices[d].code), "%s", f->map.deviceCode);
+    devices[d].bytes = 0.;
+    nDevices++;
+  }
+  f->device = d;
+  devices[d].bytes += f->bytes;
+  nFiles++;
+}
+
+// ---------------------------------------------------------------------------------------------
+// windows
+
+// add the rows of one file that fall before the end of the window
+void addRows(fleetWorker *w, inputFile *f, double windowEnd)
+{
+  fleetDevice *device = &devices[f->device];
+  double mean[MAX_FLEET_STREAMS];
+  double spread[MAX_FLEET_STREAMS];
+  double count[MAX_FLEET_STREAMS];
+  uint8_t have[MAX_FLEET_STREAMS];
+  while (!f->done && f->rowTime < windowEnd)
+  {
+    long bucket = (long)floor((f->rowTime - startTime) / bucketSeconds);
+    int b = (int)(bucket - w->windowFirst);
+    if (b < 0)
+    {
+      w->late++;
+      nextRow(f, f->rowEnd + 1);
+      continue;
+    }
+    memset(have, 0, f->nSlots);
+    csvField field;
+    const char *next = nextField(f->row, f->rowEnd, &field);
+    next = nextField(next, f->rowEnd, &field);
+    for (int k = 2; next && k < MAX_COLUMNS; k++)
+    {
+      next = nextField(next, f->rowEnd, &field);
+      int role = f->role[k];
+      double value;
+      if (role == ROLE_NONE || role == ROLE_TIME || !scanDouble(&field, &value))
+      {
+        continue;
+      }
+      int slot = f->slot[k];
+      if (role == ROLE_AVERAGE)
+        mean[slot] = value;
+      else if (role == ROLE_SPREAD)
+        spread[slot] = value;
+      else
+        count[slot] = value;
+      have[slot] |= 1 << role;
+    }
+    for (int slot = 0; slot < f->nSlots; slot++)
+    {
+      if (!(have[slot] & (1 << ROLE_AVERAGE)))
+      {
+        continue;
+      }
+      double n = (have[slot] & (1 << ROLE_COUNT)) ? count[slot] : 1.;
+      double m2 = ((have[slot] & (1 << ROLE_SPREAD)) && n > 1.) ? spread[slot] * spread[slot] * (n - 1.) : 0.;
+      mergeFleetStat(&w->stats[b][f->slotStream[slot]], n, mean[slot], m2);
+    }
+    w->bucketRows[b]++;
+    if (!device->inBucket[b])
+    {
+      device->inBucket[b] = 1;
+      w->bucketDevices[b]++;
+    }
+    w->rows++;
+    w->bytes += f->rowEnd + 1 - f->row;
+    nextRow(f, f->rowEnd + 1);
+  }
+}
+
+void *runWorker(void *arg)
+{
+  fleetWorker *w = (fleetWorker *)arg;
+  double windowEnd = startTime + (w->windowFirst + WINDOW_BUCKETS) * bucketSeconds;
+  memset(w->stats, 0, sizeof(w->stats));
+  memset(w->bucketRows, 0, sizeof(w->bucketRows));
+  memset(w->bucketDevices, 0, sizeof(w->bucketDevices));
+  for (int d = 0; d < activeDevices; d++)
+  {
+    if (devices[d].worker == w->id)
+    {
+      memset(devices[d].inBucket, 0, sizeof(devices[d].inBucket));
+    }
+  }
+  for (int j = 0; j < nFiles; j++)
+  {
+    inputFile *f = &files[j];
+    if (f->device >= activeDevices || devices[f->device].worker != w->id || f->done)
+    {
+      continue;
+    }
+    if (!f->opened)
+    {
+      if (f->firstTime >= windowEnd || !openInput(f))
+      {
+        continue;
+      }
+    }
+    addRows(w, f, windowEnd);
+  }
+  return NULL;
+}
+
+void printFleetHeader(FILE *out)
+{
+  fprintf(out, "%s,0,unixTime,devices,rows", outputCode);
+  for (int s = 0; s < nFleetStreams; s++)
+  {
+    fprintf(out, ",%s_n,%s_av,%s_sd", fleetStream[s], fleetStream[s], fleetStream[s]);
+  }
+  fprintf(out, "\r\n");
+}
+
+void printFleetRow(FILE *out, long count, double bucketStart, int nDevicesIn, unsigned long rows, fleetStat *stats)
+{
+  fprintf(out, "%s, %ld, %.3f, %d, %lu", outputCode, count, bucketStart, nDevicesIn, rows);
+  for (int s = 0; s < nFleetStreams; s++)
+  {
+    fprintf(out, ", %.0f", stats[s].n);
+    if (stats[s].n > 0.)
+      fprintf(out, ", %.4f", stats[s].mean);
+    else
+      fprintf(out, ", N//A");
+    if (stats[s].n > 1.)
+      fprintf(out, ", %.4f", sqrt(stats[s].m2 / (stats[s].n - 1.)));
+    else
+      fprintf(out, ", N//A");
+  }
+  fprintf(out, "\r\n");
+}
+
+int compareDeviceBytes(const void *a, const void *b)
+{
+  double sizeA = devices[*(const int *)a].bytes;
+  double sizeB = devices[*(const int *)b].bytes;
+  return sizeA < sizeB ? 1 : (sizeA > sizeB ? -1 : 0);
+}
+
+int compareFileTime(const void *a, const void *b)
+{
+  const inputFile *fileA = (const inputFile *)a;
+  const inputFile *fileB = (const inputFile *)b;
+  return fileA->firstTime < fileB->firstTime ? -1 : (fileA->firstTime > fileB->firstTime ? 1 : 0);
+}
+
+// aggregate the first nActive devices with nThreads workers; returns the wall time in seconds
+double aggregate(FILE *out, int nActive, int nThreads, unsigned long *rows, unsigned long *late, double *bytes)
+{
+  activeDevices = nActive;
+  nWorkers = nThreads;
+
+  // the devices go to the worker with the fewest bytes so far, largest first
+  int order[MAX_DEVICES];
+  double load[MAX_THREADS];
+  for (int t = 0; t < nWorkers; t++)
+  {
+    load[t] = 0.;
+  }
+  for (int d = 0; d < nDevices; d++)
+  {
+    order[d] = d;
+  }
+  qsort(order, activeDevices, sizeof(order[0]), compareDeviceBytes);
+  for (int k = 0; k < activeDevices; k++)
+  {
+    int least = 0;
+    for (int t = 1; t < nWorkers; t++)
+    {
+      if (load[t] < load[least])
+        least = t;
+    }
+    devices[order[k]].worker = least;
+    load[least] += devices[order[k]].bytes;
+  }
+
+  double first = 0.;
+  int any = 0;
+  for (int j = 0; j < nFiles; j++)
+  {
+    files[j].opened = 0;
+    files[j].done = files[j].device >= activeDevices;
+    if (!files[j].done && (!any || files[j].firstTime < first))
+    {
+      first = files[j].firstTime;
+      any = 1;
+    }
+  }
+  startTime = floor(first / bucketSeconds) * bucketSeconds;
+  if (out)
+  {
+    printFleetHeader(out);
+  }
+
+  struct timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+  *rows = *late = 0;
+  *bytes = 0.;
+  long count = 0;
+  fleetStat merged[MAX_FLEET_STREAMS];
+  for (;;)
+  {
+    // the window starts at the earliest row still to be read (long gaps are skipped)
+    double next = 0.;
+    any = 0;
+    for (int j = 0; j < nFiles; j++)
+    {
+      inputFile *f = &files[j];
+      double t = f->opened ? f->rowTime : f->firstTime;
+      if (!f->done && (!any || t < next))
+      {
+        next = t;
+        any = 1;
+      }
+    }
+    if (!any)
+    {
+      break;
+    }
+    long windowFirst = (long)floor((next - startTime) / bucketSeconds);
+    for (int t = 0; t < nWorkers; t++)
+    {
+      workers[t].id = t;
+      workers[t].windowFirst = windowFirst;
+      workers[t].rows = workers[t].late = 0;
+      workers[t].bytes = 0.;
+      pthread_create(&workers[t].thread, NULL, runWorker, &workers[t]);
+    }
+    for (int t = 0; t < nWorkers; t++)
+    {
+      pthread_join(workers[t].thread, NULL);
+      *rows += workers[t].rows;
+      *late += workers[t].late;
+      *bytes += workers[t].bytes;
+    }
+
+    for (int b = 0; b < WINDOW_BUCKETS; b++)
+    {
+      unsigned long bucketRows = 0;
+      int bucketDevices = 0;
+      for (int t = 0; t < nWorkers; t++)
+      {
+        bucketRows += workers[t].bucketRows[b];
+        bucketDevices += workers[t].bucketDevices[b];
+      }
+      if (bucketRows == 0)
+      {
+        continue;
+      }
+      for (int s = 0; s < nFleetStreams; s++)
+      {
+        merged[s].n = merged[s].mean = merged[s].m2 = 0.;
+        for (int t = 0; t < nWorkers; t++)
+        {
+          fleetStat *part = &workers[t].stats[b][s];
+          mergeFleetStat(&merged[s], part->n, part->mean, part->m2);
+        }
+      }
+      count++;
+      if (out)
+      {
+        printFleetRow(out, count, startTime + (windowFirst + b) * bucketSeconds, bucketDevices, bucketRows, merged);
+      }
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  return (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+}
+
+// ---------------------------------------------------------------------------------------------
+// synthetic fleet
+
+uint32_t synthState = 1;
+
+double synthUniform()
+{
+  synthState ^= synthState << 13;
+  synthState ^= synthState >> 17;
+  synthState ^= synthState << 5;
+  return (synthState + 0.5) / 4294967296.;
+}
+
+double synthGaussian()
+{
+  return sqrt(-2. * log(synthUniform())) * cos(2. * M_PI * synthUniform());
+}
+
+// nDevicesOut loggers of nRows rows: streams T and P with outputStats 5 (_cv, _av, _sd, _n) and L with
+// outputStats 0 (_cv), printed with more digits than Print uses so that the check is tight
+int synthesizeFleet(const char *dir, int nDevicesOut, int nRows)
+{
+  const char *names[] = {"T", "P", "L"};
+  nFleetStreams = 0;
+  for (int s = 0; s < 3; s++)
+  {
+    fleetStreamIndex(names[s], 1);
+  }
+  long created = 1610928000; // 1/18/2021 0:00:00
+  double horizon = nDevicesOut * 13. + nRows * intervalMillis / 1000. + 2. * bucketSeconds;
+  long nBuckets = (long)(horizon / bucketSeconds) + 1;
+  fleetStat *expected = (fleetStat *)calloc(nBuckets * 3, sizeof(fleetStat));
+  unsigned long *expectedRows = (unsigned long *)calloc(nBuckets, sizeof(unsigned long));
+  int *expectedDevices = (int *)calloc(nBuckets, sizeof(int));
+  startTime = floor(created / bucketSeconds) * bucketSeconds;
+
+  for (int d = 0; d < nDevicesOut; d++)
+  {
+    char code[DATA_SCAN_CODE_MAX];
+    if (d < 26)
+      snprintf(code, sizeof(code), "%c", 'A' + d);
+    else
+      snprintf(code, sizeof(code), "%c%c", 'A' + d / 26 - 1, 'A' + d % 26);
+    char path[DATA_SCAN_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/card%d", dir, d);
+    mkdir(dir, 0755);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/card%d/d210118", dir, d);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/card%d/d210118/%sdata000.csv", dir, d, code);
+    FILE *out = fopen(path, "wb");
+    if (!out)
+    {
+      fprintf(stderr, "aggregate: cannot write %s\n", path);
+      return 1;
+    }
+    int absolute = d % 2;                      // half the devices log unixTime
+    long deviceCreated = created + d * 13;     // the devices start at different times
+    double clockOffset = absolute ? 0.123 : 0.; // ... and not on whole seconds
+    double clockRate = absolute ? 1. + 0.002 * ((d / 2) % 3 - 1) : 1.; // and their clocks drift
+    fprintf(out, "Kite Datlogger File: /d210118/%sdata000.csv\r\n", code);
+    fprintf(out, "Kite Datlogger Code: synthetic\r\n");
+    fprintf(out, "Kite Datlogger Date file created: 1/18/2021\r\n");
+    fprintf(out, "Kite Datlogger time file created: %d:%d:%d\r\n", d * 13 / 3600, d * 13 / 60 % 60, d * 13 % 60);
+    fprintf(out, "-------------------------------------------------------------\r\n\r\n");
+    fprintf(out, "%s,0%s,T_cv,T_av,T_sd,T_n,P_cv,P_av,P_sd,P_n,L_cv\r\n", code, absolute ? ",unixTime" : "");
+    long lastBucket = -1;
+    for (int r = 1; r <= nRows; r++)
+    {
+      double t = deviceCreated + r * intervalMillis / 1000. * clockRate + clockOffset;
+      long bucket = (long)floor((t - startTime) / bucketSeconds);
+      fprintf(out, "%s, %d", code, r);
+      if (absolute)
+        fprintf(out, ", %.3f", t);
+      for (int s = 0; s < 2; s++)
+      {
+        // a sample of 20 to 60 points around a level that differs between devices and drifts
+        int n = 20 + (int)(synthUniform() * 41.);
+        double level = (s == 0 ? 20. + d : 1000. - 3. * d) + 2. * sin(t / 600.);
+        double sigma = s == 0 ? 0.5 : 2. + d % 3;
+        double sum = 0., sum2 = 0., last = 0.;
+        fleetStat sample = {0., 0., 0.};
+        for (int k = 0; k < n; k++)
+        {
+          last = level + sigma * synthGaussian();
+          sum += last;
+          sum2 += last * last;
+          mergeFleetStat(&sample, 1., last, 0.);
+          mergeFleetStat(&expected[bucket * 3 + s], 1., last, 0.);
+        }
+        fprintf(out, ", %.6f, %.6f, %.6f, %d", last, sample.mean, sqrt(sample.m2 / (n - 1.)), n);
+      }
+      double light = 300. + 50. * synthGaussian();
+      fprintf(out, ", %.6f", light);
+      mergeFleetStat(&expected[bucket * 3 + 2], 1., light, 0.);
+      expectedRows[bucket]++;
+      if (bucket != lastBucket)
+      {
+        expectedDevices[bucket]++;
+        lastBucket = bucket;
+      }
+      fprintf(out, "\r\n");
+    }
+    fclose(out);
+  }
+
+  char path[DATA_SCAN_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/expected.csv", dir);
+  FILE *out = fopen(path, "wb");
+  if (!out)
+  {
+    fprintf(stderr, "aggregate: cannot write %s\n", path);
+    return 1;
+  }
+  printFleetHeader(out);
+  long count = 0;
+  for (long b = 0; b < nBuckets; b++)
+  {
+    if (expectedRows[b] > 0)
+    {
+      printFleetRow(out, ++count, startTime + b * bucketSeconds, expectedDevices[b], expectedRows[b], &expected[b * 3]);
+    }
+  }
+  fclose(out);
+  free(expected);
+  free(expectedRows);
+  free(expectedDevices);
+  fprintf(stderr, "aggregate: %d devices of %d rows in %s, expected buckets in %s\n", nDevicesOut, nRows, dir, path);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int nThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  int bench = 0;
+  const char *outName = NULL;
+  const char *synthDir = NULL;
+  int synthDevices = 8;
+  int synthRows = 9000;
+  const char *paths[MAX_INPUTS];
+  int nPaths = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2))
+    {
+      if (nPaths < MAX_INPUTS)
+        paths[nPaths++] = arg;
+      continue;
+    }
+    if (!strcmp(arg, "--bench"))
+    {
+      bench = 1;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[++i] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    if (!strcmp(arg, "--bucket-s"))
+      bucketSeconds = atof(value) > 0. ? atof(value) : 60.;
+    else if (!strcmp(arg, "--interval-ms"))
+      intervalMillis = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--threads"))
+      nThreads = atoi(value);
+    else if (!strcmp(arg, "--out"))
+      outName = value;
+    else if (!strcmp(arg, "--code"))
+      snprintf(outputCode, sizeof(outputCode), "%s", value);
+    else if (!strcmp(arg, "--synthesize"))
+      synthDir = value;
+    else if (!strcmp(arg, "--devices"))
+      synthDevices = atoi(value);
+    else if (!strcmp(arg, "--rows"))
+      synthRows = atoi(value);
+    else if (!strcmp(arg, "--seed"))
+      synthState = strtoul(value, NULL, 10) | 1;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 2;
+    }
+  }
+  if (nThreads < 1)
+    nThreads = 1;
+  if (nThreads > MAX_THREADS)
+    nThreads = MAX_THREADS;
+
+  if (synthDir)
+  {
+    return synthesizeFleet(synthDir, synthDevices, synthRows);
+  }
+  if (nPaths == 0)
+  {
+    fprintf(stderr, "usage: aggregate [options] PATH...\n");
+    return 2;
+  }
+  for (int k = 0; k < nPaths; k++)
+  {
+    listDataFiles(paths[k], addInput);
+  }
+  if (nFiles == 0)
+  {
+    fprintf(stderr, "aggregate: no data files\n");
+    return 1;
+  }
+  // each device's files in the order they were logged
+  qsort(files, nFiles, sizeof(files[0]), compareFileTime);
+
+  unsigned long rows, late;
+  double bytes;
+  if (bench)
+  {
+    printf("devices\tthreads\tfiles\trows\tMB\tseconds\trows/s\tGB/s\n");
+    for (int d = 1; d <= nDevices; d = (d * 2 > nDevices && d < nDevices) ? nDevices : d * 2)
+    {
+      int nActiveFiles = 0;
+      for (int j = 0; j < nFiles; j++)
+      {
+        nActiveFiles += files[j].device < d;
+      }
+      for (int t = 1; t <= nThreads; t = (t * 2 > nThreads && t < nThreads) ? nThreads : t * 2)
+      {
+        double seconds = aggregate(NULL, d, t, &rows, &late, &bytes);
+        printf("%d\t%d\t%d\t%lu\t%.1f\t%.3f\t%.0f\t%.3f\n", d, t, nActiveFiles, rows, bytes / 1e6, seconds,
+               rows / seconds, bytes / seconds / 1e9);
+      }
+    }
+    return 0;
+  }
+
+  FILE *out = stdout;
+  if (outName && !(out = fopen(outName, "wb")))
+  {
+    fprintf(stderr, "cannot open %s\n", outName);
+    return 2;
+  }
+  double seconds = aggregate(out, nDevices, nThreads, &rows, &late, &bytes);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  fprintf(stderr, "aggregate: %d devices, %d files, %lu rows (%lu before their window, left out), %d streams, %.1f MB in %.3f s with %d threads (%.0f rows/s, %.3f GB/s)\n",
+          nDevices, nFiles, rows, late, nFleetStreams, bytes / 1e6, seconds, nThreads,
+          seconds > 0. ? rows / seconds : 0., seconds > 0. ? bytes / seconds / 1e9 : 0.);
+  return 0;
+}
@@ -0,0 +1,368 @@
+// benchmarkHost.cpp
+// runs the microbenchmarks from benchmarkStats.h on the host and (optionally) checks them
+// against a baseline file so that performance changes show up in review
+//
+//  build:  host/build.sh
+//  usage:  host/benchmarkHost [options]
+//    --iterations N    passes for each benchmark (default 20000)
+//    --out FILE        also write the results to FILE (same BENCH,... lines)
+//    --baseline FILE   compare against results saved earlier with --out
+//    --tolerance F     allowed slowdown as a fraction (default 0.25 = 25% slower)
+//    --sd DIR          directory used as the SD card for the file benchmarks (default "sdcard")
+//    --sd-entry-us N   modelled time to read one directory entry, for the startup benchmark (default 5)
+//  exits with status 1 if any benchmark is slower than the baseline by more than the tolerance, or
+//  if a call of the startup benchmark opens more files or looks up more paths than its limit
+//
+//  the startup benchmark (setupSDFile*) times setup_SD_file() in a directory holding thousands of
+//  files on the modelled card of host/SD.h (lookups scan the directory), so its times are card
+//  time, not host CPU time. the streams column holds the number of files of the type already there.
+//  it also prints the most SD opens and path lookups of one call against their limits:
+//    STARTUP,name,files,opens,max_opens,lookups,max_lookups
+//
+//  the capture stall benchmark triggers a window of three streams (64 samples before and after)
+//  and times the passes of a 1 ms sampling loop while it is written, on a card charging
+//  BENCH_STALL_OPEN_US per open or close and BENCH_STALL_WRITE_US per write call:
+//    CAPTURE,stall,mode,window_bytes,write_passes,worst_pass_us,card_us
+//  idle has no trigger, whole writes the window in one pass, chunked CAPTURE_WRITE_BYTES per pass
+
+#include "Arduino.h"
+#include "SD.h"
+
+#define ENABLE_BENCHMARK
+#define ENABLE_DEFERRED_DEBUG // for the debug message benchmarks (the macros stay off)
+#define ENABLE_DERIVED_STREAMS // for the derived stream benchmarks
+#define ENABLE_CAPTURE         // for the stall of a window dump
+#include "../quickDebugMessages.h"
+#include "../deviceConfigGeneric.h"
+#include "../logSD.h"
+#include "../timeBase.h"
+#include "../loopTiming.h"
+#include "../profiler.h"
+#include "../dataCompress.h"
+#include "../timeIndex.h"
+#include "../outputQueue.h"
+#include "../fastMath.h"
+#include "../sampleStats.h"
+#include "../derivedStreams.h"
+#include "../eventTracker.h"
+#include "../serialTelemetry.h"
+#include "../debugLog.h"
+#include "../eventQueue.h"
+#include "../eventCapture.h"
+#include "../simulatedSensor.h"
+#include "../benchmarkStats.h"
+
+// collects the printed results so they can be saved and compared
+class benchCapture : public Print
+{
+public:
+  char text[65536];
+  size_t length = 0;
+  size_t write(uint8_t c)
+  {
+    if (length < sizeof(text) - 1)
+    {
+      text[length++] = c;
+      text[length] = 0;
+    }
+    return 1;
+  }
+  using Print::write;
+};
+
+struct benchLine
+{
+  char name[48];
+  int streams;
+  double nsPerOp;
+};
+
+int parseBenchLines(const char *text, benchLine *lines, int maxLines)
+{
+  int n = 0;
+  const char *p = text;
+  while (p && *p && n < maxLines)
+  {
+    unsigned long iterations;
+    double opsPerSec;
+    if (sscanf(p, "BENCH,%47[^,],%d,%lu,%lf,%lf", lines[n].name, &lines[n].streams, &iterations, &lines[n].nsPerOp, &opsPerSec) == 5)
+    {
+      n++;
+    }
+    p = strchr(p, '\n');
+    if (p)
+    {
+      p++;
+    }
+  }
+  return n;
+}
+
+// create an empty file on the card
+void benchTouch(const char *path)
+{
+  char fullPath[512];
+  hostSdPath(path, fullPath, sizeof(fullPath));
+  FILE *fp = fopen(fullPath, "w");
+  if (fp)
+  {
+    fclose(fp);
+  }
+}
+
+// most SD opens and path lookups (exists or open) of one setup_SD_file(): with the marker file it
+//   reads the marker, checks that its number is unused, creates the file and rewrites the marker;
+//   without it the marker lookup fails and a binary search of the SD_FILE_MAX numbers comes first
+#define BENCH_STARTUP_OPENS 3
+#define BENCH_STARTUP_LOOKUPS 4
+#define BENCH_STARTUP_SEARCH_LOOKUPS (BENCH_STARTUP_LOOKUPS + 10) // 2^10 >= SD_FILE_MAX
+
+// time (us of card time) for each call of setup_SD_file() in a directory that holds nNumbered
+//   files of the type and nOther files of other devices, with and without the marker file
+//   returns the number of calls that went over the limits on opens and lookups
+int benchStartup(Print &out, int nNumbered, int nOther, unsigned long entryMicros)
+{
+  char path[64];
+  char fileName[40];
+  char markerName[40];
+  const int calls = 4;
+  int overLimit = 0;
+  unsigned long savedEntryMicros = hostSdEntryMicros;
+  FILE *savedSerial = Serial.out;
+  hostSerialOutput(NULL); // keep the reports of setup_SD_file() out of the results
+
+  SD.mkdir("/dstart");
+  strcpy(dirPath, "/dstart/");
+  for (int k = 0; k < nOther; k++)
+  {
+    makeSDFileName(path, "Y", "data", k % SD_FILE_MAX, ".csv");
+    path[strlen(dirPath)] = 'P' + k / SD_FILE_MAX; // other device codes
+    benchTouch(path);
+  }
+  for (int k = 0; k < nNumbered; k++)
+  {
+    makeSDFileName(path, "B", "data", k, ".csv");
+    benchTouch(path);
+  }
+  makeSDMarkerName(markerName, "B", "data");
+  writeSDFileMarker(markerName, nNumbered);
+
+  for (int withMarker = 1; withMarker >= 0; withMarker--)
+  {
+    const char *name = withMarker ? "setupSDFileMarker" : "setupSDFileSearch";
+    unsigned long maxLookups = withMarker ? BENCH_STARTUP_LOOKUPS : BENCH_STARTUP_SEARCH_LOOKUPS;
+    unsigned long mostOpens = 0;
+    unsigned long mostLookups = 0;
+    float elapsedMicros = 0.;
+    for (int call = 0; call < calls; call++)
+    {
+      if (!withMarker)
+      {
+        SD.remove(markerName);
+      }
+      hostSdEntryMicros = entryMicros;
+      uint64_t start = hostClockMicros;
+      unsigned long opens = hostSdOpenCount;
+      unsigned long lookups = hostSdLookups;
+      setup_SD_file("B", "data", ".csv", fileName);
+      elapsedMicros += (float)(hostClockMicros - start);
+      hostSdEntryMicros = 0;
+      opens = hostSdOpenCount - opens;
+      lookups = hostSdLookups - lookups;
+      mostOpens = opens > mostOpens ? opens : mostOpens;
+      mostLookups = lookups > mostLookups ? lookups : mostLookups;
+      if (opens > BENCH_STARTUP_OPENS || lookups > maxLookups)
+      {
+        overLimit++;
+      }
+    }
+    printBenchResult(out, name, nNumbered, calls, elapsedMicros);
+    char line[128];
+    snprintf(line, sizeof(line), "STARTUP,%s,%d,%lu,%d,%lu,%lu", name, nNumbered,
+             mostOpens, BENCH_STARTUP_OPENS, mostLookups, maxLookups);
+    out.println(line);
+  }
+
+  // remove the directory
+  for (int k = 0; k < nOther; k++)
+  {
+    makeSDFileName(path, "Y", "data", k % SD_FILE_MAX, ".csv");
+    path[strlen(dirPath)] = 'P' + k / SD_FILE_MAX;
+    SD.remove(path);
+  }
+  for (int k = 0; k < nNumbered + 2 * calls; k++)
+  {
+    makeSDFileName(path, "B", "data", k, ".csv");
+    SD.remove(path);
+  }
+  SD.remove(markerName);
+  char fullPath[512];
+  hostSdPath("/dstart", fullPath, sizeof(fullPath));
+  rmdir(fullPath);
+  dirPath[0] = 0;
+  hostSerialOutput(savedSerial);
+  hostSdEntryMicros = savedEntryMicros;
+  return overLimit;
+}
+
+#define BENCH_STALL_OPEN_US 2000
+#define BENCH_STALL_WRITE_US 100
+#define BENCH_STALL_PASSES 600
+
+// passes of a sampling loop (three captured streams read every 1 ms, then serviceEventCapture())
+//   while a window is written with at most maxBytes per pass (0 = no trigger)
+void benchCaptureStall(Print &out, const char *mode, unsigned long maxBytes)
+{
+  unsigned long savedOpenMicros = hostSdOpenMicros;
+  unsigned long savedWriteMicros = hostSdWriteMicros;
+  benchCaptureBegin();
+  for (int k = 0; k < 3; k++)
+  {
+    char nickName[8];
+    snprintf(nickName, sizeof(nickName), "s%d", k);
+    addDataStream(benchData, &benchSamples, "Benchmark stall stream", nickName, "arb", 4);
+    addCaptureStream(benchData, k, 64, 64);
+  }
+  int jTrigger = addEvent(benchEvents, &benchNumEvents, "Benchmark trigger", "trig", 0, 0, 2, "OFF", "ON");
+  addCaptureTrigger(benchEvents, jTrigger, 1);
+  long windowBytes = CAPTURE_HEADER_BYTES + 3 * (CAPTURE_STREAM_BYTES + 128 * CAPTURE_SAMPLE_BYTES) + CAPTURE_TRAILER_BYTES;
+
+  hostSdOpenMicros = BENCH_STALL_OPEN_US;
+  hostSdWriteMicros = BENCH_STALL_WRITE_US;
+  int writePasses = 0;
+  unsigned long worstMicros = 0;
+  uint64_t cardMicros = 0;
+  for (int pass = 0; pass < BENCH_STALL_PASSES; pass++)
+  {
+    hostAdvanceMicros(1000);
+    if (pass == 100 && maxBytes > 0)
+    {
+      updateEventState(benchEvents, jTrigger, 1, millis());
+    }
+    uint64_t start = hostClockMicros;
+    for (int k = 0; k < 3; k++)
+    {
+      updateDataSample(benchData, k, (float)(pass + k));
+    }
+    long written = serviceEventCapture(maxBytes > 0 ? maxBytes : CAPTURE_WRITE_BYTES);
+    unsigned long passMicros = (unsigned long)(hostClockMicros - start);
+    if (written > 0)
+    {
+      writePasses++;
+      cardMicros += passMicros;
+    }
+    worstMicros = passMicros > worstMicros ? passMicros : worstMicros;
+  }
+  hostSdOpenMicros = savedOpenMicros;
+  hostSdWriteMicros = savedWriteMicros;
+  benchCaptureEnd();
+
+  out.print("CAPTURE,stall,");
+  out.print(mode);
+  out.print(",");
+  out.print(maxBytes > 0 ? windowBytes : 0);
+  out.print(",");
+  out.print(writePasses);
+  out.print(",");
+  out.print(worstMicros);
+  out.print(",");
+  out.println((unsigned long)cardMicros);
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 20000;
+  const char *outName = NULL;
+  const char *baselineName = NULL;
+  double tolerance = 0.25;
+  unsigned long entryMicros = 5;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!strcmp(argv[i], "--iterations"))
+      iterations = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--out"))
+      outName = argv[i + 1];
+    else if (!strcmp(argv[i], "--baseline"))
+      baselineName = argv[i + 1];
+    else if (!strcmp(argv[i], "--tolerance"))
+      tolerance = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--sd"))
+      snprintf(hostSdRoot, sizeof(hostSdRoot), "%s", argv[i + 1]);
+    else if (!strcmp(argv[i], "--sd-entry-us"))
+      entryMicros = strtoul(argv[i + 1], NULL, 10);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  SD.begin(SD_CS);
+  benchCapture results;
+  runBenchmarks(results, iterations);
+  int overLimit = benchStartup(results, 0, 4000, entryMicros);
+  overLimit += benchStartup(results, 100, 4000, entryMicros);
+  overLimit += benchStartup(results, 990, 4000, entryMicros);
+  benchCaptureStall(results, "idle", 0);
+  benchCaptureStall(results, "whole", 100000);
+  benchCaptureStall(results, "chunked", CAPTURE_WRITE_BYTES);
+  fputs(results.text, stdout);
+
+  if (outName)
+  {
+    FILE *out = fopen(outName, "w");
+    if (!out)
+    {
+      fprintf(stderr, "cannot write %s\n", outName);
+      return 2;
+    }
+    fputs(results.text, out);
+    fclose(out);
+  }
+  if (overLimit > 0)
+  {
+    printf("%d calls of setup_SD_file() over the limits on SD opens and lookups\n", overLimit);
+  }
+
+  if (!baselineName)
+  {
+    return overLimit > 0 ? 1 : 0;
+  }
+
+  // compare with the baseline
+  static char baselineText[65536];
+  FILE *in = fopen(baselineName, "r");
+  if (!in)
+  {
+    fprintf(stderr, "cannot read %s\n", baselineName);
+    return 2;
+  }
+  size_t length = fread(baselineText, 1, sizeof(baselineText) - 1, in);
+  baselineText[length] = 0;
+  fclose(in);
+
+  static benchLine current[256];
+  static benchLine baseline[256];
+  int nCurrent = parseBenchLines(results.text, current, 256);
+  int nBaseline = parseBenchLines(baselineText, baseline, 256);
+  int regressions = 0;
+  for (int i = 0; i < nCurrent; i++)
+  {
+    for (int k = 0; k < nBaseline; k++)
+    {
+      if (!strcmp(current[i].name, baseline[k].name) && current[i].streams == baseline[k].streams)
+      {
+        double change = current[i].nsPerOp / baseline[k].nsPerOp - 1.;
+        if (change > tolerance)
+        {
+          printf("REGRESSION,%s,%d,%.1f,%.1f,%+.0f%%\n", current[i].name, current[i].streams,
+                 baseline[k].nsPerOp, current[i].nsPerOp, 100. * change);
+          regressions++;
+        }
+      }
+    }
+  }
+  printf("compared %d results with %s: %d regressions (tolerance %.0f%%)\n", nCurrent, baselineName, regressions, 100. * tolerance);
+  return (regressions > 0 || overLimit > 0) ? 1 : 0;
+}
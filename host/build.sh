@@ -0,0 +1,36 @@
+#!/bin/sh
+# build.sh
+# builds the host (Linux) programs for the logger into the host/ directory
+#   hostLogger: the unchanged sketch running on the stand-in hardware layer
+#   benchmarkHost: microbenchmarks of the statistics, event and output hot paths
+#   recoverLog: recovers the data of an unfinished preallocated log file
+#   decodeData: decodes a compressed data file back to CSV
+#   telemetryView: prints the binary Serial telemetry as the logger's text tables
+#   detokenize: turns deferred debug lines back into the text of the debug messages
+#   reprocess: reruns recorded data files through the statistics and event code with new settings
+#   aggregate: merges the data files of many loggers into fleet statistics per time bucket
+#   timeQuery: time and count range queries on a data or event file through its index
+#   pyramid: range statistics of the streams of a data file from a summary pyramid
+#   exportArrow: converts data files to an Arrow IPC file of typed columns for analysis tools
+#   decodeCapture: prints the windows of raw samples of a capture file as CSV
+#   testHost: checks of the logger's modules on the virtual clock (run by test.sh)
+#
+# the programs that include the sketch or its streams pass string literals as char *, which
+# the Arduino toolchain allows with -fpermissive; they get SKETCHFLAGS
+cd "$(dirname "$0")" || exit 1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-O2 -g -Wall -Wextra -I."}
+SKETCHFLAGS=${SKETCHFLAGS:-"-fpermissive -Wno-write-strings"}
+$CXX $CXXFLAGS $SKETCHFLAGS -o hostLogger hostLogger.cpp || exit 1
+$CXX $CXXFLAGS $SKETCHFLAGS -o benchmarkHost benchmarkHost.cpp || exit 1
+$CXX $CXXFLAGS -o recoverLog recoverLog.cpp || exit 1
+$CXX $CXXFLAGS -o decodeData decodeData.cpp || exit 1
+$CXX $CXXFLAGS -o telemetryView telemetryView.cpp || exit 1
+$CXX $CXXFLAGS -o detokenize detokenize.cpp || exit 1
+$CXX $CXXFLAGS $SKETCHFLAGS -pthread -o reprocess reprocess.cpp || exit 1
+$CXX $CXXFLAGS -pthread -o aggregate aggregate.cpp || exit 1
+$CXX $CXXFLAGS -o timeQuery timeQuery.cpp || exit 1
+$CXX $CXXFLAGS -o pyramid pyramid.cpp || exit 1
+$CXX $CXXFLAGS -o exportArrow exportArrow.cpp || exit 1
+$CXX $CXXFLAGS -o decodeCapture decodeCapture.cpp || exit 1
+$CXX $CXXFLAGS $SKETCHFLAGS -o testHost testHost.cpp || exit 1
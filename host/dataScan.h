@@ -0,0 +1,355 @@
+// dataScan.h
+// reading of the logger's text data files for the host tools (reprocess, aggregate): a file is
+// memory-mapped and its rows are scanned in place, a field at a time, without copies or allocation
+//
+//  a data file is a preamble ("Kite Datlogger ..." lines), the header row (device code, 0, names)
+//  and the rows (device code, count, values). a preallocated file ends at its first zero byte. an
+//  event file is read the same way (its header row has "count" in the second column)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <dirent.h>
+
+#define DATA_SCAN_CODE_MAX 16
+#define DATA_SCAN_WINDOW (64L << 20) // bytes searched for the end of a file before they are dropped
+#define DATA_SCAN_CODEC_LABEL "Kite Datlogger Data Codec: " // preamble line of a compressed file
+
+// a field is a pointer and length into the mapped file
+struct csvField
+{
+  const char *text;
+  int length;
+};
+
+const char *lineEndOf(const char *p, const char *end)
+{
+  const char *newline = (const char *)memchr(p, '\n', end - p);
+  return newline ? newline : end;
+}
+
+// the field starting at p (spaces after the separator skipped); returns the start of the next field
+// or NULL at the end of the line
+const char *nextField(const char *p, const char *lineEnd, csvField *field)
+{
+  while (p < lineEnd && *p == ' ')
+  {
+    p++;
+  }
+  const char *comma = (const char *)memchr(p, ',', lineEnd - p);
+  const char *end = comma ? comma : lineEnd;
+  field->text = p;
+  field->length = end - p;
+  while (field->length > 0 && (p[field->length - 1] == '\r' || p[field->length - 1] == ' '))
+  {
+    field->length--;
+  }
+  return comma ? comma + 1 : NULL;
+}
+
+int fieldIs(csvField *field, const char *text)
+{
+  int length = strlen(text);
+  return field->length == length && !memcmp(field->text, text, length);
+}
+
+// a number as Print writes it (sign, digits, point, digits, optional exponent); returns 0 if the
+// field is not a number (e.g. "N//A")
+int scanDouble(csvField *field, double *value)
+{
+  static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+  const char *p = field->text;
+  const char *end = p + field->length;
+  int negative = 0;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p == '-');
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+  {
+    if (mantissa < 100000000000000000ULL)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      exponent++;
+  }
+  if (p < end && *p == '.')
+  {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+    {
+      if (mantissa < 100000000000000000ULL)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+    }
+  }
+  if (digits == 0)
+  {
+    return 0;
+  }
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    int expNegative = 0;
+    int expValue = 0;
+    p++;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+      expNegative = (*p == '-');
+      p++;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+      expValue = expValue * 10 + (*p - '0');
+    }
+    exponent += expNegative ? -expValue : expValue;
+  }
+  if (p != end)
+  {
+    return 0;
+  }
+  double result = (double)mantissa;
+  if (exponent >= 0)
+    result = exponent <= 18 ? result * powers[exponent] : result * pow(10., exponent);
+  else
+    result = exponent >= -18 ? result / powers[-exponent] : result * pow(10., exponent);
+  *value = negative ? -result : result;
+  return 1;
+}
+
+int scanNumber(csvField *field, float *value)
+{
+  double result;
+  if (!scanDouble(field, &result))
+  {
+    return 0;
+  }
+  *value = (float)result;
+  return 1;
+}
+
+// a mapped data file
+struct dataFileMap
+{
+  const char *map;
+  size_t size;
+  const char *end;       // first zero byte, or the end of the file
+  const char *header;    // header row
+  const char *headerEnd; // its '\n'
+  char deviceCode[DATA_SCAN_CODE_MAX];
+};
+
+// map a data file and find its header row; returns NULL, or why the file cannot be used
+const char *openDataFile(const char *fileName, dataFileMap *file)
+{
+  file->map = NULL;
+  int fd = open(fileName, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) < 0 || info.st_size == 0)
+  {
+    if (fd >= 0)
+      close(fd);
+    return "cannot read";
+  }
+  const char *map = (const char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return "cannot map";
+  }
+  madvise((void *)map, info.st_size, MADV_SEQUENTIAL);
+  file->map = map;
+  file->size = info.st_size;
+  // the first zero byte, a window at a time: the windows of a large file are dropped once searched
+  // so that the file is not left resident before it is read
+  file->end = NULL;
+  for (off_t at = 0; at < info.st_size && !file->end; at += DATA_SCAN_WINDOW)
+  {
+    size_t length = info.st_size - at < DATA_SCAN_WINDOW ? info.st_size - at : DATA_SCAN_WINDOW;
+    file->end = (const char *)memchr(map + at, 0, length);
+    if (info.st_size > DATA_SCAN_WINDOW)
+      madvise((void *)(map + at), length, MADV_DONTNEED);
+  }
+  if (!file->end)
+    file->end = map + info.st_size;
+
+  // the preamble runs up to the header row (second column 0, or "count" in an event file)
+  int labelLength = strlen(DATA_SCAN_CODEC_LABEL);
+  const char *error = "no data header";
+  for (const char *p = map; p < file->end;)
+  {
+    const char *lineEnd = lineEndOf(p, file->end);
+    if (lineEnd - p >= labelLength && !memcmp(p, DATA_SCAN_CODEC_LABEL, labelLength))
+    {
+      error = "compressed (decode it with host/decodeData first)";
+      break;
+    }
+    csvField code;
+    csvField count;
+    const char *next = nextField(p, lineEnd, &code);
+    if (next && nextField(next, lineEnd, &count) && (fieldIs(&count, "0") || fieldIs(&count, "count")) && code.length < DATA_SCAN_CODE_MAX)
+    {
+      file->header = p;
+      file->headerEnd = lineEnd;
+      memcpy(file->deviceCode, code.text, code.length);
+      file->deviceCode[code.length] = 0;
+      return NULL;
+    }
+    p = lineEnd + 1;
+  }
+  munmap((void *)map, info.st_size);
+  file->map = NULL;
+  return error;
+}
+
+void closeDataFile(dataFileMap *file)
+{
+  if (file->map)
+  {
+    munmap((void *)file->map, file->size);
+  }
+  file->map = NULL;
+}
+
+// the time the file was created, from the RTC lines of its preamble, as unix seconds (-1 if the
+// logger had no RTC)
+long dataFileCreated(dataFileMap *file)
+{
+  int month = 0, day = 0, year = 0, hour = 0, minute = 0, second = 0;
+  int found = 0;
+  for (const char *p = file->map; p < file->header; p = lineEndOf(p, file->header) + 1)
+  {
+    // sscanf takes the length of its input, so it is given a copy of the line, not the mapped file
+    char line[80];
+    snprintf(line, sizeof(line), "%.*s", (int)(lineEndOf(p, file->header) - p), p);
+    if (sscanf(line, "Kite Datlogger Date file created: %d/%d/%d", &month, &day, &year) == 3)
+      found |= 1;
+    else if (sscanf(line, "Kite Datlogger time file created: %d:%d:%d", &hour, &minute, &second) == 3)
+      found |= 2;
+  }
+  if (found != 3)
+  {
+    return -1;
+  }
+  struct tm created;
+  memset(&created, 0, sizeof(created));
+  created.tm_year = year - 1900;
+  created.tm_mon = month - 1;
+  created.tm_mday = day;
+  created.tm_hour = hour;
+  created.tm_min = minute;
+  created.tm_sec = second;
+  return (long)timegm(&created);
+}
+
+// ---------------------------------------------------------------------------------------------
+// finding the data files of cards and days
+
+#define DATA_SCAN_PATH_MAX 512
+
+typedef void (*dataFileFound)(const char *fileName);
+typedef void (*dataFileFoundIn)(const char *fileName, const char *outDir);
+
+const char *baseName(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+int isDayDirectory(const char *name)
+{
+  if (name[0] != 'd' || strlen(name) != 7)
+  {
+    return 0;
+  }
+  for (int k = 1; k < 7; k++)
+  {
+    if (name[k] < '0' || name[k] > '9')
+      return 0;
+  }
+  return 1;
+}
+
+// call found() (or foundIn()) for a data file, or for every data file (.csv with "data" in its name)
+// of a day directory (dYYMMDD), a directory of day directories (an SD card) or a directory of cards.
+// foundIn() also gets outDir with the name of each directory given and walked added, as on the card
+// (a file given on its own keeps the name of its day directory)
+void walkDataFiles(const char *path, const char *outDir, dataFileFound found, dataFileFoundIn foundIn, int depth)
+{
+  struct stat info;
+  if (stat(path, &info) < 0)
+  {
+    fprintf(stderr, "cannot read %s\n", path);
+    return;
+  }
+  char parent[DATA_SCAN_PATH_MAX];
+  snprintf(parent, sizeof(parent), "%s", path);
+  char *slash = strrchr(parent, '/');
+  if (slash)
+    *slash = 0;
+  if (!S_ISDIR(info.st_mode) && found)
+  {
+    found(path);
+    return;
+  }
+  if (!S_ISDIR(info.st_mode))
+  {
+    char fileOut[DATA_SCAN_PATH_MAX];
+    if (depth == 0 && slash && isDayDirectory(baseName(parent)))
+      snprintf(fileOut, sizeof(fileOut), "%s/%s", outDir, baseName(parent));
+    else
+      snprintf(fileOut, sizeof(fileOut), "%s", outDir);
+    foundIn(path, fileOut);
+    return;
+  }
+  DIR *dir = depth <= 2 ? opendir(path) : NULL;
+  if (!dir)
+  {
+    return;
+  }
+  char dirOut[DATA_SCAN_PATH_MAX];
+  char trimmed[DATA_SCAN_PATH_MAX];
+  snprintf(trimmed, sizeof(trimmed), "%s", path);
+  for (int length = strlen(trimmed); length > 1 && trimmed[length - 1] == '/'; length--)
+  {
+    trimmed[length - 1] = 0;
+  }
+  snprintf(dirOut, sizeof(dirOut), "%s/%s", outDir, baseName(trimmed));
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    const char *name = entry->d_name;
+    char child[DATA_SCAN_PATH_MAX];
+    snprintf(child, sizeof(child), "%s/%s", trimmed, name);
+    int length = strlen(name);
+    if (isDayDirectory(name) || (depth == 0 && entry->d_type == DT_DIR && name[0] != '.'))
+    {
+      walkDataFiles(child, dirOut, found, foundIn, depth + 1); // a day, or one card of a directory of cards
+    }
+    else if (length > 4 && !strcmp(name + length - 4, ".csv") && strstr(name, "data"))
+    {
+      if (found)
+        found(child);
+      else
+        foundIn(child, dirOut);
+    }
+  }
+  closedir(dir);
+}
+
+// the data files of path
+void listDataFiles(const char *path, dataFileFound found)
+{
+  walkDataFiles(path, "", found, NULL, 0);
+}
+
+// the data files of path, with the directory under outDir that mirrors the one of each file
+void listDataFilesTo(const char *path, const char *outDir, dataFileFoundIn foundIn)
+{
+  walkDataFiles(path, outDir, NULL, foundIn, 0);
+}
@@ -0,0 +1,195 @@
+// decodeCapture.cpp
+// prints the windows of raw samples in a capture file (ENABLE_CAPTURE, see eventCapture.h) as CSV:
+// one row per sample, with the window, the event that triggered it and the time from the trigger
+//
+//  the blocks are found by their "KCAP" header after the text preamble. a block whose sizes do not
+//  add up or whose CRC does not match (damaged, or cut off at the end of the file by a power loss)
+//  is skipped and the search goes on from the byte after its header. the sample column counts from
+//  the trigger: -3, -2, -1 are the last three samples before it, 0 the first after it
+//
+//  build:  host/build.sh
+//  usage:  host/decodeCapture [--summary] FILE [OUT]
+//    writes the CSV to OUT (default stdout) and a summary of the windows to stderr
+//    --summary  only the summary: one line per window (event, state, samples of each stream)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "KCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_BYTES 48
+#define CAPTURE_STREAM_BYTES 16
+#define CAPTURE_SAMPLE_BYTES 8
+#define CAPTURE_TRAILER_BYTES 4
+#define CAPTURE_EVENT_NAME 16
+#define CAPTURE_STREAM_NAME 10
+
+// CRC-16/CCITT (polynomial 0x1021, start 0xFFFF) of one byte added to crc (as logSD.h)
+uint16_t crc16Update(uint16_t crc, uint8_t c)
+{
+  crc ^= ((uint16_t)c) << 8;
+  for (int k = 0; k < 8; k++)
+  {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint32_t getWord(const uint8_t *bytes, int size)
+{
+  uint32_t value = 0;
+  for (int k = size - 1; k >= 0; k--)
+  {
+    value = (value << 8) | bytes[k];
+  }
+  return value;
+}
+
+// checks the block at p (at most available bytes); returns its length, or 0 if it is not a whole
+// block with a good CRC
+long checkBlock(const uint8_t *p, long available)
+{
+  if (available < CAPTURE_HEADER_BYTES + CAPTURE_TRAILER_BYTES || getWord(p + 4, 2) != CAPTURE_VERSION ||
+      getWord(p + 6, 2) != CAPTURE_HEADER_BYTES)
+  {
+    return 0;
+  }
+  long length = getWord(p + 8, 4);
+  int nStreams = getWord(p + 28, 2);
+  if (length > available || length < CAPTURE_HEADER_BYTES + CAPTURE_TRAILER_BYTES)
+  {
+    return 0;
+  }
+  long at = CAPTURE_HEADER_BYTES;
+  for (int k = 0; k < nStreams; k++)
+  {
+    if (at + CAPTURE_STREAM_BYTES > length - CAPTURE_TRAILER_BYTES)
+      return 0;
+    at += CAPTURE_STREAM_BYTES + CAPTURE_SAMPLE_BYTES * (long)(getWord(p + at + 10, 2) + getWord(p + at + 12, 2));
+  }
+  if (at != length - CAPTURE_TRAILER_BYTES)
+  {
+    return 0;
+  }
+  uint16_t crc = 0xFFFF;
+  for (long k = 0; k < at; k++)
+  {
+    crc = crc16Update(crc, p[k]);
+  }
+  return crc == getWord(p + at, 2) ? length : 0;
+}
+
+int main(int argc, char **argv)
+{
+  int summaryOnly = 0;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+  {
+    if (!strcmp(argv[arg], "--summary"))
+      summaryOnly = 1;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[arg]);
+      return 2;
+    }
+  }
+  if (argc - arg < 1 || argc - arg > 2)
+  {
+    fprintf(stderr, "usage: decodeCapture [--summary] FILE [OUT]\n");
+    return 2;
+  }
+  const char *inName = argv[arg];
+  FILE *in = fopen(inName, "rb");
+  if (!in)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  uint8_t *bytes = (uint8_t *)malloc(size + 1);
+  if (!bytes || fread(bytes, 1, size, in) != (size_t)size)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fclose(in);
+  FILE *out = stdout;
+  if (argc - arg == 2 && !(out = fopen(argv[arg + 1], "w")))
+  {
+    fprintf(stderr, "cannot write %s\n", argv[arg + 1]);
+    return 2;
+  }
+
+  if (!summaryOnly)
+  {
+    fprintf(out, "window,event,state,trigger_ms,stream,sample,t_ms,value\n");
+  }
+  long windows = 0, samples = 0, damaged = 0, missed = 0;
+  for (long position = 0; position + 4 <= size;)
+  {
+    const uint8_t *magic = (const uint8_t *)memmem(bytes + position, size - position, CAPTURE_MAGIC, 4);
+    if (!magic)
+    {
+      break;
+    }
+    position = magic - bytes;
+    long length = checkBlock(magic, size - position);
+    if (length == 0)
+    {
+      damaged++;
+      position++;
+      continue;
+    }
+    unsigned long window = getWord(magic + 12, 4);
+    unsigned long triggerMillis = getWord(magic + 16, 4);
+    int event = getWord(magic + 24, 2);
+    int state = getWord(magic + 26, 2);
+    int nStreams = getWord(magic + 28, 2);
+    missed += getWord(magic + 30, 2);
+    char eventName[CAPTURE_EVENT_NAME + 1];
+    memcpy(eventName, magic + 32, CAPTURE_EVENT_NAME);
+    eventName[CAPTURE_EVENT_NAME] = 0;
+    if (!eventName[0])
+    {
+      snprintf(eventName, sizeof(eventName), "%d", event);
+    }
+    fprintf(stderr, "window %lu: %s to state %d at %lu ms:", window, eventName, state, triggerMillis);
+    const uint8_t *p = magic + CAPTURE_HEADER_BYTES;
+    for (int k = 0; k < nStreams; k++)
+    {
+      char streamName[CAPTURE_STREAM_NAME + 1];
+      memcpy(streamName, p, CAPTURE_STREAM_NAME);
+      streamName[CAPTURE_STREAM_NAME] = 0;
+      int nPre = getWord(p + 10, 2);
+      int nPost = getWord(p + 12, 2);
+      fprintf(stderr, " %s %d+%d", streamName, nPre, nPost);
+      p += CAPTURE_STREAM_BYTES;
+      for (int j = 0; j < nPre + nPost; j++, p += CAPTURE_SAMPLE_BYTES)
+      {
+        int32_t micros = (int32_t)getWord(p, 4);
+        uint32_t valueBits = getWord(p + 4, 4);
+        float value;
+        memcpy(&value, &valueBits, 4);
+        if (!summaryOnly)
+        {
+          fprintf(out, "%lu,%s,%d,%lu,%s,%d,%.3f,%.7g\n", window, eventName, state, triggerMillis, streamName, j - nPre, micros / 1000., value);
+        }
+      }
+      samples += nPre + nPost;
+    }
+    fprintf(stderr, "\n");
+    windows++;
+    position += length;
+  }
+  fprintf(stderr, "%ld windows, %ld samples, %ld triggers missed by the logger, %ld damaged blocks skipped\n", windows, samples, missed, damaged);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  free(bytes);
+  return 0;
+}
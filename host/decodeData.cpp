@@ -0,0 +1,429 @@
+// decodeData.cpp
+// decodes a compressed data file (ENABLE_COMPRESSED_DATA, see dataCompress.h) back to the CSV the
+// logger writes without compression, and reports how well each row compressed
+//
+//  the preamble and header row are copied (without the codec line and the crc column); each frame
+//  becomes a row printed the way Print does on the host (2 decimals, "N//A" for a missing standard
+//  deviation). a frame that is damaged (bad tag or CRC) or follows a missing row cannot be decoded:
+//  its rows are skipped up to the next keyframe. decoding stops at the first unused (zero) byte of
+//  a preallocated file or at the end of the file (a frame cut off there is reported as damaged)
+//
+//  build:  host/build.sh
+//  usage:  host/decodeData [--exact] [--rows] FILE [OUT]
+//    writes the CSV to OUT (default stdout) and a summary to stderr
+//    --exact  print values with all their digits (9 significant) instead of 2 decimals
+//    --rows   also report every row: frame bytes, bytes of the CSV row and of raw 4-byte values
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define CODEC_LABEL "Kite Datlogger Data Codec: "
+#define FRAME 0xC5
+#define KEYFRAME 0xC6
+#define NO_WINDOW 0xFF
+#define MAX_COLUMNS 1024
+
+#define COLUMN_INT 0
+#define COLUMN_FLOAT 1
+#define COLUMN_TIME 2
+
+struct columnState
+{
+  uint32_t previous;
+  int32_t delta;
+  uint8_t leading;
+  uint8_t trailing;
+};
+
+int columnType[MAX_COLUMNS];
+int columnMissing[MAX_COLUMNS]; // 1 for _sd columns (NAN is printed as N//A)
+int nColumns = 0;               // encoded columns (count and after)
+int codecColumns = 0;           // columns with state (DATA_CODEC_COLUMNS of the logger)
+columnState state[MAX_COLUMNS];
+uint64_t previousTime;
+int64_t timeDelta;
+
+// reads bits of a payload, most significant first
+const uint8_t *payload;
+long payloadBits;
+long bitPosition;
+int overrun;
+
+uint32_t getBits(int nBits)
+{
+  uint32_t value = 0;
+  for (int k = 0; k < nBits; k++)
+  {
+    if (bitPosition >= payloadBits)
+    {
+      overrun = 1;
+      return 0;
+    }
+    value = (value << 1) | ((payload[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 1);
+    bitPosition++;
+  }
+  return value;
+}
+
+int64_t getVarint()
+{
+  uint64_t zigzag = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    uint32_t group = getBits(8);
+    zigzag |= ((uint64_t)(group & 0x7F)) << shift;
+    if (!(group & 0x80) || overrun)
+      break;
+  }
+  return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+}
+
+int64_t getDelta()
+{
+  return getBits(1) ? getVarint() : 0;
+}
+
+void resetState()
+{
+  for (int k = 0; k < MAX_COLUMNS; k++)
+  {
+    state[k].previous = 0;
+    state[k].delta = 0;
+    state[k].leading = NO_WINDOW;
+    state[k].trailing = 0;
+  }
+  previousTime = 0;
+  timeDelta = 0;
+}
+
+float getFloat(int k)
+{
+  uint32_t bits;
+  if (k >= codecColumns)
+  {
+    bits = getBits(32);
+  }
+  else
+  {
+    columnState *column = &state[k];
+    uint32_t xorBits = 0;
+    if (getBits(1))
+    {
+      if (getBits(1) == 0 && column->leading != NO_WINDOW)
+      {
+        xorBits = getBits(32 - column->leading - column->trailing) << column->trailing;
+      }
+      else
+      {
+        int leading = getBits(5);
+        int meaningful = getBits(5) + 1;
+        int trailing = 32 - leading - meaningful;
+        if (trailing < 0)
+        {
+          overrun = 1;
+          return 0.;
+        }
+        xorBits = getBits(meaningful) << trailing;
+        column->leading = leading;
+        column->trailing = trailing;
+      }
+    }
+    bits = column->previous ^ xorBits;
+    column->previous = bits;
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+int32_t getInt(int k)
+{
+  if (k >= codecColumns)
+  {
+    return (int32_t)getVarint();
+  }
+  columnState *column = &state[k];
+  int32_t delta = (int32_t)(column->delta + getDelta());
+  int32_t value = (int32_t)column->previous + delta;
+  column->previous = (uint32_t)value;
+  column->delta = delta;
+  return value;
+}
+
+// appends a value the way Print::print(double) does on the host
+int formatFloat(char *text, size_t size, float value, int missing, int exact)
+{
+  if (isnan(value))
+    return snprintf(text, size, "%s", missing ? "N//A" : "nan");
+  if (isinf(value))
+    return snprintf(text, size, "inf");
+  if (exact)
+    return snprintf(text, size, "%.9g", value);
+  if (value > 4294967040.0 || value < -4294967040.0)
+    return snprintf(text, size, "ovf");
+  return snprintf(text, size, "%.2f", (double)value);
+}
+
+// length of the varint at bytes[0..available), 0 if it does not end there
+int readLength(const uint8_t *bytes, long available, long *length)
+{
+  *length = 0;
+  for (int k = 0; k < 5 && k < available; k++)
+  {
+    *length |= ((long)(bytes[k] & 0x7F)) << (7 * k);
+    if (!(bytes[k] & 0x80))
+      return k + 1;
+  }
+  return 0;
+}
+
+uint16_t crc16(const uint8_t *bytes, long length)
+{
+  uint16_t crc = 0xFFFF;
+  for (long k = 0; k < length; k++)
+  {
+    crc ^= ((uint16_t)bytes[k]) << 8;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+int main(int argc, char **argv)
+{
+  int exact = 0;
+  int perRow = 0;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+  {
+    if (!strcmp(argv[arg], "--exact"))
+      exact = 1;
+    else if (!strcmp(argv[arg], "--rows"))
+      perRow = 1;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[arg]);
+      return 2;
+    }
+  }
+  if (argc - arg < 1 || argc - arg > 2)
+  {
+    fprintf(stderr, "usage: decodeData [--exact] [--rows] FILE [OUT]\n");
+    return 2;
+  }
+  const char *inName = argv[arg];
+  FILE *in = fopen(inName, "rb");
+  if (!in)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  uint8_t *bytes = (uint8_t *)malloc(size + 1);
+  if (!bytes || fread(bytes, 1, size, in) != (size_t)size)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fclose(in);
+  bytes[size] = 0;
+  FILE *out = stdout;
+  if (argc - arg == 2 && !(out = fopen(argv[arg + 1], "wb")))
+  {
+    fprintf(stderr, "cannot write %s\n", argv[arg + 1]);
+    return 2;
+  }
+
+  // text up to the codec line is the preamble
+  const char *text = (const char *)bytes;
+  const char *codecLine = strstr(text, CODEC_LABEL);
+  int crc = 0;
+  if (!codecLine || sscanf(codecLine + strlen(CODEC_LABEL), "xor-dod,columns=%d,crc=%d", &codecColumns, &crc) != 2 || codecColumns > MAX_COLUMNS)
+  {
+    fprintf(stderr, "%s: no data codec line (not a compressed data file)\n", inName);
+    return 2;
+  }
+  fwrite(text, 1, codecLine - text, out);
+  const char *header = strchr(codecLine, '\n');
+  const char *headerEnd = header ? strchr(header + 1, '\n') : NULL;
+  if (!headerEnd)
+  {
+    fprintf(stderr, "%s: no header row\n", inName);
+    return 2;
+  }
+  header++;
+  long headerLength = headerEnd - header;
+  while (headerLength > 0 && (header[headerLength - 1] == '\r' || header[headerLength - 1] == '\n'))
+    headerLength--;
+  if (crc && headerLength >= 4 && !strncmp(header + headerLength - 4, ",crc", 4))
+    headerLength -= 4;
+  fwrite(header, 1, headerLength, out);
+  fprintf(out, "\r\n");
+
+  // the types of the columns come from their names: device code, count, then [unixTime,] stats
+  char deviceCode[16] = "";
+  const char *name = header;
+  for (int k = 0; name < header + headerLength; k++)
+  {
+    const char *nameEnd = (const char *)memchr(name, ',', header + headerLength - name);
+    if (!nameEnd)
+      nameEnd = header + headerLength;
+    long length = nameEnd - name;
+    if (k == 0)
+    {
+      snprintf(deviceCode, sizeof(deviceCode), "%.*s", (int)length, name);
+    }
+    else if (nColumns < MAX_COLUMNS)
+    {
+      columnMissing[nColumns] = length > 3 && !strncmp(nameEnd - 3, "_sd", 3);
+      if (k == 1 || (length > 2 && !strncmp(nameEnd - 2, "_n", 2)))
+        columnType[nColumns] = COLUMN_INT;
+      else if (length == 8 && !strncmp(name, "unixTime", 8))
+        columnType[nColumns] = COLUMN_TIME;
+      else
+        columnType[nColumns] = COLUMN_FLOAT;
+      nColumns++;
+    }
+    name = nameEnd + 1;
+  }
+
+  long position = (headerEnd + 1) - text;
+  long rows = 0, keyframes = 0, skipped = 0, resyncs = 0;
+  long frameBytes = 0, csvBytes = 0, rawBytes = 0;
+  int synced = 0;     // 1 while the state matches the logger's (after a keyframe)
+  int expected = -1;  // sequence number of the next row
+  int damaged = 0;
+  char row[32768];
+  while (position < size && bytes[position] != 0)
+  {
+    // frame: tag, sequence, payload length, payload, CRC
+    int tag = bytes[position];
+    long length = 0;
+    int lengthBytes = readLength(bytes + position + 2, size - position - 2, &length);
+    long frameEnd = position + 2 + lengthBytes + length + (crc ? 2 : 0);
+    int valid = (tag == FRAME || tag == KEYFRAME) && position + 2 < size && lengthBytes > 0;
+    if (valid && frameEnd > size)
+    {
+      // the last frame was cut off, or a damaged length: either way look for a keyframe after it
+      fprintf(stderr, "%s: frame at byte %ld goes past the end of the file\n", inName, position);
+      valid = 0;
+    }
+    const uint8_t *body = bytes + position + 2 + lengthBytes;
+    if (valid && crc && crc16(body, length) != ((body[length] << 8) | body[length + 1]))
+    {
+      valid = 0;
+    }
+    if (!valid)
+    {
+      // damaged: look for the next keyframe that checks out
+      damaged = 1;
+      if (synced)
+        resyncs++;
+      synced = 0;
+      position++;
+      while (position < size) // payloads hold zero bytes too, so this goes on to the end of the file
+      {
+        long candidateLength;
+        int candidateBytes = readLength(bytes + position + 2, size - position - 2, &candidateLength);
+        long candidateEnd = position + 2 + candidateBytes + candidateLength + (crc ? 2 : 0);
+        if (bytes[position] == KEYFRAME && candidateBytes > 0 && candidateEnd <= size &&
+            (!crc || crc16(bytes + position + 2 + candidateBytes, candidateLength) ==
+                         ((bytes[candidateEnd - 2] << 8) | bytes[candidateEnd - 1])))
+          break;
+        position++;
+      }
+      continue;
+    }
+    int sequence = bytes[position + 1];
+    if (tag == KEYFRAME)
+    {
+      resetState();
+      synced = 1;
+      keyframes++;
+    }
+    else if (sequence != expected)
+    {
+      if (synced)
+        resyncs++;
+      synced = 0; // a row is missing: the rows up to the next keyframe refer to it
+    }
+    expected = (sequence + 1) & 0xFF;
+    if (!synced)
+    {
+      skipped++;
+      position = frameEnd;
+      continue;
+    }
+
+    payload = body;
+    payloadBits = length * 8;
+    bitPosition = 0;
+    overrun = 0;
+    long rowRaw = 0;
+    int used = snprintf(row, sizeof(row), "%s", deviceCode);
+    for (int k = 0; k < nColumns && used < (int)sizeof(row) - 64; k++)
+    {
+      used += snprintf(row + used, sizeof(row) - used, ", ");
+      if (columnType[k] == COLUMN_INT)
+      {
+        used += snprintf(row + used, sizeof(row) - used, "%ld", (long)getInt(k));
+        rowRaw += 4;
+      }
+      else if (columnType[k] == COLUMN_TIME)
+      {
+        int64_t delta = timeDelta + getDelta();
+        uint64_t millisecond = previousTime + delta;
+        previousTime = millisecond;
+        timeDelta = delta;
+        used += snprintf(row + used, sizeof(row) - used, "%lu.%03u", (unsigned long)(millisecond / 1000ULL),
+                         (unsigned int)(millisecond % 1000ULL));
+        rowRaw += 8;
+      }
+      else
+      {
+        used += formatFloat(row + used, sizeof(row) - used, getFloat(k), columnMissing[k], exact);
+        rowRaw += 4;
+      }
+    }
+    used += snprintf(row + used, sizeof(row) - used, "\r\n");
+    if (overrun)
+    {
+      // the payload is shorter than the header says: the row does not match the header
+      damaged = 1;
+      synced = 0;
+      resyncs++;
+      skipped++;
+      position = frameEnd;
+      continue;
+    }
+    fwrite(row, 1, used, out);
+    rows++;
+    frameBytes += frameEnd - position;
+    csvBytes += used;
+    rawBytes += rowRaw;
+    if (perRow)
+    {
+      fprintf(stderr, "row %ld: %ld bytes, %d bytes as CSV (%.1f%%), %.1f%% of raw values%s\n", rows, frameEnd - position, used,
+              100. * (frameEnd - position) / used, 100. * (frameEnd - position) / rowRaw, tag == KEYFRAME ? ", keyframe" : "");
+    }
+    position = frameEnd;
+  }
+  if (out != stdout)
+    fclose(out);
+
+  fprintf(stderr, "%s: %ld rows (%ld keyframes), %ld rows skipped after %ld damaged or missing rows, %ld bytes unused\n",
+          inName, rows, keyframes, skipped, resyncs, size - position);
+  if (rows > 0)
+  {
+    fprintf(stderr, "%s: %.1f bytes/row compressed, %.1f bytes/row as CSV, %.1f bytes/row as raw values: %.1f%% of CSV, %.1f%% of raw\n",
+            inName, (double)frameBytes / rows, (double)csvBytes / rows, (double)rawBytes / rows,
+            100. * frameBytes / csvBytes, 100. * frameBytes / rawBytes);
+  }
+  free(bytes);
+  return damaged;
+}
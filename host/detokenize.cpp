@@ -0,0 +1,463 @@
+// detokenize.cpp
+// turns the deferred debug lines (ENABLE_DEFERRED_DEBUG, see quickDebugMessages.h and debugLog.h)
+// back into the text the DEBUG, WARN and MESSAGE macros print without it
+//
+//  the logger only records a token for each macro call: the FNV-1a hash of "DEBUG|variable",
+//  "DEBUGn|variable", "MESSAGE|text|variable" or "WARN|text|variable". the table of tokens is built
+//  here from the macro calls in the sketch's .h and .ino files (not those in comments), so it has to
+//  be the same source the logger was built from. each line "$TTTTTTTT,millis,value" is replaced by the macro's text with
+//  "[millis ms] " in front of the line holding the value; every other line (the rest of the Serial
+//  output or of the log file) is copied as it is. a record with a token that is not in the table, or
+//  one that was cut short (no value or no end of line), is copied as it is and reported on stderr
+//  with its line number, and the exit status is then 1
+//
+//  build:  host/build.sh
+//  usage:  host/detokenize [--source DIR] [--no-time] [--list] [FILE]
+//    reads FILE (default stdin) and writes to stdout, with a summary on stderr
+//    --source DIR  directory of the sketch (default: the directory above this program)
+//    --no-time     leave out the "[millis ms] " (the output is then the text the macros print)
+//    --list        print the table of tokens (token, file:line, string) instead; exits with
+//                  status 1 if two different strings have the same token
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+
+#define MAX_TOKENS 4096
+#define MAX_SOURCE_BYTES (1 << 20)
+#define MAX_LINE 4096
+
+// same hash as debugTokenHash() in quickDebugMessages.h
+uint32_t tokenHash(const char *text)
+{
+  uint32_t hash = 2166136261UL;
+  for (; *text; text++)
+  {
+    hash = (hash ^ (uint8_t)*text) * 16777619UL;
+  }
+  return hash;
+}
+
+struct tokenEntry
+{
+  uint32_t token;
+  char *macro; // DEBUG, DEBUG1..DEBUG4, WARN or MESSAGE
+  char *text;  // text of WARN and MESSAGE ("" for DEBUG)
+  char *name;  // the variable, as the preprocessor stringizes it
+  char where[96];
+};
+
+tokenEntry tokens[MAX_TOKENS];
+int nTokens = 0;
+int nCollisions = 0;
+
+tokenEntry *findToken(uint32_t token)
+{
+  for (int k = 0; k < nTokens; k++)
+  {
+    if (tokens[k].token == token)
+    {
+      return &tokens[k];
+    }
+  }
+  return NULL;
+}
+
+void addToken(const char *macro, const char *text, const char *name, const char *fileName, int line)
+{
+  char key[MAX_LINE];
+  if (text[0])
+    snprintf(key, sizeof(key), "%s|%s|%s", macro, text, name);
+  else
+    snprintf(key, sizeof(key), "%s|%s", macro, name);
+  uint32_t token = tokenHash(key);
+  tokenEntry *known = findToken(token);
+  if (known)
+  {
+    if (strcmp(known->macro, macro) || strcmp(known->text, text) || strcmp(known->name, name))
+    {
+      fprintf(stderr, "detokenize: token %08X of %s:%d is also the token of %s\n", token, fileName, line, known->where);
+      nCollisions++;
+    }
+    return; // the same message in two places
+  }
+  if (nTokens >= MAX_TOKENS)
+  {
+    return;
+  }
+  tokenEntry *entry = &tokens[nTokens++];
+  entry->token = token;
+  entry->macro = strdup(macro);
+  entry->text = strdup(text);
+  entry->name = strdup(name);
+  snprintf(entry->where, sizeof(entry->where), "%s:%d", fileName, line);
+}
+
+// skip a string or character literal starting at s[k]; returns the index after it
+int skipLiteral(const char *s, int k)
+{
+  char quote = s[k++];
+  while (s[k] && s[k] != quote)
+  {
+    if (s[k] == '\\' && s[k + 1])
+      k++;
+    k++;
+  }
+  return s[k] ? k + 1 : k;
+}
+
+// the argument as #b gives it: whitespace runs outside literals become one space, none at the ends
+void stringizeArgument(const char *s, int length, char *out, int outBytes)
+{
+  int n = 0;
+  int space = 0;
+  for (int k = 0; k < length && n < outBytes - 2;)
+  {
+    if (s[k] == ' ' || s[k] == '\t' || s[k] == '\r' || s[k] == '\n' || s[k] == '\\')
+    {
+      space = n > 0;
+      k++;
+      continue;
+    }
+    if (space)
+    {
+      out[n++] = ' ';
+      space = 0;
+    }
+    if (s[k] == '"' || s[k] == '\'')
+    {
+      int end = skipLiteral(s, k);
+      while (k < end && n < outBytes - 2)
+        out[n++] = s[k++];
+      continue;
+    }
+    out[n++] = s[k++];
+  }
+  out[n] = 0;
+}
+
+// the value of one or more adjacent string literals; returns 0 if the argument is not a literal
+int literalArgument(const char *s, int length, char *out, int outBytes)
+{
+  int n = 0;
+  int k = 0;
+  int found = 0;
+  while (k < length)
+  {
+    if (s[k] == ' ' || s[k] == '\t' || s[k] == '\r' || s[k] == '\n' || s[k] == '\\')
+    {
+      k++;
+      continue;
+    }
+    if (s[k] != '"')
+    {
+      return 0;
+    }
+    found = 1;
+    for (k++; k < length && s[k] != '"'; k++)
+    {
+      char c = s[k];
+      if (c == '\\' && k + 1 < length)
+      {
+        k++;
+        c = s[k] == 'n' ? '\n' : s[k] == 't' ? '\t' : s[k] == 'r' ? '\r' : s[k];
+      }
+      if (n < outBytes - 1)
+        out[n++] = c;
+    }
+    k++;
+  }
+  out[n] = 0;
+  return found;
+}
+
+int isIdentifierChar(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// add the tokens of the macro calls in one source file
+void scanSource(const char *path, const char *fileName)
+{
+  FILE *in = fopen(path, "rb");
+  if (!in)
+  {
+    return;
+  }
+  static char s[MAX_SOURCE_BYTES + 1];
+  size_t size = fread(s, 1, MAX_SOURCE_BYTES, in);
+  fclose(in);
+  s[size] = 0;
+
+  int line = 1;
+  for (int k = 0; s[k];)
+  {
+    if (s[k] == '\n')
+    {
+      line++;
+      k++;
+      continue;
+    }
+    if (s[k] == '/' && s[k + 1] == '/')
+    {
+      while (s[k] && s[k] != '\n')
+        k++;
+      continue;
+    }
+    if (s[k] == '/' && s[k + 1] == '*')
+    {
+      for (k += 2; s[k] && !(s[k] == '*' && s[k + 1] == '/'); k++)
+        line += s[k] == '\n';
+      k += s[k] ? 2 : 0;
+      continue;
+    }
+    if (s[k] == '"' || s[k] == '\'')
+    {
+      int end = skipLiteral(s, k);
+      for (; k < end; k++)
+        line += s[k] == '\n';
+      continue;
+    }
+    if (!isIdentifierChar(s[k]))
+    {
+      k++;
+      continue;
+    }
+    int start = k;
+    while (isIdentifierChar(s[k]))
+      k++;
+    if (start > 0 && isIdentifierChar(s[start - 1]))
+    {
+      continue;
+    }
+    char macro[16];
+    int length = k - start;
+    if (length >= (int)sizeof(macro))
+    {
+      continue;
+    }
+    memcpy(macro, s + start, length);
+    macro[length] = 0;
+    int isDebug = !strcmp(macro, "DEBUG") || (length == 6 && !strncmp(macro, "DEBUG", 5) && macro[5] >= '1' && macro[5] <= '4');
+    int isText = !strcmp(macro, "WARN") || !strcmp(macro, "MESSAGE");
+    if ((!isDebug && !isText) || s[k] != '(')
+    {
+      continue;
+    }
+    // split the arguments at the commas outside brackets and literals
+    int argStart[2] = {k + 1, 0};
+    int argEnd[2] = {0, 0};
+    int nArgs = 1;
+    int depth = 0;
+    int j = k + 1;
+    for (; s[j]; j++)
+    {
+      char c = s[j];
+      if (c == '"' || c == '\'')
+      {
+        j = skipLiteral(s, j) - 1;
+      }
+      else if (c == '(' || c == '[' || c == '{')
+      {
+        depth++;
+      }
+      else if ((c == ')' || c == ']' || c == '}') && depth > 0)
+      {
+        depth--;
+      }
+      else if (c == ')')
+      {
+        break;
+      }
+      else if (c == ',' && depth == 0)
+      {
+        if (nArgs < 2)
+        {
+          argEnd[0] = j;
+          argStart[1] = j + 1;
+        }
+        nArgs++;
+      }
+    }
+    if (!s[j])
+    {
+      break;
+    }
+    argEnd[nArgs == 1 ? 0 : 1] = j;
+    char text[MAX_LINE] = "";
+    char name[MAX_LINE];
+    if (isDebug && nArgs == 1)
+    {
+      stringizeArgument(s + argStart[0], argEnd[0] - argStart[0], name, sizeof(name));
+      addToken(macro, "", name, fileName, line);
+    }
+    else if (isText && nArgs == 2 && literalArgument(s + argStart[0], argEnd[0] - argStart[0], text, sizeof(text)))
+    {
+      stringizeArgument(s + argStart[1], argEnd[1] - argStart[1], name, sizeof(name));
+      addToken(macro, text, name, fileName, line);
+    }
+  }
+}
+
+int scanSources(const char *dirName)
+{
+  DIR *dir = opendir(dirName);
+  if (!dir)
+  {
+    return -1;
+  }
+  int files = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    const char *suffix = strrchr(entry->d_name, '.');
+    if (suffix && (!strcmp(suffix, ".h") || !strcmp(suffix, ".ino")))
+    {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/%s", dirName, entry->d_name);
+      scanSource(path, entry->d_name);
+      files++;
+    }
+  }
+  closedir(dir);
+  return files;
+}
+
+// the text of the macro for one line "$TTTTTTTT,millis,value"; returns 0 if the token is unknown
+int printToken(FILE *out, tokenEntry *entry, const char *millisText, const char *value, const char *eol, int withTime)
+{
+  char time[40] = "";
+  if (withTime)
+  {
+    snprintf(time, sizeof(time), "[%s ms] ", millisText);
+  }
+  if (!strcmp(entry->macro, "MESSAGE"))
+  {
+    fprintf(out, "%s-----------------------------------------%s", eol, eol);
+    fprintf(out, "%s%s for variable: %s = %s%s", time, entry->text, entry->name, value, eol);
+    fprintf(out, "-----------------------------------------%s%s", eol, eol);
+  }
+  else if (!strcmp(entry->macro, "WARN"))
+  {
+    fprintf(out, "%sWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW%s", eol, eol);
+    fprintf(out, "%sWARNING: %s for variable: %s = %s%s", time, entry->text, entry->name, value, eol);
+    fprintf(out, "WWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW%s%s", eol, eol);
+  }
+  else
+  {
+    fprintf(out, "%s%s: var: %s = %s%s", time, entry->macro, entry->name, value, eol);
+  }
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char sourceDir[1024];
+  const char *slash = strrchr(argv[0], '/');
+  if (slash)
+    snprintf(sourceDir, sizeof(sourceDir), "%.*s/..", (int)(slash - argv[0]), argv[0]);
+  else
+    snprintf(sourceDir, sizeof(sourceDir), "..");
+  int withTime = 1;
+  int list = 0;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+  {
+    if (!strcmp(argv[arg], "--source") && arg + 1 < argc)
+      snprintf(sourceDir, sizeof(sourceDir), "%s", argv[++arg]);
+    else if (!strcmp(argv[arg], "--no-time"))
+      withTime = 0;
+    else if (!strcmp(argv[arg], "--list"))
+      list = 1;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[arg]);
+      return 2;
+    }
+  }
+  if (argc - arg > 1)
+  {
+    fprintf(stderr, "usage: detokenize [--source DIR] [--no-time] [--list] [FILE]\n");
+    return 2;
+  }
+  int files = scanSources(sourceDir);
+  if (files <= 0)
+  {
+    fprintf(stderr, "no sketch sources in %s\n", sourceDir);
+    return 2;
+  }
+  if (list)
+  {
+    for (int k = 0; k < nTokens; k++)
+    {
+      printf("%08X %-28s %s|%s%s%s\n", tokens[k].token, tokens[k].where, tokens[k].macro, tokens[k].text,
+             tokens[k].text[0] ? "|" : "", tokens[k].name);
+    }
+    fprintf(stderr, "detokenize: %d tokens from %d files, %d collisions\n", nTokens, files, nCollisions);
+    return nCollisions > 0 ? 1 : 0;
+  }
+
+  FILE *in = stdin;
+  if (argc - arg == 1)
+  {
+    in = fopen(argv[arg], "rb");
+    if (!in)
+    {
+      fprintf(stderr, "cannot read %s\n", argv[arg]);
+      return 2;
+    }
+  }
+  unsigned long lines = 0;
+  unsigned long detokenized = 0;
+  unsigned long unknown = 0;
+  unsigned long truncated = 0;
+  char line[MAX_LINE];
+  while (fgets(line, sizeof(line), in))
+  {
+    lines++;
+    // the line ending is kept as it was (Serial.println writes "\r\n")
+    size_t length = strlen(line);
+    const char *eol = "";
+    if (length > 0 && line[length - 1] == '\n')
+    {
+      eol = (length > 1 && line[length - 2] == '\r') ? "\r\n" : "\n";
+    }
+    if (line[0] != '$')
+    {
+      fputs(line, stdout);
+      continue;
+    }
+    char *token = line + 1;
+    char *millisText = strchr(line, ',');
+    char *value = millisText ? strchr(millisText + 1, ',') : NULL;
+    if (!value || millisText - token != 8 || strspn(token, "0123456789ABCDEFabcdef") != 8 || !eol[0])
+    {
+      fprintf(stderr, "detokenize: line %lu: truncated record %.*s\n", lines, (int)strcspn(line, "\r\n"), line);
+      fputs(line, stdout);
+      truncated++;
+      continue;
+    }
+    *millisText++ = 0;
+    *value++ = 0;
+    value[strcspn(value, "\r\n")] = 0;
+    tokenEntry *entry = findToken((uint32_t)strtoul(token, NULL, 16));
+    if (!entry)
+    {
+      fprintf(stderr, "detokenize: line %lu: unknown token %s (not in the sources of %s)\n", lines, token, sourceDir);
+      printf("$%s,%s,%s%s", token, millisText, value, eol);
+      unknown++;
+      continue;
+    }
+    printToken(stdout, entry, millisText, value, eol, withTime);
+    detokenized++;
+  }
+  if (in != stdin)
+  {
+    fclose(in);
+  }
+  fprintf(stderr, "detokenize: %d tokens from %d files, %lu lines, %lu detokenized, %lu unknown tokens, %lu truncated records\n",
+          nTokens, files, lines, detokenized, unknown, truncated);
+  return unknown > 0 || truncated > 0 ? 1 : 0;
+}
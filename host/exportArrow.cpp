@@ -0,0 +1,917 @@
+// exportArrow.cpp
+// converts data files to one Apache Arrow IPC file (".arrow", the Feather v2 format), so analysis
+// tools (pyarrow, pandas, polars, DuckDB, R arrow) read typed columns with a schema instead of
+// parsing the CSV rows
+//
+//  the schema is the union of the header rows of the files, in the order the columns first appear:
+//    deviceCode  dictionary of the device codes (column one) with int32 indices
+//    count       int32 (column two)
+//    time        timestamp (ms, UTC): the unixTime column (ENABLE_ABSOLUTE_TIME), or the time the
+//                file was created (the RTC lines of the preamble) plus count times --interval-ms;
+//                null for a file of a logger without an RTC
+//    then each column of the header rows: int32 for a sample size (_n), float32 for the rest
+//    (_cv, _av, _sd, _dt, _re, _er as printSampleStatSpreadsheetToFile writes them)
+//  each stream column carries metadata: "stream" (the dataNickName), "stat" (cv, av, sd, n, dt, re
+//  or er) and, for cv, av, sd and re, "unit" (the dataUnits of the stream). the units are not in
+//  the data files: they are read from the DataNames and DataUnits rows of the table the logger
+//  writes to its log file (the log file next to each data file, "Alog000.txt" for "Adata000.csv"),
+//  or from --units FILE
+//
+//  "N//A", an empty or a missing field and a column the file does not have are nulls. rows whose
+//  count is not a number, and a last row without its line end (still being written), are skipped
+//
+//  the rows are written as record batches of --batch-rows rows (a chunk of each column per batch)
+//  across files, so memory is a batch whatever the size of the input; the files are mapped and
+//  scanned in place, and the pages already read are dropped as the scan goes. the device codes and
+//  columns come from a first pass over the header rows, so the dictionary and the schema are
+//  written once before the batches
+//
+//  build:  host/build.sh
+//  usage:  host/exportArrow [options] PATH...
+//    PATH is a data file, a day directory, an SD card directory or a directory of cards (see
+//    reprocess); compressed data files must be decoded with decodeData first
+//    --out FILE        (default data.arrow)
+//    --batch-rows N    rows in a record batch (default 65536)
+//    --interval-ms MS  time of one row of a file without a unixTime column (default SAMPLING_PERIOD)
+//    --units FILE      a file with DataNames and DataUnits rows (tab separated, as in the log file)
+//    --bench           convert with 1024, 4096 ... 262144 rows per batch (output discarded) and print
+//                      rows/s and MB/s of input
+
+#include "Arduino.h"
+#include "dataScan.h"
+#include "../deviceConfigGeneric.h"
+
+#define MAX_INPUTS 4096
+#define MAX_CODES 1024
+#define MAX_COLUMNS 256
+#define COLUMN_NAME_MAX 24
+#define UNIT_MAX 24
+#define UNITS_SCAN_BYTES (1L << 20) // how far into a log file to look for the DataUnits row
+
+// Arrow IPC constants (format/Schema.fbs, format/Message.fbs)
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY 2
+#define ARROW_HEADER_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOAT 3
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_UNIT_MILLISECOND 1
+
+// what a column of the export holds
+#define COLUMN_CODE 0  // deviceCode (dictionary index)
+#define COLUMN_COUNT 1 // count
+#define COLUMN_TIME 2  // time (ms)
+#define COLUMN_FLOAT 3
+#define COLUMN_INT 4
+#define FIRST_STREAM_COLUMN 3
+
+struct exportColumn
+{
+  char name[COLUMN_NAME_MAX];
+  char stream[COLUMN_NAME_MAX]; // dataNickName
+  char stat[4];                 // cv, av, sd, n, dt, re or er ("" if the name has no suffix)
+  int type;
+  int width;      // bytes of a value
+  uint8_t *valid; // validity bitmap of the batch
+  uint8_t *values;
+  long nValid; // valid values in the batch
+};
+
+exportColumn columns[MAX_COLUMNS];
+int nColumns = 0;
+char codes[MAX_CODES][DATA_SCAN_CODE_MAX];
+int nCodes = 0;
+char unitStream[MAX_COLUMNS][COLUMN_NAME_MAX];
+char unitName[MAX_COLUMNS][UNIT_MAX];
+int nUnits = 0;
+
+char inputs[MAX_INPUTS][DATA_SCAN_PATH_MAX];
+int nInputs = 0;
+
+long batchRows = 65536;
+unsigned long intervalMillis = SAMPLING_PERIOD;
+
+// ---------------------------------------------------------------------------------------------
+// schema
+
+int findColumn(const char *text, int length)
+{
+  for (int k = FIRST_STREAM_COLUMN; k < nColumns; k++)
+  {
+    if ((int)strlen(columns[k].name) == length && !memcmp(columns[k].name, text, length))
+      return k;
+  }
+  return -1;
+}
+
+int addColumn(const char *name, int type)
+{
+  if (nColumns == MAX_COLUMNS)
+  {
+    return -1;
+  }
+  exportColumn *c = &columns[nColumns];
+  snprintf(c->name, sizeof(c->name), "%s", name);
+  c->stream[0] = 0;
+  c->stat[0] = 0;
+  c->type = type;
+  c->width = type == COLUMN_TIME ? 8 : 4;
+  static const char *suffixes[] = {"_cv", "_av", "_sd", "_n", "_dt", "_re", "_er"};
+  for (int s = 0; type >= COLUMN_FLOAT && s < 7; s++)
+  {
+    int length = strlen(name) - strlen(suffixes[s]);
+    if (length > 0 && !strcmp(name + length, suffixes[s]))
+    {
+      snprintf(c->stream, sizeof(c->stream), "%.*s", length, name);
+      snprintf(c->stat, sizeof(c->stat), "%s", suffixes[s] + 1);
+      break;
+    }
+  }
+  return nColumns++;
+}
+
+int findCode(const char *code)
+{
+  for (int k = 0; k < nCodes; k++)
+  {
+    if (!strcmp(codes[k], code))
+      return k;
+  }
+  return -1;
+}
+
+const char *unitOf(const char *stream)
+{
+  for (int k = 0; k < nUnits; k++)
+  {
+    if (!strcmp(unitStream[k], stream))
+      return unitName[k];
+  }
+  return NULL;
+}
+
+// the units of the streams from the DataNames and DataUnits rows of a log file table
+void readUnits(const char *fileName)
+{
+  FILE *in = fopen(fileName, "r");
+  if (!in)
+  {
+    return;
+  }
+  static char names[8192];
+  static char units[8192];
+  names[0] = 0;
+  while (fgets(units, sizeof(units), in) && ftell(in) < UNITS_SCAN_BYTES)
+  {
+    if (!strncmp(units, "DataUnits", 9) && !strncmp(names, "DataNames", 9))
+    {
+      char *nameNext = names + 9;
+      char *unitNext = units + 9;
+      while (*nameNext == '\t' && *unitNext == '\t' && nUnits < MAX_COLUMNS)
+      {
+        nameNext++;
+        unitNext++;
+        int nameLength = strcspn(nameNext, "\t\r\n");
+        int unitLength = strcspn(unitNext, "\t\r\n");
+        snprintf(unitStream[nUnits], COLUMN_NAME_MAX, "%.*s", nameLength, nameNext);
+        snprintf(unitName[nUnits], UNIT_MAX, "%.*s", unitLength, unitNext);
+        if (!unitOf(unitStream[nUnits]))
+          nUnits++;
+        nameNext += nameLength;
+        unitNext += unitLength;
+      }
+      break;
+    }
+    memcpy(names, units, sizeof(names));
+  }
+  fclose(in);
+}
+
+// the log file written by the same logger as a data file: "data" -> "log", ".csv" -> ".txt"
+void readUnitsNextTo(const char *fileName)
+{
+  char logName[DATA_SCAN_PATH_MAX];
+  const char *base = baseName(fileName);
+  const char *data = strstr(base, "data");
+  int length = strlen(fileName);
+  if (!data || length < 4)
+  {
+    return;
+  }
+  snprintf(logName, sizeof(logName), "%.*slog%.*s.txt", (int)(data - fileName), fileName, (int)(fileName + length - 4 - data - 4), data + 4);
+  readUnits(logName);
+}
+
+// first pass: the device code and the header row of each file
+void addInput(const char *fileName)
+{
+  dataFileMap file;
+  const char *error = openDataFile(fileName, &file);
+  if (error)
+  {
+    fprintf(stderr, "exportArrow: %s: %s\n", fileName, error);
+    return;
+  }
+  if (nInputs == MAX_INPUTS || (findCode(file.deviceCode) < 0 && nCodes == MAX_CODES))
+  {
+    fprintf(stderr, "exportArrow: too many files, %s left out\n", fileName);
+    closeDataFile(&file);
+    return;
+  }
+  snprintf(inputs[nInputs++], DATA_SCAN_PATH_MAX, "%s", fileName);
+  if (findCode(file.deviceCode) < 0)
+    snprintf(codes[nCodes++], DATA_SCAN_CODE_MAX, "%s", file.deviceCode);
+  csvField field;
+  const char *p = nextField(file.header, file.headerEnd, &field); // device code
+  p = p ? nextField(p, file.headerEnd, &field) : NULL;            // count
+  while (p)
+  {
+    p = nextField(p, file.headerEnd, &field);
+    if (field.length == 0 || fieldIs(&field, "unixTime") || findColumn(field.text, field.length) >= 0)
+      continue;
+    char name[COLUMN_NAME_MAX];
+    snprintf(name, sizeof(name), "%.*s", field.length, field.text);
+    int length = strlen(name);
+    if (addColumn(name, length > 2 && !strcmp(name + length - 2, "_n") ? COLUMN_INT : COLUMN_FLOAT) < 0)
+    {
+      fprintf(stderr, "exportArrow: too many columns, %s left out\n", name);
+    }
+  }
+  closeDataFile(&file);
+  readUnitsNextTo(fileName);
+}
+
+// ---------------------------------------------------------------------------------------------
+// flatbuffers (the metadata of an Arrow IPC file), built back to front: an object's place is its
+// distance from the end of the buffer, and every object is built before the ones that point to it
+
+struct flatBuilder
+{
+  uint8_t *bytes;
+  size_t capacity;
+  size_t used; // the buffer is bytes[capacity - used, capacity)
+  int nFields; // of the table being built
+  uint32_t fieldAt[16];
+  uint32_t tableStart;
+};
+
+void fbBegin(flatBuilder *fb, size_t capacity)
+{
+  if (capacity > fb->capacity)
+  {
+    free(fb->bytes);
+    fb->bytes = (uint8_t *)malloc(capacity);
+    fb->capacity = capacity;
+  }
+  fb->used = 0;
+}
+
+const uint8_t *fbData(flatBuilder *fb)
+{
+  return fb->bytes + fb->capacity - fb->used;
+}
+
+void fbPrepend(flatBuilder *fb, const void *data, size_t length)
+{
+  if (fb->used + length > fb->capacity)
+  {
+    fprintf(stderr, "exportArrow: metadata too large\n");
+    exit(1);
+  }
+  fb->used += length;
+  memcpy(fb->bytes + fb->capacity - fb->used, data, length);
+}
+
+// pad so that the next size bytes end aligned to align
+void fbAlign(flatBuilder *fb, size_t size, size_t align)
+{
+  static const uint8_t zeros[8] = {0};
+  fbPrepend(fb, zeros, (align - (fb->used + size) % align) % align);
+}
+
+void fbScalar(flatBuilder *fb, uint64_t value, int size)
+{
+  uint8_t bytes[8];
+  for (int k = 0; k < size; k++)
+  {
+    bytes[k] = (uint8_t)(value >> (8 * k));
+  }
+  fbAlign(fb, size, size);
+  fbPrepend(fb, bytes, size);
+}
+
+// an offset to the object at target, from where it is written
+void fbOffset(flatBuilder *fb, uint32_t target)
+{
+  fbAlign(fb, 4, 4);
+  fbScalar(fb, fb->used + 4 - target, 4);
+}
+
+uint32_t fbString(flatBuilder *fb, const char *text)
+{
+  size_t length = strlen(text);
+  fbAlign(fb, length + 1, 4);
+  fbPrepend(fb, "", 1);
+  fbPrepend(fb, text, length);
+  fbScalar(fb, length, 4);
+  return fb->used;
+}
+
+uint32_t fbOffsetVector(flatBuilder *fb, uint32_t *targets, int n)
+{
+  for (int k = n - 1; k >= 0; k--)
+  {
+    fbOffset(fb, targets[k]);
+  }
+  fbScalar(fb, n, 4);
+  return fb->used;
+}
+
+// a vector of structs of 8 byte fields (FieldNode, Buffer and Block)
+uint32_t fbStructVector(flatBuilder *fb, const int64_t *words, int n, int structWords)
+{
+  fbAlign(fb, n * structWords * 8, 8);
+  fbPrepend(fb, words, n * structWords * 8); // little endian host
+  fbScalar(fb, n, 4);
+  return fb->used;
+}
+
+void fbStartTable(flatBuilder *fb)
+{
+  fb->nFields = 0;
+  memset(fb->fieldAt, 0, sizeof(fb->fieldAt));
+  fb->tableStart = fb->used;
+}
+
+void fbField(flatBuilder *fb, int id)
+{
+  fb->fieldAt[id] = fb->used;
+  if (id >= fb->nFields)
+    fb->nFields = id + 1;
+}
+
+void fbAddScalar(flatBuilder *fb, int id, uint64_t value, int size)
+{
+  fbScalar(fb, value, size);
+  fbField(fb, id);
+}
+
+void fbAddOffset(flatBuilder *fb, int id, uint32_t target)
+{
+  fbOffset(fb, target);
+  fbField(fb, id);
+}
+
+// the table and its vtable just before it
+uint32_t fbEndTable(flatBuilder *fb)
+{
+  int vtableBytes = 4 + 2 * fb->nFields;
+  fbScalar(fb, vtableBytes, 4); // the vtable is vtableBytes before the table
+  uint32_t table = fb->used;
+  for (int k = fb->nFields - 1; k >= 0; k--)
+  {
+    fbScalar(fb, fb->fieldAt[k] ? table - fb->fieldAt[k] : 0, 2);
+  }
+  fbScalar(fb, table - fb->tableStart, 2);
+  fbScalar(fb, vtableBytes, 2);
+  return table;
+}
+
+void fbFinish(flatBuilder *fb, uint32_t root)
+{
+  fbAlign(fb, 4, 8);
+  fbOffset(fb, root);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Arrow IPC file
+
+struct arrowWriter
+{
+  FILE *out;
+  int64_t offset; // bytes written
+  flatBuilder fb;
+  int64_t *blocks; // offset, metadata length, body length of each record batch
+  int nBlocks;
+  int maxBlocks;
+  int64_t dictionaryBlock[3];
+};
+
+void writeBytes(arrowWriter *w, const void *data, size_t length)
+{
+  if (length > 0 && fwrite(data, 1, length, w->out) != length)
+  {
+    fprintf(stderr, "exportArrow: cannot write\n");
+    exit(1);
+  }
+  w->offset += length;
+}
+
+void writePadding(arrowWriter *w)
+{
+  static const uint8_t zeros[8] = {0};
+  writeBytes(w, zeros, (8 - w->offset % 8) % 8);
+}
+
+uint32_t keyValue(flatBuilder *fb, const char *key, const char *value)
+{
+  uint32_t keyAt = fbString(fb, key);
+  uint32_t valueAt = fbString(fb, value);
+  fbStartTable(fb);
+  fbAddOffset(fb, 0, keyAt);
+  fbAddOffset(fb, 1, valueAt);
+  return fbEndTable(fb);
+}
+
+uint32_t intType(flatBuilder *fb, int bits)
+{
+  fbStartTable(fb);
+  fbAddScalar(fb, 0, bits, 4);
+  fbAddScalar(fb, 1, 1, 1); // signed
+  return fbEndTable(fb);
+}
+
+uint32_t schemaField(flatBuilder *fb, exportColumn *c)
+{
+  uint32_t nameAt = fbString(fb, c->name);
+  int typeId;
+  uint32_t typeAt;
+  uint32_t dictionaryAt = 0;
+  if (c->type == COLUMN_CODE)
+  {
+    uint32_t indexAt = intType(fb, 32);
+    fbStartTable(fb);
+    fbAddScalar(fb, 0, 0, 8); // dictionary id
+    fbAddOffset(fb, 1, indexAt);
+    dictionaryAt = fbEndTable(fb);
+    fbStartTable(fb);
+    typeAt = fbEndTable(fb);
+    typeId = ARROW_TYPE_UTF8;
+  }
+  else if (c->type == COLUMN_TIME)
+  {
+    uint32_t zoneAt = fbString(fb, "UTC");
+    fbStartTable(fb);
+    fbAddScalar(fb, 0, ARROW_UNIT_MILLISECOND, 2);
+    fbAddOffset(fb, 1, zoneAt);
+    typeAt = fbEndTable(fb);
+    typeId = ARROW_TYPE_TIMESTAMP;
+  }
+  else if (c->type == COLUMN_FLOAT)
+  {
+    fbStartTable(fb);
+    fbAddScalar(fb, 0, ARROW_PRECISION_SINGLE, 2);
+    typeAt = fbEndTable(fb);
+    typeId = ARROW_TYPE_FLOAT;
+  }
+  else
+  {
+    typeAt = intType(fb, 32);
+    typeId = ARROW_TYPE_INT;
+  }
+  uint32_t metadata[3];
+  int nMetadata = 0;
+  if (c->stream[0])
+  {
+    const char *unit = unitOf(c->stream);
+    metadata[nMetadata++] = keyValue(fb, "stream", c->stream);
+    metadata[nMetadata++] = keyValue(fb, "stat", c->stat);
+    if (unit && (!strcmp(c->stat, "cv") || !strcmp(c->stat, "av") || !strcmp(c->stat, "sd") || !strcmp(c->stat, "re")))
+      metadata[nMetadata++] = keyValue(fb, "unit", unit);
+  }
+  uint32_t metadataAt = nMetadata ? fbOffsetVector(fb, metadata, nMetadata) : 0;
+  uint32_t childrenAt = fbOffsetVector(fb, NULL, 0);
+  fbStartTable(fb);
+  fbAddOffset(fb, 0, nameAt);
+  fbAddScalar(fb, 1, c->type != COLUMN_CODE && c->type != COLUMN_COUNT, 1); // nullable
+  fbAddScalar(fb, 2, typeId, 1);
+  fbAddOffset(fb, 3, typeAt);
+  if (dictionaryAt)
+    fbAddOffset(fb, 4, dictionaryAt);
+  fbAddOffset(fb, 5, childrenAt);
+  if (metadataAt)
+    fbAddOffset(fb, 6, metadataAt);
+  return fbEndTable(fb);
+}
+
+uint32_t schemaTable(flatBuilder *fb)
+{
+  uint32_t fields[MAX_COLUMNS];
+  for (int k = 0; k < nColumns; k++)
+  {
+    fields[k] = schemaField(fb, &columns[k]);
+  }
+  uint32_t fieldsAt = fbOffsetVector(fb, fields, nColumns);
+  char interval[16];
+  snprintf(interval, sizeof(interval), "%lu", intervalMillis);
+  uint32_t metadata[1] = {keyValue(fb, "interval_ms", interval)};
+  uint32_t metadataAt = fbOffsetVector(fb, metadata, 1);
+  fbStartTable(fb);
+  fbAddScalar(fb, 0, 0, 2); // little endian
+  fbAddOffset(fb, 1, fieldsAt);
+  fbAddOffset(fb, 2, metadataAt);
+  return fbEndTable(fb);
+}
+
+size_t metadataBytes(int nBlocks)
+{
+  return 4096 + nColumns * 512 + nUnits * 64 + nBlocks * 24;
+}
+
+// an encapsulated message: continuation marker, metadata length, Message flatbuffer (its length a
+// multiple of 8, so the body that follows is aligned); returns the bytes before the body
+int64_t writeMessage(arrowWriter *w, int headerType, uint32_t header, int64_t bodyLength)
+{
+  flatBuilder *fb = &w->fb;
+  fbStartTable(fb);
+  fbAddScalar(fb, 0, ARROW_METADATA_V5, 2);
+  fbAddScalar(fb, 1, headerType, 1);
+  fbAddOffset(fb, 2, header);
+  fbAddScalar(fb, 3, bodyLength, 8);
+  fbFinish(fb, fbEndTable(fb));
+  uint32_t prefix[2] = {0xFFFFFFFF, (uint32_t)fb->used};
+  writeBytes(w, prefix, 8);
+  writeBytes(w, fbData(fb), fb->used);
+  return 8 + fb->used;
+}
+
+// a RecordBatch table of rows rows for the nodes (length, nulls) and buffers (offset, length)
+uint32_t batchTable(flatBuilder *fb, int64_t rows, int64_t *nodes, int nNodes, int64_t *buffers, int nBuffers)
+{
+  uint32_t nodesAt = fbStructVector(fb, nodes, nNodes, 2);
+  uint32_t buffersAt = fbStructVector(fb, buffers, nBuffers, 2);
+  fbStartTable(fb);
+  fbAddScalar(fb, 0, rows, 8);
+  fbAddOffset(fb, 1, nodesAt);
+  fbAddOffset(fb, 2, buffersAt);
+  return fbEndTable(fb);
+}
+
+void beginArrow(arrowWriter *w, FILE *out)
+{
+  w->out = out;
+  w->offset = 0;
+  w->nBlocks = 0;
+  writeBytes(w, ARROW_MAGIC "\0\0", 8);
+
+  fbBegin(&w->fb, metadataBytes(0));
+  writeMessage(w, ARROW_HEADER_SCHEMA, schemaTable(&w->fb), 0);
+
+  // the dictionary of device codes: utf8 offsets and characters
+  int64_t characters = 0;
+  for (int k = 0; k < nCodes; k++)
+  {
+    characters += strlen(codes[k]);
+  }
+  int64_t offsetBytes = (nCodes + 1) * 4;
+  int64_t paddedOffsets = (offsetBytes + 7) / 8 * 8;
+  int64_t nodes[2] = {nCodes, 0};
+  int64_t buffers[6] = {0, 0, 0, offsetBytes, paddedOffsets, characters};
+  int64_t bodyLength = paddedOffsets + (characters + 7) / 8 * 8;
+  fbBegin(&w->fb, metadataBytes(0));
+  uint32_t dataAt = batchTable(&w->fb, nCodes, nodes, 1, buffers, 3);
+  fbStartTable(&w->fb);
+  fbAddScalar(&w->fb, 0, 0, 8); // id
+  fbAddOffset(&w->fb, 1, dataAt);
+  uint32_t dictionaryAt = fbEndTable(&w->fb);
+  w->dictionaryBlock[0] = w->offset;
+  w->dictionaryBlock[1] = writeMessage(w, ARROW_HEADER_DICTIONARY, dictionaryAt, bodyLength);
+  w->dictionaryBlock[2] = bodyLength;
+  int32_t position = 0;
+  for (int k = 0; k <= nCodes; k++)
+  {
+    writeBytes(w, &position, 4);
+    if (k < nCodes)
+      position += strlen(codes[k]);
+  }
+  writePadding(w);
+  for (int k = 0; k < nCodes; k++)
+  {
+    writeBytes(w, codes[k], strlen(codes[k]));
+  }
+  writePadding(w);
+}
+
+// write the rows of the batch as a record batch; each column is a validity bitmap (left out when
+// there are no nulls) and its values
+void writeBatch(arrowWriter *w, long rows)
+{
+  static int64_t nodes[2 * MAX_COLUMNS];
+  static int64_t buffers[4 * MAX_COLUMNS];
+  int64_t bodyLength = 0;
+  for (int k = 0; k < nColumns; k++)
+  {
+    exportColumn *c = &columns[k];
+    int64_t validBytes = c->nValid < rows ? (rows + 7) / 8 : 0;
+    int64_t valueBytes = rows * c->width;
+    nodes[2 * k] = rows;
+    nodes[2 * k + 1] = rows - c->nValid;
+    buffers[4 * k] = bodyLength;
+    buffers[4 * k + 1] = validBytes;
+    bodyLength += (validBytes + 7) / 8 * 8;
+    buffers[4 * k + 2] = bodyLength;
+    buffers[4 * k + 3] = valueBytes;
+    bodyLength += (valueBytes + 7) / 8 * 8;
+  }
+  if (w->nBlocks == w->maxBlocks)
+  {
+    w->maxBlocks = w->maxBlocks ? 2 * w->maxBlocks : 256;
+    w->blocks = (int64_t *)realloc(w->blocks, w->maxBlocks * 3 * sizeof(int64_t));
+  }
+  int64_t *block = &w->blocks[3 * w->nBlocks++];
+  block[0] = w->offset;
+  fbBegin(&w->fb, metadataBytes(0));
+  block[1] = writeMessage(w, ARROW_HEADER_BATCH, batchTable(&w->fb, rows, nodes, nColumns, buffers, 2 * nColumns), bodyLength);
+  block[2] = bodyLength;
+  for (int k = 0; k < nColumns; k++)
+  {
+    exportColumn *c = &columns[k];
+    writeBytes(w, c->valid, buffers[4 * k + 1]);
+    writePadding(w);
+    writeBytes(w, c->values, buffers[4 * k + 3]);
+    writePadding(w);
+  }
+}
+
+// end of stream marker, then the footer: the schema again and where each batch is
+void endArrow(arrowWriter *w)
+{
+  uint32_t endOfStream[2] = {0xFFFFFFFF, 0};
+  writeBytes(w, endOfStream, 8);
+  flatBuilder *fb = &w->fb;
+  fbBegin(fb, metadataBytes(w->nBlocks));
+  uint32_t schemaAt = schemaTable(fb);
+  // Block: offset (int64), metadata length (int32 and 4 bytes of padding), body length (int64)
+  uint32_t dictionariesAt = fbStructVector(fb, w->dictionaryBlock, 1, 3);
+  uint32_t batchesAt = fbStructVector(fb, w->blocks, w->nBlocks, 3);
+  fbStartTable(fb);
+  fbAddScalar(fb, 0, ARROW_METADATA_V5, 2);
+  fbAddOffset(fb, 1, schemaAt);
+  fbAddOffset(fb, 2, dictionariesAt);
+  fbAddOffset(fb, 3, batchesAt);
+  fbFinish(fb, fbEndTable(fb));
+  writeBytes(w, fbData(fb), fb->used);
+  uint32_t footerLength = fb->used;
+  writeBytes(w, &footerLength, 4);
+  writeBytes(w, ARROW_MAGIC, 6);
+}
+
+// ---------------------------------------------------------------------------------------------
+// conversion
+
+long batchUsed = 0;
+long rowsOut = 0;
+long rowsSkipped = 0;
+int64_t bytesIn = 0;
+
+void clearBatch()
+{
+  for (int k = 0; k < nColumns; k++)
+  {
+    memset(columns[k].valid, 0, (batchRows + 7) / 8);
+    memset(columns[k].values, 0, batchRows * columns[k].width);
+    columns[k].nValid = 0;
+  }
+  batchUsed = 0;
+}
+
+void setValue(exportColumn *c, long row, const void *value)
+{
+  memcpy(c->values + row * c->width, value, c->width);
+  c->valid[row >> 3] |= 1 << (row & 7);
+  c->nValid++;
+}
+
+// the rows of one data file into the batches
+void convertFile(arrowWriter *w, const char *fileName)
+{
+  dataFileMap file;
+  if (openDataFile(fileName, &file))
+  {
+    return;
+  }
+  int32_t code = findCode(file.deviceCode);
+  long created = dataFileCreated(&file);
+
+  // export column of each column of the header row (-1 = none)
+  static int target[MAX_COLUMNS];
+  int nFileColumns = 0;
+  int hasTime = 0;
+  csvField field;
+  const char *p = nextField(file.header, file.headerEnd, &field);
+  p = p ? nextField(p, file.headerEnd, &field) : NULL;
+  while (p && nFileColumns < MAX_COLUMNS)
+  {
+    p = nextField(p, file.headerEnd, &field);
+    target[nFileColumns] = fieldIs(&field, "unixTime") ? COLUMN_TIME : findColumn(field.text, field.length);
+    hasTime |= target[nFileColumns] == COLUMN_TIME;
+    nFileColumns++;
+  }
+
+  const char *released = file.map;
+  for (p = file.headerEnd + 1; p < file.end;)
+  {
+    const char *lineEnd = lineEndOf(p, file.end);
+    if (lineEnd == file.end)
+    {
+      break; // a row still being written
+    }
+    const char *next = nextField(p, lineEnd, &field); // device code
+    double count;
+    if (!next || !nextField(next, lineEnd, &field) || !scanDouble(&field, &count) || count != (int32_t)count)
+    {
+      if (lineEnd > p + 1)
+        rowsSkipped++;
+      p = lineEnd + 1;
+      continue;
+    }
+    next = nextField(next, lineEnd, &field);
+    long row = batchUsed;
+    int32_t count32 = (int32_t)count;
+    setValue(&columns[COLUMN_CODE], row, &code);
+    setValue(&columns[COLUMN_COUNT], row, &count32);
+    if (!hasTime && created >= 0)
+    {
+      int64_t time = (int64_t)created * 1000 + (int64_t)count32 * intervalMillis;
+      setValue(&columns[COLUMN_TIME], row, &time);
+    }
+    for (int k = 0; next && k < nFileColumns; k++)
+    {
+      next = nextField(next, lineEnd, &field);
+      double value;
+      if (target[k] < 0 || !scanDouble(&field, &value))
+        continue;
+      exportColumn *c = &columns[target[k]];
+      if (c->type == COLUMN_FLOAT)
+      {
+        float single = (float)value;
+        setValue(c, row, &single);
+      }
+      else if (c->type == COLUMN_INT && value == (int32_t)value)
+      {
+        int32_t integer = (int32_t)value;
+        setValue(c, row, &integer);
+      }
+      else if (c->type == COLUMN_TIME)
+      {
+        int64_t time = llround(value * 1000.);
+        setValue(c, row, &time);
+      }
+    }
+    rowsOut++;
+    if (++batchUsed == batchRows)
+    {
+      writeBatch(w, batchUsed);
+      clearBatch();
+    }
+    p = lineEnd + 1;
+
+    // drop the pages already read, so a file of many GB does not stay resident
+    if (p - released >= DATA_SCAN_WINDOW)
+    {
+      long page = sysconf(_SC_PAGESIZE);
+      size_t length = (p - released) / page * page;
+      madvise((void *)released, length, MADV_DONTNEED);
+      released += length;
+    }
+  }
+  bytesIn += file.end - file.map;
+  closeDataFile(&file);
+}
+
+double elapsedSeconds(struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// convert every input to out; returns the bytes written
+int64_t convert(FILE *out)
+{
+  static arrowWriter w;
+  for (int k = 0; k < nColumns; k++)
+  {
+    free(columns[k].valid);
+    free(columns[k].values);
+    columns[k].valid = (uint8_t *)malloc((batchRows + 7) / 8);
+    columns[k].values = (uint8_t *)malloc(batchRows * columns[k].width);
+  }
+  rowsOut = 0;
+  rowsSkipped = 0;
+  bytesIn = 0;
+  clearBatch();
+  beginArrow(&w, out);
+  for (int k = 0; k < nInputs; k++)
+  {
+    convertFile(&w, inputs[k]);
+  }
+  if (batchUsed > 0)
+  {
+    writeBatch(&w, batchUsed);
+  }
+  endArrow(&w);
+  return w.offset;
+}
+
+int main(int argc, char **argv)
+{
+  const char *outName = "data.arrow";
+  int bench = 0;
+  const char *paths[64];
+  int nPaths = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2))
+    {
+      if (nPaths < 64)
+        paths[nPaths++] = arg;
+      continue;
+    }
+    if (!strcmp(arg, "--bench"))
+    {
+      bench = 1;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[++i] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    if (!strcmp(arg, "--out"))
+      outName = value;
+    else if (!strcmp(arg, "--batch-rows"))
+      batchRows = atol(value) > 0 ? atol(value) : 65536;
+    else if (!strcmp(arg, "--interval-ms"))
+      intervalMillis = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--units"))
+      readUnits(value);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 2;
+    }
+  }
+  if (nPaths == 0)
+  {
+    fprintf(stderr, "usage: exportArrow [options] PATH...\n");
+    return 2;
+  }
+
+  addColumn("deviceCode", COLUMN_CODE);
+  addColumn("count", COLUMN_COUNT);
+  addColumn("time", COLUMN_TIME);
+  for (int k = 0; k < nPaths; k++)
+  {
+    listDataFiles(paths[k], addInput);
+  }
+  if (nInputs == 0)
+  {
+    fprintf(stderr, "exportArrow: no data files\n");
+    return 1;
+  }
+
+  if (bench)
+  {
+    FILE *out = fopen("/dev/null", "wb");
+    printf("batch_rows\trows\tMB_in\tMB_out\tbatch_MB\tseconds\tMrows/s\tMB/s\n");
+    for (batchRows = 1024; batchRows <= 262144; batchRows *= 4)
+    {
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      int64_t bytesOut = convert(out);
+      double seconds = elapsedSeconds(&start);
+      double batchBytes = 0.;
+      for (int k = 0; k < nColumns; k++)
+      {
+        batchBytes += (batchRows + 7) / 8 + batchRows * columns[k].width;
+      }
+      printf("%ld\t%ld\t%.1f\t%.1f\t%.2f\t%.3f\t%.2f\t%.1f\n", batchRows, rowsOut, bytesIn / 1e6, bytesOut / 1e6, batchBytes / 1e6, seconds,
+             rowsOut / seconds / 1e6, bytesIn / seconds / 1e6);
+    }
+    fclose(out);
+    return 0;
+  }
+
+  FILE *out = fopen(outName, "wb");
+  if (!out)
+  {
+    fprintf(stderr, "exportArrow: cannot write %s\n", outName);
+    return 1;
+  }
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int64_t bytesOut = convert(out);
+  fclose(out);
+  double seconds = elapsedSeconds(&start);
+  fprintf(stderr, "exportArrow: %d files, %d devices, %ld rows (%ld skipped), %d columns, %.1f MB -> %.1f MB in %.3f s (%.1f MB/s)\n", nInputs,
+          nCodes, rowsOut, rowsSkipped, nColumns, bytesIn / 1e6, bytesOut / 1e6, seconds, bytesIn / seconds / 1e6);
+  return 0;
+}
@@ -0,0 +1,226 @@
+// hostLogger.cpp
+// runs the unchanged logger sketch (setup() then loop()) on Linux with the host stand-ins
+// for the Arduino core, SD card, RTC and sensors. time is virtual, so hours of logging take
+// seconds and repeated runs with the same options produce the same files
+//
+//  the stand-ins for Arduino.h, SD.h, RTClib.h and the sensor libraries live in this directory;
+//  the Arduino IDE only compiles the sketch folder and src/, so nothing here ends up on the board
+//
+//  build:  host/build.sh            (or see the g++ line in that script)
+//  usage:  host/hostLogger [options]
+//    --seconds S     virtual time to run (default 60)
+//    --sd DIR        directory used as the SD card (default "sdcard")
+//    --seed N        seed for random() (default 12345)
+//    --gpio FILE     script of pin changes: "timeMs pin value" per line
+//    --serial FILE   write Serial output to FILE ("-" = stdout, default /dev/null)
+//    --serial-in FILE  bytes sent to the board's Serial (e.g. telemetry requests)
+//    --baud N        model the UART: Serial writes wait for room in the TX buffer (default 0 = no limit)
+//    --serial-tx-buffer N  size of the modelled TX buffer in bytes (default 64)
+//    --loop-us N     virtual time charged for each pass through loop() (default 1000)
+//    --sd-open-us N  virtual time charged for each SD open and close (default 0)
+//    --sd-write-us N virtual time charged for each SD write (default 0)
+//    --sd-cluster-us N virtual time charged for each cluster a write allocates (default 0)
+//    --sensor-us N   virtual time charged for each sensor read (default 0)
+//    --rtc-drift PPM rate error of the RTC relative to the virtual clock (default 0)
+//    --no-sd         make SD.begin() fail
+//    --sd-remove S   remove the SD card (opens and SD.begin() fail) at S seconds of virtual time
+//    --sd-insert S   put the SD card back at S seconds of virtual time
+//    --sim-seed N    seed of the simulated signals (with ENABLE_SIMULATED_DATA, default SIMULATION_SEED)
+//    --sim-trace FILE,COLUMN  replay COLUMN of the data file FILE as stream tSim (FILE is copied
+//                    to the card as SIM_TRACE_FILE; with ENABLE_SIMULATED_DATA)
+
+#include "Arduino.h"
+#include "SD.h"
+
+// prototypes normally generated by the Arduino IDE
+void pixelSet(int pixMode, int pixLevel);
+
+#include "../LoggerStatisticsVersion2.ino"
+
+int main(int argc, char **argv)
+{
+  double seconds = 60.;
+  unsigned long loopMicros = 1000;
+  const char *serialName = "/dev/null";
+  double sdRemoveSeconds = -1.;
+  double sdInsertSeconds = -1.;
+#ifdef ENABLE_SIMULATED_DATA
+  const char *traceArg = NULL;
+#endif
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!strcmp(arg, "--no-sd"))
+    {
+      hostSdFailBegin = 1;
+      continue;
+    }
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    if (!strcmp(arg, "--seconds"))
+      seconds = atof(value);
+    else if (!strcmp(arg, "--sd"))
+      snprintf(hostSdRoot, sizeof(hostSdRoot), "%s", value);
+    else if (!strcmp(arg, "--seed"))
+      randomSeed(strtoul(value, NULL, 10));
+    else if (!strcmp(arg, "--gpio"))
+    {
+      if (hostLoadGpioScript(value) < 0)
+      {
+        fprintf(stderr, "cannot read gpio script %s\n", value);
+        return 2;
+      }
+    }
+    else if (!strcmp(arg, "--serial"))
+      serialName = value;
+    else if (!strcmp(arg, "--serial-in"))
+    {
+      FILE *serialIn = fopen(value, "rb");
+      if (!serialIn)
+      {
+        fprintf(stderr, "cannot read %s\n", value);
+        return 2;
+      }
+      hostSerialInput(serialIn);
+    }
+    else if (!strcmp(arg, "--baud"))
+      hostSerialBaud = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--serial-tx-buffer"))
+      hostSerialTxBufferBytes = atoi(value);
+    else if (!strcmp(arg, "--loop-us"))
+      loopMicros = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--sd-open-us"))
+      hostSdOpenMicros = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--sd-write-us"))
+      hostSdWriteMicros = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--sd-cluster-us"))
+      hostSdClusterMicros = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--rtc-drift"))
+      hostRtcDriftPPM = atof(value);
+    else if (!strcmp(arg, "--sd-remove"))
+      sdRemoveSeconds = atof(value);
+    else if (!strcmp(arg, "--sd-insert"))
+      sdInsertSeconds = atof(value);
+    else if (!strcmp(arg, "--sensor-us"))
+      hostSensorReadMicros = strtoul(value, NULL, 10);
+#ifdef ENABLE_SIMULATED_DATA
+    else if (!strcmp(arg, "--sim-seed"))
+      simulationSeed = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--sim-trace"))
+      traceArg = value;
+#endif
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 2;
+    }
+    i++;
+  }
+
+#ifdef ENABLE_SIMULATED_DATA
+  if (traceArg)
+  {
+    // the sketch reads the trace from the card
+    const char *comma = strrchr(traceArg, ',');
+    char traceName[512];
+    snprintf(traceName, sizeof(traceName), "%.*s", comma ? (int)(comma - traceArg) : 0, traceArg);
+    if (!comma || hostSdCopyIn(traceName, SIM_TRACE_FILE) < 0)
+    {
+      fprintf(stderr, "cannot use %s as a trace (FILE,COLUMN)\n", traceArg);
+      return 2;
+    }
+    snprintf(simTraceColumn, sizeof(simTraceColumn), "%s", comma + 1);
+  }
+#endif
+
+  if (!strcmp(serialName, "-"))
+  {
+    hostSerialOutput(stdout);
+  }
+  else
+  {
+    FILE *serialFile = fopen(serialName, "w");
+    if (!serialFile)
+    {
+      fprintf(stderr, "cannot open %s\n", serialName);
+      return 2;
+    }
+    hostSerialOutput(serialFile);
+  }
+
+  // buttons and switches read HIGH (released) until the script changes them
+  for (int pin = 0; pin < HOST_MAX_PINS; pin++)
+  {
+    hostSetPin(pin, HIGH);
+  }
+
+  struct timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  setup();
+  uint64_t endMicros = (uint64_t)(seconds * 1000000.);
+  unsigned long passes = 0;
+  uint64_t sdRemoveMicros = sdRemoveSeconds >= 0. ? (uint64_t)(sdRemoveSeconds * 1000000.) : UINT64_MAX;
+  uint64_t sdInsertMicros = sdInsertSeconds >= 0. ? (uint64_t)(sdInsertSeconds * 1000000.) : UINT64_MAX;
+  while (hostClockMicros < endMicros)
+  {
+    if (hostClockMicros >= sdRemoveMicros)
+    {
+      hostSdFailBegin = hostSdFailOpen = 1;
+      sdRemoveMicros = UINT64_MAX;
+    }
+    if (hostClockMicros >= sdInsertMicros)
+    {
+      hostSdFailBegin = hostSdFailOpen = 0;
+      sdInsertMicros = UINT64_MAX;
+    }
+    loop();
+    hostAdvanceMicros(loopMicros);
+    passes++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  double wallSeconds = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+  fprintf(stderr, "hostLogger: %lu passes, %.1f s virtual in %.3f s wall (%.0fx real time), %lu SD bytes, %lu SD opens, %lu clusters allocated, %.1f ms of card time\n",
+          passes, ((double)hostClockMicros) / 1e6, wallSeconds, ((double)hostClockMicros) / 1e6 / wallSeconds,
+          hostSdBytesWritten, hostSdOpenCount, hostSdClustersAllocated, hostSdMicros / 1000.);
+  if (hostI2CTransactions > 0)
+  {
+    fprintf(stderr, "hostLogger: I2C bus %lu transactions, %.0f us on the bus\n", hostI2CTransactions, hostI2CMicros);
+  }
+  fprintf(stderr, "hostLogger: serial %lu bytes (%.0f bytes/s), %.1f ms blocked in Serial.write (longest %.1f ms)\n",
+          Serial.bytesWritten, Serial.bytesWritten / (((double)hostClockMicros) / 1e6),
+          hostSerialBlockedMicros / 1000., hostSerialWorstBlock / 1000.);
+#ifdef ENABLE_GROUP_COMMIT
+  fprintf(stderr, "hostLogger: group commit %lu syncs\n", logCommits);
+#endif
+#ifdef ENABLE_COMPRESSED_DATA
+  fprintf(stderr, "hostLogger: compressed data %lu rows (%lu keyframes), %.1f bytes/row, %.1f%% of raw values, %.2f us/row to encode\n",
+          dataCodecRows, dataCodecKeyframes, dataCodecRows > 0 ? (double)dataCodecBytes / dataCodecRows : 0.,
+          dataCodecRawBytes > 0 ? 100. * dataCodecBytes / dataCodecRawBytes : 0., dataCodecRows > 0 ? dataCodecMicros / dataCodecRows : 0.);
+#endif
+#ifdef ENABLE_EVENT_QUEUE
+  fprintf(stderr, "hostLogger: event queue %lu changes, %lu written in %lu writes, %lu merged, %lu bounces not written, %lu dropped, high %d of %d, %.1f ms writing\n",
+          eventQueueQueued, eventQueueWritten, eventQueueBatches, eventQueueCoalesced, eventQueueCancelled, eventQueueDropped,
+          eventQueueHigh, EVENT_QUEUE_RECORDS, eventQueueMicros / 1000.);
+#endif
+#ifdef ENABLE_TIME_INDEX
+  fprintf(stderr, "hostLogger: time index %lu entries in %lu writes, %lu rows not written, %lu entries dropped, %lu failed opens\n",
+          timeIndexEntries, timeIndexWrites, timeIndexMissed, timeIndexDropped, timeIndexFailures);
+#endif
+#ifdef ENABLE_DEFERRED_DEBUG
+  fprintf(stderr, "hostLogger: debug log %lu records, %lu written, %lu dropped, high %u of %d bytes, %.1f ms writing\n",
+          debugLogRecorded, debugLogWritten, debugLogDropped, debugLogHigh, DEBUG_LOG_BYTES, debugLogMicros / 1000.);
+#endif
+#ifdef ENABLE_OUTPUT_QUEUE
+  fprintf(stderr, "hostLogger: output queue %lu queued, %lu written, %lu dropped (%lu bytes), %lu blocked, high %d of %d bytes, %lu card failures, %lu recoveries\n",
+          sdQueue.queued, sdQueue.written, sdQueue.dropped, sdQueue.droppedBytes, sdQueue.blocked, sdQueue.highWater,
+          OUTPUT_QUEUE_BYTES, sdQueue.sdFailures, sdQueue.recoveries);
+#endif
+  return 0;
+}
@@ -0,0 +1,946 @@
+// pyramid.cpp
+// summary pyramid next to a data file, so the statistics of a stream over any time range ("mean, SD
+// and max of Az between t1 and t2" over weeks of data) are found from O(log n) blocks of the
+// pyramid and at most two blocks of rows, instead of by reading every row
+//
+//  the rows of a data file are taken --base-rows at a time (a base block). level 0 of the pyramid
+//  holds the statistics of each base block and level k those of 2^k base blocks: for every stream
+//  n, mean, M2 (sum of squared deviations from the mean) and the smallest and largest row value.
+//  they merge exactly (the pairwise update of Chan, Golub and LeVeque, as in aggregate), so a range
+//  is the merge of the largest aligned blocks inside it and of the rows at its two ends
+//
+//  a row counts as in aggregate: n from its _n column (1 without one), its mean from _av (or _cv)
+//  and its spread from _sd. min and max are of the row values (a row does not keep the extremes of
+//  its samples). a row's time is its unixTime column, or the time the file was created (0 without
+//  an RTC) plus its count times --interval-ms; the rows of a file are taken to be in time order
+//
+//  the pyramid (FILE with the suffix .pyr) is append only. when base block i closes, the blocks it
+//  closes are written, level 0 first, so block j of level k (closed by base block i = (j + 1) 2^k - 1)
+//  is record 2i - popcount(i) + k and is read with one seek. running pyramid again on a file that
+//  has grown adds the blocks closed since; the rows after the last base block are read from the
+//  data file. a pyramid whose data file no longer matches it is rebuilt
+//    header  "KPYR", version, base rows, streams, record size, 0 (uint32), hash of the header row
+//            of the data file (uint64), the name of each stream (16 bytes)
+//    record  first and last time (double), offset of the first row and past the last row in the
+//            data file (uint64), first row, rows, level, 0 (uint32), then for each stream n, mean,
+//            M2 (double), min, max (float)
+//
+//  build:  host/build.sh
+//  usage:  host/pyramid [options] PATH...
+//    PATH is a data file, a day directory, an SD card directory or a directory of cards (see
+//    reprocess); the pyramid of each data file is built, or brought up to date
+//    --base-rows N     rows in a base block (default 16)
+//    --interval-ms MS  time of one row of a file without a unixTime column (default SAMPLING_PERIOD)
+//  queries (on the first data file; its pyramid is brought up to date first):
+//    --from S --to S   print n, mean, sd, min and max of each stream over the rows with time in [S, S]
+//    --stream NAME     only this stream (repeat for more)
+//    --brute           read every row of the range from the data file instead (to check the pyramid)
+//    --bench N         time N random queries of --span-s seconds (default 3600) with the pyramid and
+//                      by reading the rows, and print the latency and the largest difference
+//    --seed N          (default 1)
+
+#include "Arduino.h"
+#include <float.h>
+#include "dataScan.h"
+#include "../deviceConfigGeneric.h"
+
+#define PYRAMID_MAGIC "KPYR"
+#define PYRAMID_VERSION 1
+#define PYRAMID_HEAD_BYTES 32
+#define RECORD_HEAD_BYTES 48
+#define STREAM_BYTES 32
+#define MAX_STREAMS 128
+#define MAX_COLUMNS 256
+#define MAX_LEVELS 40
+#define STREAM_NAME_MAX 16
+
+// what a column of a data file holds (as in aggregate)
+#define ROLE_NONE 0
+#define ROLE_AVERAGE 1 // _av, or _cv of a stream without _av
+#define ROLE_SPREAD 2  // _sd
+#define ROLE_COUNT 3   // _n
+#define ROLE_TIME 4    // unixTime
+
+// n, mean, sum of squared deviations from the mean, smallest and largest value of a set of rows
+struct rangeStat
+{
+  double n;
+  double mean;
+  double m2;
+  float min;
+  float max;
+};
+
+struct pyramidBlock
+{
+  double firstTime;
+  double lastTime;
+  uint64_t firstOffset; // of the first row in the data file
+  uint64_t endOffset;   // just past the last row
+  uint32_t firstRow;    // rows of the data file before it
+  uint32_t rows;
+  rangeStat stats[MAX_STREAMS];
+};
+
+// a data file and its pyramid
+struct pyramidFile
+{
+  char name[DATA_SCAN_PATH_MAX];
+  char pyramidName[DATA_SCAN_PATH_MAX];
+  dataFileMap data;
+  long created;
+  int nStreams;
+  char streamName[MAX_STREAMS][STREAM_NAME_MAX];
+  uint8_t role[MAX_COLUMNS];
+  uint8_t slot[MAX_COLUMNS];
+  uint64_t headerHash;
+  int recordBytes;
+  long headBytes; // bytes before the first record
+  int fd;         // pyramid open for reading (-1 = none)
+  uint32_t nBase; // base blocks written
+};
+
+// the values of one row
+struct rowValues
+{
+  double time;
+  double mean[MAX_STREAMS];
+  double spread[MAX_STREAMS];
+  double count[MAX_STREAMS];
+  uint8_t have[MAX_STREAMS];
+};
+
+int baseRows = 16;
+unsigned long intervalMillis = SAMPLING_PERIOD;
+
+void clearRangeStats(rangeStat *stats, int nStreams)
+{
+  for (int s = 0; s < nStreams; s++)
+  {
+    stats[s].n = 0.;
+    stats[s].mean = 0.;
+    stats[s].m2 = 0.;
+    stats[s].min = FLT_MAX;
+    stats[s].max = -FLT_MAX;
+  }
+}
+
+// add a set of n values with this mean, m2, min and max (the pairwise update)
+void mergeRangeStat(rangeStat *into, double n, double mean, double m2, float min, float max)
+{
+  if (n <= 0.)
+  {
+    return;
+  }
+  double total = into->n + n;
+  double delta = mean - into->mean;
+  into->mean += delta * n / total;
+  into->m2 += m2 + delta * delta * into->n * n / total;
+  into->n = total;
+  if (min < into->min)
+    into->min = min;
+  if (max > into->max)
+    into->max = max;
+}
+
+void mergeBlock(pyramidBlock *into, pyramidBlock *from, int nStreams)
+{
+  if (from->rows == 0)
+  {
+    return;
+  }
+  if (into->rows == 0)
+  {
+    into->firstTime = from->firstTime;
+    into->firstOffset = from->firstOffset;
+    into->firstRow = from->firstRow;
+  }
+  into->lastTime = from->lastTime;
+  into->endOffset = from->endOffset;
+  into->rows += from->rows;
+  for (int s = 0; s < nStreams; s++)
+  {
+    mergeRangeStat(&into->stats[s], from->stats[s].n, from->stats[s].mean, from->stats[s].m2, from->stats[s].min, from->stats[s].max);
+  }
+}
+
+void clearBlock(pyramidBlock *block, int nStreams)
+{
+  block->rows = 0;
+  clearRangeStats(block->stats, nStreams);
+}
+
+// ---------------------------------------------------------------------------------------------
+// rows
+
+int streamIndex(pyramidFile *f, const char *text, int length)
+{
+  for (int s = 0; s < f->nStreams; s++)
+  {
+    if ((int)strlen(f->streamName[s]) == length && !memcmp(f->streamName[s], text, length))
+      return s;
+  }
+  if (f->nStreams == MAX_STREAMS || length >= STREAM_NAME_MAX)
+  {
+    return -1;
+  }
+  memcpy(f->streamName[f->nStreams], text, length);
+  f->streamName[f->nStreams][length] = 0;
+  return f->nStreams++;
+}
+
+int hasColumn(csvField *names, int nColumns, csvField *name, const char *suffix)
+{
+  int length = name->length - 3;
+  for (int k = 2; k < nColumns; k++)
+  {
+    if (names[k].length == length + 3 && !memcmp(names[k].text, name->text, length) && !memcmp(names[k].text + length, suffix, 3))
+      return 1;
+  }
+  return 0;
+}
+
+// the role and stream of each column of the header
+void mapColumns(pyramidFile *f)
+{
+  csvField names[MAX_COLUMNS];
+  int nColumns = 0;
+  for (const char *p = f->data.header; p && nColumns < MAX_COLUMNS;)
+  {
+    p = nextField(p, f->data.headerEnd, &names[nColumns++]);
+  }
+  f->nStreams = 0;
+  memset(f->role, ROLE_NONE, sizeof(f->role));
+  for (int k = 2; k < nColumns; k++)
+  {
+    csvField *name = &names[k];
+    if (fieldIs(name, "unixTime"))
+    {
+      f->role[k] = ROLE_TIME;
+      continue;
+    }
+    if (name->length < 3)
+    {
+      continue;
+    }
+    const char *suffix = name->text + name->length - 3;
+    int role = ROLE_NONE;
+    if (!memcmp(suffix, "_av", 3) || (!memcmp(suffix, "_cv", 3) && !hasColumn(names, nColumns, name, "_av")))
+      role = ROLE_AVERAGE;
+    else if (!memcmp(suffix, "_sd", 3))
+      role = ROLE_SPREAD;
+    else if (name->length >= 2 && !memcmp(name->text + name->length - 2, "_n", 2))
+      role = ROLE_COUNT;
+    if (role == ROLE_NONE)
+    {
+      continue;
+    }
+    int s = streamIndex(f, name->text, name->length - (role == ROLE_COUNT ? 2 : 3));
+    if (s >= 0)
+    {
+      f->role[k] = role;
+      f->slot[k] = s;
+    }
+  }
+  // FNV-1a of the header row: the pyramid belongs to a file with these columns
+  f->headerHash = 14695981039346656037ULL;
+  for (const char *p = f->data.header; p < f->data.headerEnd; p++)
+  {
+    f->headerHash = (f->headerHash ^ (uint8_t)*p) * 1099511628211ULL;
+  }
+}
+
+// read the row at p; returns 0 if the line is not a row of the file
+int readRow(pyramidFile *f, const char *p, const char *lineEnd, rowValues *row)
+{
+  csvField field;
+  const char *next = nextField(p, lineEnd, &field);
+  if (!next || !fieldIs(&field, f->data.deviceCode))
+  {
+    return 0;
+  }
+  next = nextField(next, lineEnd, &field);
+  double count;
+  if (!next || !scanDouble(&field, &count) || count == 0.)
+  {
+    return 0; // a torn row, or the header written again
+  }
+  memset(row->have, 0, f->nStreams);
+  row->time = f->created + count * intervalMillis / 1000.;
+  for (int k = 2; next && k < MAX_COLUMNS; k++)
+  {
+    next = nextField(next, lineEnd, &field);
+    int role = f->role[k];
+    double value;
+    if (role == ROLE_NONE || !scanDouble(&field, &value))
+    {
+      continue;
+    }
+    if (role == ROLE_TIME)
+    {
+      row->time = value;
+      continue;
+    }
+    int s = f->slot[k];
+    if (role == ROLE_AVERAGE)
+      row->mean[s] = value;
+    else if (role == ROLE_SPREAD)
+      row->spread[s] = value;
+    else
+      row->count[s] = value;
+    row->have[s] |= 1 << role;
+  }
+  return 1;
+}
+
+void addRow(rangeStat *stats, int nStreams, rowValues *row)
+{
+  for (int s = 0; s < nStreams; s++)
+  {
+    if (!(row->have[s] & (1 << ROLE_AVERAGE)))
+    {
+      continue;
+    }
+    double n = (row->have[s] & (1 << ROLE_COUNT)) ? row->count[s] : 1.;
+    double m2 = ((row->have[s] & (1 << ROLE_SPREAD)) && n > 1.) ? row->spread[s] * row->spread[s] * (n - 1.) : 0.;
+    mergeRangeStat(&stats[s], n, row->mean[s], m2, (float)row->mean[s], (float)row->mean[s]);
+  }
+}
+
+// ---------------------------------------------------------------------------------------------
+// pyramid file
+
+// records written once base blocks 0 to nBase - 1 have closed
+uint64_t recordsFor(uint64_t nBase)
+{
+  return 2 * nBase - __builtin_popcountll(nBase);
+}
+
+// record of block j of level k
+uint64_t recordOf(int level, uint64_t j)
+{
+  uint64_t i = ((j + 1) << level) - 1;
+  return recordsFor(i) + level;
+}
+
+void putWord(uint8_t *bytes, uint64_t value, int size)
+{
+  for (int k = 0; k < size; k++)
+  {
+    bytes[k] = (uint8_t)(value >> (8 * k));
+  }
+}
+
+uint64_t getWord(const uint8_t *bytes, int size)
+{
+  uint64_t value = 0;
+  for (int k = size - 1; k >= 0; k--)
+  {
+    value = (value << 8) | bytes[k];
+  }
+  return value;
+}
+
+void encodeBlock(pyramidFile *f, pyramidBlock *block, int level, uint8_t *record)
+{
+  memcpy(record, &block->firstTime, 8);
+  memcpy(record + 8, &block->lastTime, 8);
+  putWord(record + 16, block->firstOffset, 8);
+  putWord(record + 24, block->endOffset, 8);
+  putWord(record + 32, block->firstRow, 4);
+  putWord(record + 36, block->rows, 4);
+  putWord(record + 40, level, 4);
+  putWord(record + 44, 0, 4);
+  uint8_t *p = record + RECORD_HEAD_BYTES;
+  for (int s = 0; s < f->nStreams; s++, p += STREAM_BYTES)
+  {
+    memcpy(p, &block->stats[s].n, 8);
+    memcpy(p + 8, &block->stats[s].mean, 8);
+    memcpy(p + 16, &block->stats[s].m2, 8);
+    memcpy(p + 24, &block->stats[s].min, 4);
+    memcpy(p + 28, &block->stats[s].max, 4);
+  }
+}
+
+unsigned long recordsRead = 0; // for the query summary
+
+// read record r (with the statistics when withStats); returns 0 if it is not in the file
+int readBlock(pyramidFile *f, uint64_t r, pyramidBlock *block, int withStats)
+{
+  uint8_t record[RECORD_HEAD_BYTES + MAX_STREAMS * STREAM_BYTES];
+  int bytes = withStats ? f->recordBytes : RECORD_HEAD_BYTES;
+  if (pread(f->fd, record, bytes, f->headBytes + r * f->recordBytes) != bytes)
+  {
+    return 0;
+  }
+  recordsRead++;
+  memcpy(&block->firstTime, record, 8);
+  memcpy(&block->lastTime, record + 8, 8);
+  block->firstOffset = getWord(record + 16, 8);
+  block->endOffset = getWord(record + 24, 8);
+  block->firstRow = getWord(record + 32, 4);
+  block->rows = getWord(record + 36, 4);
+  const uint8_t *p = record + RECORD_HEAD_BYTES;
+  for (int s = 0; withStats && s < f->nStreams; s++, p += STREAM_BYTES)
+  {
+    memcpy(&block->stats[s].n, p, 8);
+    memcpy(&block->stats[s].mean, p + 8, 8);
+    memcpy(&block->stats[s].m2, p + 16, 8);
+    memcpy(&block->stats[s].min, p + 24, 4);
+    memcpy(&block->stats[s].max, p + 28, 4);
+  }
+  return 1;
+}
+
+// open the pyramid of the file if it matches the file; returns the number of records, or -1
+long openPyramid(pyramidFile *f, int flags)
+{
+  f->fd = open(f->pyramidName, flags);
+  if (f->fd < 0)
+  {
+    return -1;
+  }
+  uint8_t head[PYRAMID_HEAD_BYTES];
+  struct stat info;
+  int match = fstat(f->fd, &info) == 0 && pread(f->fd, head, PYRAMID_HEAD_BYTES, 0) == PYRAMID_HEAD_BYTES &&
+              !memcmp(head, PYRAMID_MAGIC, 4) && getWord(head + 4, 4) == PYRAMID_VERSION &&
+              (int)getWord(head + 8, 4) == baseRows && (int)getWord(head + 12, 4) == f->nStreams &&
+              (int)getWord(head + 16, 4) == f->recordBytes && getWord(head + 24, 8) == f->headerHash &&
+              info.st_size >= f->headBytes;
+  if (!match)
+  {
+    close(f->fd);
+    f->fd = -1;
+    return -1;
+  }
+  return (info.st_size - f->headBytes) / f->recordBytes;
+}
+
+// base blocks whose records are all in a file of nRecords records
+uint32_t baseBlocksIn(long nRecords)
+{
+  uint64_t low = 0, high = nRecords; // the answer is in [low, high]
+  while (low < high)
+  {
+    uint64_t middle = (low + high + 1) / 2;
+    if (recordsFor(middle) <= (uint64_t)nRecords)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return (uint32_t)low;
+}
+
+// map the data file and find its streams
+const char *openPyramidFile(const char *fileName, pyramidFile *f)
+{
+  snprintf(f->name, sizeof(f->name), "%s", fileName);
+  snprintf(f->pyramidName, sizeof(f->pyramidName), "%s", fileName);
+  char *dot = strrchr(f->pyramidName, '.');
+  if (dot && !strchr(dot, '/'))
+    *dot = 0;
+  strncat(f->pyramidName, ".pyr", sizeof(f->pyramidName) - strlen(f->pyramidName) - 1);
+  const char *error = openDataFile(fileName, &f->data);
+  if (error)
+  {
+    return error;
+  }
+  f->created = dataFileCreated(&f->data);
+  if (f->created < 0)
+    f->created = 0;
+  mapColumns(f);
+  f->recordBytes = RECORD_HEAD_BYTES + f->nStreams * STREAM_BYTES;
+  f->headBytes = PYRAMID_HEAD_BYTES + f->nStreams * STREAM_NAME_MAX;
+  f->fd = -1;
+  f->nBase = 0;
+  return NULL;
+}
+
+pyramidBlock leftBlocks[MAX_LEVELS]; // a finished block of each level waiting for the block after it
+pyramidBlock baseBlock;
+pyramidBlock readBack;
+
+// bring the pyramid of the file up to date; returns the number of records added, or -1
+long updatePyramid(pyramidFile *f)
+{
+  long nRecords = openPyramid(f, O_RDWR);
+  uint32_t nBase = 0;
+  if (nRecords >= 0)
+  {
+    nBase = baseBlocksIn(nRecords);
+    // the last base block must still be in the data file (it may have been rewritten or cut)
+    if (nBase > 0 && (!readBlock(f, recordOf(0, nBase - 1), &readBack, 0) || readBack.endOffset > (uint64_t)(f->data.end - f->data.map) ||
+                      f->data.map[readBack.endOffset - 1] != '\n'))
+    {
+      close(f->fd);
+      f->fd = -1;
+      nRecords = -1;
+      nBase = 0;
+    }
+  }
+  if (nRecords < 0)
+  {
+    // a new pyramid
+    f->fd = open(f->pyramidName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0)
+    {
+      return -1;
+    }
+    uint8_t head[PYRAMID_HEAD_BYTES];
+    memcpy(head, PYRAMID_MAGIC, 4);
+    putWord(head + 4, PYRAMID_VERSION, 4);
+    putWord(head + 8, baseRows, 4);
+    putWord(head + 12, f->nStreams, 4);
+    putWord(head + 16, f->recordBytes, 4);
+    putWord(head + 20, 0, 4);
+    putWord(head + 24, f->headerHash, 8);
+    if (write(f->fd, head, PYRAMID_HEAD_BYTES) != PYRAMID_HEAD_BYTES ||
+        write(f->fd, f->streamName, f->nStreams * STREAM_NAME_MAX) != f->nStreams * STREAM_NAME_MAX)
+    {
+      return -1;
+    }
+  }
+  // drop a record cut off (or the blocks of an unfinished base block) and carry on from there
+  uint64_t written = recordsFor(nBase);
+  if (ftruncate(f->fd, f->headBytes + written * f->recordBytes) < 0)
+  {
+    return -1;
+  }
+
+  // a block of level k + 1 is always the merge of its two blocks of level k, so a pyramid brought up
+  // to date is the same as one built at once: level k has a block waiting for the one after it
+  // when bit k of nBase is set, and it is read back
+  const char *p = f->data.headerEnd + 1;
+  uint32_t rowNumber = 0;
+  for (int k = 0; k < MAX_LEVELS && (nBase >> k) > 0; k++)
+  {
+    if ((nBase >> k) & 1)
+      readBlock(f, recordOf(k, (nBase >> k) - 1), &leftBlocks[k], 1);
+  }
+  if (nBase > 0)
+  {
+    readBlock(f, recordOf(0, nBase - 1), &readBack, 0);
+    p = f->data.map + readBack.endOffset;
+    rowNumber = readBack.firstRow + readBack.rows;
+  }
+
+  // add the base blocks that have closed since
+  FILE *out = fdopen(f->fd, "r+b");
+  fseek(out, 0, SEEK_END);
+  uint8_t record[RECORD_HEAD_BYTES + MAX_STREAMS * STREAM_BYTES];
+  pyramidBlock *base = &baseBlock;
+  clearBlock(base, f->nStreams);
+  rowValues row;
+  long added = 0;
+  while (p < f->data.end)
+  {
+    const char *lineEnd = lineEndOf(p, f->data.end);
+    if (lineEnd == f->data.end)
+    {
+      break; // a row still being written
+    }
+    if (readRow(f, p, lineEnd, &row))
+    {
+      if (base->rows == 0)
+      {
+        base->firstTime = row.time;
+        base->firstOffset = p - f->data.map;
+        base->firstRow = rowNumber;
+      }
+      base->lastTime = row.time;
+      base->endOffset = lineEnd + 1 - f->data.map;
+      base->rows++;
+      rowNumber++;
+      addRow(base->stats, f->nStreams, &row);
+      if ((int)base->rows == baseRows)
+      {
+        // base block nBase closes level 0 and every level k with 2^k dividing nBase + 1
+        int k = 0;
+        encodeBlock(f, base, 0, record);
+        fwrite(record, 1, f->recordBytes, out);
+        added++;
+        for (; k < MAX_LEVELS - 1 && ((nBase >> k) & 1); k++)
+        {
+          mergeBlock(&leftBlocks[k], base, f->nStreams);
+          *base = leftBlocks[k];
+          encodeBlock(f, base, k + 1, record);
+          fwrite(record, 1, f->recordBytes, out);
+          added++;
+        }
+        leftBlocks[k] = *base;
+        nBase++;
+        clearBlock(base, f->nStreams);
+      }
+    }
+    p = lineEnd + 1;
+  }
+  fflush(out);
+  f->nBase = nBase;
+  return added;
+}
+
+// ---------------------------------------------------------------------------------------------
+// queries
+
+unsigned long rowsRead = 0;
+
+// add the rows from p on with time in [low, high], up to end or the first row after high
+void addRows(pyramidFile *f, const char *p, const char *end, double low, double high, rangeStat *stats)
+{
+  rowValues row;
+  while (p < end)
+  {
+    const char *lineEnd = lineEndOf(p, end);
+    if (readRow(f, p, lineEnd, &row))
+    {
+      rowsRead++;
+      if (row.time > high)
+        break;
+      if (row.time >= low)
+        addRow(stats, f->nStreams, &row);
+    }
+    p = lineEnd + 1;
+  }
+}
+
+// first base block with firstTime >= t (after) or lastTime > t (!after), from the level 0 records
+uint32_t findBase(pyramidFile *f, double t, int after)
+{
+  uint32_t low = 0, high = f->nBase;
+  pyramidBlock *block = &readBack;
+  while (low < high)
+  {
+    uint32_t middle = (low + high) / 2;
+    readBlock(f, recordOf(0, middle), block, 0);
+    if (after ? block->firstTime >= t : block->lastTime > t)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return low;
+}
+
+pyramidBlock queryBlock;
+
+// statistics of the rows with time in [low, high]
+void queryPyramid(pyramidFile *f, double low, double high, rangeStat *stats)
+{
+  clearRangeStats(stats, f->nStreams);
+  uint32_t s = findBase(f, low, 1);      // base blocks s to e are inside the range
+  uint32_t e = findBase(f, high, 0) - 1; // (e = -1 when none is)
+  const char *start = f->data.headerEnd + 1;
+  if (s > 0)
+  {
+    readBlock(f, recordOf(0, s - 1), &queryBlock, 0);
+    start = f->data.map + queryBlock.firstOffset;
+  }
+  if (e + 1 == 0 || s > e)
+  {
+    addRows(f, start, f->data.end, low, high, stats); // within two base blocks, or after the last
+    return;
+  }
+  if (s > 0)
+  {
+    addRows(f, start, f->data.map + queryBlock.endOffset, low, high, stats); // the rows before block s
+  }
+  // the largest aligned blocks that cover base blocks s to e
+  for (uint64_t b = s; b <= e;)
+  {
+    int level = 0;
+    while (level + 1 < MAX_LEVELS && (b & ((2ULL << level) - 1)) == 0 && b + (2ULL << level) <= (uint64_t)e + 1)
+    {
+      level++;
+    }
+    readBlock(f, recordOf(level, b >> level), &queryBlock, 1);
+    for (int k = 0; k < f->nStreams; k++)
+    {
+      mergeRangeStat(&stats[k], queryBlock.stats[k].n, queryBlock.stats[k].mean, queryBlock.stats[k].m2, queryBlock.stats[k].min, queryBlock.stats[k].max);
+    }
+    b += 1ULL << level;
+  }
+  readBlock(f, recordOf(0, e), &queryBlock, 0);
+  addRows(f, f->data.map + queryBlock.endOffset, f->data.end, low, high, stats); // the rows after block e
+}
+
+// the same statistics from every row of the range, in two passes over the rows (the mean, then
+// the squared deviations from it), to check the pyramid
+void queryBrute(pyramidFile *f, double low, double high, rangeStat *stats)
+{
+  long double n[MAX_STREAMS], sum[MAX_STREAMS], squares[MAX_STREAMS];
+  for (int s = 0; s < f->nStreams; s++)
+  {
+    n[s] = sum[s] = squares[s] = 0.;
+    stats[s].min = FLT_MAX;
+    stats[s].max = -FLT_MAX;
+  }
+  rowValues row;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (const char *p = f->data.headerEnd + 1; p < f->data.end;)
+    {
+      const char *lineEnd = lineEndOf(p, f->data.end);
+      if (readRow(f, p, lineEnd, &row))
+      {
+        rowsRead++;
+        if (row.time > high)
+          break;
+        for (int s = 0; row.time >= low && s < f->nStreams; s++)
+        {
+          if (!(row.have[s] & (1 << ROLE_AVERAGE)))
+            continue;
+          double rowN = (row.have[s] & (1 << ROLE_COUNT)) ? row.count[s] : 1.;
+          if (rowN <= 0.)
+            continue;
+          if (pass == 0)
+          {
+            n[s] += rowN;
+            sum[s] += rowN * (long double)row.mean[s];
+            if ((float)row.mean[s] < stats[s].min)
+              stats[s].min = (float)row.mean[s];
+            if ((float)row.mean[s] > stats[s].max)
+              stats[s].max = (float)row.mean[s];
+            continue;
+          }
+          long double deviation = row.mean[s] - (long double)stats[s].mean;
+          squares[s] += rowN * deviation * deviation;
+          if ((row.have[s] & (1 << ROLE_SPREAD)) && rowN > 1.)
+            squares[s] += row.spread[s] * (long double)row.spread[s] * (rowN - 1.);
+        }
+      }
+      p = lineEnd + 1;
+    }
+    for (int s = 0; s < f->nStreams; s++)
+    {
+      stats[s].n = (double)n[s];
+      stats[s].mean = n[s] > 0. ? (double)(sum[s] / n[s]) : 0.;
+      stats[s].m2 = (double)squares[s];
+    }
+  }
+}
+
+double standardDeviation(rangeStat *stat)
+{
+  return stat->n > 1. && stat->m2 > 0. ? sqrt(stat->m2 / (stat->n - 1.)) : 0.;
+}
+
+void printRangeStats(pyramidFile *f, rangeStat *stats, const char **names, int nNames)
+{
+  printf("stream,n,mean,sd,min,max\n");
+  for (int s = 0; s < f->nStreams; s++)
+  {
+    int wanted = nNames == 0;
+    for (int k = 0; k < nNames; k++)
+    {
+      wanted |= !strcmp(names[k], f->streamName[s]);
+    }
+    if (!wanted)
+      continue;
+    if (stats[s].n <= 0.)
+      printf("%s,0,N//A,N//A,N//A,N//A\n", f->streamName[s]);
+    else
+      printf("%s,%.0f,%.6g,%.6g,%.6g,%.6g\n", f->streamName[s], stats[s].n, stats[s].mean, standardDeviation(&stats[s]),
+             stats[s].min, stats[s].max);
+  }
+}
+
+double elapsedSeconds(struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+uint32_t benchState = 1;
+
+// random queries with the pyramid and with every row; returns 1 if they disagree
+int benchQueries(pyramidFile *f, int nQueries, double spanSeconds)
+{
+  rowValues row;
+  double first = 0., last = 0.;
+  int nRows = 0;
+  for (const char *p = f->data.headerEnd + 1; p < f->data.end; p = lineEndOf(p, f->data.end) + 1)
+  {
+    if (readRow(f, p, lineEndOf(p, f->data.end), &row))
+    {
+      if (nRows++ == 0)
+        first = row.time;
+      last = row.time;
+    }
+  }
+  static rangeStat fast[MAX_STREAMS], brute[MAX_STREAMS];
+  double seconds[2] = {0., 0.};
+  unsigned long reads[2] = {0, 0};
+  unsigned long records = 0;
+  double worstMean = 0., worstSpread = 0.;
+  int mismatches = 0;
+  for (int q = 0; q < nQueries; q++)
+  {
+    benchState = benchState * 1664525u + 1013904223u;
+    double low = first + (last - first) * (benchState >> 8) / 16777216.;
+    struct timespec start;
+    unsigned long rowsBefore = rowsRead;
+    unsigned long recordsBefore = recordsRead;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    queryPyramid(f, low, low + spanSeconds, fast);
+    seconds[0] += elapsedSeconds(&start);
+    reads[0] += rowsRead - rowsBefore;
+    records += recordsRead - recordsBefore;
+    rowsBefore = rowsRead;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    queryBrute(f, low, low + spanSeconds, brute);
+    seconds[1] += elapsedSeconds(&start);
+    reads[1] += rowsRead - rowsBefore;
+    for (int s = 0; s < f->nStreams; s++)
+    {
+      if (fast[s].n != brute[s].n || (brute[s].n > 0. && (fast[s].min != brute[s].min || fast[s].max != brute[s].max)))
+      {
+        mismatches++;
+        continue;
+      }
+      // relative to the spread of the stream, since a mean near 0 has no relative precision
+      double scale = fabs(brute[s].mean) + standardDeviation(&brute[s]) + 1e-9;
+      double meanError = fabs(fast[s].mean - brute[s].mean) / scale;
+      double spreadError = fabs(standardDeviation(&fast[s]) - standardDeviation(&brute[s])) / scale;
+      if (meanError > worstMean)
+        worstMean = meanError;
+      if (spreadError > worstSpread)
+        worstSpread = spreadError;
+    }
+  }
+  printf("queries\tspan_s\tMB\tbase_blocks\trecords/query\trows/query\tpyramid_us\trows/query\tbrute_us\tspeedup\n");
+  printf("%d\t%.0f\t%.1f\t%u\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", nQueries, spanSeconds, (f->data.end - f->data.map) / 1e6, f->nBase,
+         (double)records / nQueries, (double)reads[0] / nQueries, seconds[0] / nQueries * 1e6, (double)reads[1] / nQueries,
+         seconds[1] / nQueries * 1e6, seconds[0] > 0. ? seconds[1] / seconds[0] : 0.);
+  printf("largest difference from every row: mean %.2g, sd %.2g (relative); %d n, min or max different\n", worstMean, worstSpread, mismatches);
+  return mismatches > 0 || worstMean > 1e-9 || worstSpread > 1e-9;
+}
+
+const char *paths[64];
+int nPaths = 0;
+char firstFile[DATA_SCAN_PATH_MAX];
+int nUpdated = 0;
+long nAdded = 0;
+int updateAll = 1; // 0 = only the first file (for a query)
+
+void updateFile(const char *fileName)
+{
+  static pyramidFile f;
+  if (!updateAll && nUpdated > 0)
+  {
+    return;
+  }
+  const char *error = openPyramidFile(fileName, &f);
+  if (error)
+  {
+    fprintf(stderr, "pyramid: %s: %s\n", fileName, error);
+    return;
+  }
+  long added = updatePyramid(&f);
+  if (added < 0)
+    fprintf(stderr, "pyramid: cannot write %s\n", f.pyramidName);
+  else
+    nAdded += added;
+  if (f.fd >= 0)
+    close(f.fd);
+  closeDataFile(&f.data);
+  if (nUpdated++ == 0)
+    snprintf(firstFile, sizeof(firstFile), "%s", fileName);
+}
+
+int main(int argc, char **argv)
+{
+  double from = -DBL_MAX, to = DBL_MAX;
+  int brute = 0;
+  int nBench = 0;
+  double spanSeconds = 3600.;
+  const char *names[MAX_STREAMS];
+  int nNames = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2))
+    {
+      if (nPaths < 64)
+        paths[nPaths++] = arg;
+      continue;
+    }
+    if (!strcmp(arg, "--brute"))
+    {
+      brute = 1;
+      updateAll = 0;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[++i] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    if (!strcmp(arg, "--base-rows"))
+      baseRows = atoi(value) > 0 ? atoi(value) : 16;
+    else if (!strcmp(arg, "--interval-ms"))
+      intervalMillis = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--from"))
+      from = atof(value);
+    else if (!strcmp(arg, "--to"))
+      to = atof(value);
+    else if (!strcmp(arg, "--stream") && nNames < MAX_STREAMS)
+      names[nNames++] = value;
+    else if (!strcmp(arg, "--bench"))
+      nBench = atoi(value);
+    else if (!strcmp(arg, "--span-s"))
+      spanSeconds = atof(value);
+    else if (!strcmp(arg, "--seed"))
+      benchState = strtoul(value, NULL, 10);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 2;
+    }
+    if (strcmp(arg, "--base-rows") && strcmp(arg, "--interval-ms"))
+      updateAll = 0; // a query
+  }
+  if (nPaths == 0)
+  {
+    fprintf(stderr, "usage: pyramid [options] PATH...\n");
+    return 2;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int k = 0; k < nPaths; k++)
+  {
+    listDataFiles(paths[k], updateFile);
+  }
+  if (nUpdated == 0)
+  {
+    fprintf(stderr, "pyramid: no data files\n");
+    return 1;
+  }
+  if (updateAll)
+  {
+    fprintf(stderr, "pyramid: %d files, %ld records added in %.3f s\n", nUpdated, nAdded, elapsedSeconds(&start));
+    return 0;
+  }
+
+  static pyramidFile f;
+  openPyramidFile(firstFile, &f);
+  long nRecords = openPyramid(&f, O_RDONLY);
+  f.nBase = nRecords > 0 ? baseBlocksIn(nRecords) : 0;
+  if (nBench > 0)
+  {
+    return benchQueries(&f, nBench, spanSeconds);
+  }
+  static rangeStat stats[MAX_STREAMS];
+  recordsRead = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (brute)
+    queryBrute(&f, from, to, stats);
+  else
+    queryPyramid(&f, from, to, stats);
+  double seconds = elapsedSeconds(&start);
+  printRangeStats(&f, stats, names, nNames);
+  fprintf(stderr, "pyramid: %s, %lu records and %lu rows read in %.3f ms\n", brute ? "every row" : "pyramid", recordsRead, rowsRead, seconds * 1e3);
+  return 0;
+}
@@ -0,0 +1,274 @@
+// recoverLog.cpp
+// recovers the data of a log file copied from the SD card after the logger lost power
+//
+//  preallocated files (ENABLE_LOG_PREALLOCATE, see logSD.h) are the size of their extent, with the
+//  unused part full of zero bytes, and the length in their preamble ("Kite Datlogger Length:
+//  ##########") may be behind: the data ends at the first zero byte after the recorded length.
+//  files without a length line are trimmed at their first zero byte, so any log file can be passed
+//
+//  files written with group commit (ENABLE_GROUP_COMMIT) end each row with a CRC-16 column (the
+//  header row ends with ",crc"). the last valid row is found by checking rows backwards from the
+//  end, so only the damaged tail is read; everything after it is dropped. rows before it that fail
+//  their CRC (a changed byte) are left out of OUT. without CRCs a row cut off by the power loss (no
+//  end of line) is dropped
+//
+//  build:  host/build.sh
+//  usage:  host/recoverLog [--check] FILE [OUT]
+//    prints what was found; with OUT writes the recovered data (with the length updated) to OUT
+//    --check also checks every row: CRC failures and gaps or steps back in the sequence numbers
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define LENGTH_LABEL "Kite Datlogger Length: "
+#define LENGTH_DIGITS 10
+#define PREAMBLE_SEARCH 4096 // the length line is in the preamble at the start of the file
+#define CRC_HEADER ",crc"
+#define CRC_COLUMN 5 // ",XXXX"
+
+// same CRC as crc16Update() in logSD.h
+uint16_t crc16(const char *text, long length)
+{
+  uint16_t crc = 0xFFFF;
+  for (long k = 0; k < length; k++)
+  {
+    crc ^= ((uint16_t)(uint8_t)text[k]) << 8;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// length of the line at text[start] without its end of line
+long lineLength(const char *text, long start, long end)
+{
+  long k = start;
+  while (k < end && text[k] != '\r' && text[k] != '\n')
+    k++;
+  return k - start;
+}
+
+// 1 if the line of the given length ends with the CRC of the rest of the line
+int validRow(const char *text, long length)
+{
+  if (length <= CRC_COLUMN || text[length - CRC_COLUMN] != ',')
+    return 0;
+  char *stop;
+  unsigned long crc = strtoul(text + length - CRC_COLUMN + 1, &stop, 16);
+  return stop == text + length && crc == crc16(text, length - CRC_COLUMN);
+}
+
+// sequence number of a row (the count column after the device code), -1 if there is none
+long rowSequence(const char *text, long length)
+{
+  const char *comma = (const char *)memchr(text, ',', length);
+  return comma ? strtol(comma + 1, NULL, 10) : -1;
+}
+
+int main(int argc, char **argv)
+{
+  int check = 0;
+  int arg = 1;
+  if (arg < argc && !strcmp(argv[arg], "--check"))
+  {
+    check = 1;
+    arg++;
+  }
+  if (argc - arg < 1 || argc - arg > 2)
+  {
+    fprintf(stderr, "usage: recoverLog [--check] FILE [OUT]\n");
+    return 2;
+  }
+  const char *inName = argv[arg];
+  const char *outName = (argc - arg == 2) ? argv[arg + 1] : NULL;
+  FILE *in = fopen(inName, "rb");
+  if (!in)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  char *text = (char *)malloc(size + 1);
+  if (!text || fread(text, 1, size, in) != (size_t)size)
+  {
+    fprintf(stderr, "cannot read %s\n", inName);
+    return 2;
+  }
+  fclose(in);
+  text[size] = 0;
+
+  // length recorded in the preamble
+  long recorded = -1;
+  long lengthOffset = -1;
+  const char *label = strstr(text, LENGTH_LABEL);
+  if (label && label - text < PREAMBLE_SEARCH)
+  {
+    lengthOffset = (label - text) + strlen(LENGTH_LABEL);
+    recorded = strtol(text + lengthOffset, NULL, 10);
+  }
+  if (recorded < 0 || recorded > size)
+  {
+    recorded = 0;
+  }
+
+  // the data goes on past the recorded length up to the first unused (zero) byte
+  long end = recorded;
+  while (end < size && text[end] != 0)
+  {
+    end++;
+  }
+  // or stops short of it if the length is ahead of the data
+  while (end > 0 && text[end - 1] == 0)
+  {
+    end--;
+  }
+
+  // rows start after the header row (the last line of the preamble that ends with ",crc")
+  long dataStart = -1;
+  for (const char *header = strstr(text, CRC_HEADER); header && header < text + end; header = strstr(header + 1, CRC_HEADER))
+  {
+    const char *after = header + strlen(CRC_HEADER);
+    if (*after == '\r' || *after == '\n')
+    {
+      while (after < text + end && (*after == '\r' || *after == '\n'))
+        after++;
+      dataStart = after - text;
+    }
+  }
+
+  long rowEnd = end;
+  long lastSequence = -1;
+  if (dataStart >= 0)
+  {
+    // last row with a valid CRC, checking backwards from the end
+    rowEnd = dataStart;
+    long lineEnd = end; // end of the line being checked, including its end of line
+    while (lineEnd > dataStart)
+    {
+      long lineStart = lineEnd;
+      if (text[lineStart - 1] == '\n')
+        lineStart--;
+      while (lineStart > dataStart && text[lineStart - 1] != '\n')
+        lineStart--;
+      long length = lineLength(text, lineStart, lineEnd);
+      // a valid row also needs its end of line, otherwise it may have been cut off
+      if (length > 0 && lineStart + length < lineEnd && validRow(text + lineStart, length))
+      {
+        rowEnd = lineEnd;
+        lastSequence = rowSequence(text + lineStart, length);
+        break;
+      }
+      lineEnd = lineStart;
+    }
+    // blank lines after the last row are kept
+    while (rowEnd > dataStart && rowEnd < end && (text[rowEnd] == '\r' || text[rowEnd] == '\n'))
+      rowEnd++;
+  }
+  else
+  {
+    // drop a row that was cut off
+    while (rowEnd > recorded && text[rowEnd - 1] != '\n')
+    {
+      rowEnd--;
+    }
+  }
+
+  printf("%s: %ld bytes, %s%ld, data ends at %ld (%ld bytes after the recorded length), %ld bytes of damaged or cut off rows dropped, %ld unused bytes",
+         inName, size, lengthOffset >= 0 ? "recorded length " : "no length line, scanned from ", recorded,
+         rowEnd, rowEnd - recorded, end - rowEnd, size - end);
+  if (dataStart >= 0)
+  {
+    printf(", last valid row %ld", lastSequence);
+  }
+  printf("\n");
+
+  int damaged = 0;
+  if (check && dataStart >= 0)
+  {
+    long rows = 0, badRows = 0, gaps = 0, backwards = 0;
+    long previous = -1;
+    for (long lineStart = dataStart; lineStart < rowEnd;)
+    {
+      long length = lineLength(text, lineStart, rowEnd);
+      if (length > 0)
+      {
+        rows++;
+        if (!validRow(text + lineStart, length))
+        {
+          badRows++;
+          printf("  bad CRC at byte %ld: %.60s\n", lineStart, text + lineStart);
+        }
+        else
+        {
+          long sequence = rowSequence(text + lineStart, length);
+          if (previous >= 0 && sequence > previous + 1)
+            gaps++;
+          if (previous >= 0 && sequence < previous)
+            backwards++;
+          previous = sequence;
+        }
+      }
+      lineStart += length;
+      while (lineStart < rowEnd && (text[lineStart] == '\r' || text[lineStart] == '\n'))
+        lineStart++;
+    }
+    printf("  %ld rows, %ld with a bad CRC, %ld gaps and %ld steps back in the sequence numbers\n", rows, badRows, gaps, backwards);
+    damaged = badRows > 0;
+  }
+
+  if (outName && dataStart >= 0)
+  {
+    // leave out the rows before the last valid one that fail their CRC
+    long kept = dataStart;
+    long dropped = 0;
+    for (long lineStart = dataStart; lineStart < rowEnd;)
+    {
+      long length = lineLength(text, lineStart, rowEnd);
+      long next = lineStart + length;
+      while (next < rowEnd && (text[next] == '\r' || text[next] == '\n'))
+        next++;
+      if (length == 0 || validRow(text + lineStart, length))
+      {
+        memmove(text + kept, text + lineStart, next - lineStart);
+        kept += next - lineStart;
+      }
+      else
+      {
+        dropped++;
+      }
+      lineStart = next;
+    }
+    if (dropped > 0)
+    {
+      printf("  %ld rows with a bad CRC before the last valid row left out\n", dropped);
+    }
+    rowEnd = kept;
+  }
+
+  if (outName)
+  {
+    if (lengthOffset >= 0 && lengthOffset + LENGTH_DIGITS <= rowEnd)
+    {
+      char digits[24]; // any long, so a length too large for the line is seen rather than cut
+      if (snprintf(digits, sizeof(digits), "%0*ld", LENGTH_DIGITS, rowEnd) != LENGTH_DIGITS)
+      {
+        fprintf(stderr, "length %ld does not fit the length line of %s\n", rowEnd, outName);
+        return 2;
+      }
+      memcpy(text + lengthOffset, digits, LENGTH_DIGITS);
+    }
+    FILE *out = fopen(outName, "wb");
+    if (!out || fwrite(text, 1, rowEnd, out) != (size_t)rowEnd)
+    {
+      fprintf(stderr, "cannot write %s\n", outName);
+      return 2;
+    }
+    fclose(out);
+  }
+  free(text);
+  return damaged;
+}
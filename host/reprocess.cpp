@@ -0,0 +1,929 @@
+// reprocess.cpp
+// runs recorded data files back through the statistics (sampleStats.h) and threshold event
+// (eventTracker.h) code of the logger with new settings, e.g. after changing outputStats, a
+// baseline or the breakpoints of an event, and writes a new data file and event file for each input
+//
+//  each input row is merged into the streams as the samples it summarizes: its average (_av, or the
+//  current value _cv of a stream without an average), standard deviation (_sd) and sample size (_n)
+//  add to the sums exactly as if the samples had been taken again, so the new averages, standard
+//  deviations and sizes are those of all the samples behind the rows. a stream without _n counts each
+//  row as one sample, and then its new _sd is the spread of the row averages (the spread inside the
+//  rows cannot be weighed without their sizes). every --rows rows the streams are output and reset
+//  the way loop() does at the end of a sample, with the threshold events evaluated in between.
+//  time is the row count times --interval-ms
+//
+//  files are memory-mapped and scanned in place (no copies of the rows, nothing allocated per file);
+//  the files are spread over --threads workers that take work from each other when they run out
+//  (largest files first), and each worker has its own streams, events and output buffers
+//
+//  build:  host/build.sh
+//  usage:  host/reprocess [options] PATH...
+//    PATH is a data file, a day directory (dYYMMDD), an SD card directory holding day directories or a
+//    directory of SD card directories;
+//    directories give every .csv file with "data" in its name (compressed files: run decodeData first)
+//    --out DIR         directory for the new files (default "reprocessed"); a file keeps its name, and
+//                      its day directory and the directory given as PATH are made under DIR (e.g.
+//                      card7/d210118/Adata000.csv -> DIR/card7/d210118/Adata000.csv for PATH card7).
+//                      the event file has "evnt" in place of "data"
+//    --rows N          input rows in each output row (default 10)
+//    --interval-ms MS  time of one input row (default SAMPLING_PERIOD)
+//    --stats K         outputStats of every stream (default 4 = average and standard deviation; the
+//                      standard deviation is of the samples behind the rows if the input has _n)
+//    --stats NAME=K    outputStats of one stream (by the nickname of its columns, e.g. Ax)
+//    --trend NAME      also output the trendline of NAME
+//    --baseline NAME=VALUE  subtract VALUE from NAME
+//    --baseline NAME=auto   subtract the average of NAME over the first --baseline-rows output rows
+//    --baseline-rows N output rows averaged for the automatic baselines (default 10)
+//    --event NAME,BP1[,BP2[,BP3]]  threshold event on the average of NAME (states S0 to S3,
+//                      breakpoints in increasing order)
+//    --threads N       worker threads (default: processors online)
+//    --bench           time the processing (outputs discarded) with 1, 2, 4 ... --threads workers
+//                      and print rows/s and GB/s of input for each
+//    --repeat N        with --bench, process the inputs N times for each thread count (default 1)
+
+#include "Arduino.h"
+#include "SD.h"
+
+#include <pthread.h>
+#include "dataScan.h"
+
+#include "../quickDebugMessages.h"
+#include "../deviceConfigGeneric.h"
+#include "../logSD.h"
+#include "../timeBase.h"
+#include "../profiler.h"
+#include "../dataCompress.h"
+#include "../timeIndex.h"
+#include "../outputQueue.h"
+#include "../fastMath.h"
+#include "../sampleStats.h"
+#include "../eventTracker.h"
+
+#define MAX_INPUTS 4096
+#define MAX_COLUMNS 256
+#define MAX_SETTINGS 64
+#define MAX_THREADS 64
+
+#define ROLE_NONE 0
+#define ROLE_AVERAGE 1 // _av, or _cv of a stream without _av
+#define ROLE_SPREAD 2  // _sd
+#define ROLE_COUNT 3   // _n
+#define ROLE_CURRENT 4 // _cv of a stream with _av
+#define OUTPUT_BUFFER_BYTES 65536
+#define THRESHOLD_BREAKPOINTS 3 // setEventBreakpoints() repeats BP3, so a fourth would not be used as given
+
+// settings of the streams, read by every worker
+struct streamSetting
+{
+  char nickName[DATA_NAME_SHORT];
+  int outputStats; // -2 = default
+  int calcTrendline;
+  int baselineType; // 0 = none, 1 = input, 2 = calculate (as sampleStats.baselineType)
+  float baseline;
+};
+
+struct thresholdSetting
+{
+  char nickName[DATA_NAME_SHORT];
+  int nBreakpoints;
+  float breakpoint[THRESHOLD_BREAKPOINTS];
+};
+
+streamSetting settings[MAX_SETTINGS];
+int nSettings = 0;
+thresholdSetting thresholds[MAX_EVENTS];
+int nThresholds = 0;
+int defaultOutputStats = 4;
+int rowsPerOutput = 10;
+int baselineRows = 10;
+unsigned long intervalMillis = SAMPLING_PERIOD;
+char outRoot[DATA_SCAN_PATH_MAX] = "reprocessed";
+
+struct reprocessJob
+{
+  char inName[DATA_SCAN_PATH_MAX];
+  char dataName[DATA_SCAN_PATH_MAX]; // outputs
+  char eventName[DATA_SCAN_PATH_MAX];
+  off_t bytes;
+  unsigned long rows;    // rows read
+  unsigned long outputs; // rows written
+  unsigned long changes; // event changes written
+  const char *error;     // why the file was skipped (NULL = processed)
+};
+
+reprocessJob jobs[MAX_INPUTS];
+int nJobs = 0;
+
+// buffered output of one file (discarded when file is NULL). the row functions of the logger start
+// every line with deviceCode, the code of this build: the code of the input file takes its place
+class reprocessOutput : public Print
+{
+public:
+  FILE *file = NULL;
+  char buffer[OUTPUT_BUFFER_BYTES];
+  size_t length = 0;
+  unsigned long bytes = 0;
+  char code[DATA_SCAN_CODE_MAX] = ""; // device code of the input ("" = lines are written as they are)
+  int lineStart = 1;
+  int skip = 0;
+
+  void put(uint8_t c)
+  {
+    if (length == sizeof(buffer))
+    {
+      flush();
+    }
+    buffer[length++] = c;
+    bytes++;
+  }
+  size_t write(uint8_t c)
+  {
+    if (lineStart && code[0] && c != '\r' && c != '\n')
+    {
+      for (const char *p = code; *p; p++)
+      {
+        put(*p);
+      }
+      skip = strlen(deviceCode);
+    }
+    lineStart = (c == '\n');
+    if (skip > 0)
+    {
+      skip--;
+      return 1;
+    }
+    put(c);
+    return 1;
+  }
+  using Print::write;
+  void flush()
+  {
+    if (file && length > 0)
+    {
+      fwrite(buffer, 1, length, file);
+    }
+    length = 0;
+  }
+  int begin(const char *fileName, const char *deviceCodeIn)
+  {
+    length = 0;
+    bytes = 0;
+    code[0] = 0;
+    lineStart = 1;
+    skip = 0;
+    file = NULL;
+    if (fileName)
+    {
+      file = fopen(fileName, "wb");
+      if (!file)
+      {
+        return 0;
+      }
+    }
+    snprintf(code, sizeof(code), "%s", deviceCodeIn);
+    return 1;
+  }
+  void end()
+  {
+    flush();
+    if (file)
+    {
+      fclose(file);
+    }
+    file = NULL;
+  }
+};
+
+// everything one worker changes while it processes a file
+struct workerState
+{
+  sampleStats streams[MAX_SAMPLES];
+  int nStreams;
+  eventTracker localEvents[MAX_EVENTS];
+  int nLocalEvents;
+  int columnStream[MAX_COLUMNS]; // stream fed by each input column (-1 = none)
+  int columnRole[MAX_COLUMNS];   // what the column holds (ROLE_)
+  float rowMean[MAX_SAMPLES];    // the columns of each stream in the current row
+  float rowSpread[MAX_SAMPLES];
+  float rowCount[MAX_SAMPLES];
+  float rowCurrent[MAX_SAMPLES];
+  int rowHave[MAX_SAMPLES]; // bit (1 << role) for each column of the stream in the row
+  reprocessOutput dataOut;
+  reprocessOutput eventOut;
+  int countLine;
+  int countEvents;
+  int nOutputs;
+};
+
+// ---------------------------------------------------------------------------------------------
+// streams and events
+
+streamSetting *findSetting(const char *nickName)
+{
+  for (int s = 0; s < nSettings; s++)
+  {
+    if (!strcmp(settings[s].nickName, nickName))
+    {
+      return &settings[s];
+    }
+  }
+  return NULL;
+}
+
+// the stream with this nickname, created (with its settings) if it is new; -1 if there is no room
+int findStream(workerState *w, const char *nickName, int create)
+{
+  for (int i = 0; i < w->nStreams; i++)
+  {
+    if (!strcmp(w->streams[i].dataNickName, nickName))
+    {
+      return i;
+    }
+  }
+  if (!create)
+  {
+    return -1;
+  }
+  streamSetting *setting = findSetting(nickName);
+  int outputStats = (setting && setting->outputStats != -2) ? setting->outputStats : defaultOutputStats;
+  int i = addDataStream(w->streams, &w->nStreams, (char *)nickName, (char *)nickName, "", outputStats);
+  if (i >= 0 && setting)
+  {
+    w->streams[i].calcTrendline = setting->calcTrendline;
+    w->streams[i].baselineType = setting->baselineType;
+    w->streams[i].baseline = setting->baselineType == 1 ? setting->baseline : 0.;
+  }
+  return i;
+}
+
+// map the columns of a header row to streams, in the order of the columns: the _av column of
+// each stream, or its _cv column if it has no average, makes the stream; its _sd, _n and other _cv
+// columns are merged into it
+int hasColumn(csvField *names, int nColumns, csvField *name, const char *suffix)
+{
+  int length = name->length - 3;
+  for (int k = 2; k < nColumns; k++)
+  {
+    if (names[k].length == length + 3 && !memcmp(names[k].text, name->text, length) && !memcmp(names[k].text + length, suffix, 3))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void mapHeader(workerState *w, const char *line, const char *lineEnd, int create)
+{
+  csvField names[MAX_COLUMNS];
+  int nColumns = 0;
+  const char *p = line;
+  while (p && nColumns < MAX_COLUMNS)
+  {
+    p = nextField(p, lineEnd, &names[nColumns++]);
+  }
+  int nickLength[MAX_COLUMNS];
+  for (int k = 0; k < MAX_COLUMNS; k++)
+  {
+    w->columnStream[k] = -1;
+    w->columnRole[k] = ROLE_NONE;
+  }
+  for (int k = 2; k < nColumns; k++)
+  {
+    csvField *name = &names[k];
+    if (name->length < 3)
+    {
+      continue;
+    }
+    const char *suffix = name->text + name->length - 3;
+    int role = ROLE_NONE;
+    if (!memcmp(suffix, "_av", 3) || (!memcmp(suffix, "_cv", 3) && !hasColumn(names, nColumns, name, "_av")))
+      role = ROLE_AVERAGE;
+    else if (!memcmp(suffix, "_cv", 3))
+      role = ROLE_CURRENT;
+    else if (!memcmp(suffix, "_sd", 3))
+      role = ROLE_SPREAD;
+    else if (!memcmp(name->text + name->length - 2, "_n", 2))
+      role = ROLE_COUNT;
+    int length = name->length - (role == ROLE_COUNT ? 2 : 3);
+    if (role == ROLE_NONE || length < 1 || length >= DATA_NAME_SHORT)
+    {
+      continue;
+    }
+    w->columnRole[k] = role;
+    nickLength[k] = length;
+  }
+  // the averages first, so the streams are made in the order of their average columns
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int k = 2; k < nColumns; k++)
+    {
+      if (w->columnRole[k] == ROLE_NONE || (w->columnRole[k] == ROLE_AVERAGE) != (pass == 0))
+      {
+        continue;
+      }
+      char nickName[DATA_NAME_SHORT];
+      memcpy(nickName, names[k].text, nickLength[k]);
+      nickName[nickLength[k]] = 0;
+      w->columnStream[k] = findStream(w, nickName, create && pass == 0);
+    }
+  }
+}
+
+// add one input row of a stream to its sums: n samples with this mean and standard deviation,
+// as updateDataSample would have added them one at a time
+void mergeDataRow(sampleStats *stream, int n, float mean, float sd, float current, float relTime)
+{
+  stream->currentVal = current - stream->baseline;
+  if (n <= 0)
+  {
+    return; // the stream had no samples in this row
+  }
+  float value = mean - stream->baseline;
+  stream->sumX += n * value;
+  stream->sumX2 += (n - 1) * sd * sd + n * value * value;
+  if (stream->calcTrendline == 1)
+  {
+    stream->sumT += n * relTime;
+    stream->sumXT += n * value * relTime;
+    stream->sumT2 += n * relTime * relTime;
+  }
+  stream->n += n;
+}
+
+void addThresholdEvents(workerState *w)
+{
+  static char *stateNames[] = {"S0", "S1", "S2", "S3"};
+  w->nLocalEvents = 0;
+  for (int t = 0; t < nThresholds; t++)
+  {
+    int i = findStream(w, thresholds[t].nickName, 0);
+    if (i < 0)
+    {
+      continue; // not in this file
+    }
+    char eventName[EVENT_NAME_MAX];
+    if (snprintf(eventName, sizeof(eventName), "Threshold on %s", thresholds[t].nickName) >= (int)sizeof(eventName))
+    {
+      continue; // nicknames are shorter than DATA_NAME_SHORT, so this does not happen
+    }
+    int nStates = thresholds[t].nBreakpoints + 1;
+    int j = addEvent(w->localEvents, &w->nLocalEvents, eventName, thresholds[t].nickName, 1, 0, nStates,
+                     stateNames[0], stateNames[1], nStates > 2 ? stateNames[2] : NULL, nStates > 3 ? stateNames[3] : NULL);
+    if (j < 0)
+    {
+      break;
+    }
+    float *bp = thresholds[t].breakpoint;
+    setEventBreakpoints(w->localEvents, j, i, bp[0], bp[1], bp[2]);
+  }
+}
+
+// the end of a sample: statistics, baselines, threshold events (as in loop()), then the output row
+void outputSample(workerState *w, unsigned long timeMillis, reprocessJob *job)
+{
+  updateSampleStats(w->streams, w->nStreams);
+
+  for (int j = 0; j < w->nLocalEvents; j++)
+  {
+    int currentState = evaluateEventBreakpoints(w->localEvents, j, w->streams);
+    if (currentState != w->localEvents[j].state)
+    {
+      updateEventState(w->localEvents, j, currentState, timeMillis);
+      w->countEvents++;
+      reportEventRow(w->eventOut, w->localEvents, j, ",", w->countEvents, 0);
+      job->changes++;
+    }
+    else
+    {
+      w->localEvents[j].priorState = currentState;
+      w->localEvents[j].justUpdated = 0;
+    }
+  }
+
+  if (w->nOutputs < baselineRows)
+  {
+    addSamplesToBaseline(w->streams, w->nStreams);
+    if (w->nOutputs == baselineRows - 1)
+    {
+      for (int i = 0; i < w->nStreams; i++)
+      {
+        if (w->streams[i].baselineType == 2 && w->streams[i].baselineCount > 0)
+        {
+          w->streams[i].baseline = w->streams[i].baselineSum / ((float)w->streams[i].baselineCount);
+        }
+      }
+    }
+  }
+  w->nOutputs++;
+
+  w->countLine++;
+  printSampleStatSpreadsheetRow(w->dataOut, w->streams, w->nStreams, ", ", w->countLine, 0);
+  job->outputs++;
+  resetSampleStats(w->streams, w->nStreams);
+}
+
+// ---------------------------------------------------------------------------------------------
+// one file
+
+void processFile(workerState *w, reprocessJob *job, int writeOutputs)
+{
+  job->rows = job->outputs = job->changes = 0;
+  dataFileMap file;
+  job->error = openDataFile(job->inName, &file);
+  if (job->error)
+  {
+    return;
+  }
+  job->bytes = file.size;
+  const char *header = file.header;
+  const char *headerEnd = file.headerEnd;
+  const char *end = file.end;
+  const char *map = file.map;
+  const char *deviceCodeIn = file.deviceCode;
+
+  w->nStreams = 0;
+  w->countLine = 0;
+  w->countEvents = 0;
+  w->nOutputs = 0;
+  mapHeader(w, header, headerEnd, 1);
+  addThresholdEvents(w);
+
+  if (!w->dataOut.begin(writeOutputs ? job->dataName : NULL, "") ||
+      !w->eventOut.begin(writeOutputs && w->nLocalEvents > 0 ? job->eventName : NULL, ""))
+  {
+    job->error = "cannot write the output";
+    w->dataOut.end();
+    closeDataFile(&file);
+    return;
+  }
+  // the preamble of the input, naming the new file and where it came from
+  for (const char *q = map; q < header;)
+  {
+    const char *lineEnd = lineEndOf(q, header);
+    if (!strncmp(q, "Kite Datlogger File: ", 21))
+    {
+      w->dataOut.print("Kite Datlogger File: ");
+      w->dataOut.println(job->dataName);
+      w->dataOut.print("Kite Datlogger Reprocessed from: ");
+      w->dataOut.println(job->inName);
+    }
+    else if (strncmp(q, "Kite Datlogger Length: ", 23))
+    {
+      w->dataOut.write((const uint8_t *)q, lineEnd + 1 - q);
+    }
+    q = lineEnd + 1;
+  }
+  snprintf(w->dataOut.code, sizeof(w->dataOut.code), "%s", deviceCodeIn);
+  snprintf(w->eventOut.code, sizeof(w->eventOut.code), "%s", deviceCodeIn);
+  printSampleStatSpreadsheetRow(w->dataOut, w->streams, w->nStreams, ",", 0, 1);
+  if (w->nLocalEvents > 0)
+  {
+    reportEventRow(w->eventOut, w->localEvents, 0, ",", 0, 1);
+  }
+
+  // the rows
+  int rowsInSample = 0;
+  unsigned long rowTime = 0;
+  unsigned long sampleStart = 0;
+  for (const char *p = headerEnd + 1; p < end;)
+  {
+    const char *lineEnd = lineEndOf(p, end);
+    const char *next = p;
+    csvField field;
+    next = nextField(next, lineEnd, &field); // device code
+    if (!next || !fieldIs(&field, deviceCodeIn))
+    {
+      p = lineEnd + 1;
+      continue; // blank line, another preamble, or a torn row
+    }
+    next = nextField(next, lineEnd, &field);
+    float count;
+    if (!next || !scanNumber(&field, &count))
+    {
+      p = lineEnd + 1;
+      continue;
+    }
+    if (count == 0.)
+    {
+      mapHeader(w, p, lineEnd, 0); // header written again (e.g. after the card came back)
+      p = lineEnd + 1;
+      continue;
+    }
+    rowTime = (unsigned long)count * intervalMillis;
+    if (rowsInSample == 0)
+    {
+      sampleStart = rowTime;
+    }
+    float relTime = ((float)(rowTime - sampleStart)) / 1000.;
+    memset(w->rowHave, 0, w->nStreams * sizeof(int));
+    for (int k = 2; next && k < MAX_COLUMNS; k++)
+    {
+      next = nextField(next, lineEnd, &field);
+      int i = w->columnStream[k];
+      float value;
+      if (i < 0 || !scanNumber(&field, &value))
+      {
+        continue;
+      }
+      int role = w->columnRole[k];
+      if (role == ROLE_AVERAGE)
+        w->rowMean[i] = value;
+      else if (role == ROLE_SPREAD)
+        w->rowSpread[i] = value;
+      else if (role == ROLE_COUNT)
+        w->rowCount[i] = value;
+      else
+        w->rowCurrent[i] = value;
+      w->rowHave[i] |= 1 << role;
+    }
+    for (int i = 0; i < w->nStreams; i++)
+    {
+      int have = w->rowHave[i];
+      if (!(have & (1 << ROLE_AVERAGE)))
+      {
+        continue;
+      }
+      int n = (have & (1 << ROLE_COUNT)) ? (int)w->rowCount[i] : 1;
+      float sd = (have & (1 << ROLE_SPREAD)) ? w->rowSpread[i] : 0.;
+      float current = (have & (1 << ROLE_CURRENT)) ? w->rowCurrent[i] : w->rowMean[i];
+      mergeDataRow(&w->streams[i], n, w->rowMean[i], sd, current, relTime);
+    }
+    job->rows++;
+    if (++rowsInSample == rowsPerOutput)
+    {
+      outputSample(w, rowTime, job);
+      rowsInSample = 0;
+    }
+    p = lineEnd + 1;
+  }
+  if (rowsInSample > 0)
+  {
+    outputSample(w, rowTime, job);
+  }
+
+  w->dataOut.end();
+  w->eventOut.end();
+  closeDataFile(&file);
+}
+
+// ---------------------------------------------------------------------------------------------
+// work-stealing pool: each worker takes the newest job of its own queue and, when that is empty,
+// the oldest job of another worker's queue
+
+struct workQueue
+{
+  pthread_mutex_t lock;
+  int job[MAX_INPUTS];
+  int head; // oldest
+  int tail; // one past the newest
+};
+
+struct worker
+{
+  pthread_t thread;
+  int id;
+  int nWorkers;
+  int writeOutputs;
+  unsigned long filesDone;
+  unsigned long stolen;
+  workerState state;
+};
+
+workQueue queues[MAX_THREADS];
+worker workers[MAX_THREADS];
+
+int takeJob(workQueue *queue, int newest)
+{
+  int j = -1;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->head < queue->tail)
+  {
+    j = newest ? queue->job[--queue->tail] : queue->job[queue->head++];
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return j;
+}
+
+void *runWorker(void *arg)
+{
+  worker *self = (worker *)arg;
+  for (;;)
+  {
+    int j = takeJob(&queues[self->id], 1);
+    for (int k = 1; j < 0 && k < self->nWorkers; k++)
+    {
+      j = takeJob(&queues[(self->id + k) % self->nWorkers], 0);
+      if (j >= 0)
+      {
+        self->stolen++;
+      }
+    }
+    if (j < 0)
+    {
+      return NULL; // no jobs are added once the workers start
+    }
+    processFile(&self->state, &jobs[j], self->writeOutputs);
+    self->filesDone++;
+  }
+}
+
+int compareJobSize(const void *a, const void *b)
+{
+  off_t sizeA = jobs[*(const int *)a].bytes;
+  off_t sizeB = jobs[*(const int *)b].bytes;
+  return sizeA < sizeB ? 1 : (sizeA > sizeB ? -1 : 0);
+}
+
+// process every job with nWorkers threads; returns the wall time in seconds
+double runJobs(int nWorkers, int writeOutputs)
+{
+  static int order[MAX_INPUTS];
+  for (int j = 0; j < nJobs; j++)
+  {
+    order[j] = j;
+  }
+  qsort(order, nJobs, sizeof(order[0]), compareJobSize);
+  for (int t = 0; t < nWorkers; t++)
+  {
+    pthread_mutex_init(&queues[t].lock, NULL);
+    queues[t].head = queues[t].tail = 0;
+  }
+  // deal the largest files first; each worker starts on its largest (the newest of its queue)
+  for (int j = nJobs - 1; j >= 0; j--)
+  {
+    workQueue *queue = &queues[j % nWorkers];
+    queue->job[queue->tail++] = order[j];
+  }
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int t = 0; t < nWorkers; t++)
+  {
+    workers[t].id = t;
+    workers[t].nWorkers = nWorkers;
+    workers[t].writeOutputs = writeOutputs;
+    workers[t].filesDone = workers[t].stolen = 0;
+    pthread_create(&workers[t].thread, NULL, runWorker, &workers[t]);
+  }
+  for (int t = 0; t < nWorkers; t++)
+  {
+    pthread_join(workers[t].thread, NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  return (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// ---------------------------------------------------------------------------------------------
+// inputs
+
+// outDir: directory of the new files
+void addJob(const char *path, const char *outDir)
+{
+  if (nJobs == MAX_INPUTS)
+  {
+    fprintf(stderr, "reprocess: more than %d files, %s not processed\n", MAX_INPUTS, path);
+    return;
+  }
+  reprocessJob *job = &jobs[nJobs];
+  const char *name = baseName(path);
+  const char *data = strstr(name, "data");
+  const char *dot = strrchr(name, '.');
+  int eventLength;
+  if (data)
+    eventLength = snprintf(job->eventName, sizeof(job->eventName), "%s/%.*sevnt%s", outDir, (int)(data - name), name, data + 4);
+  else
+    eventLength = snprintf(job->eventName, sizeof(job->eventName), "%s/%.*s_evnt%s", outDir, dot ? (int)(dot - name) : (int)strlen(name), name, dot ? dot : "");
+  if (snprintf(job->inName, sizeof(job->inName), "%s", path) >= (int)sizeof(job->inName) ||
+      snprintf(job->dataName, sizeof(job->dataName), "%s/%s", outDir, name) >= (int)sizeof(job->dataName) ||
+      eventLength >= (int)sizeof(job->eventName))
+  {
+    fprintf(stderr, "reprocess: the name of %s or of its outputs in %s is longer than %d characters, not processed\n", path, outDir, DATA_SCAN_PATH_MAX - 1);
+    return;
+  }
+  for (int j = 0; j < nJobs; j++)
+  {
+    if (!strcmp(jobs[j].dataName, job->dataName))
+    {
+      fprintf(stderr, "reprocess: %s and %s would both be written to %s, %s not processed\n", jobs[j].inName, path, job->dataName, path);
+      return;
+    }
+  }
+  struct stat info;
+  job->bytes = stat(path, &info) == 0 ? info.st_size : 0;
+  nJobs++;
+}
+
+// make a directory and the directories it is in
+void makeDirectories(const char *path)
+{
+  char partial[DATA_SCAN_PATH_MAX];
+  snprintf(partial, sizeof(partial), "%s", path);
+  for (char *p = partial + 1; *p; p++)
+  {
+    if (*p == '/')
+    {
+      *p = 0;
+      mkdir(partial, 0755);
+      *p = '/';
+    }
+  }
+  mkdir(partial, 0755);
+}
+
+int parseStreamOption(const char *value, char *nickName, const char **rest)
+{
+  const char *equals = strchr(value, '=');
+  int length = equals ? (int)(equals - value) : (int)strlen(value);
+  if (length == 0 || length >= DATA_NAME_SHORT)
+  {
+    return 0;
+  }
+  memcpy(nickName, value, length);
+  nickName[length] = 0;
+  *rest = equals ? equals + 1 : NULL;
+  return 1;
+}
+
+streamSetting *settingFor(const char *nickName)
+{
+  streamSetting *setting = findSetting(nickName);
+  if (!setting && nSettings < MAX_SETTINGS)
+  {
+    setting = &settings[nSettings++];
+    snprintf(setting->nickName, sizeof(setting->nickName), "%s", nickName);
+    setting->outputStats = -2;
+    setting->calcTrendline = 0;
+    setting->baselineType = 0;
+    setting->baseline = 0.;
+  }
+  return setting;
+}
+
+int main(int argc, char **argv)
+{
+  int nThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  int bench = 0;
+  int repeat = 1;
+  const char *paths[MAX_INPUTS];
+  int nPaths = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2))
+    {
+      if (nPaths < MAX_INPUTS)
+        paths[nPaths++] = arg;
+      continue;
+    }
+    if (!strcmp(arg, "--bench"))
+    {
+      bench = 1;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[++i] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    char nickName[DATA_NAME_SHORT];
+    const char *rest;
+    if (!strcmp(arg, "--out"))
+      snprintf(outRoot, sizeof(outRoot), "%s", value);
+    else if (!strcmp(arg, "--rows"))
+      rowsPerOutput = atoi(value) > 0 ? atoi(value) : 1;
+    else if (!strcmp(arg, "--interval-ms"))
+      intervalMillis = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--baseline-rows"))
+      baselineRows = atoi(value);
+    else if (!strcmp(arg, "--threads"))
+      nThreads = atoi(value);
+    else if (!strcmp(arg, "--repeat"))
+      repeat = atoi(value) > 0 ? atoi(value) : 1;
+    else if (!strcmp(arg, "--stats") && !strchr(value, '='))
+      defaultOutputStats = atoi(value);
+    else if (!strcmp(arg, "--stats") && parseStreamOption(value, nickName, &rest) && settingFor(nickName))
+      settingFor(nickName)->outputStats = atoi(rest);
+    else if (!strcmp(arg, "--trend") && parseStreamOption(value, nickName, &rest) && settingFor(nickName))
+      settingFor(nickName)->calcTrendline = 1;
+    else if (!strcmp(arg, "--baseline") && parseStreamOption(value, nickName, &rest) && rest && settingFor(nickName))
+    {
+      streamSetting *setting = settingFor(nickName);
+      setting->baselineType = strcmp(rest, "auto") ? 1 : 2;
+      setting->baseline = atof(rest);
+    }
+    else if (!strcmp(arg, "--event") && nThresholds < MAX_EVENTS)
+    {
+      thresholdSetting *threshold = &thresholds[nThresholds];
+      const char *comma = strchr(value, ',');
+      int length = comma ? (int)(comma - value) : 0;
+      if (length == 0 || length >= DATA_NAME_SHORT)
+      {
+        fprintf(stderr, "--event needs NAME,BP1[,BP2[,BP3]]\n");
+        return 2;
+      }
+      snprintf(threshold->nickName, sizeof(threshold->nickName), "%.*s", length, value);
+      threshold->nBreakpoints = 0;
+      for (const char *p = comma; p && threshold->nBreakpoints < THRESHOLD_BREAKPOINTS; p = strchr(p + 1, ','))
+      {
+        threshold->breakpoint[threshold->nBreakpoints++] = atof(p + 1);
+      }
+      for (int k = threshold->nBreakpoints; k < THRESHOLD_BREAKPOINTS; k++)
+      {
+        threshold->breakpoint[k] = 0.;
+      }
+      nThresholds++;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s %s\n", arg, value);
+      return 2;
+    }
+  }
+  if (nPaths == 0)
+  {
+    fprintf(stderr, "usage: reprocess [options] PATH...\n");
+    return 2;
+  }
+  if (nThreads < 1)
+    nThreads = 1;
+  if (nThreads > MAX_THREADS)
+    nThreads = MAX_THREADS;
+
+  for (int k = 0; k < nPaths; k++)
+  {
+    listDataFilesTo(paths[k], outRoot, addJob);
+  }
+  if (nJobs == 0)
+  {
+    fprintf(stderr, "reprocess: no data files\n");
+    return 1;
+  }
+
+  if (bench)
+  {
+    // warm the page cache, then time each thread count
+    runJobs(1, 0);
+    printf("threads\tfiles\trows\tMB\tseconds\trows/s\tGB/s\tspeedup\tstolen\n");
+    double oneThread = 0.;
+    for (int n = 1; n <= nThreads; n = (n * 2 > nThreads && n < nThreads) ? nThreads : n * 2)
+    {
+      double seconds = 0.;
+      unsigned long rows = 0;
+      double bytes = 0.;
+      unsigned long stolen = 0;
+      for (int r = 0; r < repeat; r++)
+      {
+        seconds += runJobs(n, 0);
+        for (int j = 0; j < nJobs; j++)
+        {
+          rows += jobs[j].rows;
+          bytes += jobs[j].bytes;
+        }
+        for (int t = 0; t < n; t++)
+        {
+          stolen += workers[t].stolen;
+        }
+      }
+      if (n == 1)
+        oneThread = seconds;
+      printf("%d\t%d\t%lu\t%.1f\t%.3f\t%.0f\t%.3f\t%.2f\t%lu\n", n, nJobs * repeat, rows, bytes / 1e6, seconds,
+             rows / seconds, bytes / seconds / 1e9, oneThread / seconds, stolen);
+    }
+    return 0;
+  }
+
+  // the output directories, made before the workers start
+  for (int j = 0; j < nJobs; j++)
+  {
+    char outDir[DATA_SCAN_PATH_MAX];
+    snprintf(outDir, sizeof(outDir), "%s", jobs[j].dataName);
+    *strrchr(outDir, '/') = 0;
+    makeDirectories(outDir);
+  }
+
+  double seconds = runJobs(nThreads, 1);
+  unsigned long rows = 0;
+  unsigned long outputs = 0;
+  unsigned long changes = 0;
+  double bytes = 0.;
+  int failed = 0;
+  for (int j = 0; j < nJobs; j++)
+  {
+    if (jobs[j].error)
+    {
+      fprintf(stderr, "reprocess: %s: %s\n", jobs[j].inName, jobs[j].error);
+      failed++;
+      continue;
+    }
+    rows += jobs[j].rows;
+    outputs += jobs[j].outputs;
+    changes += jobs[j].changes;
+    bytes += jobs[j].bytes;
+  }
+  fprintf(stderr, "reprocess: %d files (%d skipped), %lu rows in, %lu rows and %lu event changes out, %.1f MB in %.3f s with %d threads (%.0f rows/s, %.3f GB/s)\n",
+          nJobs - failed, failed, rows, outputs, changes, bytes / 1e6, seconds, nThreads,
+          seconds > 0. ? rows / seconds : 0., seconds > 0. ? bytes / seconds / 1e9 : 0.);
+  return failed == nJobs ? 1 : 0;
+}
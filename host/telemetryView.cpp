@@ -0,0 +1,466 @@
+// telemetryView.cpp
+// reads the binary telemetry of a logger built with ENABLE_SERIAL_TELEMETRY (see serialTelemetry.h)
+// from a serial device or a capture of one, and prints the tables and event reports the logger
+// prints as text without it
+//
+//  frames are split at the zero bytes and checked with their CRC; anything between zero bytes that
+//  is not a frame (the startup messages, DEBUG output) is printed as it is, and a frame that fails
+//  its CRC (or is cut off by the end of a capture) is counted as damaged and dropped. statistics
+//  need the schema (names and units): on a serial device the schema is requested when the viewer
+//  starts and whenever the statistics carry a schemaId the viewer has not seen; a capture that
+//  starts after the schema was sent prints the streams by number
+//
+//  build:  host/build.sh
+//  usage:  host/telemetryView [--baud N] SOURCE
+//    SOURCE is a serial device (e.g. /dev/ttyACM0, set to raw mode at N baud, default 115200), a
+//    file, or "-" for stdin. prints to stdout; a summary of the frames goes to stderr at the end
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#define MAX_STREAMS 256
+#define MAX_EVENTS 256
+#define MAX_STATES 20
+#define NAME_MAX_BYTES 256
+#define FRAME_MAX_BYTES 4096
+
+struct streamSchema
+{
+  char nick[NAME_MAX_BYTES];
+  char units[NAME_MAX_BYTES];
+  char name[NAME_MAX_BYTES];
+};
+
+struct eventSchema
+{
+  char nick[NAME_MAX_BYTES];
+  char name[NAME_MAX_BYTES];
+  int numStates;
+  char states[MAX_STATES][NAME_MAX_BYTES];
+};
+
+int haveSchema = 0;
+uint16_t schemaId = 0;
+int nStreams = 0;
+int nEvents = 0;
+char deviceCode[NAME_MAX_BYTES];
+char deviceName[NAME_MAX_BYTES] = "?";
+streamSchema streams[MAX_STREAMS];
+eventSchema events[MAX_EVENTS];
+
+// counters for the summary
+unsigned long framesByType[256];
+unsigned long badFrames = 0;
+unsigned long textBytes = 0;
+unsigned long staleStats = 0;
+unsigned long requests = 0;
+int staleSinceRequest = 0; // statistics without the schema since the last request (asks again every 10)
+
+// same CRC as crc16Update() in logSD.h
+uint16_t crc16(const uint8_t *bytes, int length)
+{
+  uint16_t crc = 0xFFFF;
+  for (int k = 0; k < length; k++)
+  {
+    crc ^= ((uint16_t)bytes[k]) << 8;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// decode a COBS frame (without its delimiters) into payload; returns the payload length without
+// the CRC, or -1 if it is not a valid frame
+int decodeFrame(const uint8_t *frame, int length, uint8_t *payload)
+{
+  int out = 0;
+  int k = 0;
+  while (k < length)
+  {
+    int code = frame[k++];
+    if (k + code - 1 > length)
+      return -1;
+    for (int j = 1; j < code; j++)
+      payload[out++] = frame[k++];
+    if (code < 255 && k < length)
+      payload[out++] = 0;
+  }
+  if (out < 3)
+    return -1;
+  uint16_t crc = crc16(payload, out - 2);
+  if (payload[out - 2] != (uint8_t)(crc >> 8) || payload[out - 1] != (uint8_t)(crc & 0xFF))
+    return -1;
+  return out - 2;
+}
+
+// send a frame (e.g. the schema request) to the logger
+void sendFrame(int fd, const uint8_t *payload, int length)
+{
+  uint8_t body[64];
+  memcpy(body, payload, length);
+  uint16_t crc = crc16(payload, length);
+  body[length++] = (uint8_t)(crc >> 8);
+  body[length++] = (uint8_t)(crc & 0xFF);
+  uint8_t frame[80];
+  int n = 0;
+  frame[n++] = 0;
+  for (int k = 0; k <= length;)
+  {
+    int run = 0;
+    while (k + run < length && body[k + run] != 0)
+      run++;
+    frame[n++] = (uint8_t)(run + 1);
+    memcpy(frame + n, body + k, run);
+    n += run;
+    k += run + 1;
+  }
+  frame[n++] = 0;
+  if (write(fd, frame, n) != n)
+    fprintf(stderr, "telemetryView: cannot send to the logger\n");
+}
+
+void requestSchema(int fd)
+{
+  uint8_t request = 'R';
+  sendFrame(fd, &request, 1);
+  requests++;
+  staleSinceRequest = 1;
+}
+
+// reads the fields of a payload in order (past the end they read as zero)
+struct payloadReader
+{
+  const uint8_t *bytes;
+  int length;
+  int at;
+
+  uint32_t get(int size)
+  {
+    uint32_t value = 0;
+    for (int k = 0; k < size; k++, at++)
+      if (at < length)
+        value |= ((uint32_t)bytes[at]) << (8 * k);
+    return value;
+  }
+  uint8_t u8() { return (uint8_t)get(1); }
+  uint16_t u16() { return (uint16_t)get(2); }
+  uint32_t u32() { return get(4); }
+  float f32()
+  {
+    uint32_t bits = get(4);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  void str(char *text)
+  {
+    int n = u8();
+    int k = 0;
+    for (; k < n; k++, at++)
+      text[k] = at < length ? (char)bytes[at] : 0;
+    text[k] = 0;
+  }
+};
+
+// a value the way Print::print(double) does it
+void printFloat(float value)
+{
+  if (isnan(value))
+    printf("nan");
+  else if (isinf(value))
+    printf("inf");
+  else if (value > 4294967040.0 || value < -4294967040.0)
+    printf("ovf");
+  else
+    printf("%.2f", (double)value);
+}
+
+// the table of printSampleStatTable() with tabs between the columns
+void printStats(payloadReader *in)
+{
+  in->u16(); // schemaId, checked by the caller
+  in->u32(); // millis
+  int n = in->u8();
+  float current[MAX_STREAMS], average[MAX_STREAMS], deviation[MAX_STREAMS];
+  uint32_t size[MAX_STREAMS];
+  for (int i = 0; i < n; i++)
+  {
+    current[i] = in->f32();
+    average[i] = in->f32();
+    deviation[i] = in->f32();
+    size[i] = in->u32();
+  }
+  int named = haveSchema && n <= nStreams;
+  printf("\r\n---- Sample Data Summary for Device = %s ------------------------\r\n", deviceName);
+  printf("DataNames");
+  for (int i = 0; i < n; i++)
+    named ? printf("\t%s", streams[i].nick) : printf("\t%d", i);
+  printf("\r\nDataUnits");
+  for (int i = 0; i < n; i++)
+    printf("\t%s", named ? streams[i].units : "?");
+  printf("\r\nCurrentData");
+  for (int i = 0; i < n; i++)
+  {
+    printf("\t");
+    printFloat(current[i]);
+  }
+  printf("\r\nAverageData");
+  for (int i = 0; i < n; i++)
+  {
+    printf("\t");
+    printFloat(average[i]);
+  }
+  printf("\r\nStandardDev");
+  for (int i = 0; i < n; i++)
+  {
+    printf("\t");
+    if (isnan(deviation[i]))
+      printf("N/A");
+    else
+      printFloat(deviation[i]);
+  }
+  printf("\r\nSampleSize");
+  for (int i = 0; i < n; i++)
+    printf("\t%u", size[i]);
+  printf("\r\n");
+}
+
+// the report of reportEventToSerial()
+void printEvent(payloadReader *in)
+{
+  int j = in->u8();
+  uint32_t timeLastChange = in->u32();
+  int prior = in->u8();
+  int state = in->u8();
+  uint32_t duration = in->u32();
+  int named = haveSchema && j < nEvents;
+  char number[3][16];
+  snprintf(number[0], sizeof(number[0]), "%d", j);
+  snprintf(number[1], sizeof(number[1]), "%d", prior);
+  snprintf(number[2], sizeof(number[2]), "%d", state);
+  printf("EVENT: millis = %u event %s ----------------------------------------------\r\n", timeLastChange,
+         named ? events[j].name : number[0]);
+  printf("FROM state = %s\r\n", named && prior < events[j].numStates ? events[j].states[prior] : number[1]);
+  printf("TO state = %s previous state duration = %u\r\n", named && state < events[j].numStates ? events[j].states[state] : number[2],
+         duration);
+}
+
+void printDiagnostics(payloadReader *in)
+{
+  uint32_t millisNow = in->u32();
+  uint32_t bytes = in->u32();
+  uint32_t frames = in->u32();
+  uint32_t dropped = in->u32();
+  int high = in->u16();
+  uint32_t writeMicros = in->u32();
+  uint32_t serialMillis = in->u32();
+  uint32_t dataMillis = in->u32();
+  printf("telemetry: millis = %u, %u bytes, %u frames, %u dropped, ring high %d bytes, %.1f ms in Serial.write, serial output %u ms, data file output %u ms\r\n",
+         millisNow, bytes, frames, dropped, high, writeMicros / 1000., serialMillis, dataMillis);
+}
+
+// text (the startup messages, DEBUG output) rather than a damaged frame
+int isText(const uint8_t *chunk, int length)
+{
+  for (int j = 0; j < length; j++)
+  {
+    if (chunk[j] < 0x20 && chunk[j] != '\r' && chunk[j] != '\n' && chunk[j] != '\t')
+      return 0;
+  }
+  return 1;
+}
+
+void handlePayload(int fd, int isDevice, const uint8_t *payload, int length)
+{
+  payloadReader in = {payload, length, 1};
+  uint8_t type = payload[0];
+  framesByType[type]++;
+  switch (type)
+  {
+  case 'D':
+    schemaId = in.u16();
+    nStreams = in.u8();
+    nEvents = in.u8();
+    in.str(deviceCode);
+    in.str(deviceName);
+    haveSchema = 1;
+    staleSinceRequest = 0;
+    break;
+  case 's':
+  {
+    int i = in.u8();
+    in.str(streams[i].nick);
+    in.str(streams[i].units);
+    in.str(streams[i].name);
+    break;
+  }
+  case 'e':
+  {
+    int j = in.u8();
+    in.str(events[j].nick);
+    in.str(events[j].name);
+    events[j].numStates = in.u8();
+    if (events[j].numStates > MAX_STATES)
+      events[j].numStates = MAX_STATES;
+    for (int k = 0; k < events[j].numStates; k++)
+      in.str(events[j].states[k]);
+    break;
+  }
+  case 'T':
+  {
+    uint16_t id = payload[1] | (payload[2] << 8);
+    if (!haveSchema || id != schemaId)
+    {
+      staleStats++;
+      haveSchema = 0; // print by number until the new schema arrives
+      if (isDevice && staleSinceRequest++ % 10 == 0)
+        requestSchema(fd);
+    }
+    printStats(&in);
+    break;
+  }
+  case 'E':
+    printEvent(&in);
+    break;
+  case 'G':
+    printDiagnostics(&in);
+    break;
+  default:
+    break;
+  }
+  fflush(stdout);
+}
+
+speed_t baudConstant(long baud)
+{
+  switch (baud)
+  {
+  case 9600:
+    return B9600;
+  case 19200:
+    return B19200;
+  case 38400:
+    return B38400;
+  case 57600:
+    return B57600;
+  case 230400:
+    return B230400;
+  case 460800:
+    return B460800;
+  case 921600:
+    return B921600;
+  default:
+    return B115200;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  long baud = 115200;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg += 2)
+  {
+    if (!strcmp(argv[arg], "--baud") && arg + 1 < argc)
+      baud = strtol(argv[arg + 1], NULL, 10);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[arg]);
+      return 2;
+    }
+  }
+  if (argc - arg != 1)
+  {
+    fprintf(stderr, "usage: telemetryView [--baud N] SOURCE\n");
+    return 2;
+  }
+  const char *source = argv[arg];
+  int fd = !strcmp(source, "-") ? 0 : open(source, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+    fd = open(source, O_RDONLY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "cannot read %s\n", source);
+    return 2;
+  }
+  int isDevice = isatty(fd) && fd != 0;
+  if (isDevice)
+  {
+    struct termios tty;
+    if (tcgetattr(fd, &tty) == 0)
+    {
+      cfmakeraw(&tty);
+      cfsetispeed(&tty, baudConstant(baud));
+      cfsetospeed(&tty, baudConstant(baud));
+      tty.c_cc[VMIN] = 1;
+      tty.c_cc[VTIME] = 0;
+      tcsetattr(fd, TCSANOW, &tty);
+    }
+    requestSchema(fd);
+  }
+
+  static uint8_t chunk[FRAME_MAX_BYTES];
+  static uint8_t payload[FRAME_MAX_BYTES];
+  int chunkBytes = 0;
+  int overflow = 0;
+  uint8_t buffer[4096];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+  {
+    for (ssize_t k = 0; k < n; k++)
+    {
+      if (buffer[k] != 0)
+      {
+        if (chunkBytes < FRAME_MAX_BYTES)
+          chunk[chunkBytes++] = buffer[k];
+        else
+        {
+          // too long for a frame: text, printed as it comes
+          fwrite(chunk, 1, chunkBytes, stdout);
+          textBytes += chunkBytes;
+          chunkBytes = 0;
+          overflow = 1;
+          chunk[chunkBytes++] = buffer[k];
+        }
+        continue;
+      }
+      if (chunkBytes > 0)
+      {
+        int length = overflow ? -1 : decodeFrame(chunk, chunkBytes, payload);
+        if (length > 0)
+          handlePayload(fd, isDevice, payload, length);
+        else
+        {
+          // text, or a frame damaged by text written into it
+          if (isText(chunk, chunkBytes))
+          {
+            fwrite(chunk, 1, chunkBytes, stdout);
+            textBytes += chunkBytes;
+          }
+          else
+            badFrames++;
+        }
+      }
+      chunkBytes = 0;
+      overflow = 0;
+    }
+  }
+  // the capture ends in text or in the middle of a frame
+  if (chunkBytes > 0 && isText(chunk, chunkBytes))
+  {
+    fwrite(chunk, 1, chunkBytes, stdout);
+    textBytes += chunkBytes;
+  }
+  else if (chunkBytes > 0)
+    badFrames++;
+
+  fprintf(stderr, "telemetryView: %lu statistics, %lu events, %lu diagnostics, %lu schema frames, %lu damaged frames, %lu bytes of text, %lu statistics without a matching schema, %lu schema requests\n",
+          framesByType['T'], framesByType['E'], framesByType['G'], framesByType['D'] + framesByType['s'] + framesByType['e'],
+          badFrames, textBytes, staleStats, requests);
+  return 0;
+}
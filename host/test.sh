@@ -0,0 +1,596 @@
+#!/bin/sh
+# test.sh
+# builds the host programs (build.sh) and runs the host tests; prints PASS or FAIL for each check
+# and exits 1 if any check failed
+#   hostLogger runs with fixed seeds and options are compared with the reference files in
+#   testdata/ (lines with the compile date and time left out), and the host tools check the
+#   files they read
+#
+#  usage:  host/test.sh [--update]
+#    --update   write the reference files of testdata/ from this build instead of comparing
+#
+# the ENABLE_ variants of hostLogger are built into a temporary directory, with the flags of build.sh
+cd "$(dirname "$0")" || exit 1
+sh build.sh || exit 1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-O2 -g -Wall -Wextra -I."}
+SKETCHFLAGS=${SKETCHFLAGS:-"-fpermissive -Wno-write-strings"}
+update=0
+if [ "$1" = "--update" ]; then
+  update=1
+fi
+work=$(mktemp -d "${TMPDIR:-/tmp}/loggerTest.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+# check NAME COMMAND...: run a check, printing the end of its output if it fails
+check() {
+  name=$1
+  shift
+  if "$@" > "$work/check.out" 2>&1; then
+    echo "PASS $name"
+  else
+    echo "FAIL $name"
+    tail -n 20 "$work/check.out" | sed 's/^/    /'
+    failures=$((failures + 1))
+  fi
+}
+
+# logger NAME FLAGS: build hostLogger with extra -D flags as $work/NAME
+logger() {
+  $CXX $CXXFLAGS $SKETCHFLAGS $2 -o "$work/$1" hostLogger.cpp || exit 1
+}
+
+# same REFERENCE DIR: the files of the card DIR match testdata/REFERENCE (or become it with --update)
+same() {
+  if [ $update -eq 1 ]; then
+    rm -rf "testdata/$1"
+    mkdir -p "testdata/$1"
+  fi
+  status=0
+  for file in $(cd "$2" && find . -type f | sort); do
+    grep -v 'ompiled' "$2/$file" > "$work/filtered"
+    if [ $update -eq 1 ]; then
+      mkdir -p "$(dirname "testdata/$1/$file")"
+      cp "$work/filtered" "testdata/$1/$file"
+    elif ! cmp -s "$work/filtered" "testdata/$1/$file"; then
+      echo "$file differs from testdata/$1/$file"
+      diff "testdata/$1/$file" "$work/filtered" | head -n 10
+      status=1
+    fi
+  done
+  if [ $update -eq 0 ] && [ "$(cd "$2" && find . -type f | wc -l)" -ne "$(cd "testdata/$1" && find . -type f | wc -l)" ]; then
+    echo "the files of $2 are not those of testdata/$1"
+    status=1
+  fi
+  return $status
+}
+
+# passes DATAFILE OUTPUT: the loopt_n counts of the rows of DATAFILE add up to the passes that
+# hostLogger reported in OUTPUT, less those of the period still open at the end
+passes() {
+  awk -F', *' -v out="$2" '
+    BEGIN { while ((getline line < out) > 0) if (line ~ /^hostLogger: [0-9]+ passes/) { split(line, w, " "); passes = w[2] } }
+    /^A,0,/ { for (i = 1; i <= NF; i++) if ($i == "loopt_n") column = i }
+    /^A, / && column { sum += $column; last = $column }
+    END {
+      printf "%d passes, %d in the rows of the data file\n", passes, sum
+      exit !(column && sum <= passes && passes - sum <= 2 * last)
+    }' "$1"
+}
+
+# unplug FILE BYTES OUT: FILE as the card holds it after losing power BYTES into it: the rest of its
+# extent is zero bytes and its recorded length is as it was
+unplug() {
+  head -c "$2" "$1" > "$3"
+  head -c $(($(wc -c < "$1") - $2)) /dev/zero >> "$3"
+}
+
+# rows FILE BYTES: the complete lines of the first BYTES bytes of FILE, without the length line
+rows() {
+  LC_ALL=C awk -v bytes="$2" '{ count += length($0) + 1; if (count <= bytes) print }' "$1" | grep -v 'Datlogger Length'
+}
+
+# poke FILE OFFSET CHARACTER: overwrite the byte of FILE at OFFSET, as a bad sector or a torn write would
+poke() {
+  printf '%s' "$3" | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# button FILE: the ButS rows of the event file FILE enter PRESS and RELEASE in turn (no change is
+# missing between two rows) and the button ends released
+button() {
+  awk -F, '
+    $4 == "ButS" && $5 == "TO" {
+      if ($6 == state) { print "row " $2 " enters " state " again"; bad = 1 }
+      state = $6
+      changes++
+    }
+    END { print changes " changes of ButS, last " state; exit bad || state != "RELEASE" }' "$1"
+}
+
+# columns FILE REGEX [other]: the columns of the data rows of FILE whose names match REGEX (with
+# "other", the columns whose names do not)
+columns() {
+  awk -F', *' -v pattern="$2" -v other="$3" '
+    /^A,0,/ { for (i = 3; i <= NF; i++) use[i] = ($i ~ pattern) != (other == "other") }
+    /^A, / { row = ""; for (i = 3; i <= NF; i++) if (use[i]) row = row " " $i; print row }' "$1"
+}
+
+# query FILE OPTIONS...: timeQuery through the index of FILE prints rows, and the rows of a scan
+# of the whole file
+query() {
+  file=$1
+  shift
+  ./timeQuery "$@" "$file" > "$work/indexed.rows" || return 1
+  ./timeQuery --scan "$@" "$file" > "$work/scanned.rows" || return 1
+  [ "$(wc -l < "$work/indexed.rows")" -gt 2 ] && cmp "$work/indexed.rows" "$work/scanned.rows"
+}
+
+# tables FILE: the statistics tables and event reports of the Serial output FILE (text, or printed by
+# telemetryView), without the debug messages that can land inside a table
+tables() {
+  perl -0777 -pe 's/\r\n(W{43}|-{41})\r\n[^\r\n]*\r\n\1\r\n\r\n//g; s/DEBUG\d?: var: [^\r\n]*\r\n//g' "$1" |
+    awk '/^---- Sample Data Summary/ { n = 7 } n > 0 { print; n-- } /^EVENT: |^FROM state|^TO state/' | tr -d '\r'
+}
+
+# frames FILE: the offset and length of each statistics frame (type T, not text) in the telemetry
+# capture FILE, one per line
+frames() {
+  perl -0777 -ne 'while (/\x00([^\x00]T[^\x00]*)(?=\x00)/g) { my ($at, $frame) = ($-[1], $1); print "$at ", length($frame), "\n" if $frame =~ /[^\x20-\x7e\r\n\t]/ }' "$1"
+}
+
+# refused PATTERN COMMAND...: COMMAND exits with an error status and says PATTERN on stderr
+refused() {
+  pattern=$1
+  shift
+  if "$@" > /dev/null 2> "$work/refused.err"; then
+    echo "no error from $*"
+    return 1
+  fi
+  cat "$work/refused.err"
+  grep -q "$pattern" "$work/refused.err"
+}
+
+# damage FILE RUNS SEED: RUNS copies of the group commit data FILE, cut off or with one byte changed
+# at random offsets among its rows; recoverLog keeps every row that ends before the damage and
+# writes no row that fails its CRC
+damage() {
+  first=$(grep -abo '^A, ' "$1" | head -n 1 | cut -d: -f1)
+  awk -v runs="$2" -v seed="$3" -v first="$first" -v size="$(wc -c < "$1")" 'BEGIN {
+      srand(seed)
+      for (k = 0; k < runs; k++)
+        print (k % 2 ? "cut" : "change"), first + int(rand() * (size - first)), 1 + int(rand() * 255)
+    }' | while read -r how at bits; do
+    if [ "$how" = cut ]; then
+      head -c "$at" "$1" > "$work/damaged.csv"
+    else
+      perl -0777 -pe "substr(\$_, $at, 1) = chr(ord(substr(\$_, $at, 1)) ^ $bits)" "$1" > "$work/damaged.csv"
+    fi
+    perl -0777 -ne "print substr(\$_, 0, rindex(\$_, \"\\n\", $at - 1) + 1)" "$1" > "$work/damaged.before"
+    ./recoverLog "$work/damaged.csv" "$work/damaged.recovered.csv" > /dev/null
+    if ! ./recoverLog --check "$work/damaged.recovered.csv" > "$work/damaged.out"; then
+      echo "$how at byte $at: rows with a bad CRC recovered"
+      cat "$work/damaged.out"
+      return 1
+    fi
+    if ! cmp -n "$(wc -c < "$work/damaged.before")" "$work/damaged.before" "$work/damaged.recovered.csv"; then
+      echo "$how at byte $at: rows before it lost"
+      return 1
+    fi
+  done
+}
+
+# numbered CARD CODE FIRST LAST: empty data files FIRST to LAST of device CODE on CARD
+numbered() {
+  mkdir -p "$1/d210118"
+  seq -f "$1/d210118/$2data%03g.csv" "$3" "$4" | xargs touch
+}
+
+# startsAt CARD NUMBER: hostLogger started on CARD logs to data file NUMBER and leaves the next
+# number in the marker file
+startsAt() {
+  ./hostLogger --seconds 1 --seed 12345 --sd "$1" > /dev/null 2>&1
+  grep -q '^A, ' "$1/d210118/Adata$2.csv" || return 1
+  [ "$(tr -d '\r' < "$1/d210118/Adata.nxt")" = "$(expr "$2" + 1)" ]
+}
+
+# steps FILE MS: between every two rows of the data file FILE the unixTime column moves with the
+# CPU time column (to within MS ms, both are rounded), so the absolute time is never stepped
+steps() {
+  awk -F', *' -v ms="$2" '
+    /^A,0,/ { for (i = 3; i <= NF; i++) { if ($i == "unixTime") u = i; if ($i == "CPUt_cv") t = i } }
+    /^A, / && u && t {
+      if (rows++) { d = ($u - last) - ($t - cpu); d = d < 0 ? -d : d; worst = d > worst ? d : worst }
+      last = $u
+      cpu = $t
+    }
+    END { printf "largest step %.3f s over %d rows\n", worst, rows; exit !(rows > 1 && worst * 1000 <= ms) }' "$1"
+}
+
+# arrow ARROW CSV...: read with pyarrow, the file exportArrow wrote from the data files CSV... (in
+# that order) has the schema of exportArrow.cpp and their values, with nulls where a file has no value
+arrow() {
+  python3 - "$@" << 'EOF'
+import sys
+import pyarrow as pa
+import pyarrow.ipc as ipc
+
+table = ipc.open_file(sys.argv[1]).read_all()
+errors = []
+
+
+def expect(ok, message):
+    if not ok:
+        errors.append(message)
+
+
+def typeOf(name):
+    return table.schema.field(name).type
+
+
+expect(typeOf("deviceCode") == pa.dictionary(pa.int32(), pa.string()), "deviceCode is %s" % typeOf("deviceCode"))
+expect(typeOf("count") == pa.int32(), "count is %s" % typeOf("count"))
+expect(typeOf("time") == pa.timestamp("ms", tz="UTC"), "time is %s" % typeOf("time"))
+rows = []
+for name in sys.argv[2:]:
+    header = []
+    for line in open(name, newline=""):
+        fields = [field.strip() for field in line.rstrip("\r\n").split(",")]
+        if line.startswith("A,0,"):
+            header = [field for field in fields[2:] if field]
+        elif line.startswith("A, ") and header:
+            rows.append((fields[0], int(fields[1]), dict(zip(header, fields[2:]))))
+    for column in header:
+        field = table.schema.field(column)
+        stream, stat = column.rsplit("_", 1)
+        expect(field.type == (pa.int32() if stat == "n" else pa.float32()), "%s is %s" % (column, field.type))
+        metadata = field.metadata or {}
+        expect(metadata.get(b"stream") == stream.encode() and metadata.get(b"stat") == stat.encode(), "%s has %s" % (column, metadata))
+        expect((b"unit" in metadata) == (stat in ("cv", "av", "sd", "re")), "%s has %s" % (column, metadata))
+expect(table.num_rows == len(rows), "%d rows, %d in the data files" % (table.num_rows, len(rows)))
+times = table.column("time").cast(pa.int64()).to_pylist()
+for k, row in enumerate(table.to_pylist()[: len(rows)]):
+    code, count, values = rows[k]
+    expect(row["deviceCode"] == code and row["count"] == count, "row %d is %s %s" % (k, row["deviceCode"], row["count"]))
+    # the files were created on 18 January 2021 at 0:00 UTC and their rows are SAMPLING_PERIOD apart
+    expect(times[k] == 1610928000000 + count * 400, "row %d time %s" % (k, times[k]))
+    for column, value in row.items():
+        if column in ("deviceCode", "count", "time"):
+            continue
+        text = values.get(column, "N//A")
+        if text in ("N//A", ""):
+            expect(value is None, "row %d %s is %s, not null" % (k, column, value))
+        else:
+            expected = float(text)
+            expect(value is not None and abs(value - expected) <= 1e-6 * max(1.0, abs(expected)), "row %d %s is %s, not %s" % (k, column, value, text))
+for message in errors[:10]:
+    print(message)
+print("%d rows, %d columns, %d differences" % (table.num_rows, table.num_columns, len(errors)))
+sys.exit(1 if errors else 0)
+EOF
+}
+
+# ---------------------------------------------------------------------------------------------
+# the sketch as it is configured, against its reference files
+
+./hostLogger --seconds 60 --seed 12345 --sd "$work/default" > /dev/null 2>&1
+check "default run matches testdata/default" same default "$work/default"
+
+# ---------------------------------------------------------------------------------------------
+# the modules on the virtual clock (testHost.cpp)
+
+check "loop timing on scripted passes" ./testHost TIMING
+check "profiled regions and their report" ./testHost PROFILE
+check "IMU FIFO drains of scripted contents" ./testHost FIFO
+check "rate group schedules and statistics" ./testHost RATE
+check "time base across rollovers and RTC drift" ./testHost TIME
+check "fast math kernels within their error bounds" ./testHost ACCURACY
+check "derived streams and their evaluations" ./testHost DERIVED
+check "adaptive intervals resolve the bursts" ./testHost ADAPTIVE
+$CXX $CXXFLAGS $SKETCHFLAGS -DTEST_WITHOUT_RATE_GROUPS -o "$work/testMainGroup" testHost.cpp || exit 1
+check "adaptive intervals resolve the bursts without rate groups" "$work/testMainGroup" ADAPTIVE
+check "capture windows read back as they were fed in" ./testHost --sd "$work/capture" CAPTURE
+
+# ---------------------------------------------------------------------------------------------
+# the output queue with a slow card that is removed for 40 s: the rows written while the card is
+# missing are rolled up, so no pass is lost and nothing is dropped
+
+logger queue "-DENABLE_OUTPUT_QUEUE"
+"$work/queue" --seconds 120 --seed 12345 --sd-write-us 2000 --sd-remove 30 --sd-insert 70 --sd "$work/queue.sd" > "$work/queue.out" 2>&1
+check "output queue recovers a removed card" grep ' 0 dropped .* 1 card failures, 1 recoveries' "$work/queue.out"
+check "output queue loses no pass while the card is out" passes "$work/queue.sd/d210118/Adata000.csv" "$work/queue.out"
+
+# ---------------------------------------------------------------------------------------------
+# files rotated on the minute of the wall clock: the files are opened before the clock is anchored
+# to the RTC, and the first minute still lands in file 000 rather than leaving it header-only
+
+logger rotated "-DENABLE_ABSOLUTE_TIME -DENABLE_LOG_ROTATION -DLOG_ROTATE_PERIOD=60"
+"$work/rotated" --seconds 150 --seed 12345 --sd "$work/rotated.sd" > /dev/null 2>&1
+check "wall-clock rotation keeps the rows of the first period" grep -q '^A, ' "$work/rotated.sd/d210118/Adata000.csv"
+check "wall-clock rotation starts a data file each minute" sh -c "ls '$work/rotated.sd/d210118' | grep -c 'Adata00[0-9].csv' | grep -qx 3"
+
+# ---------------------------------------------------------------------------------------------
+# the next file number at startup: from the marker file, past a stale marker whose file exists,
+# by binary search without a marker, and among more than a thousand files; setup_SD_file() of the
+# startup benchmark stays within its SD opens and lookups in directories of 4000 files
+
+numbered "$work/marker.sd" A 0 6
+printf '7\r\n' > "$work/marker.sd/d210118/Adata.nxt"
+check "startup takes the file number of the marker" startsAt "$work/marker.sd" 007
+numbered "$work/stale.sd" A 0 9
+printf '4\r\n' > "$work/stale.sd/d210118/Adata.nxt"
+check "startup steps past a stale marker to an unused file" startsAt "$work/stale.sd" 010
+numbered "$work/nomarker.sd" A 0 11
+check "startup without a marker finds the first unused file" startsAt "$work/nomarker.sd" 012
+numbered "$work/full.sd" B 0 999
+numbered "$work/full.sd" C 0 499
+numbered "$work/full.sd" A 0 640
+check "startup among 2141 files finds the first unused file" startsAt "$work/full.sd" 641
+mkdir -p "$work/bench.sd"
+check "startup benchmark within its SD opens and lookups" ./benchmarkHost --iterations 100 --sd "$work/bench.sd"
+
+# ---------------------------------------------------------------------------------------------
+# an RTC that runs slow: until the drift is known each re-anchor finds the clock ahead of the RTC,
+# and the difference is slewed rather than stepped, so the absolute time never goes backwards
+
+logger slowrtc "-DENABLE_ABSOLUTE_TIME"
+"$work/slowrtc" --seconds 1300 --seed 12345 --rtc-drift -100 --sd "$work/slowrtc.sd" > /dev/null 2>&1
+check "re-anchors of a slow RTC do not step the absolute time" steps "$work/slowrtc.sd/d210118/Adata000.csv" 20
+
+# ---------------------------------------------------------------------------------------------
+# a preallocated data file cut off in the middle of a row: recoverLog keeps every complete row,
+# including those written after the length was last recorded
+
+logger preallocate "-DENABLE_LOG_PREALLOCATE"
+"$work/preallocate" --seconds 60 --seed 12345 --sd "$work/preallocate.sd" > /dev/null 2>&1
+./recoverLog "$work/preallocate.sd/d210118/Adata000.csv" "$work/whole.csv" > /dev/null
+unplug "$work/preallocate.sd/d210118/Adata000.csv" 25000 "$work/cut.csv"
+./recoverLog "$work/cut.csv" "$work/recovered.csv" > /dev/null
+rows "$work/whole.csv" 25000 > "$work/expected.csv"
+check "recoverLog keeps the complete rows of a cut file" sh -c "grep -av 'Datlogger Length' '$work/recovered.csv' | cmp - '$work/expected.csv'"
+check "recoverLog records the recovered length" grep -aq "Length: $(printf %010d "$(wc -c < "$work/recovered.csv")")" "$work/recovered.csv"
+
+# ---------------------------------------------------------------------------------------------
+# group commit rows with their CRCs: recoverLog --check finds a changed byte in the middle of the
+# file, and recovery drops a damaged last row, and any row with a changed byte
+
+logger commit "-DENABLE_GROUP_COMMIT"
+"$work/commit" --seconds 60 --seed 12345 --sd "$work/commit.sd" > /dev/null 2>&1
+data="$work/commit.sd/d210118/Adata000.csv"
+check "recoverLog --check passes the rows as written" ./recoverLog --check "$data"
+cp "$data" "$work/corrupt.csv"
+poke "$work/corrupt.csv" $(($(grep -abo '^A, 80, ' "$data" | cut -d: -f1) + 9)) 9
+./recoverLog --check "$work/corrupt.csv" > "$work/corrupt.out"
+check "recoverLog --check finds a changed byte" grep 'bad CRC at byte .*: A, 80, ' "$work/corrupt.out"
+cp "$data" "$work/torn.csv"
+poke "$work/torn.csv" $(($(wc -c < "$data") - 30)) x
+./recoverLog "$work/torn.csv" "$work/torn.recovered.csv" > /dev/null
+sed '$d' "$data" > "$work/torn.expected.csv"
+check "recoverLog drops a damaged last row" cmp "$work/torn.recovered.csv" "$work/torn.expected.csv"
+check "recoverLog keeps the rows before 60 random cuts and changed bytes" damage "$data" 60 36
+
+# ---------------------------------------------------------------------------------------------
+# compressed data: decodeData gives back the rows of the default run, value for value as printed
+
+logger compressed "-DENABLE_COMPRESSED_DATA"
+"$work/compressed" --seconds 60 --seed 12345 --sd "$work/compressed.sd" > /dev/null 2>&1
+./decodeData "$work/compressed.sd/d210118/Adata000.kcd" "$work/decoded.csv" 2> /dev/null
+grep -v 'ompiled\|Datlogger File' "$work/decoded.csv" > "$work/decoded.rows"
+grep -v 'ompiled\|Datlogger File' testdata/default/d210118/Adata000.csv > "$work/default.rows"
+check "decodeData round trip of the compressed data file" diff "$work/default.rows" "$work/decoded.rows"
+
+# ---------------------------------------------------------------------------------------------
+# binary telemetry: telemetryView prints the tables of the same run printing text; a statistics frame
+# with a changed byte, or cut short, fails its CRC and is dropped, and the frames after it are read
+# from the next zero byte
+
+./hostLogger --seconds 60 --seed 12345 --sd "$work/text.sd" --serial "$work/text.serial" > /dev/null 2>&1
+tables "$work/text.serial" > "$work/text.tables"
+logger telemetry "-DENABLE_SERIAL_TELEMETRY"
+"$work/telemetry" --seconds 60 --seed 12345 --sd "$work/telemetry.sd" --serial "$work/telemetry.serial" > /dev/null 2>&1
+./telemetryView "$work/telemetry.serial" 2> /dev/null | tables - > "$work/telemetry.tables"
+check "telemetryView prints the text tables of the same run" sh -c "[ -s '$work/text.tables' ] && diff '$work/text.tables' '$work/telemetry.tables'"
+frames "$work/telemetry.serial" | sed -n 10p > "$work/frame10"
+read at length < "$work/frame10"
+awk '/^---- Sample Data Summary/ && ++k == 10 { n = 7 } n > 0 { n--; next } { print }' "$work/telemetry.tables" > "$work/dropped.tables"
+perl -0777 -pe "substr(\$_, $((at + length / 2)), 1) = substr(\$_, $((at + length / 2)), 1) eq chr(1) ? chr(2) : chr(1)" \
+  "$work/telemetry.serial" > "$work/changed.serial"
+./telemetryView "$work/changed.serial" 2> "$work/changed.err" | tables - > "$work/changed.tables"
+check "telemetryView drops a frame with a changed byte" sh -c "grep ' 1 damaged frames' '$work/changed.err' && diff '$work/dropped.tables' '$work/changed.tables'"
+perl -0777 -pe "substr(\$_, $((at + length / 2)), $((length - length / 2))) = ''" "$work/telemetry.serial" > "$work/short.serial"
+./telemetryView "$work/short.serial" 2> "$work/short.err" | tables - > "$work/short.tables"
+check "telemetryView drops a frame cut short" sh -c "grep ' 1 damaged frames' '$work/short.err' && diff '$work/dropped.tables' '$work/short.tables'"
+
+# ---------------------------------------------------------------------------------------------
+# a storm of button bounces (the button on pin 7 pressed 20 times, bouncing 4 times 3 ms apart when
+# pressed and when released) through the event queue: with a free card the rows are those of direct
+# writes; with a slow card every change seen is written; with EVENT_COALESCE_MS each press and
+# each release is one row
+
+awk 'BEGIN {
+  for (p = 0; p < 20; p++)
+    for (b = 0; b < 5; b++) {
+      print 2000 + p * 3000 + 6 * b, 7, 0
+      print 3000 + p * 3000 + 6 * b, 7, 1
+      if (b < 4) {
+        print 2003 + p * 3000 + 6 * b, 7, 1
+        print 3003 + p * 3000 + 6 * b, 7, 0
+      }
+    }
+}' | sort -n > "$work/storm.gpio"
+./hostLogger --seconds 70 --seed 12345 --gpio "$work/storm.gpio" --sd "$work/direct.sd" > /dev/null 2>&1
+logger events "-DENABLE_EVENT_QUEUE"
+"$work/events" --seconds 70 --seed 12345 --gpio "$work/storm.gpio" --sd "$work/events.sd" > /dev/null 2>&1
+grep -v 'ompiled' "$work/direct.sd/d210118/Aevnt000.csv" > "$work/direct.events"
+grep -v 'ompiled' "$work/events.sd/d210118/Aevnt000.csv" > "$work/queued.events"
+check "event queue writes the rows of direct writes" diff "$work/direct.events" "$work/queued.events"
+"$work/events" --seconds 70 --seed 12345 --gpio "$work/storm.gpio" --sd-open-us 5000 --sd-write-us 20 --sd "$work/slow.sd" > "$work/slow.out" 2>&1
+check "event queue writes every change on a slow card" grep 'event queue \([0-9]*\) changes, \1 written .* 0 dropped' "$work/slow.out"
+check "event queue keeps the button states in order" button "$work/slow.sd/d210118/Aevnt000.csv"
+logger coalesce "-DENABLE_EVENT_QUEUE -DEVENT_COALESCE_MS=50"
+"$work/coalesce" --seconds 70 --seed 12345 --gpio "$work/storm.gpio" --sd-open-us 5000 --sd-write-us 20 --sd "$work/coalesce.sd" > /dev/null 2>&1
+button "$work/coalesce.sd/d210118/Aevnt000.csv" > "$work/coalesce.out"
+check "event coalescing merges each bouncing press and release" grep -x '40 changes of ButS, last RELEASE' "$work/coalesce.out"
+
+# ---------------------------------------------------------------------------------------------
+# deferred debug: detokenized, the debug lines of a tokenized run are those of the same run printing
+# the text (of the telemetry check above), line for line (lines that look alike but are printed directly, and so are already text
+# in the tokenized run, are left out); a token that is not in the sources and a record cut short
+# are errors
+
+logger deferred "-DENABLE_DEFERRED_DEBUG"
+"$work/deferred" --seconds 60 --seed 12345 --sd "$work/deferred.sd" --serial "$work/deferred.serial" > /dev/null 2>&1
+./detokenize --no-time "$work/deferred.serial" > "$work/detokenized.serial" 2> /dev/null
+grep -a 'var: \|for variable: ' "$work/deferred.serial" > "$work/direct.lines"
+grep -a 'var: \|for variable: ' "$work/text.serial" | grep -avxFf "$work/direct.lines" > "$work/text.debug"
+grep -a 'var: \|for variable: ' "$work/detokenized.serial" | grep -avxFf "$work/direct.lines" > "$work/detokenized.debug"
+check "detokenized debug lines are the text debug lines" sh -c "[ -s '$work/text.debug' ] && diff '$work/text.debug' '$work/detokenized.debug'"
+{ head -n 5 "$work/deferred.serial"; printf '$DEADBEEF,1234,5\r\n'; } > "$work/unknown.serial"
+check "detokenize refuses an unknown token" refused 'line 6: unknown token DEADBEEF' ./detokenize "$work/unknown.serial"
+last=$(grep -an '^\$' "$work/deferred.serial" | tail -n 1 | cut -d: -f1)
+{ head -n $((last - 1)) "$work/deferred.serial"; sed -n "${last}p" "$work/deferred.serial" | head -c 12; } > "$work/cut.serial"
+check "detokenize refuses a truncated record" refused "line $last: truncated record" ./detokenize "$work/cut.serial"
+
+# ---------------------------------------------------------------------------------------------
+# simulated data: the same seeds give the same card, another --sim-seed changes the simulated
+# streams and nothing else, and a replayed column comes back as stream tSim (the replay starts at
+# the first row of the trace, so each row of tSim_av averages two rows of the trace)
+
+logger simulated "-DENABLE_SIMULATED_DATA"
+"$work/simulated" --seconds 60 --seed 12345 --sim-seed 7 --sd "$work/seed7.sd" > /dev/null 2>&1
+"$work/simulated" --seconds 60 --seed 12345 --sim-seed 7 --sd "$work/again7.sd" > /dev/null 2>&1
+"$work/simulated" --seconds 60 --seed 12345 --sim-seed 8 --sd "$work/seed8.sd" > /dev/null 2>&1
+check "simulated data repeats with the same seeds" diff -r "$work/seed7.sd" "$work/again7.sd"
+trace="$work/seed7.sd/d210118/Adata000.csv"
+columns "$trace" Sim_ other > "$work/seed7.other"
+columns "$work/seed8.sd/d210118/Adata000.csv" Sim_ other > "$work/seed8.other"
+check "--sim-seed leaves the other streams alone" cmp "$work/seed7.other" "$work/seed8.other"
+columns "$trace" Sim_ > "$work/seed7.simulated"
+columns "$work/seed8.sd/d210118/Adata000.csv" Sim_ > "$work/seed8.simulated"
+check "--sim-seed changes the simulated streams" sh -c "! cmp -s '$work/seed7.simulated' '$work/seed8.simulated'"
+"$work/simulated" --seconds 60 --seed 12345 --sim-seed 7 --sim-trace "$trace,xSim_av" --sd "$work/replay.sd" > /dev/null 2>&1
+columns "$trace" '^xSim_av$' > "$work/trace.values"
+columns "$work/replay.sd/d210118/Adata000.csv" '^tSim_av$' > "$work/replay.values"
+check "--sim-trace replays the column of the trace" awk '
+  NR == FNR { trace[NR] = $1; rows = NR; next }
+  FNR < rows {
+    error = $1 - (trace[FNR] + trace[FNR + 1]) / 2
+    if (error < 0) error = -error
+    if (error > 0.1) { print "row " FNR ": tSim_av " $1 ", trace " trace[FNR] " and " trace[FNR + 1]; bad = 1 }
+  }
+  END { exit bad || FNR != rows }' "$work/trace.values" "$work/replay.values"
+
+# ---------------------------------------------------------------------------------------------
+# reprocessing: the default run with its own settings, one input row to each output row, gives back
+# its rows (the means of every stream, and the spread and size of the streams with _n; the rows are
+# rounded, so -0.00 and 0.00 are the same value). two intervals of scripted raw samples merged into one row have the
+# mean, standard deviation and size of all of their samples
+
+./reprocess --rows 1 --threads 2 --stats CPUt=2 --stats loopt=5 --stats TC=0 --stats RH=0 --stats AOG=0 \
+  --out "$work/same" "$work/default/d210118/Adata000.csv" 2> /dev/null
+columns "$work/default/d210118/Adata000.csv" '_(cv|av)$|^loopt_(sd|n)$' | sed 's/-0\.00/0.00/g' > "$work/default.stats"
+columns "$work/same/d210118/Adata000.csv" '_(cv|av)$|^loopt_(sd|n)$' | sed 's/-0\.00/0.00/g' > "$work/same.stats"
+check "reprocess with unchanged settings gives back the rows" sh -c "[ -s '$work/same.stats' ] && diff '$work/default.stats' '$work/same.stats'"
+mkdir -p "$work/intervals/d210118"
+awk -v raw="$work/raw.samples" 'BEGIN {
+  srand(7)
+  print "-------------------------------------------------------------"
+  print "A,0,raw_av,raw_sd,raw_n"
+  for (k = 1; k <= 20; k++) {
+    n = 40 + 7 * (k % 5)
+    s = 0
+    s2 = 0
+    for (j = 0; j < n; j++) {
+      x = 10 * sin(k / 3) + 4 * rand()
+      print k, x > raw
+      s += x
+      s2 += x * x
+    }
+    printf "A, %d, %.6f, %.6f, %d\n", k, s / n, sqrt((s2 - s * s / n) / (n - 1)), n
+  }
+}' > "$work/intervals/d210118/Adata000.csv"
+./reprocess --rows 2 --threads 1 --stats raw=5 --out "$work/merged" "$work/intervals/d210118/Adata000.csv" 2> /dev/null
+columns "$work/merged/d210118/Adata000.csv" '^raw_(av|sd|n)' | tr -d '\r' > "$work/merged.stats"
+check "reprocess merges two intervals into the statistics of their samples" awk '
+  NR == FNR { row = int(($1 + 1) / 2); n[row]++; s[row] += $2; s2[row] += $2 * $2; rows = row; next }
+  {
+    average = s[FNR] / n[FNR]
+    deviation = sqrt((s2[FNR] - s[FNR] * average) / (n[FNR] - 1))
+    if ((average - $1) ^ 2 > 0.0001 || (deviation - $2) ^ 2 > 0.0001 || n[FNR] != $3) {
+      printf "row %d: %s %s %s, from the samples %.2f %.2f %d\n", FNR, $1, $2, $3, average, deviation, n[FNR]
+      bad = 1
+    }
+  }
+  END { exit bad || FNR != rows }' "$work/raw.samples" "$work/merged.stats"
+
+# ---------------------------------------------------------------------------------------------
+# fleet aggregation: six synthetic loggers starting 13 s apart, half of them with unixTime from
+# clocks off the whole second and running 0.2 % slow, on time and 0.2 % fast; the buckets
+# aggregate gives are those computed from the raw data points
+
+./aggregate --synthesize "$work/fleet" --devices 6 --rows 3000 --seed 7 2> /dev/null
+./aggregate --threads 3 --out "$work/fleet.csv" "$work/fleet" 2> /dev/null
+check "aggregate merges a synthetic fleet into the buckets of its data points" diff "$work/fleet/expected.csv" "$work/fleet.csv"
+
+# ---------------------------------------------------------------------------------------------
+# time index of the data and event files (with the bounce storm above for the events): every entry
+# checks, queries through the index give the rows of a scan, also when the data file has been cut
+# off behind its index
+
+logger indexed "-DENABLE_TIME_INDEX"
+"$work/indexed" --seconds 300 --seed 12345 --gpio "$work/storm.gpio" --sd "$work/indexed.sd" > /dev/null 2>&1
+data="$work/indexed.sd/d210118/Adata000.csv"
+events="$work/indexed.sd/d210118/Aevnt000.csv"
+./timeQuery --check "$data" > "$work/data.check"
+./timeQuery --check "$events" > "$work/events.check"
+check "timeQuery --check uses every entry of the data index" grep 'index: \([1-9][0-9]*\) entries, \1 usable' "$work/data.check"
+check "timeQuery --check uses every entry of the event index" grep 'index: \([1-9][0-9]*\) entries, \1 usable' "$work/events.check"
+check "indexed time range of the data file" query "$data" --from 100000 --to 160000
+check "indexed count range of the data file" query "$data" --count-from 300 --count-to 420
+check "indexed time range of the event file" query "$events" --from 20000 --to 40000
+check "indexed queries agree with scans" ./timeQuery --bench 200 --span-ms 30000 "$data"
+head -c $(($(wc -c < "$data") * 2 / 3)) "$data" > "$work/short.csv"
+cp "$work/indexed.sd/d210118/Adata000.idx" "$work/short.idx"
+check "indexed time range of a data file shorter than its index" query "$work/short.csv" --from 150000 --to 300000
+
+# ---------------------------------------------------------------------------------------------
+# summary pyramid of a 10 minute data file: range queries give the statistics of reading every row,
+# and a pyramid brought up to date as its file grows is the one built from the whole file
+
+./hostLogger --seconds 600 --seed 12345 --sd "$work/long.sd" > /dev/null 2>&1
+data="$work/long.sd/d210118/Adata000.csv"
+start=1610928000 # the RTC of the host starts on 18 January 2021
+./pyramid --base-rows 4 --from $((start + 100)).3 --to $((start + 457)).1 "$data" > "$work/pyramid.stats" 2> /dev/null
+./pyramid --base-rows 4 --from $((start + 100)).3 --to $((start + 457)).1 --brute "$data" > "$work/brute.stats" 2> /dev/null
+check "pyramid range query matches every row" cmp "$work/pyramid.stats" "$work/brute.stats"
+./pyramid --base-rows 4 --from $((start + 200)).5 --to $((start + 201)).7 "$data" > "$work/pyramid.stats" 2> /dev/null
+./pyramid --base-rows 4 --from $((start + 200)).5 --to $((start + 201)).7 --brute "$data" > "$work/brute.stats" 2> /dev/null
+check "pyramid query inside one base block matches every row" cmp "$work/pyramid.stats" "$work/brute.stats"
+check "pyramid queries agree with every row" ./pyramid --base-rows 4 --bench 200 --span-s 200 "$data"
+mkdir "$work/growing"
+rows "$data" $(($(wc -c < "$data") / 2)) > "$work/growing/Adata000.csv"
+./pyramid --base-rows 4 "$work/growing/Adata000.csv" > /dev/null 2>&1
+cp "$data" "$work/growing/Adata000.csv"
+./pyramid --base-rows 4 "$work/growing/Adata000.csv" > /dev/null 2>&1
+check "pyramid grown with its file is the pyramid of the whole file" cmp "$work/growing/Adata000.pyr" "$work/long.sd/d210118/Adata000.pyr"
+
+# ---------------------------------------------------------------------------------------------
+# Arrow export of the default run and of the simulated run (which has more columns), in batches of
+# 64 rows: schema, metadata and values, read back with pyarrow
+
+./exportArrow --batch-rows 64 --out "$work/data.arrow" "$work/default" "$work/seed7.sd" > /dev/null 2>&1
+if python3 -c 'import pyarrow' 2> /dev/null; then
+  check "exportArrow schema and values read back with pyarrow" arrow "$work/data.arrow" "$work/default/d210118/Adata000.csv" "$work/seed7.sd/d210118/Adata000.csv"
+else
+  echo "SKIP exportArrow schema and values (no pyarrow)"
+fi
+
+# ---------------------------------------------------------------------------------------------
+if [ $update -eq 1 ]; then
+  echo "reference files written to testdata/"
+fi
+if [ $failures -gt 0 ]; then
+  echo "$failures checks failed"
+  exit 1
+fi
+echo "all checks passed"
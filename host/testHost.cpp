@@ -0,0 +1,1241 @@
+// testHost.cpp
+// checks of the logger's modules on the host, driven by the virtual clock of the stand-ins
+// (hostClockMicros, see Arduino.h) so the timings they see are scripted and repeatable.
+// every check prints one line and counts as failed when ok is 0:
+//    GROUP,name,value,expected,ok
+//  TIMING  loop jitter histogram, percentiles and worst pass (loopTiming.h)
+//  PROFILE regions of scripted length recorded as profile streams, the regions opened while one is
+//          recorded left out, and the report of printProfileReport() (profiler.h)
+//  FIFO    FIFO drains replayed through a mock driver: decoded values, realignment after an
+//          overrun, bursts, the cap on one drain and the sample times; and the bus time per sample
+//          against one read per sample (imuFifo.h)
+//  RATE    acquisition and output schedules of rate groups, and the statistics of one group
+//          finalized without touching the others (rateGroups.h)
+//  TIME    monoMicros() across rollovers of micros(), the RTC anchor, the drift estimate and the
+//          absolute time of an RTC that runs fast, and that the re-anchors of an RTC that runs slow
+//          never set the absolute time back (timeBase.h with the RTC of host/RTClib.h)
+//  ACCURACY  the largest error of every precision of the fast math kernels against libm in double
+//          (fastMath.h): relative for sqrt, absolute for sin and cos, ulps of x / n for the reciprocal;
+//          and the trendline errors of a row with too few samples (sampleStats.h)
+//  DERIVED the values of derived streams against the same expressions in C, that only the streams
+//          that are used are evaluated (once each per finalize), and that bad expressions are
+//          refused (derivedStreams.h)
+//  ADAPTIVE  adaptive output and acquisition intervals against fixed fast and slow ones on
+//          simulated bursts of motion: the bursts resolved, the bytes and samples spent and how soon
+//          a burst is seen (adaptiveRate.h)
+//  CAPTURE windows captured on scripted triggers read back from the capture file: the samples
+//          before and after each trigger, the triggers missed and the CRC of each block
+//          (eventCapture.h)
+//
+//  build:  host/build.sh            (run by host/test.sh)
+//          (with -DTEST_WITHOUT_RATE_GROUPS the modules are built without ENABLE_RATE_GROUPS, as
+//          the sketch is by default, and RATE is left out)
+//  usage:  host/testHost [--sd DIR] [GROUP...]   (default: every group)
+//    --sd DIR   directory used as the SD card for the capture file (default "sdcard")
+//  exits with status 1 if any check failed
+
+#include "Arduino.h"
+#include "SD.h"
+#include "Adafruit_LSM6DS33.h"
+
+#define ENABLE_LOOP_TIMING
+#define ENABLE_PROFILER
+#define PROFILE_VIRTUAL_CLOCK // regions are timed on the virtual clock
+#define ENABLE_IMU_FIFO
+#ifndef TEST_WITHOUT_RATE_GROUPS
+#define ENABLE_RATE_GROUPS
+#endif
+#define ENABLE_ABSOLUTE_TIME
+#define ENABLE_FAST_MATH // the statistics divide by n with fastReciprocal(), as on the board
+#define ENABLE_DERIVED_STREAMS
+#define ENABLE_ADAPTIVE_RATE
+#define ENABLE_SIMULATED_DATA // the simulated signals of the ADAPTIVE runs
+#define ENABLE_CAPTURE
+#include "../quickDebugMessages.h"
+#include "../deviceConfigGeneric.h"
+#include "../logSD.h"
+#include "../timeBase.h"
+#include "../loopTiming.h"
+#include "../profiler.h"
+#include "../dataCompress.h"
+#include "../timeIndex.h"
+#include "../outputQueue.h"
+#include "../fastMath.h"
+#include "../sampleStats.h"
+#include "../imuFifo.h"
+#include "../derivedStreams.h"
+#include "../adaptiveRate.h"
+#include "../rateGroups.h"
+#include "../eventTracker.h"
+#include "../eventCapture.h"
+#include "../simulatedSensor.h"
+
+// returns 1 if the check failed
+int printTestResult(Print &out, const char *group, const char *name, double value, double expected, int ok, int digits = 6)
+{
+  out.print(group);
+  out.print(",");
+  out.print(name);
+  out.print(",");
+  out.print(value, digits);
+  out.print(",");
+  out.print(expected, digits);
+  out.print(",");
+  out.println(ok);
+  return ok ? 0 : 1;
+}
+
+int printTestEqual(Print &out, const char *group, const char *name, double value, double expected)
+{
+  return printTestResult(out, group, name, value, expected, value == expected);
+}
+
+int printTestNear(Print &out, const char *group, const char *name, double value, double expected, double tolerance)
+{
+  return printTestResult(out, group, name, value, expected, fabs(value - expected) <= tolerance);
+}
+
+// keeps what is printed, e.g. a header row
+class testText : public Print
+{
+public:
+  char text[4096];
+  size_t length = 0;
+  size_t write(uint8_t c)
+  {
+    if (length < sizeof(text) - 1)
+    {
+      text[length++] = c;
+      text[length] = 0;
+    }
+    return 1;
+  }
+  using Print::write;
+};
+
+sampleStats testData[MAX_SAMPLES];
+int testSamples = 0;
+eventTracker testEvents[MAX_EVENTS];
+int testNumEvents = 0;
+
+// ---------------------------------------------------------------------------------------------
+// TIMING: passes of known length on the virtual clock
+
+// one pass of loop() spending the given times reading sensors, writing the card and elsewhere
+void testLoopPass(loopTiming *timer, unsigned long sensorMicros, unsigned long sdMicros, unsigned long otherMicros)
+{
+  loopTimingStart(timer);
+  hostAdvanceMicros(sensorMicros);
+  loopTimingPhase(timer, LOOP_PHASE_SENSOR);
+  hostAdvanceMicros(sdMicros);
+  loopTimingPhase(timer, LOOP_PHASE_SD);
+  hostAdvanceMicros(otherMicros);
+  loopTimingEnd(timer);
+}
+
+int checkLoopTiming(Print &out)
+{
+  int failures = 0;
+  loopTiming timer;
+
+  // 100 passes of 1 ms, one of 7 ms blocked on the card, and the pass after it
+  initLoopTiming(&timer);
+  for (int k = 0; k < 100; k++)
+  {
+    testLoopPass(&timer, 600, 100, 300);
+  }
+  testLoopPass(&timer, 200, 6000, 800);
+  testLoopPass(&timer, 600, 100, 300);
+  failures += printTestEqual(out, "TIMING", "passes", timer.nLoops, 102);
+  failures += printTestEqual(out, "TIMING", "binOf1ms", timer.jitterHist[1000 / JITTER_BIN_WIDTH], 100);
+  failures += printTestEqual(out, "TIMING", "binOf7ms", timer.jitterHist[7000 / JITTER_BIN_WIDTH], 1);
+  failures += printTestEqual(out, "TIMING", "minInterval", timer.minInterval, 1000);
+  failures += printTestEqual(out, "TIMING", "maxInterval", timer.maxInterval, 7000);
+  failures += printTestEqual(out, "TIMING", "p50", loopTimingPercentile(&timer, 50.), 1000 + JITTER_BIN_WIDTH);
+  failures += printTestEqual(out, "TIMING", "p99", loopTimingPercentile(&timer, 99.), 1000 + JITTER_BIN_WIDTH);
+  failures += printTestEqual(out, "TIMING", "p100", loopTimingPercentile(&timer, 100.), 7000 + JITTER_BIN_WIDTH);
+  failures += printTestEqual(out, "TIMING", "worstPass", timer.worstLoop, 7000);
+  failures += printTestEqual(out, "TIMING", "worstPassSD", timer.worstPhaseTime[LOOP_PHASE_SD], 6000);
+  failures += printTestEqual(out, "TIMING", "worstPhaseIsSD", timer.worstPhase == LOOP_PHASE_SD, 1);
+  failures += printTestEqual(out, "TIMING", "blameSensor", timer.phaseBlame[LOOP_PHASE_SENSOR], 101);
+  failures += printTestEqual(out, "TIMING", "blameSD", timer.phaseBlame[LOOP_PHASE_SD], 1);
+
+  // intervals across the rollover of micros()
+  hostClockMicros = ((uint64_t)1 << 32) - 2500;
+  initLoopTiming(&timer);
+  for (int k = 0; k < 6; k++)
+  {
+    testLoopPass(&timer, 600, 100, 300);
+  }
+  failures += printTestEqual(out, "TIMING", "rolloverMinInterval", timer.minInterval, 1000);
+  failures += printTestEqual(out, "TIMING", "rolloverMaxInterval", timer.maxInterval, 1000);
+
+  // a stall longer than the histogram goes to its last bin, and its percentile is the stall
+  resetLoopTiming(&timer);
+  testLoopPass(&timer, 600, 24000, 400);
+  testLoopPass(&timer, 600, 100, 300);
+  failures += printTestEqual(out, "TIMING", "overflowBin", timer.jitterHist[JITTER_BINS - 1], 1);
+  failures += printTestEqual(out, "TIMING", "overflowP100", loopTimingPercentile(&timer, 100.), 25000);
+
+  // the pass that outputs the interval asks for the reset while it writes the card: it is not
+  // charged to the next interval, which starts with the pass after it
+  loopTimingStart(&timer);
+  hostAdvanceMicros(600);
+  loopTimingPhase(&timer, LOOP_PHASE_SENSOR);
+  hostAdvanceMicros(9000);
+  loopTimingPhase(&timer, LOOP_PHASE_SD);
+  loopTimingResetAtEnd(&timer);
+  hostAdvanceMicros(400);
+  loopTimingEnd(&timer);
+  failures += printTestEqual(out, "TIMING", "resetAtEndPasses", timer.nLoops, 0);
+  failures += printTestEqual(out, "TIMING", "resetAtEndWorstPass", timer.worstLoop, 0);
+  testLoopPass(&timer, 600, 100, 300);
+  failures += printTestEqual(out, "TIMING", "afterResetPasses", timer.nLoops, 1);
+  failures += printTestEqual(out, "TIMING", "afterResetWorstPass", timer.worstLoop, 1000);
+  failures += printTestEqual(out, "TIMING", "afterResetBlameSD", timer.phaseBlame[LOOP_PHASE_SD], 0);
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// PROFILE: regions of scripted length on the virtual clock (profiler.h with PROFILE_VIRTUAL_CLOCK),
+// recorded into profile streams and printed by printProfileReport()
+
+// one profiled region that takes the given time (us) on the virtual clock
+void testProfileRegion(int iRegion, unsigned long regionMicros)
+{
+  PROFILE_REGION(iRegion)
+  hostAdvanceMicros(regionMicros);
+}
+
+int checkProfiler(Print &out)
+{
+  int failures = 0;
+  testSamples = 0;
+  initProfiler(testData);
+  iProfSensor = addDataStream(testData, &testSamples, "Profile sensor reads", "pSens", "us", 5);
+  iProfUpdate = addDataStream(testData, &testSamples, "Profile updateDataSample", "pUpd", "us", 5);
+  iProfEvents = addDataStream(testData, &testSamples, "Profile event evaluation", "pEvt", "us", 5);
+  iProfSDWrite = addDataStream(testData, &testSamples, "Profile SD writes", "pSD", "us", 5);
+  int iValue = addDataStream(testData, &testSamples, "Test profiled value", "tVal", "arb", 2);
+
+  // ten sensor reads of 200 and 400 us in turn
+  for (int k = 0; k < 10; k++)
+  {
+    testProfileRegion(iProfSensor, k % 2 ? 400 : 200);
+  }
+  // four event evaluations of 150 us, each writing an event to the card for 100 us of it (the
+  // regions are inclusive, so the SD write is also in the evaluation)
+  for (int k = 0; k < 4; k++)
+  {
+    PROFILE_REGION(iProfEvents)
+    hostAdvanceMicros(50);
+    testProfileRegion(iProfSDWrite, 100);
+  }
+  // three samples of a stream: each is timed by updateDataSample's own region, but the samples
+  // that record the other regions are not (their region opens while profileRecording is set)
+  for (int k = 0; k < 3; k++)
+  {
+    updateDataSample(testData, iValue, (float)k, 0.);
+  }
+
+  failures += printTestEqual(out, "PROFILE", "sensorN", testData[iProfSensor].n, 10);
+  failures += printTestNear(out, "PROFILE", "sensorMeanUs", testData[iProfSensor].sumX / testData[iProfSensor].n, 300., 0.001);
+  failures += printTestEqual(out, "PROFILE", "eventsN", testData[iProfEvents].n, 4);
+  failures += printTestNear(out, "PROFILE", "eventsMeanUs", testData[iProfEvents].sumX / testData[iProfEvents].n, 150., 0.001);
+  failures += printTestEqual(out, "PROFILE", "sdWriteN", testData[iProfSDWrite].n, 4);
+  failures += printTestNear(out, "PROFILE", "sdWriteMeanUs", testData[iProfSDWrite].sumX / testData[iProfSDWrite].n, 100., 0.001);
+  failures += printTestEqual(out, "PROFILE", "updateN", testData[iProfUpdate].n, 3);
+  failures += printTestEqual(out, "PROFILE", "recording", profileRecording, 0);
+
+  // the report over a 10 ms interval (regions that are not profiled are left out)
+  testText report;
+  printProfileReport(report, testData, 10);
+  const char *expected = "PROFILE: region\tn\tavg us\tsd us\ttotal us\tpercent\r\n"
+                         "PROFILE: pSens\t10\t300.00\t105.41\t3000.00\t30.00\r\n"
+                         "PROFILE: pUpd\t3\t0.00\t0.00\t0.00\t0.00\r\n"
+                         "PROFILE: pEvt\t4\t150.00\t0.00\t600.00\t6.00\r\n"
+                         "PROFILE: pSD\t4\t100.00\t0.00\t400.00\t4.00\r\n";
+  int same = !strcmp(report.text, expected);
+  if (!same)
+  {
+    out.print(report.text);
+  }
+  failures += printTestEqual(out, "PROFILE", "report", same, 1);
+
+  profileData = NULL;
+  iProfSensor = iProfUpdate = iProfEvents = iProfSDWrite = -1;
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// FIFO: drains of the IMU FIFO (imuFifo.h) through a mock imuFifoDriver that replays scripted
+// FIFO_STATUS and data bytes: the decoded values, the realignment after an overrun, the bursts,
+// the cap on the sets of one drain and the sample times; then the bus time per sample of the FIFO
+// against one read per sample, on the I2C model of host/Wire.h
+
+#define TEST_FIFO_BYTES 2048
+#define TEST_FIFO_READS 64
+
+// what the mock driver replays: FIFO_STATUS1..4 for each drain, then the bytes of the FIFO output
+struct testFifoScript
+{
+  uint8_t status[4][4];
+  int nStatus;
+  int statusAt;
+  uint8_t data[TEST_FIFO_BYTES];
+  int nData;
+  int dataAt;
+  int readLength[TEST_FIFO_READS]; // length of each read of the FIFO output
+  int nReads;
+  int writes;
+};
+
+testFifoScript testFifo;
+
+int testFifoReadRegisters(uint8_t reg, uint8_t *buffer, int length)
+{
+  if (reg == LSM6DS33_FIFO_STATUS1 && length == 4 && testFifo.statusAt < testFifo.nStatus)
+  {
+    memcpy(buffer, testFifo.status[testFifo.statusAt++], 4);
+    return 4;
+  }
+  if (reg != LSM6DS33_FIFO_DATA_OUT_L || testFifo.dataAt + length > testFifo.nData)
+  {
+    return -1;
+  }
+  memcpy(buffer, testFifo.data + testFifo.dataAt, length);
+  testFifo.dataAt += length;
+  if (testFifo.nReads < TEST_FIFO_READS)
+  {
+    testFifo.readLength[testFifo.nReads++] = length;
+  }
+  return length;
+}
+
+int testFifoWriteRegister(uint8_t /* reg */, uint8_t /* value */)
+{
+  testFifo.writes++;
+  return 1;
+}
+
+imuFifoDriver testFifoDriver = {testFifoReadRegisters, testFifoWriteRegister};
+
+void testFifoReset()
+{
+  memset(&testFifo, 0, sizeof(testFifo));
+}
+
+// a drain that finds words unread words, the next of them at pattern index pattern
+void testFifoStatus(int words, int pattern, int overrun)
+{
+  uint8_t *status = testFifo.status[testFifo.nStatus++];
+  status[0] = words & 0xFF;
+  status[1] = ((words >> 8) & 0x0F) | (overrun ? IMU_FIFO_OVERRUN : 0) | (words == 0 ? IMU_FIFO_EMPTY : 0);
+  status[2] = pattern & 0xFF;
+  status[3] = (pattern >> 8) & 0x03;
+}
+
+void testFifoWord(int16_t word)
+{
+  testFifo.data[testFifo.nData++] = word & 0xFF;
+  testFifo.data[testFifo.nData++] = (word >> 8) & 0xFF;
+}
+
+// raw words of set k: gyro x, y, z then accel x, y, z
+int16_t testFifoRaw(int k, int w)
+{
+  const int16_t base[IMU_FIFO_WORDS_PER_SET] = {1, -2, 3, 1000, -2000, 8192};
+  return base[w] + (w % 2 ? -k : k);
+}
+
+void testFifoSets(int first, int count)
+{
+  for (int k = first; k < first + count; k++)
+  {
+    for (int w = 0; w < IMU_FIFO_WORDS_PER_SET; w++)
+    {
+      testFifoWord(testFifoRaw(k, w));
+    }
+  }
+}
+
+// sets of the last drain that decode to the raw words of sets first, first + 1, ...
+int testFifoDecoded(imuFifo *fifo, int first)
+{
+  int matches = 0;
+  for (int k = 0; k < fifo->nSets; k++)
+  {
+    int j = first + k;
+    matches += fifo->gx[k] == testFifoRaw(j, 0) * fifo->gyroScale && fifo->gy[k] == testFifoRaw(j, 1) * fifo->gyroScale &&
+               fifo->gz[k] == testFifoRaw(j, 2) * fifo->gyroScale && fifo->ax[k] == testFifoRaw(j, 3) * fifo->accelScale &&
+               fifo->ay[k] == testFifoRaw(j, 4) * fifo->accelScale && fifo->az[k] == testFifoRaw(j, 5) * fifo->accelScale;
+  }
+  return matches;
+}
+
+// reads of the FIFO output of the given length
+int testFifoReadsOf(int length)
+{
+  int count = 0;
+  for (int k = 0; k < testFifo.nReads; k++)
+  {
+    count += testFifo.readLength[k] == length;
+  }
+  return count;
+}
+
+int checkImuFifo(Print &out)
+{
+  int failures = 0;
+  imuFifo fifo;
+
+  // three sets at 104 Hz, drained at 10 s: one burst, the newest set at the time of the drain
+  testFifoReset();
+  failures += printTestEqual(out, "FIFO", "begin", imuFifoBegin(&fifo, &testFifoDriver, 4), 1);
+  failures += printTestEqual(out, "FIFO", "beginWrites", testFifo.writes, 5);
+  testFifoStatus(3 * IMU_FIFO_WORDS_PER_SET, 0, 0);
+  testFifoSets(0, 3);
+  failures += printTestEqual(out, "FIFO", "sets", imuFifoDrain(&fifo, 10.), 3);
+  failures += printTestEqual(out, "FIFO", "decoded", testFifoDecoded(&fifo, 0), 3);
+  failures += printTestEqual(out, "FIFO", "reads", testFifo.nReads, 1);
+  failures += printTestEqual(out, "FIFO", "lastTime", fifo.relTime[2], 10.);
+  failures += printTestNear(out, "FIFO", "spacing1", fifo.relTime[1] - fifo.relTime[0], 1. / 104., 2e-6);
+  failures += printTestNear(out, "FIFO", "spacing2", fifo.relTime[2] - fifo.relTime[1], 1. / 104., 2e-6);
+
+  // an empty FIFO reads nothing past the status
+  testFifoStatus(0, 0, 0);
+  failures += printTestEqual(out, "FIFO", "emptySets", imuFifoDrain(&fifo, 10.05), 0);
+
+  // after an overrun the next word is the gyro z of a set: the four words up to the next gyro x are
+  // read one at a time and dropped
+  testFifoReset();
+  imuFifoBegin(&fifo, &testFifoDriver, 4);
+  testFifoStatus(4 + 2 * IMU_FIFO_WORDS_PER_SET, 2, 1);
+  for (int w = 2; w < IMU_FIFO_WORDS_PER_SET; w++)
+  {
+    testFifoWord(0x7FFF);
+  }
+  testFifoSets(0, 2);
+  failures += printTestEqual(out, "FIFO", "overrunSets", imuFifoDrain(&fifo, 1.), 2);
+  failures += printTestEqual(out, "FIFO", "overruns", fifo.overruns, 1);
+  failures += printTestEqual(out, "FIFO", "overrunSkipped", testFifoReadsOf(2), 4);
+  failures += printTestEqual(out, "FIFO", "overrunDecoded", testFifoDecoded(&fifo, 0), 2);
+
+  // twelve sets are read in bursts of IMU_FIFO_BURST_SETS (5, 5 and 2)
+  testFifoReset();
+  imuFifoBegin(&fifo, &testFifoDriver, 4);
+  testFifoStatus(12 * IMU_FIFO_WORDS_PER_SET, 0, 0);
+  testFifoSets(0, 12);
+  failures += printTestEqual(out, "FIFO", "burstSets", imuFifoDrain(&fifo, 1.), 12);
+  failures += printTestEqual(out, "FIFO", "fullBursts", testFifoReadsOf(IMU_FIFO_BURST_SETS * IMU_FIFO_BYTES_PER_SET), 2);
+  failures += printTestEqual(out, "FIFO", "lastBurst", testFifoReadsOf(2 * IMU_FIFO_BYTES_PER_SET), 1);
+  failures += printTestEqual(out, "FIFO", "burstDecoded", testFifoDecoded(&fifo, 0), 12);
+
+  // a hundred sets: one drain takes IMU_FIFO_MAX_SETS, the next the rest
+  testFifoReset();
+  imuFifoBegin(&fifo, &testFifoDriver, 4);
+  testFifoStatus(100 * IMU_FIFO_WORDS_PER_SET, 0, 0);
+  testFifoStatus((100 - IMU_FIFO_MAX_SETS) * IMU_FIFO_WORDS_PER_SET, 0, 0);
+  testFifoSets(0, 100);
+  failures += printTestEqual(out, "FIFO", "cappedSets", imuFifoDrain(&fifo, 1.), IMU_FIFO_MAX_SETS);
+  failures += printTestEqual(out, "FIFO", "cappedBytes", testFifo.dataAt, IMU_FIFO_MAX_SETS * IMU_FIFO_BYTES_PER_SET);
+  failures += printTestEqual(out, "FIFO", "restSets", imuFifoDrain(&fifo, 1.05), 100 - IMU_FIFO_MAX_SETS);
+  failures += printTestEqual(out, "FIFO", "restDecoded", testFifoDecoded(&fifo, IMU_FIFO_MAX_SETS), 100 - IMU_FIFO_MAX_SETS);
+  failures += printTestEqual(out, "FIFO", "samples", fifo.samples, 100);
+
+  // throughput on the bus: ten seconds of drains every IMU_FIFO_DRAIN_INTERVAL against one
+  // getEvent() (temperature, gyro and accel) per sample
+  hostClockMicros = 0;
+  imuFifoBegin(&fifo, &imuWireDriver, 4);
+  double busStart = hostI2CMicros;
+  while (hostClockMicros < 10000000ULL)
+  {
+    hostAdvanceMicros(IMU_FIFO_DRAIN_INTERVAL * 1000UL);
+    imuFifoDrain(&fifo, ((float)hostClockMicros) / 1000000.);
+  }
+  double fifoUsPerSample = (hostI2CMicros - busStart) / fifo.samples;
+  // the sample count follows the ODR, not the 200 drains (the bus time runs the clock a little past 10 s)
+  failures += printTestNear(out, "FIFO", "samplesIn10s", fifo.samples, 1040., 10.);
+
+  Adafruit_LSM6DS33 imu;
+  sensors_event_t accel, gyro, temp;
+  busStart = hostI2CMicros;
+  for (int k = 0; k < 1000; k++)
+  {
+    imu.getEvent(&accel, &gyro, &temp);
+  }
+  double pollUsPerSample = (hostI2CMicros - busStart) / 1000.;
+  failures += printTestEqual(out, "FIFO", "pollBusUsPerSample", pollUsPerSample, 17 * hostI2CByteMicros);
+  // the value is the FIFO, expected is one read per sample
+  failures += printTestResult(out, "FIFO", "samplesPerBusSecond", 1e6 / fifoUsPerSample, 1e6 / pollUsPerSample,
+                              fifoUsPerSample < pollUsPerSample, 0);
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// RATE: a main group output every second and a slow group read every 200 ms and output every 5 s,
+// run for 20 s of 1 ms passes as loop() does
+
+#ifdef ENABLE_RATE_GROUPS
+int checkRateGroups(Print &out)
+{
+  int failures = 0;
+  rateGroup rates[MAX_RATE_GROUPS];
+  int nRates = 0;
+  hostClockMicros = 0;
+  testSamples = 0;
+  int gMain = addRateGroup(rates, &nRates, "data", 0, 1000);
+  int gSlow = addRateGroup(rates, &nRates, "slow", 200, 5000);
+  int gEmpty = addRateGroup(rates, &nRates, "none", 100, 100);
+  int iFast = addDataStream(testData, &testSamples, "Fast stream", "F", "arb", 4);
+  int iSlow = addDataStream(testData, &testSamples, "Slow stream", "S", "arb", 4);
+  setRateGroup(testData, iSlow, gSlow);
+  countRateGroupStreams(testData, testSamples, rates, nRates);
+  failures += printTestEqual(out, "RATE", "mainStreams", rates[gMain].nStreams, 1);
+  failures += printTestEqual(out, "RATE", "slowStreams", rates[gSlow].nStreams, 1);
+
+  int mainOutputs = 0;
+  int slowReads = 0;
+  int slowOutputs = 0;
+  int emptyDue = 0;
+  int slowSizeAtOutput = 0;
+  float slowAverageAtOutput = 0.;
+  int fastSizeAtOutput = 0;
+  unsigned long nextMainOutput = millis() + 1000;
+  for (int pass = 0; pass < 20000; pass++)
+  {
+    unsigned long now = millis();
+    updateDataSample(testData, iFast, 1.);
+    if (rateGroupAcquireDue(rates, gSlow, now))
+    {
+      slowReads++;
+      updateDataSample(testData, iSlow, (float)slowReads); // 1, 2, 3 ...
+    }
+    emptyDue += rateGroupAcquireDue(rates, gEmpty, now) + rateGroupOutputDue(rates, gEmpty, now);
+    if (now > nextMainOutput)
+    {
+      updateSampleStats(testData, testSamples, gMain);
+      fastSizeAtOutput = testData[iFast].n;
+      resetSampleStats(testData, testSamples, gMain);
+      nextMainOutput = now + 1000;
+      mainOutputs++;
+    }
+    if (rateGroupOutputDue(rates, gSlow, now))
+    {
+      updateSampleStats(testData, testSamples, gSlow);
+      if (slowOutputs == 0)
+      {
+        slowSizeAtOutput = testData[iSlow].n;
+        slowAverageAtOutput = testData[iSlow].average;
+      }
+      resetSampleStats(testData, testSamples, gSlow);
+      slowOutputs++;
+    }
+    hostAdvanceMicros(1000);
+  }
+  // reads at 0, 200 ... 19800 ms; outputs after the interval has passed (5001, 10002, 15003 ms)
+  failures += printTestEqual(out, "RATE", "slowReads", slowReads, 100);
+  failures += printTestEqual(out, "RATE", "slowOutputs", slowOutputs, 3);
+  failures += printTestEqual(out, "RATE", "mainOutputs", mainOutputs, 19);
+  failures += printTestEqual(out, "RATE", "emptyGroupNeverDue", emptyDue, 0);
+  // the main group's resets every second leave the slow stream's 5 s of reads (0 to 5000 ms) alone
+  failures += printTestEqual(out, "RATE", "slowSampleSize", slowSizeAtOutput, 26);
+  failures += printTestNear(out, "RATE", "slowAverage", slowAverageAtOutput, 13.5, 1e-4);
+  // a main output comes 1 ms after its interval has passed, so it has 1001 passes
+  failures += printTestEqual(out, "RATE", "fastSampleSize", fastSizeAtOutput, 1001);
+
+  // the header of the slow group's file lists only its own streams
+  testText header;
+  printSampleStatSpreadsheetRow(header, testData, testSamples, ",", 0, 1, gSlow);
+  failures += printTestEqual(out, "RATE", "slowHeaderHasSlow", strstr(header.text, ",S_av") != NULL, 1);
+  failures += printTestEqual(out, "RATE", "slowHeaderHasNoFast", strstr(header.text, ",F_av") == NULL, 1);
+  return failures;
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// TIME: an RTC running TEST_DRIFT_PPM fast, anchored by timeBaseService() on 1 ms passes
+
+#define TEST_DRIFT_PPM 100
+#define TEST_DRIFT_HOURS 2
+
+// the RTC's time (us since 1970) at the current virtual time
+double testRtcMicros()
+{
+  return ((double)hostRtcStartUnix) * 1e6 + ((double)hostClockMicros) * (1. + hostRtcDriftPPM / 1e6);
+}
+
+int checkTimeBase(Print &out)
+{
+  int failures = 0;
+
+  // three rollovers of micros(), with monoMicros() called every 10 s
+  hostClockMicros = 0;
+  monoLastMicros = 0;
+  monoHighMicros = 0;
+  int monotonic = 1;
+  uint64_t last = 0;
+  while (hostClockMicros < 3 * 0x100000000ULL + 5000000ULL)
+  {
+    hostAdvanceMicros(10000000ULL);
+    uint64_t mono = monoMicros();
+    monotonic &= mono > last;
+    last = mono;
+  }
+  failures += printTestEqual(out, "TIME", "monotonic", monotonic, 1);
+  failures += printTestEqual(out, "TIME", "monoMinusClockUs", (double)(int64_t)(monoMicros() - hostClockMicros), 0.);
+
+  // the first anchor is at the RTC seconds edge after the start (0.3 s into a second)
+  hostClockMicros = 300000;
+  monoLastMicros = 0;
+  monoHighMicros = 0;
+  hostRtcDriftPPM = TEST_DRIFT_PPM;
+  timeBaseBegin(&clockBase);
+  failures += printTestEqual(out, "TIME", "anchorSecond", clockBase.anchorUnix, hostRtcStartUnix + 1);
+  failures += printTestNear(out, "TIME", "anchorAtEdgeUs", (double)clockBase.anchorMono, 1e6 / (1. + TEST_DRIFT_PPM / 1e6), 1000.);
+
+  // hours of 1 ms passes: the drift is measured once the anchors are TIME_BASE_DRIFT_SPAN apart
+  double worstErrorUs = 0.;
+  while (hostClockMicros < TEST_DRIFT_HOURS * 3600000000ULL)
+  {
+    hostAdvanceMicros(1000);
+    uint64_t mono = monoMicros();
+    timeBaseService(&clockBase, mono);
+    if (mono - clockBase.firstMono > TIME_BASE_DRIFT_SPAN + TIME_BASE_REFRESH_INTERVAL)
+    {
+      // once the drift is known, the absolute time between anchors follows the RTC
+      double error = fabs((double)absoluteMicros(&clockBase, mono) - testRtcMicros());
+      worstErrorUs = error > worstErrorUs ? error : worstErrorUs;
+    }
+  }
+  unsigned long anchors = TEST_DRIFT_HOURS * 3600000000ULL / TIME_BASE_REFRESH_INTERVAL;
+  failures += printTestNear(out, "TIME", "driftPPB", clockBase.driftPPB, TEST_DRIFT_PPM * 1000., 1000.);
+  failures += printTestNear(out, "TIME", "anchors", clockBase.anchors, anchors, 1.);
+  failures += printTestResult(out, "TIME", "absoluteErrorUs", worstErrorUs, 2000., worstErrorUs <= 2000.);
+  // each refresh reads the RTC for at most a second of passes
+  failures += printTestResult(out, "TIME", "rtcReadsPerAnchor", clockBase.rtcReads / clockBase.anchors, 1000.,
+                              clockBase.rtcReads / clockBase.anchors <= 1000);
+
+  // an RTC running as slow (as with hostLogger --rtc-drift -100): until the drift is known each
+  // anchor is behind the time extrapolated from the last one, and is slewed to, not stepped to
+  hostClockMicros = 300000;
+  monoLastMicros = 0;
+  monoHighMicros = 0;
+  hostRtcDriftPPM = -TEST_DRIFT_PPM;
+  timeBaseBegin(&clockBase);
+  uint64_t lastAbsolute = absoluteMicros(&clockBase, monoMicros());
+  int64_t worstBackUs = 0;
+  double worstSlewUs = 0.;
+  double worstSlewedErrorUs = 0.;
+  unsigned long slewAnchors = clockBase.anchors;
+  while (hostClockMicros < 3 * TIME_BASE_REFRESH_INTERVAL)
+  {
+    hostAdvanceMicros(1000);
+    uint64_t mono = monoMicros();
+    timeBaseService(&clockBase, mono);
+    uint64_t absolute = absoluteMicros(&clockBase, mono);
+    int64_t back = (int64_t)(lastAbsolute - absolute);
+    worstBackUs = back > worstBackUs ? back : worstBackUs;
+    lastAbsolute = absolute;
+    double slewUs = fabs((double)clockBase.slewMicros);
+    worstSlewUs = slewUs > worstSlewUs ? slewUs : worstSlewUs;
+    // once the slew is taken up the time is that of the new anchor again
+    if (slewAnchors != clockBase.anchors && mono - clockBase.anchorMono >= clockBase.slewSpan)
+    {
+      slewAnchors = clockBase.anchors;
+      double error = fabs((double)absolute - testRtcMicros());
+      worstSlewedErrorUs = error > worstSlewedErrorUs ? error : worstSlewedErrorUs;
+    }
+  }
+  failures += printTestEqual(out, "TIME", "slowRtcNeverBackUs", (double)worstBackUs, 0.);
+  // the drift is not known yet: each anchor is TIME_BASE_REFRESH_INTERVAL * TEST_DRIFT_PPM behind
+  failures += printTestNear(out, "TIME", "slowRtcSlewUs", worstSlewUs, TIME_BASE_REFRESH_INTERVAL * TEST_DRIFT_PPM / 1e6, 1500.);
+  // the RTC drifts on while the slew is taken up
+  double slewedBoundUs = 1000. + worstSlewUs * TEST_DRIFT_PPM / TIME_BASE_SLEW_PPM;
+  failures += printTestResult(out, "TIME", "slowRtcSlewedErrorUs", worstSlewedErrorUs, slewedBoundUs,
+                              worstSlewedErrorUs <= slewedBoundUs);
+  hostRtcDriftPPM = 0.;
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// ACCURACY: the kernels of fastMath.h against libm (the value is the largest error, expected is the
+// bound of fastMath.h)
+
+#define TEST_MATH_CHECKS 4096 // arguments checked for each precision
+
+int printAccuracyResult(Print &out, const char *kernel, int precision, double maxError, double bound)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "%s<%d>", kernel, precision);
+  return printTestResult(out, "ACCURACY", name, maxError, bound, maxError <= bound, 9);
+}
+
+template <int steps>
+int checkFastSqrt(Print &out)
+{
+  double maxError = 0.;
+  for (int k = 0; k < TEST_MATH_CHECKS; k++)
+  {
+    // every mantissa of two octaves (the first guess repeats every two), from 1e-6 to 1e6
+    float x = (1. + 3. * ((double)k) / TEST_MATH_CHECKS) * pow(4., (k % 21) - 10);
+    double exact = sqrt((double)x);
+    double error = fabs(fastSqrt<steps>(x) - exact) / exact;
+    maxError = error > maxError ? error : maxError;
+  }
+  return printAccuracyResult(out, "fastSqrt", steps, maxError, fastSqrtError[steps]);
+}
+
+template <int bits>
+int checkFastSine(Print &out)
+{
+  double maxSin = 0.;
+  double maxCos = 0.;
+  for (int k = 0; k < TEST_MATH_CHECKS; k++)
+  {
+    // across both signs and several turns, off the steps of the table
+    float turns = -2. + 4. * (k + 0.37) / TEST_MATH_CHECKS;
+    double sinError = fabs(fastSinTurns<bits>(turns) - sin(2. * PI * (double)turns));
+    double cosError = fabs(fastCosTurns<bits>(turns) - cos(2. * PI * (double)turns));
+    maxSin = sinError > maxSin ? sinError : maxSin;
+    maxCos = cosError > maxCos ? cosError : maxCos;
+  }
+  return printAccuracyResult(out, "fastSin", bits, maxSin, fastSineError[bits]) +
+         printAccuracyResult(out, "fastCos", bits, maxCos, fastSineError[bits]);
+}
+
+int checkFastReciprocal(Print &out)
+{
+  float maxUlps = 0.;
+  for (unsigned long n = 1; n <= 2 * FAST_MATH_RECIPROCALS; n++)
+  {
+    for (int k = 0; k < 16; k++)
+    {
+      float x = -1000. + 137.1 * k;
+      float exact = x / ((float)n);
+      float ulp = nextafterf(fabs(exact), INFINITY) - fabs(exact);
+      float ulps = fabs(x * fastReciprocal(n) - exact) / ulp;
+      maxUlps = ulps > maxUlps ? ulps : maxUlps;
+    }
+  }
+  return printAccuracyResult(out, "fastReciprocal", FAST_MATH_RECIPROCALS, maxUlps, 1.);
+}
+
+// the residual error and the standard error of the slope (the _re and _er columns) of a row of one
+// trendline stream of n samples
+void testTrendErrors(int n, double *residualError, double *slopeError)
+{
+  testSamples = 0;
+  int i = addDataStream(testData, &testSamples, "Trend stream", "T", "arb", -1);
+  testData[i].calcTrendline = 1;
+  for (int k = 0; k < n; k++)
+  {
+    updateDataSample(testData, i, 1. + 0.5 * k + 0.1 * (k % 2), (float)k);
+  }
+  testText row;
+  printSampleStatSpreadsheetRow(row, testData, testSamples, ",", 1, 0);
+  char *lastColumn = strrchr(row.text, ',');
+  *lastColumn = 0;
+  *slopeError = atof(lastColumn + 1);
+  *residualError = atof(strrchr(row.text, ',') + 1);
+}
+
+// a line through two points leaves no residual: nan below three samples, instead of a division by
+// a negative n
+int checkTrendErrors(Print &out)
+{
+  int failures = 0;
+  for (int n = 0; n <= 3; n++)
+  {
+    double residualError;
+    double slopeError;
+    testTrendErrors(n, &residualError, &slopeError);
+    char name[32];
+    snprintf(name, sizeof(name), "trendResidualNaN%d", n);
+    failures += printTestEqual(out, "ACCURACY", name, isnan(residualError), n <= 2);
+    snprintf(name, sizeof(name), "trendSlopeErrorNaN%d", n);
+    failures += printTestEqual(out, "ACCURACY", name, isnan(slopeError), n <= 2);
+  }
+  return failures;
+}
+
+int checkFastMath(Print &out)
+{
+  return checkTrendErrors(out) + checkFastSqrt<0>(out) + checkFastSqrt<1>(out) + checkFastSqrt<2>(out) + checkFastSqrt<3>(out) +
+         checkFastSine<4>(out) + checkFastSine<5>(out) + checkFastSine<6>(out) +
+         checkFastSine<7>(out) + checkFastSine<8>(out) + checkFastSine<9>(out) +
+         checkFastReciprocal(out);
+}
+
+// ---------------------------------------------------------------------------------------------
+// DERIVED: derived streams over five inputs, evaluated when the sample is finalized (the name of a
+// value check is its expression, that of a refusal the bad expression)
+
+#define TEST_DERIVED_INPUTS 5
+const char *testDerivedNames[TEST_DERIVED_INPUTS] = {"Ax", "Ay", "Az", "TC", "RH"};
+#define TEST_DERIVED_CHECKS 8
+const char *testDerivedChecks[TEST_DERIVED_CHECKS] = {
+    "sqrt(Ax^2 + Ay^2 + Az^2)",
+    "atan2(Ax, Az) * 180 / pi",
+    "243.12 * (log(RH / 100) + 17.62 * TC / (243.12 + TC)) / (17.62 - log(RH / 100) - 17.62 * TC / (243.12 + TC))",
+    "Ax.cv - Ax.av + Ax.sd * Ax.n",
+    "Ax.dt",
+    "-Ay^2 + 2^3^2 / 64",
+    "min(abs(Az), max(exp(TC / 100), log(RH))) + sin(Ax) * cos(Ay) - atan(Az)",
+    "d0 * 2 + d3"}; // refers to two derived streams
+
+int checkDerivedStreams(Print &out)
+{
+  int failures = 0;
+  int firstDerived = nDerived;
+  int firstOp = nDerivedOps;
+  testSamples = 0;
+  testNumEvents = 0;
+  for (int k = 0; k < TEST_DERIVED_INPUTS; k++)
+  {
+    addDataStream(testData, &testSamples, "Test input", (char *)testDerivedNames[k], "arb", 4);
+  }
+  testData[0].calcTrendline = 1;
+  int checks[TEST_DERIVED_CHECKS];
+  for (int k = 0; k < TEST_DERIVED_CHECKS; k++)
+  {
+    char nickName[4] = {'d', (char)('0' + k), 0};
+    checks[k] = addDerivedStream(testData, &testSamples, "Test derived", nickName, "arb", 1, testDerivedChecks[k]);
+  }
+  int unused = addDerivedStream(testData, &testSamples, "Test unused", "dU", "arb", -1, "Ax * 3");
+  int jEvent = addEvent(testEvents, &testNumEvents, "Test threshold", "thresh", 1, 1, 2, "LOW", "HIGH");
+  setEventBreakpoints(testEvents, jEvent, unused < 0 ? 0 : unused, 1.);
+
+  for (int k = 0; k < 10; k++)
+  {
+    updateDataSample(testData, 0, 0.3 + 0.07 * k, 0.1 * k);
+    updateDataSample(testData, 1, -0.2 + 0.03 * (k % 3));
+    updateDataSample(testData, 2, 9.7 + 0.02 * (k % 4));
+    updateDataSample(testData, 3, 21.5 + 0.1 * (k % 2));
+    updateDataSample(testData, 4, 43. + 0.4 * k);
+  }
+  float av[TEST_DERIVED_INPUTS];
+  for (int k = 0; k < TEST_DERIVED_INPUTS; k++)
+  {
+    av[k] = testData[k].sumX / ((float)testData[k].n);
+  }
+  float ax = av[0], ay = av[1], az = av[2], tc = av[3], rh = av[4];
+  sampleStats *x = &testData[0];
+  float n = (float)x->n;
+  float sd = sqrt((x->sumX2 - x->sumX * x->sumX / n) / (n - 1.));
+  float slope = (x->sumXT - x->sumX * x->sumT / n) / (x->sumT2 - x->sumT * x->sumT / n);
+  float g = log(rh / 100.) + 17.62 * tc / (243.12 + tc);
+  float expected[TEST_DERIVED_CHECKS];
+  expected[0] = sqrt(ax * ax + ay * ay + az * az);
+  expected[1] = atan2(ax, az) * 180. / PI;
+  expected[2] = 243.12 * g / (17.62 - g);
+  expected[3] = x->currentVal - ax + sd * n;
+  expected[4] = slope;
+  expected[5] = -ay * ay + 8.;
+  expected[6] = fmin(fabs(az), fmax(exp(tc / 100.), log(rh))) + sin(ax) * cos(ay) - atan(az);
+  expected[7] = expected[0] * 2. + expected[3];
+
+  unsigned long evaluations = derivedEvaluations;
+  updateSampleStats(testData, testSamples);
+  unsigned long evaluated = derivedEvaluations - evaluations;
+  for (int k = 0; k < TEST_DERIVED_CHECKS; k++)
+  {
+    float value = checks[k] < 0 ? NAN : testData[checks[k]].average;
+    int ok = fabs(value - expected[k]) <= 1e-4 * (1. + fabs(expected[k]));
+    failures += printTestResult(out, "DERIVED", testDerivedChecks[k], value, expected[k], ok);
+  }
+  // each stream that is output once (d0 and d3 are also used by d7), the unused one not at all
+  failures += printTestResult(out, "DERIVED", "evaluations", evaluated, TEST_DERIVED_CHECKS, evaluated == TEST_DERIVED_CHECKS);
+  // the threshold event asks for the unused stream: evaluated on the first call only
+  evaluations = derivedEvaluations;
+  int state = evaluateEventBreakpoints(testEvents, jEvent, testData);
+  state += evaluateEventBreakpoints(testEvents, jEvent, testData);
+  failures += printTestResult(out, "DERIVED", "thresholdEvaluations", derivedEvaluations - evaluations, 1, unused >= 0 && derivedEvaluations - evaluations == 1 && state == 2);
+
+  const char *bad[] = {"Ax +", "sqrt(Ax", "nope * 2", "Ax.xx", "foo(1)", "atan2(Ax)", "Ax Ay", "bad * 2"};
+  for (unsigned int k = 0; k < sizeof(bad) / sizeof(bad[0]); k++)
+  {
+    int before = nDerived;
+    int refused = addDerivedStream(testData, &testSamples, "Test bad", "bad", "arb", 1, bad[k]) == -1 && nDerived == before;
+    failures += printTestResult(out, "DERIVED", bad[k], refused, 1, refused);
+  }
+
+  nDerived = firstDerived;
+  nDerivedOps = firstOp;
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// ADAPTIVE: ten minutes of a simulated Az (noise, with bursts of motion) acquired and output at
+// fixed fast, fixed slow and adaptive intervals. a burst is resolved when at least
+// TEST_ADAPTIVE_RESOLVED rows lie inside it; the latency is from its start to the end of the first
+// row whose standard deviation reaches the threshold. the adaptive intervals must resolve every
+// burst the fixed fast ones do, with at most TEST_ADAPTIVE_BYTES of their bytes, and see the bursts
+// sooner than the fixed slow ones
+
+#define TEST_ADAPTIVE_SECONDS 600
+#define TEST_ADAPTIVE_TICK 10     // ms of simulated time per step (the fast acquisition interval)
+#define TEST_ADAPTIVE_BURSTS 8
+#define TEST_ADAPTIVE_FIRST 30000 // ms, start of the first burst
+#define TEST_ADAPTIVE_EVERY 67300 // ms between bursts (not a multiple of any interval)
+#define TEST_ADAPTIVE_LENGTH 2000 // ms
+#define TEST_ADAPTIVE_RESOLVED 5
+#define TEST_ADAPTIVE_BYTES 0.25
+#define TEST_ADAPTIVE_THRESHOLD 0.5
+#define TEST_ADAPTIVE_FAST_OUTPUT 100
+#define TEST_ADAPTIVE_SLOW_OUTPUT 2000
+#define TEST_ADAPTIVE_FAST_ACQUIRE TEST_ADAPTIVE_TICK
+#define TEST_ADAPTIVE_SLOW_ACQUIRE 100
+
+// counts the bytes of the rows instead of writing them
+class testCountPrint : public Print
+{
+public:
+  unsigned long bytes = 0;
+  size_t write(uint8_t)
+  {
+    bytes++;
+    return 1;
+  }
+  size_t write(const uint8_t *, size_t size)
+  {
+    bytes += size;
+    return size;
+  }
+  using Print::write;
+};
+
+struct testAdaptiveResult
+{
+  unsigned long samples;
+  unsigned long bytes;
+  int resolved;
+  long latency; // mean over the bursts seen, -1 if none was
+};
+
+// the burst that time t (ms) falls in, -1 between bursts
+int testBurstAt(unsigned long t)
+{
+  if (t < TEST_ADAPTIVE_FIRST)
+  {
+    return -1;
+  }
+  unsigned long k = (t - TEST_ADAPTIVE_FIRST) / TEST_ADAPTIVE_EVERY;
+  return (k < TEST_ADAPTIVE_BURSTS && (t - TEST_ADAPTIVE_FIRST) % TEST_ADAPTIVE_EVERY < TEST_ADAPTIVE_LENGTH) ? (int)k : -1;
+}
+
+testAdaptiveResult testAdaptiveRun(int adaptive, unsigned long outputInterval, unsigned long acquireInterval)
+{
+  testAdaptiveResult result = {0, 0, 0, -1};
+  testCountPrint counter;
+  int firstController = nAdaptiveRates;
+  testSamples = 0;
+  testNumEvents = 0;
+  int iWatch = addDataStream(testData, &testSamples, "Test Az", "Az", "m/s^2", 4);
+  if (adaptive)
+  {
+    int k = addAdaptiveRate(testData, &testSamples, iWatch, TEST_ADAPTIVE_THRESHOLD, TEST_ADAPTIVE_FAST_OUTPUT, TEST_ADAPTIVE_SLOW_OUTPUT,
+                            TEST_ADAPTIVE_FAST_ACQUIRE, TEST_ADAPTIVE_SLOW_ACQUIRE, "rateMs");
+    if (k < 0)
+    {
+      return result;
+    }
+    acquireInterval = adaptiveAcquireInterval(testData, MAIN_RATE_GROUP, acquireInterval);
+  }
+  else
+  {
+    int iRate = addDataStream(testData, &testSamples, "Test output interval", "rateMs", "ms", 0); // the same columns
+    testData[iRate].currentVal = (float)outputInterval;
+  }
+  // a signal of our own after those of the logger, removed again at the end
+  int firstSignal = nSimSignals;
+  int noise = addSimSignal(-1);
+  if (noise < 0)
+  {
+    return result;
+  }
+  addSimComponent(noise, SIM_CONSTANT, 9.8, 0., 0.);
+  addSimComponent(noise, SIM_GAUSSIAN, 0.05, 0., 0.);
+
+  int rowsInBurst[TEST_ADAPTIVE_BURSTS] = {0};
+  long latency[TEST_ADAPTIVE_BURSTS];
+  for (int b = 0; b < TEST_ADAPTIVE_BURSTS; b++)
+  {
+    latency[b] = -1;
+  }
+  unsigned long rows = 0;
+  unsigned long nextAcquire = 0;
+  unsigned long rowStart = 0;
+  unsigned long nextOutput = outputInterval;
+  for (unsigned long now = 0; now < TEST_ADAPTIVE_SECONDS * 1000UL; now += TEST_ADAPTIVE_TICK)
+  {
+    if (now >= nextAcquire)
+    {
+      float value = simulatedValue(noise, simulationStartMicros + 1000ULL * now);
+      if (testBurstAt(now) >= 0)
+      {
+        value += 2. * mathSinPeriod((float)now, 250.); // the climber moves: 2 m/s^2 at 4 Hz
+      }
+      updateDataSample(testData, iWatch, value);
+      result.samples++;
+      nextAcquire = now + acquireInterval;
+      if (adaptive && adaptiveRateTriggered(testData, MAIN_RATE_GROUP))
+      {
+        nextOutput = now; // end the sample now
+      }
+    }
+    if (now >= nextOutput)
+    {
+      updateSampleStats(testData, testSamples);
+      if (adaptive)
+      {
+        outputInterval = adaptRateGroup(testData, MAIN_RATE_GROUP, outputInterval);
+        acquireInterval = adaptiveAcquireInterval(testData, MAIN_RATE_GROUP, acquireInterval);
+      }
+      int first = testBurstAt(rowStart);
+      int last = testBurstAt(now - 1);
+      if (first >= 0 && first == last)
+      {
+        rowsInBurst[first]++;
+      }
+      int seen = last >= 0 ? last : first;
+      if (seen >= 0 && latency[seen] < 0 && testData[iWatch].standardDeviation >= TEST_ADAPTIVE_THRESHOLD)
+      {
+        latency[seen] = (long)now - (long)(TEST_ADAPTIVE_FIRST + seen * TEST_ADAPTIVE_EVERY);
+      }
+      printSampleStatSpreadsheetRow(counter, testData, testSamples, ", ", ++rows, 0);
+      resetSampleStats(testData, testSamples);
+      rowStart = now;
+      nextOutput = now + outputInterval;
+    }
+  }
+  result.bytes = counter.bytes;
+  long latencySum = 0;
+  int detected = 0;
+  for (int b = 0; b < TEST_ADAPTIVE_BURSTS; b++)
+  {
+    result.resolved += rowsInBurst[b] >= TEST_ADAPTIVE_RESOLVED;
+    if (latency[b] >= 0)
+    {
+      latencySum += latency[b];
+      detected++;
+    }
+  }
+  result.latency = detected ? latencySum / detected : -1;
+  nSimSignals = firstSignal;
+  nAdaptiveRates = firstController;
+  return result;
+}
+
+int checkAdaptiveRate(Print &out)
+{
+  int failures = 0;
+  testAdaptiveResult fast = testAdaptiveRun(0, TEST_ADAPTIVE_FAST_OUTPUT, TEST_ADAPTIVE_FAST_ACQUIRE);
+  testAdaptiveResult slow = testAdaptiveRun(0, TEST_ADAPTIVE_SLOW_OUTPUT, TEST_ADAPTIVE_SLOW_ACQUIRE);
+  testAdaptiveResult adaptive = testAdaptiveRun(1, TEST_ADAPTIVE_SLOW_OUTPUT, TEST_ADAPTIVE_SLOW_ACQUIRE);
+  failures += printTestEqual(out, "ADAPTIVE", "fixedFastResolved", fast.resolved, TEST_ADAPTIVE_BURSTS);
+  // the bursts are too short for rows of the slow interval: without it the checks below say little
+  failures += printTestResult(out, "ADAPTIVE", "fixedSlowResolved", slow.resolved, TEST_ADAPTIVE_BURSTS, slow.resolved < TEST_ADAPTIVE_BURSTS);
+  failures += printTestEqual(out, "ADAPTIVE", "adaptiveResolved", adaptive.resolved, fast.resolved);
+  double bytesRatio = fast.bytes ? ((double)adaptive.bytes) / ((double)fast.bytes) : 0.;
+  failures += printTestResult(out, "ADAPTIVE", "adaptiveBytesOverFast", bytesRatio, TEST_ADAPTIVE_BYTES, bytesRatio > 0. && bytesRatio <= TEST_ADAPTIVE_BYTES, 4);
+  double samplesRatio = fast.samples ? ((double)adaptive.samples) / ((double)fast.samples) : 0.;
+  failures += printTestResult(out, "ADAPTIVE", "adaptiveSamplesOverFast", samplesRatio, 1., samplesRatio > 0. && samplesRatio < 1., 4);
+  failures += printTestResult(out, "ADAPTIVE", "adaptiveLatencyMs", adaptive.latency, slow.latency, adaptive.latency >= 0 && adaptive.latency < slow.latency, 0);
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+// CAPTURE: windows of raw samples captured on scripted triggers (eventCapture.h), read back from
+// the capture file and checked against the samples that were fed in: the values before and after
+// each trigger, the triggers missed while a window was recorded or written, and the CRC of each
+// block
+
+#define TEST_CAPTURE_PASSES 300
+#define TEST_CAPTURE_WINDOWS 3
+#define TEST_CAPTURE_FILE_BYTES 2048
+char testCaptureName[] = "/tcapt.bin";
+
+uint32_t testCaptureWord(const uint8_t *bytes, int size)
+{
+  uint32_t value = 0;
+  for (int k = size - 1; k >= 0; k--)
+  {
+    value = (value << 8) | bytes[k];
+  }
+  return value;
+}
+
+// samples of one stream of a block that are what was fed in: pre samples of value first, first +
+// step, ... up to the trigger and post samples from there on, with times before and after it;
+// returns the count (0 if the counts of the stream differ from pre and post), p moves past it
+int testCaptureStreamMatches(const uint8_t **p, int pre, int post, float first, float step)
+{
+  const uint8_t *stream = *p;
+  int nPre = testCaptureWord(stream + 10, 2);
+  int nPost = testCaptureWord(stream + 12, 2);
+  *p += CAPTURE_STREAM_BYTES + CAPTURE_SAMPLE_BYTES * (nPre + nPost);
+  if (nPre != pre || nPost != post)
+  {
+    return 0;
+  }
+  int matches = 0;
+  for (int j = 0; j < nPre + nPost; j++)
+  {
+    const uint8_t *sample = stream + CAPTURE_STREAM_BYTES + CAPTURE_SAMPLE_BYTES * j;
+    int32_t micros = (int32_t)testCaptureWord(sample, 4);
+    uint32_t valueBits = testCaptureWord(sample + 4, 4);
+    float value;
+    memcpy(&value, &valueBits, 4);
+    matches += value == first + step * j && (j < nPre ? micros < 0 : micros >= 0);
+  }
+  return matches;
+}
+
+int checkEventCapture(Print &out)
+{
+  int failures = 0;
+  SD.begin(SD_CS);
+  strcpy(captureFileName, testCaptureName);
+  SD.remove(captureFileName);
+  testSamples = 0;
+  testNumEvents = 0;
+  addDataStream(testData, &testSamples, "Test captured A", "cA", "arb", 4);
+  addDataStream(testData, &testSamples, "Test captured B", "cB", "arb", 4);
+  addCaptureStream(testData, 0, 16, 8);
+  addCaptureStream(testData, 1, 4, 12); // read on every other pass
+  int jTrigger = addEvent(testEvents, &testNumEvents, "Test trigger", "trig", 0, 0, 2, "OFF", "ON");
+  addCaptureTrigger(testEvents, jTrigger, 1);
+
+  // the trigger goes ON at passes 5, 100 and 200 (windows), and at 7 while the first window is
+  // recorded and at 35 while it is written (missed); OFF at 150 does not trigger. the first two
+  // windows are written a few bytes per pass, the last at once
+  const int script[][2] = {{5, 1}, {7, 1}, {35, 1}, {100, 1}, {150, 0}, {200, 1}};
+  const int nScript = sizeof(script) / sizeof(script[0]);
+  const int windowPass[TEST_CAPTURE_WINDOWS] = {5, 100, 200};
+  const int missedBefore[TEST_CAPTURE_WINDOWS] = {1, 1, 0}; // 7 is noted in the first block, 35 in the second
+  int step = 0;
+  for (int pass = 0; pass < TEST_CAPTURE_PASSES; pass++)
+  {
+    if (step < nScript && script[step][0] == pass)
+    {
+      updateEventState(testEvents, jTrigger, script[step][1], millis());
+      step++;
+    }
+    updateDataSample(testData, 0, (float)pass);
+    if (pass % 2 == 0)
+    {
+      updateDataSample(testData, 1, (float)(1000 + pass));
+    }
+    serviceEventCapture(pass < 150 ? 24 : 100000);
+    hostAdvanceMicros(500);
+  }
+  failures += printTestEqual(out, "CAPTURE", "missed", captureMissed, 2);
+
+  static uint8_t bytes[TEST_CAPTURE_FILE_BYTES];
+  long size = 0;
+  releaseLogFile(captureFileName); // group commit keeps the file open
+  File file = SD.open(captureFileName, FILE_READ);
+  if (file)
+  {
+    size = file.read(bytes, TEST_CAPTURE_FILE_BYTES);
+    file.close();
+  }
+  int windows = 0;
+  char name[24];
+  for (long at = 0; at + CAPTURE_HEADER_BYTES + CAPTURE_TRAILER_BYTES <= size && windows < TEST_CAPTURE_WINDOWS; windows++)
+  {
+    const uint8_t *block = bytes + at;
+    long length = testCaptureWord(block + 8, 4);
+    if (memcmp(block, "KCAP", 4) != 0 || length > size - at || testCaptureWord(block + 12, 4) != (uint32_t)windows)
+    {
+      break;
+    }
+    uint16_t crc = 0xFFFF;
+    for (long k = 0; k < length - CAPTURE_TRAILER_BYTES; k++)
+    {
+      crc = crc16Update(crc, block[k]);
+    }
+    snprintf(name, sizeof(name), "w%d.crc", windows);
+    failures += printTestEqual(out, "CAPTURE", name, crc == testCaptureWord(block + length - CAPTURE_TRAILER_BYTES, 2), 1);
+    snprintf(name, sizeof(name), "w%d.missedBefore", windows);
+    failures += printTestEqual(out, "CAPTURE", name, testCaptureWord(block + 30, 2), missedBefore[windows]);
+
+    // A has every pass, B the even ones: each holds what came before the trigger, up to its pre
+    int t = windowPass[windows];
+    int preA = t < 16 ? t : 16;
+    int firstB = t + t % 2; // first pass of B after the trigger
+    int preB = firstB / 2 < 4 ? firstB / 2 : 4;
+    const uint8_t *p = block + CAPTURE_HEADER_BYTES;
+    snprintf(name, sizeof(name), "w%d.cA", windows);
+    failures += printTestEqual(out, "CAPTURE", name, testCaptureStreamMatches(&p, preA, 8, (float)(t - preA), 1.), preA + 8);
+    snprintf(name, sizeof(name), "w%d.cB", windows);
+    failures += printTestEqual(out, "CAPTURE", name, testCaptureStreamMatches(&p, preB, 12, (float)(1000 + firstB - 2 * preB), 2.), preB + 12);
+    at += length;
+  }
+  failures += printTestEqual(out, "CAPTURE", "windows", windows, TEST_CAPTURE_WINDOWS);
+
+  SD.remove(captureFileName);
+  for (int k = 0; k < nCaptureStreams; k++)
+  {
+    testData[captureStreams[k].stream].captureIndex = -1;
+  }
+  nCaptureStreams = 0;
+  nCaptureTriggers = 0;
+  captureArenaUsed = 0;
+  return failures;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+struct testGroup
+{
+  const char *name;
+  int (*run)(Print &out);
+};
+
+testGroup testGroups[] = {
+    {"TIMING", checkLoopTiming},
+    {"PROFILE", checkProfiler},
+    {"FIFO", checkImuFifo},
+#ifdef ENABLE_RATE_GROUPS
+    {"RATE", checkRateGroups},
+#endif
+    {"TIME", checkTimeBase},
+    {"ACCURACY", checkFastMath},
+    {"DERIVED", checkDerivedStreams},
+    {"ADAPTIVE", checkAdaptiveRate},
+    {"CAPTURE", checkEventCapture},
+};
+
+int main(int argc, char **argv)
+{
+  hostSerialOutput(stdout);
+  int failures = 0;
+  int nGroups = sizeof(testGroups) / sizeof(testGroups[0]);
+  int nNames = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--sd") && i + 1 < argc)
+      snprintf(hostSdRoot, sizeof(hostSdRoot), "%s", argv[++i]);
+    else
+      argv[1 + nNames++] = argv[i];
+  }
+  for (int g = 0; g < nGroups; g++)
+  {
+    int wanted = nNames == 0;
+    for (int i = 1; i <= nNames; i++)
+    {
+      wanted |= !strcmp(argv[i], testGroups[g].name);
+    }
+    if (wanted)
+    {
+      failures += testGroups[g].run(Serial);
+    }
+  }
+  if (failures)
+  {
+    printf("%d checks failed\n", failures);
+  }
+  return failures > 0 ? 1 : 0;
+}
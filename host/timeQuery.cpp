@@ -0,0 +1,588 @@
+// timeQuery.cpp
+// time and count range queries on a data or event file through the index the logger writes next
+// to it (ENABLE_TIME_INDEX, see timeIndex.h): the entry at or before the start of the range is
+// found by binary search and the file is read from its offset, instead of from the start
+//
+//  a data row has no time of its own: its time is interpolated on the count between the entries
+//  around it (past the last entry, at the rate of the last two). an event row has the time of its
+//  change (the tEnd column). times are in ms since the logger started, as in the event file
+//
+//  each entry is checked before it is used: its CRC, that counts and offsets go up, and that the
+//  row at its offset is in the file and has its count. the index is used up to the first entry that
+//  fails and the file is read on from there, so a file cut off by a power loss, or an index that
+//  reaches past its file, gives the same rows as a scan of the whole file
+//
+//  build:  host/build.sh
+//  usage:  host/timeQuery [options] FILE
+//    FILE is a data or event file; its index is the same name with the suffix .idx
+//    --from MS --to MS      print the header and the rows whose time is in [MS, MS]
+//    --count-from N --count-to N  print the header and the rows whose count is in [N, N]
+//    --events FILE          with a data FILE: each event change of the event FILE in the range
+//                           (default all), followed by the data rows just before and after it
+//    --interval-ms MS       time of one row when the index has a single entry (default SAMPLING_PERIOD)
+//    --scan                 read the files from their start instead of seeking (the same rows)
+//    --check                check the index against the file and print how much of it can be used
+//    --bench N              time N random queries of --span-ms with the index and with a scan of
+//                           the whole file, check that they give the same rows and print the latency
+//    --span-ms MS           (default 60000)   --seed N (default 1)
+
+#include "Arduino.h"
+#include <limits.h>
+#include "dataScan.h"
+#include "../deviceConfigGeneric.h"
+
+#define INDEX_MAGIC "KTIX"
+#define INDEX_VERSION 1
+#define INDEX_RECORD_BYTES 16
+
+struct indexEntry
+{
+  uint32_t time;
+  uint32_t count;
+  uint32_t offset;
+};
+
+// a data or event file and the usable entries of its index
+struct indexedFile
+{
+  dataFileMap file;
+  const char *rows;   // first line after the header row
+  int timeColumn;     // column of tEnd in an event file (-1 = data file)
+  indexEntry *entries;
+  int nEntries;       // entries that passed the checks
+  int nRecords;       // entries in the index file
+  const char *stopped; // why the index was not used to its end (NULL = it was)
+};
+
+unsigned long intervalMillis = SAMPLING_PERIOD;
+int useIndex = 1;
+
+// CRC-16/CCITT (polynomial 0x1021, start 0xFFFF) of one byte added to crc (as logSD.h)
+uint16_t crc16Update(uint16_t crc, uint8_t c)
+{
+  crc ^= ((uint16_t)c) << 8;
+  for (int k = 0; k < 8; k++)
+  {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint32_t getWord(const uint8_t *bytes, int size)
+{
+  uint32_t value = 0;
+  for (int k = size - 1; k >= 0; k--)
+  {
+    value = (value << 8) | bytes[k];
+  }
+  return value;
+}
+
+// the code and count of the row (or header) starting at p; returns 0 if the line is not a row of
+// this file (a blank line or one cut off before its count)
+int readRowCount(indexedFile *f, const char *p, const char *lineEnd, long *count)
+{
+  csvField code;
+  csvField countField;
+  const char *next = nextField(p, lineEnd, &code);
+  double value;
+  if (!next || !fieldIs(&code, f->file.deviceCode) || !nextField(next, lineEnd, &countField) || !scanDouble(&countField, &value))
+  {
+    return 0;
+  }
+  *count = (long)value;
+  return 1;
+}
+
+// tEnd of an event row (-1 if it has none)
+double readEventTime(indexedFile *f, const char *p, const char *lineEnd)
+{
+  csvField field;
+  for (int column = 0; p && column <= f->timeColumn; column++)
+  {
+    p = nextField(p, lineEnd, &field);
+    double value;
+    if (column == f->timeColumn && scanDouble(&field, &value))
+      return value;
+  }
+  return -1.;
+}
+
+// check one entry: it follows the previous one and points at the start of its row
+const char *checkEntry(indexedFile *f, indexEntry *entry, indexEntry *previous)
+{
+  if (previous && (entry->count <= previous->count || entry->offset <= previous->offset || entry->time < previous->time))
+  {
+    return "entries out of order";
+  }
+  const char *p = f->file.map + entry->offset;
+  if (p < f->rows || p >= f->file.end || p[-1] != '\n')
+  {
+    return "entry past the end of the file (truncated)";
+  }
+  long count;
+  if (!readRowCount(f, p, lineEndOf(p, f->file.end), &count) || count != (long)entry->count)
+  {
+    return "entry does not match its row";
+  }
+  return NULL;
+}
+
+// map FILE, read its index and keep the entries that pass the checks; returns NULL or an error
+const char *openIndexedFile(const char *fileName, indexedFile *f)
+{
+  const char *error = openDataFile(fileName, &f->file);
+  if (error)
+  {
+    return error;
+  }
+  f->rows = f->file.headerEnd + 1;
+  f->timeColumn = -1;
+  f->entries = NULL;
+  f->nEntries = 0;
+  f->nRecords = 0;
+  f->stopped = "no index";
+
+  // an event file has a tEnd column
+  csvField name;
+  int column = 0;
+  for (const char *p = f->file.header; p; column++)
+  {
+    p = nextField(p, f->file.headerEnd, &name);
+    if (fieldIs(&name, "tEnd"))
+      f->timeColumn = column;
+  }
+
+  char indexName[DATA_SCAN_PATH_MAX];
+  snprintf(indexName, sizeof(indexName), "%s", fileName);
+  char *dot = strrchr(indexName, '.');
+  if (dot && !strchr(dot, '/'))
+    *dot = 0;
+  strncat(indexName, ".idx", sizeof(indexName) - strlen(indexName) - 1);
+  FILE *indexFile = fopen(indexName, "rb");
+  if (!indexFile)
+  {
+    return NULL;
+  }
+  fseek(indexFile, 0, SEEK_END);
+  long bytes = ftell(indexFile);
+  fseek(indexFile, 0, SEEK_SET);
+  uint8_t *records = (uint8_t *)malloc(bytes > 0 ? bytes : 1);
+  bytes = fread(records, 1, bytes, indexFile);
+  fclose(indexFile);
+  if (bytes < INDEX_RECORD_BYTES || memcmp(records, INDEX_MAGIC, 4) || getWord(records + 4, 2) != INDEX_VERSION ||
+      getWord(records + 6, 2) != INDEX_RECORD_BYTES)
+  {
+    free(records);
+    f->stopped = "not an index file";
+    return NULL;
+  }
+  f->nRecords = bytes / INDEX_RECORD_BYTES - 1;
+  f->entries = (indexEntry *)malloc((f->nRecords + 1) * sizeof(indexEntry));
+  f->stopped = bytes % INDEX_RECORD_BYTES ? "last entry cut off" : NULL;
+  for (int k = 0; k < f->nRecords; k++)
+  {
+    const uint8_t *record = records + (k + 1) * INDEX_RECORD_BYTES;
+    uint16_t crc = 0xFFFF;
+    for (int j = 0; j < 12; j++)
+    {
+      crc = crc16Update(crc, record[j]);
+    }
+    if (crc != getWord(record + 12, 2))
+    {
+      f->stopped = "bad CRC";
+      break;
+    }
+    indexEntry *entry = &f->entries[f->nEntries];
+    entry->time = getWord(record, 4);
+    entry->count = getWord(record + 4, 4);
+    entry->offset = getWord(record + 8, 4);
+    const char *why = checkEntry(f, entry, f->nEntries > 0 ? entry - 1 : NULL);
+    if (why)
+    {
+      f->stopped = why;
+      break;
+    }
+    f->nEntries++;
+  }
+  free(records);
+  return NULL;
+}
+
+// where to start reading for the rows after entry k (-1 = from the header)
+const char *entryStart(indexedFile *f, int k)
+{
+  return (k < 0 || !useIndex) ? f->rows : f->file.map + f->entries[k].offset;
+}
+
+// last entry with time before t, or with count at most c (-1 if none)
+int findEntryByTime(indexedFile *f, double t)
+{
+  int low = 0, high = f->nEntries; // first entry with time >= t is in [low, high]
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if (f->entries[middle].time < t)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low - 1;
+}
+
+int findEntryByCount(indexedFile *f, long c)
+{
+  int low = 0, high = f->nEntries;
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if ((long)f->entries[middle].count <= c)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low - 1;
+}
+
+// time of the data row with this count, from the entries around it
+double dataRowTime(indexedFile *f, long count)
+{
+  if (f->nEntries == 0)
+  {
+    return -1.;
+  }
+  int k = findEntryByCount(f, count);
+  if (k < 0)
+    k = 0;
+  if (k == f->nEntries - 1 && k > 0)
+    k--; // past the last entry: at the rate of the last two
+  indexEntry *a = &f->entries[k];
+  if (k + 1 >= f->nEntries)
+  {
+    return a->time + ((double)count - a->count) * intervalMillis;
+  }
+  indexEntry *b = &f->entries[k + 1];
+  return a->time + ((double)count - a->count) * ((double)b->time - a->time) / ((double)b->count - a->count);
+}
+
+double rowTime(indexedFile *f, const char *p, const char *lineEnd, long count)
+{
+  return f->timeColumn >= 0 ? readEventTime(f, p, lineEnd) : dataRowTime(f, count);
+}
+
+// where a query ends its output: a FILE, or (for the benchmark) a running hash of the lines
+struct querySink
+{
+  FILE *out;
+  uint64_t hash;
+  unsigned long rows;
+};
+
+void emitLine(querySink *sink, const char *p, const char *lineEnd)
+{
+  sink->rows++;
+  if (sink->out)
+  {
+    fwrite(p, 1, lineEnd - p + 1, sink->out);
+    return;
+  }
+  for (; p < lineEnd; p++)
+  {
+    sink->hash = (sink->hash ^ (uint8_t)*p) * 1099511628211ULL;
+  }
+}
+
+// print the rows whose time (byTime) or count is in [low, high]; the rows of a file are in time
+// and count order, so reading stops at the first row past high
+void queryRange(indexedFile *f, int byTime, double low, double high, querySink *sink)
+{
+  int k = byTime ? findEntryByTime(f, low) : findEntryByCount(f, (long)low);
+  for (const char *p = entryStart(f, k); p < f->file.end;)
+  {
+    const char *lineEnd = lineEndOf(p, f->file.end);
+    long count;
+    if (readRowCount(f, p, lineEnd, &count))
+    {
+      double key = byTime ? rowTime(f, p, lineEnd, count) : count;
+      if (key > high)
+        break;
+      if (key >= low)
+        emitLine(sink, p, lineEnd);
+    }
+    p = lineEnd + 1;
+  }
+}
+
+// for each event change in [low, high]: its lines and the data rows just before and after it
+void joinEvents(indexedFile *events, indexedFile *data, double low, double high, querySink *sink)
+{
+  int k = findEntryByTime(events, low);
+  for (const char *p = entryStart(events, k); p < events->file.end;)
+  {
+    const char *lineEnd = lineEndOf(p, events->file.end);
+    long count;
+    if (!readRowCount(events, p, lineEnd, &count))
+    {
+      p = lineEnd + 1;
+      continue;
+    }
+    double tEnd = readEventTime(events, p, lineEnd);
+    if (tEnd > high)
+      break;
+    // the lines of the change (FROM and TO share its count)
+    const char *change = p;
+    long changeCount = count;
+    while (p < events->file.end && readRowCount(events, p, lineEnd, &count) && count == changeCount)
+    {
+      p = lineEnd + 1;
+      lineEnd = lineEndOf(p, events->file.end);
+    }
+    if (tEnd < low)
+      continue;
+    for (const char *q = change; q < p; q = lineEndOf(q, events->file.end) + 1)
+    {
+      emitLine(sink, q, lineEndOf(q, events->file.end));
+    }
+    // the last data row at or before the change and the first after it
+    const char *before = NULL;
+    const char *beforeEnd = NULL;
+    int j = findEntryByTime(data, tEnd);
+    for (const char *q = entryStart(data, j); q < data->file.end;)
+    {
+      const char *qEnd = lineEndOf(q, data->file.end);
+      long rowCount;
+      if (readRowCount(data, q, qEnd, &rowCount))
+      {
+        if (dataRowTime(data, rowCount) > tEnd)
+        {
+          if (before)
+            emitLine(sink, before, beforeEnd);
+          emitLine(sink, q, qEnd);
+          before = NULL;
+          break;
+        }
+        before = q;
+        beforeEnd = qEnd;
+      }
+      q = qEnd + 1;
+    }
+    if (before)
+      emitLine(sink, before, beforeEnd); // the change is after the last data row
+    if (sink->out)
+      fputc('\n', sink->out);
+  }
+}
+
+void printHeader(indexedFile *f)
+{
+  fwrite(f->file.header, 1, f->file.headerEnd - f->file.header + 1, stdout);
+}
+
+// rows after the last usable entry (read to check what a truncated index leaves to scan)
+unsigned long rowsAfter(indexedFile *f, const char *p, long *lastCount)
+{
+  unsigned long rows = 0;
+  while (p < f->file.end)
+  {
+    const char *lineEnd = lineEndOf(p, f->file.end);
+    long count;
+    if (readRowCount(f, p, lineEnd, &count))
+    {
+      rows++;
+      *lastCount = count;
+    }
+    p = lineEnd + 1;
+  }
+  return rows;
+}
+
+void checkIndex(const char *fileName, indexedFile *f)
+{
+  printf("%s: %s file, %lu bytes\n", fileName, f->timeColumn >= 0 ? "event" : "data", (unsigned long)(f->file.end - f->file.map));
+  printf("index: %d entries, %d usable", f->nRecords, f->nEntries);
+  if (f->stopped)
+    printf(" (stopped: %s)", f->stopped);
+  printf("\n");
+  if (f->nEntries > 0)
+  {
+    indexEntry *first = &f->entries[0];
+    indexEntry *last = &f->entries[f->nEntries - 1];
+    printf("covers counts %u to %u, times %u to %u ms, offsets %u to %u\n", first->count, last->count, first->time,
+           last->time, first->offset, last->offset);
+  }
+  long lastCount = 0;
+  unsigned long rows = rowsAfter(f, entryStart(f, f->nEntries - 1), &lastCount);
+  printf("%lu rows read from the last usable entry on (last count %ld)\n", rows, lastCount);
+}
+
+double elapsedSeconds(struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+uint32_t benchState = 1;
+
+// time random queries with the index and by scanning the whole file; returns 1 if they disagree
+int benchQueries(indexedFile *f, indexedFile *events, int nQueries, double spanMillis)
+{
+  if (f->nEntries < 2)
+  {
+    fprintf(stderr, "timeQuery: the benchmark needs an index with two entries or more\n");
+    return 1;
+  }
+  double first = f->entries[0].time;
+  double last = f->entries[f->nEntries - 1].time;
+  double seconds[2] = {0., 0.};
+  uint64_t hash[2] = {0, 0};
+  unsigned long rows[2] = {0, 0};
+  for (int q = 0; q < nQueries; q++)
+  {
+    benchState = benchState * 1664525u + 1013904223u;
+    double low = first + (last - first) * (benchState >> 8) / 16777216.;
+    for (int mode = 0; mode < 2; mode++)
+    {
+      useIndex = (mode == 0);
+      querySink sink = {NULL, 14695981039346656037ULL, 0};
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      if (events)
+        joinEvents(events, f, low, low + spanMillis, &sink);
+      else
+        queryRange(f, 1, low, low + spanMillis, &sink);
+      seconds[mode] += elapsedSeconds(&start);
+      hash[mode] ^= sink.hash + q;
+      rows[mode] += sink.rows;
+    }
+  }
+  useIndex = 1;
+  double bytes = f->file.end - f->file.map;
+  printf("queries\tspan_ms\tMB\trows/query\tindexed_us\tscan_us\tspeedup\n");
+  printf("%d\t%.0f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", nQueries, spanMillis, bytes / 1e6, (double)rows[0] / nQueries,
+         seconds[0] / nQueries * 1e6, seconds[1] / nQueries * 1e6, seconds[0] > 0. ? seconds[1] / seconds[0] : 0.);
+  if (hash[0] != hash[1] || rows[0] != rows[1])
+  {
+    fprintf(stderr, "timeQuery: the indexed queries and the scans gave different rows\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *fileName = NULL;
+  const char *eventsName = NULL;
+  double from = -1., to = 4294967295.;
+  long countFrom = -1, countTo = LONG_MAX;
+  int check = 0;
+  int nBench = 0;
+  double spanMillis = 60000.;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--", 2))
+    {
+      fileName = arg;
+      continue;
+    }
+    if (!strcmp(arg, "--scan"))
+    {
+      useIndex = 0;
+      continue;
+    }
+    if (!strcmp(arg, "--check"))
+    {
+      check = 1;
+      continue;
+    }
+    const char *value = (i + 1 < argc) ? argv[++i] : NULL;
+    if (!value)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 2;
+    }
+    if (!strcmp(arg, "--from"))
+      from = atof(value);
+    else if (!strcmp(arg, "--to"))
+      to = atof(value);
+    else if (!strcmp(arg, "--count-from"))
+      countFrom = atol(value);
+    else if (!strcmp(arg, "--count-to"))
+      countTo = atol(value);
+    else if (!strcmp(arg, "--events"))
+      eventsName = value;
+    else if (!strcmp(arg, "--interval-ms"))
+      intervalMillis = strtoul(value, NULL, 10);
+    else if (!strcmp(arg, "--bench"))
+      nBench = atoi(value);
+    else if (!strcmp(arg, "--span-ms"))
+      spanMillis = atof(value);
+    else if (!strcmp(arg, "--seed"))
+      benchState = strtoul(value, NULL, 10);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 2;
+    }
+  }
+  if (!fileName)
+  {
+    fprintf(stderr, "usage: timeQuery [options] FILE\n");
+    return 2;
+  }
+
+  indexedFile file;
+  indexedFile events;
+  const char *error = openIndexedFile(fileName, &file);
+  if (!error && eventsName)
+  {
+    error = openIndexedFile(eventsName, &events);
+    fileName = eventsName;
+  }
+  if (error)
+  {
+    fprintf(stderr, "%s: %s\n", fileName, error);
+    return 1;
+  }
+  if (check)
+  {
+    checkIndex(fileName, eventsName ? &events : &file);
+    return 0;
+  }
+  if (eventsName && (file.timeColumn >= 0 || events.timeColumn < 0))
+  {
+    fprintf(stderr, "timeQuery: --events joins an event file to a data file\n");
+    return 2;
+  }
+  if (nBench > 0)
+  {
+    return benchQueries(&file, eventsName ? &events : NULL, nBench, spanMillis);
+  }
+  if (file.timeColumn < 0 && file.nEntries == 0 && (from >= 0. || eventsName))
+  {
+    fprintf(stderr, "timeQuery: the times of data rows come from the index (%s)\n", file.stopped);
+    return 1;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  querySink sink = {stdout, 0, 0};
+  if (eventsName)
+  {
+    joinEvents(&events, &file, from, to, &sink);
+  }
+  else
+  {
+    printHeader(&file);
+    if (countFrom >= 0 || countTo != LONG_MAX)
+      queryRange(&file, 0, countFrom, countTo, &sink);
+    else
+      queryRange(&file, 1, from, to, &sink);
+  }
+  fflush(stdout);
+  fprintf(stderr, "timeQuery: %lu rows in %.3f ms (%s, %d of %d index entries usable)\n", sink.rows, elapsedSeconds(&start) * 1e3,
+          useIndex ? "indexed" : "scan", (eventsName ? &events : &file)->nEntries, (eventsName ? &events : &file)->nRecords);
+  return 0;
+}
@@ -0,0 +1,269 @@
+// imuFifo.h
+// FIFO acquisition for the LSM6DS33 accelerometer / gyroscope
+//  the IMU samples at a fixed output data rate (ODR) into its own FIFO, and the FIFO is drained in
+//  bursts (one I2C transaction for up to IMU_FIFO_BURST_SETS samples) instead of one blocking
+//  getEvent() per pass through loop(). the sample rate no longer depends on the loop rate
+//  (random delays and SD writes only change how many samples each drain finds)
+//
+//  timestamps: the newest sample in a drain is taken to be at the time of the drain, earlier
+//  samples are spaced 1/ODR apart before it
+//
+//  register access goes through an imuFifoDriver (two function pointers), so the FIFO can be
+//  replaced by a mock that replays FIFO contents (the host build emulates the sensor in host/Wire.h)
+//
+//  note: the LIS3MDL magnetometer has no FIFO, so it is still read once per pass
+//
+//  enable with ENABLE_IMU_FIFO in the deviceConfig file
+
+#ifdef ENABLE_IMU_FIFO
+
+// LSM6DS33 registers used for the FIFO
+#define LSM6DS33_ADDRESS 0x6A
+#define LSM6DS33_FIFO_CTRL3 0x08     // decimation of gyro and accel data in the FIFO
+#define LSM6DS33_FIFO_CTRL5 0x0A     // FIFO ODR and mode
+#define LSM6DS33_CTRL1_XL 0x10       // accel ODR and full scale
+#define LSM6DS33_CTRL2_G 0x11        // gyro ODR and full scale
+#define LSM6DS33_FIFO_STATUS1 0x3A   // number of unread words (low byte)
+#define LSM6DS33_FIFO_DATA_OUT_L 0x3E // FIFO output (address wraps from 0x3F back to 0x3E on a burst read)
+
+#define IMU_FIFO_MODE_BYPASS 0x00
+#define IMU_FIFO_MODE_CONTINUOUS 0x06
+#define IMU_FIFO_OVERRUN 0x40 // FIFO_STATUS2: data was lost because the FIFO was full
+#define IMU_FIFO_EMPTY 0x10   // FIFO_STATUS2: no unread data
+
+// data set stored in the FIFO for each sample: gyro x, y, z then accel x, y, z (16 bit words)
+#define IMU_FIFO_WORDS_PER_SET 6
+#define IMU_FIFO_BYTES_PER_SET 12
+
+#ifndef IMU_FIFO_ODR_CODE
+#define IMU_FIFO_ODR_CODE 4 // 1 = 12.5 Hz, 2 = 26, 3 = 52, 4 = 104, 5 = 208, 6 = 416, 7 = 833, 8 = 1660 Hz
+#endif
+#ifndef IMU_FIFO_BURST_SETS
+#define IMU_FIFO_BURST_SETS 5 // sets read per I2C transaction (5 x 12 bytes fits the 64 byte Wire buffer)
+#endif
+#ifndef IMU_FIFO_DRAIN_INTERVAL
+#define IMU_FIFO_DRAIN_INTERVAL 50 // ms between drains of the FIFO
+#endif
+#define IMU_FIFO_MAX_SETS 64 // most samples fed into the data streams from one drain
+
+struct imuFifoDriver
+{
+  int (*readRegisters)(uint8_t reg, uint8_t *buffer, int length); // returns number of bytes read or -1
+  int (*writeRegister)(uint8_t reg, uint8_t value);                // returns 1 on success or -1
+};
+
+struct imuFifo
+{
+  imuFifoDriver *driver;
+  float odrHz;      // sample rate of the IMU
+  float accelScale; // m/s^2 per LSB
+  float gyroScale;  // rad/s per LSB
+
+  unsigned long samples;      // total samples drained
+  unsigned long transactions; // total I2C transactions used by the FIFO
+  unsigned long overruns;     // number of drains that found the FIFO had overflowed
+  unsigned long busMicros;    // total time spent in I2C transactions
+
+  // samples from the most recent drain (in m/s^2 and rad/s)
+  int nSets;
+  float ax[IMU_FIFO_MAX_SETS], ay[IMU_FIFO_MAX_SETS], az[IMU_FIFO_MAX_SETS];
+  float gx[IMU_FIFO_MAX_SETS], gy[IMU_FIFO_MAX_SETS], gz[IMU_FIFO_MAX_SETS];
+  float relTime[IMU_FIFO_MAX_SETS];
+};
+
+imuFifo imuFifoLSM;
+unsigned long nextImuFifoDrain = 0;
+
+float imuOdrHz(int odrCode)
+{
+  if (odrCode <= 0)
+  {
+    return 0.;
+  }
+  if (odrCode == 1)
+  {
+    return 12.5;
+  }
+  return 13. * (float)(1 << (odrCode - 1)); // 26, 52, 104, 208, 416, 833, 1660 Hz
+}
+
+int imuFifoWrite(imuFifo *fifo, uint8_t reg, uint8_t value)
+{
+  unsigned long start = micros();
+  int status = fifo->driver->writeRegister(reg, value);
+  fifo->busMicros += micros() - start;
+  fifo->transactions++;
+  return status;
+}
+
+int imuFifoRead(imuFifo *fifo, uint8_t reg, uint8_t *buffer, int length)
+{
+  unsigned long start = micros();
+  int status = fifo->driver->readRegisters(reg, buffer, length);
+  fifo->busMicros += micros() - start;
+  fifo->transactions++;
+  return status;
+}
+
+// configure the IMU for continuous FIFO mode with accel +-4 g and gyro 2000 dps (the library defaults)
+int imuFifoBegin(imuFifo *fifo, imuFifoDriver *driver, int odrCode)
+{
+  fifo->driver = driver;
+  fifo->odrHz = imuOdrHz(odrCode);
+  fifo->accelScale = 0.122e-3 * 9.80665;         // 0.122 mg/LSB at +-4 g
+  fifo->gyroScale = 70.e-3 * 3.14159265 / 180.;   // 70 mdps/LSB at 2000 dps
+  fifo->samples = 0;
+  fifo->transactions = 0;
+  fifo->overruns = 0;
+  fifo->busMicros = 0;
+  fifo->nSets = 0;
+
+  int status = 1;
+  if (imuFifoWrite(fifo, LSM6DS33_CTRL1_XL, (odrCode << 4) | 0x08) < 0) // FS_XL = 10 (+-4 g)
+    status = -1;
+  if (imuFifoWrite(fifo, LSM6DS33_CTRL2_G, (odrCode << 4) | 0x0C) < 0) // FS_G = 11 (2000 dps)
+    status = -1;
+  if (imuFifoWrite(fifo, LSM6DS33_FIFO_CTRL3, 0x09) < 0) // no decimation of gyro or accel
+    status = -1;
+  // switching through bypass mode empties the FIFO
+  if (imuFifoWrite(fifo, LSM6DS33_FIFO_CTRL5, IMU_FIFO_MODE_BYPASS) < 0)
+    status = -1;
+  if (imuFifoWrite(fifo, LSM6DS33_FIFO_CTRL5, (odrCode << 3) | IMU_FIFO_MODE_CONTINUOUS) < 0)
+    status = -1;
+  if (status < 0)
+  {
+    WARN("IMU FIFO configuration failed", status)
+  }
+  return status;
+}
+
+// read every complete sample waiting in the FIFO into fifo->ax ... fifo->gz
+//  relTimeNow = time (s) of the drain, used to timestamp the samples
+//  returns the number of samples read (0 if none) or -1 on a bus error
+int imuFifoDrain(imuFifo *fifo, float relTimeNow)
+{
+  fifo->nSets = 0;
+
+  // FIFO_STATUS1..4: unread words, flags and the pattern index of the next word
+  uint8_t status[4];
+  if (imuFifoRead(fifo, LSM6DS33_FIFO_STATUS1, status, 4) != 4)
+  {
+    return -1;
+  }
+  if (status[1] & IMU_FIFO_OVERRUN)
+  {
+    fifo->overruns++;
+  }
+  if (status[1] & IMU_FIFO_EMPTY)
+  {
+    return 0;
+  }
+  int words = ((int)(status[1] & 0x0F) << 8) | status[0];
+  int pattern = ((int)(status[3] & 0x03) << 8) | status[2];
+
+  // after an overrun the next word may not be a gyro x: skip words until the pattern realigns
+  uint8_t raw[IMU_FIFO_BURST_SETS * IMU_FIFO_BYTES_PER_SET];
+  while (pattern % IMU_FIFO_WORDS_PER_SET != 0 && words > 0)
+  {
+    if (imuFifoRead(fifo, LSM6DS33_FIFO_DATA_OUT_L, raw, 2) != 2)
+    {
+      return -1;
+    }
+    pattern++;
+    words--;
+  }
+
+  int sets = words / IMU_FIFO_WORDS_PER_SET;
+  if (sets > IMU_FIFO_MAX_SETS)
+  {
+    sets = IMU_FIFO_MAX_SETS; // the rest is read on the next drain
+  }
+
+  while (fifo->nSets < sets)
+  {
+    int burst = sets - fifo->nSets;
+    if (burst > IMU_FIFO_BURST_SETS)
+    {
+      burst = IMU_FIFO_BURST_SETS;
+    }
+    int length = burst * IMU_FIFO_BYTES_PER_SET;
+    if (imuFifoRead(fifo, LSM6DS33_FIFO_DATA_OUT_L, raw, length) != length)
+    {
+      return -1;
+    }
+    for (int k = 0; k < burst; k++)
+    {
+      int16_t word[IMU_FIFO_WORDS_PER_SET];
+      for (int w = 0; w < IMU_FIFO_WORDS_PER_SET; w++)
+      {
+        word[w] = (int16_t)(raw[k * IMU_FIFO_BYTES_PER_SET + 2 * w] | (raw[k * IMU_FIFO_BYTES_PER_SET + 2 * w + 1] << 8));
+      }
+      int iSet = fifo->nSets + k;
+      fifo->gx[iSet] = word[0] * fifo->gyroScale;
+      fifo->gy[iSet] = word[1] * fifo->gyroScale;
+      fifo->gz[iSet] = word[2] * fifo->gyroScale;
+      fifo->ax[iSet] = word[3] * fifo->accelScale;
+      fifo->ay[iSet] = word[4] * fifo->accelScale;
+      fifo->az[iSet] = word[5] * fifo->accelScale;
+    }
+    fifo->nSets += burst;
+  }
+
+  // reconstruct sample times from the ODR: the newest sample is at the time of the drain
+  float period = fifo->odrHz > 0. ? 1. / fifo->odrHz : 0.;
+  for (int k = 0; k < fifo->nSets; k++)
+  {
+    fifo->relTime[k] = relTimeNow - ((float)(fifo->nSets - 1 - k)) * period;
+  }
+  fifo->samples += fifo->nSets;
+  return fifo->nSets;
+}
+
+// drain the FIFO and add the samples to the accel and gyro data streams as a batch
+int imuFifoUpdateDataStreams(imuFifo *fifo, sampleStats *dataStream, int iAccelX, int iAccelY, int iAccelZ,
+                             int iGyroX, int iGyroY, int iGyroZ, float relTimeNow)
+{
+  int nSets = imuFifoDrain(fifo, relTimeNow);
+  if (nSets <= 0)
+  {
+    return nSets;
+  }
+  updateDataSampleBatch(dataStream, iAccelX, fifo->ax, fifo->relTime, nSets);
+  updateDataSampleBatch(dataStream, iAccelY, fifo->ay, fifo->relTime, nSets);
+  updateDataSampleBatch(dataStream, iAccelZ, fifo->az, fifo->relTime, nSets);
+  updateDataSampleBatch(dataStream, iGyroX, fifo->gx, fifo->relTime, nSets);
+  updateDataSampleBatch(dataStream, iGyroY, fifo->gy, fifo->relTime, nSets);
+  updateDataSampleBatch(dataStream, iGyroZ, fifo->gz, fifo->relTime, nSets);
+  return nSets;
+}
+
+// driver for the sensor on the I2C bus (Wire)
+#include <Wire.h>
+
+int imuWireReadRegisters(uint8_t reg, uint8_t *buffer, int length)
+{
+  Wire.beginTransmission(LSM6DS33_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+  {
+    return -1;
+  }
+  int received = Wire.requestFrom((uint8_t)LSM6DS33_ADDRESS, (uint8_t)length);
+  for (int k = 0; k < received; k++)
+  {
+    buffer[k] = Wire.read();
+  }
+  return received;
+}
+
+int imuWireWriteRegister(uint8_t reg, uint8_t value)
+{
+  Wire.beginTransmission(LSM6DS33_ADDRESS);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0 ? 1 : -1;
+}
+
+imuFifoDriver imuWireDriver = {imuWireReadRegisters, imuWireWriteRegister};
+
+#endif
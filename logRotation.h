@@ -0,0 +1,135 @@
+// logRotation.h
+// rotation of the SD files by size and by wall-clock period
+//  a rotating file is moved on to the next file number of its type (setup_SD_file() finds it from
+//  the marker file of the type in a few lookups) when it reaches LOG_ROTATE_BYTES, or at each
+//  boundary of LOG_ROTATE_PERIOD (on the wall clock with ENABLE_ABSOLUTE_TIME, e.g. on the hour,
+//  otherwise counted from startup). the caller prints the header of the file after a rotation, so
+//  every file starts with its preamble and schema header and can be read on its own
+//
+//  the size is read from the card at most once every LOG_ROTATE_SIZE_CHECK_INTERVAL. with
+//  ENABLE_OUTPUT_QUEUE the queue is written out before a rotation so no rows land in the wrong file
+//  (no rotation while the card is missing)
+//
+//  files stay in the directory chosen at startup (up to SD_FILE_MAX files of each type)
+//
+//  with ENABLE_ABSOLUTE_TIME the files are opened before the clock is anchored to the RTC: call
+//  logRotationStartPeriod() for each rotation after timeBaseBegin(), or the first boundary is
+//  counted from the unanchored clock and the first row rotates the file away
+//
+//  enable with ENABLE_LOG_ROTATION in the deviceConfig file
+
+#ifdef ENABLE_LOG_ROTATION
+
+#ifndef LOG_ROTATE_BYTES
+#define LOG_ROTATE_BYTES 4000000UL // start a new file when the current one reaches this size (0 = no limit)
+#endif
+#ifndef LOG_ROTATE_PERIOD
+#define LOG_ROTATE_PERIOD 3600UL // start a new file at each boundary of this period (s, 0 = never)
+#endif
+#define LOG_ROTATE_SIZE_CHECK_INTERVAL 60000 // ms between reads of the file size
+
+struct logRotation
+{
+  char *fullFileName; // buffer holding the name of the current file
+  char *fileType;     // type and suffix passed to setup_SD_file() for the next file
+  char *fileSuffix;
+  unsigned long maxBytes;
+  uint64_t periodMicros;
+  uint64_t nextPeriod;         // time (see logRotationClock) of the next period boundary
+  unsigned long nextSizeCheck; // millis() of the next read of the file size
+  unsigned long rotations;
+};
+
+logRotation dataRotation;
+logRotation eventRotation;
+
+// time used for the period boundaries (us)
+uint64_t logRotationClock()
+{
+#ifdef ENABLE_ABSOLUTE_TIME
+  return absoluteMicros(&clockBase, monoMicros());
+#else
+  return monoMicros();
+#endif
+}
+
+// the next period boundary from the current time
+void logRotationStartPeriod(logRotation *rotation)
+{
+  if (rotation->periodMicros > 0)
+  {
+    rotation->nextPeriod = (logRotationClock() / rotation->periodMicros + 1) * rotation->periodMicros;
+  }
+}
+
+void logRotationBegin(logRotation *rotation, char *fullFileName, char *fileType, char *fileSuffix,
+                      unsigned long maxBytes, unsigned long periodSeconds)
+{
+  rotation->fullFileName = fullFileName;
+  rotation->fileType = fileType;
+  rotation->fileSuffix = fileSuffix;
+  rotation->maxBytes = maxBytes;
+  rotation->periodMicros = ((uint64_t)periodSeconds) * 1000000ULL;
+  logRotationStartPeriod(rotation);
+  rotation->nextSizeCheck = millis() + LOG_ROTATE_SIZE_CHECK_INTERVAL;
+  rotation->rotations = 0;
+}
+
+// returns 1 when the file is due to be rotated
+int logRotationDue(logRotation *rotation)
+{
+  if (rotation->fullFileName[0] == 0)
+  {
+    return 0; // the file was never created (no card)
+  }
+  if (rotation->periodMicros > 0 && logRotationClock() >= rotation->nextPeriod)
+  {
+    return 1;
+  }
+#ifdef ENABLE_LOG_PREALLOCATE
+  int e = findLogExtent(rotation->fullFileName);
+  if (rotation->maxBytes > 0 && e >= 0)
+  {
+    return logExtents[e].length >= rotation->maxBytes; // the size on the card is the preallocated size
+  }
+#endif
+  if (rotation->maxBytes > 0 && millis() >= rotation->nextSizeCheck)
+  {
+    rotation->nextSizeCheck = millis() + LOG_ROTATE_SIZE_CHECK_INTERVAL;
+    File tmpFile = SD.open(rotation->fullFileName, FILE_READ);
+    if (tmpFile)
+    {
+      unsigned long size = tmpFile.size();
+      tmpFile.close();
+      return size >= rotation->maxBytes;
+    }
+  }
+  return 0;
+}
+
+// start the next file; returns 1 when the caller should print the header to the new file
+int rotateLogFile(logRotation *rotation)
+{
+#ifdef ENABLE_OUTPUT_QUEUE
+  outputQueueWrite(&sdQueue, 0); // rows already queued belong in the old file
+  if (sdQueue.records > 0)
+  {
+    return -1; // the card is missing: try again later
+  }
+#endif
+  unsigned long preallocateBytes = 0;
+#ifdef ENABLE_LOG_PREALLOCATE
+  preallocateBytes = logExtentCapacity(rotation->fullFileName); // the next file is preallocated like this one
+#endif
+  if (setup_SD_file(deviceCode, rotation->fileType, rotation->fileSuffix, rotation->fullFileName, preallocateBytes) < 0)
+  {
+    return -1;
+  }
+  logRotationStartPeriod(rotation);
+  rotation->nextSizeCheck = millis() + LOG_ROTATE_SIZE_CHECK_INTERVAL;
+  rotation->rotations++;
+  MESSAGE("rotated to", rotation->fullFileName)
+  return 1;
+}
+
+#endif
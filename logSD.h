@@ -1,191 +1,574 @@
-
-// ---SD CARD SETUP----------------------------------------------------------
-//  SD communication Based on on-line SD library example:
-//    http://arduino.cc/en/Tutorial/Datalogger
-
-// for datalogging to SD wtih real-time-clock
-#include <SPI.h>
-#include <SD.h>
-#include <RTClib.h>
-
-// should move to deviceConfig
-// SD chip select is pin 10 on Adalogger featherwing!
-//#define SD_CS 10
-// SD chip select for E-Ink featherwing
-//#define SD_CS 5
-
-//*********** SD Card Setup
-// char logFileType[] = "log";
-// char dataFileType[] = "data";
-// char eventFileType[] = "evnt";
-// char fileSuffix[] = ".txt";
-char dirPath[30];      // create buffer to hold path to directory
-char logFileName[40]; // create buffer to hold filename for datalogger
-char dataFileName[40]; // create buffer to hold filename for datalogger
-char eventFileName[40]; // create buffer to hold filename for datalogger
-
-// File logFile;
-// File dataFile;
-// File eventFile;
-
-#ifdef USE_RTC
-RTC_PCF8523 rtc; // real time clock on Adafruit adalogger
-//RTC_DS1307 rtc;
-DateTime currentNow;
-#endif
-
-int setup_SD_file(char *fileCode, char *filePre, char *fileSuf, char *fullFileName)
-{
-    //String filePre = "DD3v";
-    //String fileSuf = ".txt";
-    int fileNum = 0;
-    Serial.print("InitSD-");
-    // make sure that the default chip select pin is set to
-    // output, even if you don't use it:
-    pinMode(SD_CS, OUTPUT);
-    //pinMode(10, OUTPUT);
-    // see if the card is present and can be initialized:
-    if (!SD.begin(SD_CS))
-    {
-        Serial.println("SD fail");
-        // don't do anything more:
-        return -1;
-    }
-    Serial.println("done");
-
-    // check to see if data file already exists - increment file number until you find
-    //   a number that does not exist; using numbers from 00 to 99
-    int nextLoop = 1;
-    for (fileNum = 0; fileNum < 100 && nextLoop; fileNum++)
-    {
-        String tempFileName = "";
-        if (dirPath[0])
-            tempFileName += String(dirPath);
-        tempFileName += String(fileCode);
-        tempFileName += String(filePre);
-
-        if (fileNum < 10)
-            tempFileName += "0";
-        tempFileName += String(fileNum);
-        tempFileName += String(fileSuf);
-        tempFileName.toCharArray(fullFileName, 40);
-        Serial.print("filename [");
-        Serial.print(fullFileName);
-        Serial.println("]");
-
-        if (SD.exists(fullFileName))
-        {
-            // filename already exists - try again
-            nextLoop = 1;
-        }
-        else
-        {
-            // fileName does not exist - use this one!
-            nextLoop = 0;
-            Serial.print("SD OK <<");
-            Serial.print(fullFileName);
-            Serial.println(">>");
-        }
-    }
-    // int SDstatus = setup_SD(dataFileName, fileSuffix, dataFileBase);
-    // open the file. note that only one file can be open at a time,
-    // so you have to close this one before opening another.
-    File tmpFile;
-    tmpFile = SD.open(fullFileName, FILE_WRITE);
-    // if the file opened okay, write to it:
-    if (tmpFile)
-    {
-        tmpFile.print("Kite Datlogger File: ");
-        tmpFile.println((char *)fullFileName); // first line
-        tmpFile.print("Kite Datlogger Code: ");
-        tmpFile.println(__FILE__); // first line
-        tmpFile.print("Kite Datlogger Date compiled: ");
-        tmpFile.println(__DATE__); // first line
-        tmpFile.print("Kite Datlogger time compiled: ");
-        tmpFile.println(__TIME__); // first line
-        //Serial.print("RTC Current Date (MM/DD/YYYY): ");
-        //Serial.print(" and time (HH:MM:SS): ");
-        tmpFile.print("Kite Datlogger Date file created: ");
-
-#ifdef USE_RTC
-        currentNow = rtc.now();
-        tmpFile.print(currentNow.month());
-        tmpFile.print("/");
-        tmpFile.print(currentNow.day());
-        tmpFile.print("/");
-        tmpFile.println(currentNow.year());
-        tmpFile.print("Kite Datlogger time file created: ");
-        tmpFile.print(currentNow.hour());
-        tmpFile.print(":");
-        tmpFile.print(currentNow.minute());
-        tmpFile.print(":");
-        tmpFile.println(currentNow.second());
-#else
-        tmpFile.println("no RTC available");
-#endif
-        tmpFile.println("-------------------------------------------------------------");
-        tmpFile.println(); // blank line
-        //    dataFile.print("{\""); dataFile.print((char*)dataFileName); dataFile.println("\":["); // first line is start of Json structure
-        tmpFile.close(); // close the file:
-    }
-    else
-    {
-        // if the file didn't open, print an error:
-        Serial.println("error opening data file");
-    }
-
-    return 1;
-} // END OF SD FILE SETUP ----------------------------------------------------
-
-void initializeSDFileDirectory()
-{
-    // check to see if we have an RTC
-#ifdef USE_RTC
-    if (!rtc.begin())
-    {
-        Serial.println("Couldn't find RTC");
-        while (1)
-            ;
-    }
-    currentNow = rtc.now();
-    Serial.print("RTC Current Date (YYMMDD)");
-    Serial.print((currentNow.year()-2000) * 10000 + currentNow.month() * 100 + currentNow.day());
-    Serial.print(" and time (HHMMSS) =");
-    Serial.println(currentNow.hour() * 10000 + currentNow.minute() * 100 + currentNow.second());
-    int dirDate((currentNow.year() - 2000) * 10000 + currentNow.month() * 100 + currentNow.day());
-//int dirTime(currentNow.hour() * 10000 + currentNow.minute() * 100 + currentNow.second());
-    char charDirDate[12];
-    itoa(dirDate, charDirDate, 10);
-#else
-    char charDirDate[12];
-    strcpy(charDirDate, dataFolder);
-    //itoa(dirDate, charDirDate, 10);
-#endif
-    strcpy(dirPath, "/d");
-    //char charDirTime[10];
-    //itoa(dirTime, charDirTime, 10);
-    strcat(dirPath, charDirDate);
-    //strcat(dirPath, "/");
-    //strcat(dirPath, charDirTime);
-    Serial.print("Directory path = ");
-    Serial.println(dirPath);
-    Serial.print("Initializing SD card...");
-    if (!SD.begin(SD_CS))
-    {
-        Serial.println("initialization failed!");
-        while (1)
-            ; // prevent code from processing any further if SD not functioning
-    }
-    Serial.println("initialization done.");
-    if (SD.mkdir(dirPath))
-    {
-        Serial.println("new directory made successfully");
-        strcat(dirPath, "/");
-    }
-    else
-    {
-        Serial.println("new directory failed");
-        dirPath[0] = 0;
-    }
-    return;
-}
+
+// ---SD CARD SETUP----------------------------------------------------------
+//  SD communication Based on on-line SD library example:
+//    http://arduino.cc/en/Tutorial/Datalogger
+
+// for datalogging to SD wtih real-time-clock
+#include <SPI.h>
+#include <SD.h>
+#include <RTClib.h>
+
+// should move to deviceConfig
+// SD chip select is pin 10 on Adalogger featherwing!
+//#define SD_CS 10
+// SD chip select for E-Ink featherwing
+//#define SD_CS 5
+
+//*********** SD Card Setup
+// char logFileType[] = "log";
+// char dataFileType[] = "data";
+// char eventFileType[] = "evnt";
+// char fileSuffix[] = ".txt";
+char dirPath[30];      // create buffer to hold path to directory
+char logFileName[40]; // create buffer to hold filename for datalogger
+char dataFileName[40]; // create buffer to hold filename for datalogger
+char eventFileName[40]; // create buffer to hold filename for datalogger
+
+// File logFile;
+// File dataFile;
+// File eventFile;
+
+#ifdef USE_RTC
+RTC_PCF8523 rtc; // real time clock on Adafruit adalogger
+//RTC_DS1307 rtc;
+DateTime currentNow;
+#endif
+
+// file numbers: "Dtype###.suffix" keeps 4 character types within 8.3 file names
+#define SD_FILE_DIGITS 3
+#define SD_FILE_MAX 1000 // files 000 to 999 of each type in a directory
+
+// full name of file number fileNum, e.g. "/d210118/Zdata012.csv"
+void makeSDFileName(char *fullFileName, char *fileCode, char *filePre, int fileNum, char *fileSuf)
+{
+    snprintf(fullFileName, 40, "%s%s%s%0*d%s", dirPath, fileCode, filePre, SD_FILE_DIGITS, fileNum, fileSuf);
+}
+
+// each type of file has a small marker file in the directory holding the next file number,
+//   e.g. "/d210118/Zdata.nxt", so finding the next file takes a few lookups however full the
+//   directory is (a FAT directory is scanned linearly on every SD.exists)
+void makeSDMarkerName(char *markerName, char *fileCode, char *filePre)
+{
+    snprintf(markerName, 40, "%s%s%s.nxt", dirPath, fileCode, filePre);
+}
+
+// returns the number in the marker file or -1 if there is none
+int readSDFileMarker(char *markerName)
+{
+    File marker = SD.open(markerName, FILE_READ);
+    if (!marker)
+    {
+        return -1;
+    }
+    char text[8];
+    int length = marker.read(text, sizeof(text) - 1);
+    marker.close();
+    if (length <= 0)
+    {
+        return -1;
+    }
+    text[length] = 0;
+    return atoi(text);
+}
+
+void writeSDFileMarker(char *markerName, int fileNum)
+{
+    File marker = SD.open(markerName, O_WRITE | O_CREAT | O_TRUNC);
+    if (marker)
+    {
+        marker.println(fileNum);
+        marker.close();
+    }
+}
+
+// finds the next unused file number and puts its name in fullFileName
+//   returns SD_FILE_MAX if every number is used
+int nextSDFileNumber(char *fileCode, char *filePre, char *fileSuf, char *fullFileName)
+{
+    char markerName[40];
+    makeSDMarkerName(markerName, fileCode, filePre);
+    int fileNum = readSDFileMarker(markerName);
+    if (fileNum < 0 || fileNum > SD_FILE_MAX)
+    {
+        // no marker (new directory, or files from an older version): files are numbered from 0
+        //   without gaps, so binary search for the first unused number
+        int low = 0;
+        int high = SD_FILE_MAX;
+        while (low < high)
+        {
+            int middle = (low + high) / 2;
+            makeSDFileName(fullFileName, fileCode, filePre, middle, fileSuf);
+            if (SD.exists(fullFileName))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        fileNum = low;
+    }
+    // the marker is behind if power was lost between creating a file and updating the marker
+    makeSDFileName(fullFileName, fileCode, filePre, fileNum, fileSuf);
+    while (fileNum < SD_FILE_MAX && SD.exists(fullFileName))
+    {
+        fileNum++;
+        makeSDFileName(fullFileName, fileCode, filePre, fileNum, fileSuf);
+    }
+    return fileNum;
+}
+
+#ifdef ENABLE_LOG_PREALLOCATE
+// preallocated files: the log, data and event files are written full of zero bytes when they are
+//   created, so every cluster they will need is allocated in setup() and appending a row never
+//   has to search and update the FAT (the periodic multi-ms stalls of a growing file). rows are
+//   written in place at the end of the data, which is kept in the preamble line
+//   "Kite Datlogger Length: ##########" (updated at most once every LOG_EXTENT_SYNC_INTERVAL)
+//   a file that was not finished (power lost) is recovered on the host with host/recoverLog,
+//   which trims the unused zero bytes and finds rows written after the last length update
+//   a file that fills its extent keeps growing the usual way
+#ifndef LOG_PREALLOCATE_BYTES
+#define LOG_PREALLOCATE_BYTES 1048576UL // size of each preallocated file
+#endif
+#ifndef LOG_EXTENT_SYNC_INTERVAL
+#define LOG_EXTENT_SYNC_INTERVAL 10000 // ms between updates of the length in the preamble
+#endif
+#define LOG_EXTENT_MAX 6
+#define LOG_EXTENT_DIGITS 10
+#define LOG_EXTENT_FILL 512 // bytes written per call while filling the extent
+
+struct logExtent
+{
+    char *fullFileName;          // buffer holding the name of the file (NULL = unused)
+    unsigned long capacity;      // bytes preallocated
+    unsigned long length;        // bytes of data in the file
+    unsigned long lengthOffset;  // position of the length in the preamble
+    unsigned long recordedLength; // length written in the preamble
+    unsigned long nextSync;      // millis() of the next update of the length in the preamble
+};
+
+logExtent logExtents[LOG_EXTENT_MAX];
+
+int findLogExtent(char *fullFileName)
+{
+    for (int e = 0; e < LOG_EXTENT_MAX; e++)
+    {
+        if (logExtents[e].fullFileName == fullFileName && logExtents[e].capacity > 0)
+            return e;
+    }
+    return -1;
+}
+
+// capacity of the preallocated file held in fullFileName (0 if it is not preallocated)
+unsigned long logExtentCapacity(char *fullFileName)
+{
+    int e = findLogExtent(fullFileName);
+    return e < 0 ? 0 : logExtents[e].capacity;
+}
+
+void writeLogExtentLength(File &file, logExtent *extent)
+{
+    char digits[LOG_EXTENT_DIGITS + 1];
+    snprintf(digits, sizeof(digits), "%0*lu", LOG_EXTENT_DIGITS, extent->length);
+    file.seek(extent->lengthOffset);
+    file.write((uint8_t *)digits, LOG_EXTENT_DIGITS);
+    extent->recordedLength = extent->length;
+    extent->nextSync = millis() + LOG_EXTENT_SYNC_INTERVAL;
+}
+#else
+#define LOG_PREALLOCATE_BYTES 0 // files grow as they are written
+#endif
+
+#ifdef ENABLE_GROUP_COMMIT
+// group commit: the log, data and event files stay open and are synced to the card (flush)
+//   every LOG_COMMIT_RECORDS writes or LOG_COMMIT_INTERVAL ms, whichever comes first, instead of
+//   being closed after every row. each data and event row ends with a CRC-16 of the row (see
+//   crcLinePrint) and carries its sequence number (countSDLine, countEvents) in the count
+//   column, so after a power loss host/recoverLog can find the last complete row even though
+//   the rows since the last commit may be missing or cut off
+#ifndef LOG_COMMIT_RECORDS
+#define LOG_COMMIT_RECORDS 10 // writes between syncs
+#endif
+#ifndef LOG_COMMIT_INTERVAL
+#define LOG_COMMIT_INTERVAL 5000 // longest time (ms) a write waits for a sync
+#endif
+#define LOG_OPEN_MAX 6
+
+struct logOpenFile
+{
+    char *fullFileName; // buffer holding the name of the file (NULL = unused)
+    File file;
+    int pending;              // writes since the last sync
+    unsigned long commitTime; // millis() by which the pending writes must be synced
+};
+
+logOpenFile logOpenFiles[LOG_OPEN_MAX];
+unsigned long logCommits = 0; // syncs made
+
+int findLogOpenFile(char *fullFileName)
+{
+    for (int f = 0; f < LOG_OPEN_MAX; f++)
+    {
+        if (logOpenFiles[f].fullFileName == fullFileName)
+            return f;
+    }
+    return -1;
+}
+
+void commitLogOpenFile(logOpenFile *open)
+{
+    open->file.flush(); // writes the cached block and the directory entry (size) to the card
+    open->pending = 0;
+    logCommits++;
+}
+
+// call on every pass through loop(): syncs files whose writes have waited LOG_COMMIT_INTERVAL
+void serviceLogFiles()
+{
+    for (int f = 0; f < LOG_OPEN_MAX; f++)
+    {
+        if (logOpenFiles[f].fullFileName && logOpenFiles[f].pending > 0 && millis() >= logOpenFiles[f].commitTime)
+            commitLogOpenFile(&logOpenFiles[f]);
+    }
+}
+#endif
+
+// sync and close a log file kept open by group commit (before its name changes or it is removed)
+void releaseLogFile(char *fullFileName)
+{
+#ifdef ENABLE_GROUP_COMMIT
+    int f = findLogOpenFile(fullFileName);
+    if (f >= 0)
+    {
+        if (logOpenFiles[f].pending > 0)
+            commitLogOpenFile(&logOpenFiles[f]);
+        logOpenFiles[f].file.close();
+        logOpenFiles[f].fullFileName = NULL;
+    }
+#else
+    (void)fullFileName; // files are closed after each write
+#endif
+}
+
+// open a log file to add to it: preallocated files are positioned at the end of their data
+File openLogFile(char *fullFileName)
+{
+#ifdef ENABLE_GROUP_COMMIT
+    int f = findLogOpenFile(fullFileName);
+    if (f >= 0)
+        return logOpenFiles[f].file; // still open (and positioned) from the last write
+#endif
+    File file;
+#ifdef ENABLE_LOG_PREALLOCATE
+    int e = findLogExtent(fullFileName);
+    if (e >= 0)
+    {
+        file = SD.open(fullFileName, O_READ | O_WRITE);
+        if (file)
+            file.seek(logExtents[e].length);
+    }
+    else
+#endif
+        file = SD.open(fullFileName, FILE_WRITE);
+#ifdef ENABLE_GROUP_COMMIT
+    f = findLogOpenFile(NULL);
+    if (file && f >= 0)
+    {
+        logOpenFiles[f].fullFileName = fullFileName;
+        logOpenFiles[f].file = file;
+        logOpenFiles[f].pending = 0;
+    }
+#endif
+    return file;
+}
+
+// close a log file opened with openLogFile (with group commit: sync it when a commit is due)
+void closeLogFile(File &file, char *fullFileName)
+{
+#if !defined(ENABLE_LOG_PREALLOCATE) && !defined(ENABLE_GROUP_COMMIT)
+    (void)fullFileName; // the file is only closed
+#endif
+#ifdef ENABLE_LOG_PREALLOCATE
+    int e = findLogExtent(fullFileName);
+    if (e >= 0)
+    {
+        logExtents[e].length = file.position();
+        if (millis() >= logExtents[e].nextSync && logExtents[e].length != logExtents[e].recordedLength)
+        {
+            writeLogExtentLength(file, &logExtents[e]);
+            file.seek(logExtents[e].length); // back to the end of the data for the next write
+        }
+    }
+#endif
+#ifdef ENABLE_GROUP_COMMIT
+    int f = findLogOpenFile(fullFileName);
+    if (f >= 0)
+    {
+        if (logOpenFiles[f].pending == 0)
+            logOpenFiles[f].commitTime = millis() + LOG_COMMIT_INTERVAL;
+        logOpenFiles[f].pending++;
+        if (logOpenFiles[f].pending >= LOG_COMMIT_RECORDS || millis() >= logOpenFiles[f].commitTime)
+            commitLogOpenFile(&logOpenFiles[f]);
+        return;
+    }
+#endif
+    file.close();
+}
+
+// byte offset in the file where the next write to a file opened with openLogFile goes
+unsigned long logFileEnd(File &file, char *fullFileName)
+{
+#ifdef ENABLE_LOG_PREALLOCATE
+    if (findLogExtent(fullFileName) >= 0)
+        return file.position(); // the end of the data, not of the preallocated file
+#else
+    (void)fullFileName; // only preallocated files end before their size
+#endif
+    return file.size();
+}
+
+// CRC-16/CCITT (polynomial 0x1021, start 0xFFFF) of one byte added to crc
+uint16_t crc16Update(uint16_t crc, uint8_t c)
+{
+    crc ^= ((uint16_t)c) << 8;
+    for (int bit = 0; bit < 8; bit++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+// passes rows through to another Print and ends each line with a CRC column: ",XXXX" (the
+//   CRC-16 of the line before it, in hex) on data rows and ",crc" on header rows
+class crcLinePrint : public Print
+{
+public:
+    crcLinePrint(Print &destination, int headerFlag) : out(destination), header(headerFlag), crc(0xFFFF), lineBytes(0) {}
+    size_t write(uint8_t c)
+    {
+        if ((c == '\r' || c == '\n') && lineBytes > 0)
+        {
+            if (header)
+            {
+                out.print(",crc");
+            }
+            else
+            {
+                char text[6];
+                snprintf(text, sizeof(text), ",%04X", crc);
+                out.print(text);
+            }
+            crc = 0xFFFF;
+            lineBytes = 0;
+        }
+        else if (c != '\r' && c != '\n')
+        {
+            crc = crc16Update(crc, c);
+            lineBytes++;
+        }
+        return out.write(c);
+    }
+    using Print::write;
+
+private:
+    Print &out;
+    int header;
+    uint16_t crc;
+    int lineBytes;
+};
+
+// preallocateBytes: with ENABLE_LOG_PREALLOCATE, size of the preallocated file (0 = grow as written)
+int setup_SD_file(char *fileCode, char *filePre, char *fileSuf, char *fullFileName, unsigned long preallocateBytes = 0)
+{
+    //String filePre = "DD3v";
+    //String fileSuf = ".txt";
+    Serial.print("InitSD-");
+    // make sure that the default chip select pin is set to
+    // output, even if you don't use it:
+    pinMode(SD_CS, OUTPUT);
+    //pinMode(10, OUTPUT);
+    // see if the card is present and can be initialized:
+    if (!SD.begin(SD_CS))
+    {
+        Serial.println("SD fail");
+        // don't do anything more:
+        return -1;
+    }
+    Serial.println("done");
+    releaseLogFile(fullFileName); // the buffer may hold an earlier (rotated) file that is still open
+
+#ifdef ENABLE_LOG_PREALLOCATE
+    // the buffer may hold an earlier (rotated) file: record its final length
+    int e = findLogExtent(fullFileName);
+    if (e >= 0)
+    {
+        File oldFile = SD.open(fullFileName, O_READ | O_WRITE);
+        if (oldFile)
+        {
+            writeLogExtentLength(oldFile, &logExtents[e]);
+            oldFile.close();
+        }
+        logExtents[e].capacity = 0;
+    }
+#endif
+
+    // use the next file number from the marker file of this type
+    int fileNum = nextSDFileNumber(fileCode, filePre, fileSuf, fullFileName);
+    if (fileNum == SD_FILE_MAX)
+    {
+        // every number is used: keep adding to the last file
+        WARN("no unused file numbers left", fileNum)
+        makeSDFileName(fullFileName, fileCode, filePre, SD_FILE_MAX - 1, fileSuf);
+        preallocateBytes = 0;
+    }
+    Serial.print("SD OK <<");
+    Serial.print(fullFileName);
+    Serial.println(">>");
+
+    // int SDstatus = setup_SD(dataFileName, fileSuffix, dataFileBase);
+    // open the file. note that only one file can be open at a time,
+    // so you have to close this one before opening another.
+    File tmpFile;
+    tmpFile = SD.open(fullFileName, FILE_WRITE);
+    // if the file opened okay, write to it:
+    if (tmpFile)
+    {
+        tmpFile.print("Kite Datlogger File: ");
+        tmpFile.println((char *)fullFileName); // first line
+        tmpFile.print("Kite Datlogger Code: ");
+        tmpFile.println(__FILE__); // first line
+        tmpFile.print("Kite Datlogger Date compiled: ");
+        tmpFile.println(__DATE__); // first line
+        tmpFile.print("Kite Datlogger time compiled: ");
+        tmpFile.println(__TIME__); // first line
+        //Serial.print("RTC Current Date (MM/DD/YYYY): ");
+        //Serial.print(" and time (HH:MM:SS): ");
+        tmpFile.print("Kite Datlogger Date file created: ");
+
+#ifdef USE_RTC
+        currentNow = rtc.now();
+        tmpFile.print(currentNow.month());
+        tmpFile.print("/");
+        tmpFile.print(currentNow.day());
+        tmpFile.print("/");
+        tmpFile.println(currentNow.year());
+        tmpFile.print("Kite Datlogger time file created: ");
+        tmpFile.print(currentNow.hour());
+        tmpFile.print(":");
+        tmpFile.print(currentNow.minute());
+        tmpFile.print(":");
+        tmpFile.println(currentNow.second());
+#else
+        tmpFile.println("no RTC available");
+#endif
+#ifdef ENABLE_LOG_PREALLOCATE
+        unsigned long lengthOffset = 0;
+        if (preallocateBytes > 0)
+        {
+            tmpFile.print("Kite Datlogger Length: ");
+            lengthOffset = tmpFile.position();
+            tmpFile.println("0000000000"); // LOG_EXTENT_DIGITS, filled in by writeLogExtentLength()
+        }
+#endif
+        tmpFile.println("-------------------------------------------------------------");
+        tmpFile.println(); // blank line
+        //    dataFile.print("{\""); dataFile.print((char*)dataFileName); dataFile.println("\":["); // first line is start of Json structure
+#ifdef ENABLE_LOG_PREALLOCATE
+        for (e = 0; preallocateBytes > 0 && e < LOG_EXTENT_MAX && logExtents[e].capacity > 0; e++)
+            ;
+        if (preallocateBytes > 0 && e < LOG_EXTENT_MAX)
+        {
+            // allocate every cluster of the file now
+            logExtent *extent = &logExtents[e];
+            extent->fullFileName = fullFileName;
+            extent->capacity = preallocateBytes;
+            extent->length = tmpFile.position();
+            extent->lengthOffset = lengthOffset;
+            uint8_t zeros[LOG_EXTENT_FILL];
+            memset(zeros, 0, sizeof(zeros));
+            for (unsigned long filled = extent->length; filled < preallocateBytes; filled += LOG_EXTENT_FILL)
+            {
+                unsigned long chunk = preallocateBytes - filled < LOG_EXTENT_FILL ? preallocateBytes - filled : LOG_EXTENT_FILL;
+                tmpFile.write(zeros, chunk);
+            }
+            // FILE_WRITE appends every write, so reopen to write the length in place
+            tmpFile.close();
+            tmpFile = SD.open(fullFileName, O_READ | O_WRITE);
+            writeLogExtentLength(tmpFile, extent);
+        }
+#else
+        (void)preallocateBytes; // the file grows as it is written
+#endif
+        tmpFile.close(); // close the file:
+    }
+    else
+    {
+        // if the file didn't open, print an error:
+        Serial.println("error opening data file");
+    }
+
+    // the marker is updated after the file exists, so a power loss in between cannot skip a number
+    if (fileNum < SD_FILE_MAX)
+    {
+        char markerName[40];
+        makeSDMarkerName(markerName, fileCode, filePre);
+        writeSDFileMarker(markerName, fileNum + 1);
+    }
+    return 1;
+} // END OF SD FILE SETUP ----------------------------------------------------
+
+// returns 1 when the card is ready, -1 when it is missing (the logger keeps running without it)
+int initializeSDFileDirectory()
+{
+    char charDirDate[12];
+    // check to see if we have an RTC
+#ifdef USE_RTC
+    if (!rtc.begin())
+    {
+        Serial.println("Couldn't find RTC");
+        strcpy(charDirDate, dataFolder); // name the directory as if there were no RTC
+    }
+    else
+    {
+        currentNow = rtc.now();
+        Serial.print("RTC Current Date (YYMMDD)");
+        Serial.print((currentNow.year()-2000) * 10000 + currentNow.month() * 100 + currentNow.day());
+        Serial.print(" and time (HHMMSS) =");
+        Serial.println(currentNow.hour() * 10000 + currentNow.minute() * 100 + currentNow.second());
+        int dirDate((currentNow.year() - 2000) * 10000 + currentNow.month() * 100 + currentNow.day());
+//int dirTime(currentNow.hour() * 10000 + currentNow.minute() * 100 + currentNow.second());
+        itoa(dirDate, charDirDate, 10);
+    }
+#else
+    strcpy(charDirDate, dataFolder);
+    //itoa(dirDate, charDirDate, 10);
+#endif
+    strcpy(dirPath, "/d");
+    //char charDirTime[10];
+    //itoa(dirTime, charDirTime, 10);
+    strcat(dirPath, charDirDate);
+    //strcat(dirPath, "/");
+    //strcat(dirPath, charDirTime);
+    Serial.print("Directory path = ");
+    Serial.println(dirPath);
+    Serial.print("Initializing SD card...");
+    if (!SD.begin(SD_CS))
+    {
+        Serial.println("initialization failed!");
+        dirPath[0] = 0;
+        return -1;
+    }
+    Serial.println("initialization done.");
+    if (SD.exists(dirPath))
+    {
+        // keep using the directory of an earlier start on the same day (the marker files give the next numbers)
+        Serial.println("using existing directory");
+        strcat(dirPath, "/");
+    }
+    else if (SD.mkdir(dirPath))
+    {
+        Serial.println("new directory made successfully");
+        strcat(dirPath, "/");
+    }
+    else
+    {
+        Serial.println("new directory failed");
+        dirPath[0] = 0;
+    }
+    return 1;
+}
@@ -0,0 +1,266 @@
+// loopTiming.h
+// instrumentation of the timing of each pass through loop()
+//  - every pass is timestamped with micros() when it starts (the "sample" time)
+//  - the interval between successive sample timestamps is binned into a jitter histogram
+//  - the time spent in each phase of loop() (sensor reads, events, Serial, SD, other) is
+//    accumulated with loopTimingPhase() so the slowest pass can be blamed on one phase
+//  - once per sampling interval the results are copied into data streams (extra columns
+//    in the data file) and the instrumentation is reset at the end of that pass
+//
+//  enable with ENABLE_LOOP_TIMING in the deviceConfig file; when it is not defined all of
+//  the LOOP_TIMING_ macros expand to nothing and none of this code is compiled
+//
+//  the clock can be replaced (e.g. with a mock clock when testing off-device) by defining
+//  LOOP_TIMING_MICROS() before this file is included
+
+// phases of loop() that time can be attributed to
+#define LOOP_PHASE_SENSOR 0 // reading sensors and updating data streams
+#define LOOP_PHASE_EVENTS 1 // checking pins, thresholds and reporting events
+#define LOOP_PHASE_SERIAL 2 // table output to Serial (and log file)
+#define LOOP_PHASE_SD 3     // spreadsheet output to the SD data file
+#define LOOP_PHASE_OTHER 4  // random delay, LEDs and anything not otherwise marked
+#define LOOP_PHASES_MAX 5
+
+#ifdef ENABLE_LOOP_TIMING
+
+#ifndef LOOP_TIMING_MICROS
+#define LOOP_TIMING_MICROS() micros()
+#endif
+
+// jitter histogram: JITTER_BINS bins of width JITTER_BIN_WIDTH (in us), the last bin collects everything longer
+#ifndef JITTER_BINS
+#define JITTER_BINS 20
+#endif
+#ifndef JITTER_BIN_WIDTH
+#define JITTER_BIN_WIDTH 500
+#endif
+
+struct loopTiming
+{
+  unsigned long lastSampleMicros; // timestamp of the start of the previous pass through loop()
+  unsigned long loopStartMicros;  // timestamp of the start of the current pass
+  unsigned long phaseStartMicros; // timestamp at which the current phase started
+  unsigned long phaseTime[LOOP_PHASES_MAX]; // time spent in each phase during the current pass (us)
+  int started;                              // flag indicating that lastSampleMicros is valid
+  int resetDue;                             // flag to reset the statistics when the current pass ends
+
+  // statistics for the current sampling interval
+  unsigned long nLoops;                     // number of passes completed in the interval
+  unsigned long jitterHist[JITTER_BINS];    // histogram of intervals between sample timestamps
+  unsigned long maxInterval;                // longest interval between sample timestamps (us)
+  unsigned long minInterval;                // shortest interval between sample timestamps (us)
+  unsigned long worstLoop;                  // longest single pass through loop() (us)
+  unsigned long worstPhaseTime[LOOP_PHASES_MAX]; // phase times of the longest pass
+  int worstPhase;                           // phase that dominated the longest pass
+  unsigned long phaseBlame[LOOP_PHASES_MAX]; // number of passes in which each phase dominated
+};
+
+loopTiming loopTimer;
+
+void resetLoopTiming(loopTiming *timer)
+{
+  timer->nLoops = 0;
+  timer->maxInterval = 0;
+  timer->minInterval = (unsigned long)-1;
+  timer->worstLoop = 0;
+  timer->worstPhase = LOOP_PHASE_OTHER;
+  for (int k = 0; k < JITTER_BINS; k++)
+  {
+    timer->jitterHist[k] = 0;
+  }
+  for (int k = 0; k < LOOP_PHASES_MAX; k++)
+  {
+    timer->worstPhaseTime[k] = 0;
+    timer->phaseBlame[k] = 0;
+  }
+}
+
+void initLoopTiming(loopTiming *timer)
+{
+  timer->started = 0;
+  timer->resetDue = 0;
+  timer->lastSampleMicros = 0;
+  timer->loopStartMicros = LOOP_TIMING_MICROS();
+  timer->phaseStartMicros = timer->loopStartMicros;
+  for (int k = 0; k < LOOP_PHASES_MAX; k++)
+  {
+    timer->phaseTime[k] = 0;
+  }
+  resetLoopTiming(timer);
+}
+
+// call at the very start of loop(): timestamps the sample and updates the jitter histogram
+void loopTimingStart(loopTiming *timer)
+{
+  unsigned long now = LOOP_TIMING_MICROS();
+  if (timer->started)
+  {
+    // unsigned subtraction handles micros() rolling over (in 32 bits, where unsigned long is wider)
+    unsigned long interval = (uint32_t)(now - timer->lastSampleMicros);
+    unsigned long bin = interval / JITTER_BIN_WIDTH;
+    if (bin >= JITTER_BINS)
+    {
+      bin = JITTER_BINS - 1;
+    }
+    timer->jitterHist[bin]++;
+    if (interval > timer->maxInterval)
+    {
+      timer->maxInterval = interval;
+    }
+    if (interval < timer->minInterval)
+    {
+      timer->minInterval = interval;
+    }
+  }
+  timer->started = 1;
+  timer->lastSampleMicros = now;
+  timer->loopStartMicros = now;
+  timer->phaseStartMicros = now;
+  for (int k = 0; k < LOOP_PHASES_MAX; k++)
+  {
+    timer->phaseTime[k] = 0;
+  }
+}
+
+// call at the end of each phase: the time since the previous mark is charged to the phase
+void loopTimingPhase(loopTiming *timer, int phase)
+{
+  unsigned long now = LOOP_TIMING_MICROS();
+  timer->phaseTime[phase] += (uint32_t)(now - timer->phaseStartMicros);
+  timer->phaseStartMicros = now;
+}
+
+// call at the very end of loop(): finds the dominant phase and keeps track of the worst pass
+void loopTimingEnd(loopTiming *timer)
+{
+  loopTimingPhase(timer, LOOP_PHASE_OTHER); // anything since the last mark
+  unsigned long loopMicros = (uint32_t)(timer->phaseStartMicros - timer->loopStartMicros);
+
+  int dominant = 0;
+  for (int k = 1; k < LOOP_PHASES_MAX; k++)
+  {
+    if (timer->phaseTime[k] > timer->phaseTime[dominant])
+    {
+      dominant = k;
+    }
+  }
+  timer->phaseBlame[dominant]++;
+
+  if (loopMicros >= timer->worstLoop)
+  {
+    timer->worstLoop = loopMicros;
+    timer->worstPhase = dominant;
+    for (int k = 0; k < LOOP_PHASES_MAX; k++)
+    {
+      timer->worstPhaseTime[k] = timer->phaseTime[k];
+    }
+  }
+  timer->nLoops++;
+  if (timer->resetDue)
+  {
+    timer->resetDue = 0;
+    resetLoopTiming(timer);
+  }
+}
+
+// call when the statistics of the interval have been output: they are reset when the current pass
+// ends, so the pass that wrote them is not charged to the next interval
+void loopTimingResetAtEnd(loopTiming *timer)
+{
+  timer->resetDue = 1;
+}
+
+// estimate a percentile (0 - 100) of the interval between samples from the jitter histogram
+// returns the upper edge of the bin containing the percentile (in us)
+unsigned long loopTimingPercentile(loopTiming *timer, float percentile)
+{
+  unsigned long total = 0;
+  for (int k = 0; k < JITTER_BINS; k++)
+  {
+    total += timer->jitterHist[k];
+  }
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  float target = percentile / 100. * ((float)total);
+  unsigned long cumulative = 0;
+  for (int k = 0; k < JITTER_BINS - 1; k++)
+  {
+    cumulative += timer->jitterHist[k];
+    if (((float)cumulative) >= target)
+    {
+      return (unsigned long)(k + 1) * JITTER_BIN_WIDTH;
+    }
+  }
+  return timer->maxInterval; // percentile falls in the overflow bin
+}
+
+// names of phases used when printing diagnostics
+const char *loopPhaseName(int phase)
+{
+  switch (phase)
+  {
+  case LOOP_PHASE_SENSOR:
+    return "SENSOR";
+  case LOOP_PHASE_EVENTS:
+    return "EVENTS";
+  case LOOP_PHASE_SERIAL:
+    return "SERIAL";
+  case LOOP_PHASE_SD:
+    return "SD";
+  default:
+    return "OTHER";
+  }
+}
+
+// print a diagnostics summary of the interval (e.g. to Serial or the log file)
+void printLoopTiming(Print &out, loopTiming *timer)
+{
+  out.print("LOOP TIMING: passes = ");
+  out.print(timer->nLoops);
+  out.print(" p50 = ");
+  out.print(loopTimingPercentile(timer, 50.));
+  out.print(" p99 = ");
+  out.print(loopTimingPercentile(timer, 99.));
+  out.print(" max = ");
+  out.print(timer->maxInterval);
+  out.print(" us; worst pass = ");
+  out.print(timer->worstLoop);
+  out.print(" us dominated by ");
+  out.println(loopPhaseName(timer->worstPhase));
+
+  out.print("LOOP TIMING: worst pass phases (us)");
+  for (int k = 0; k < LOOP_PHASES_MAX; k++)
+  {
+    out.print(" ");
+    out.print(loopPhaseName(k));
+    out.print(" = ");
+    out.print(timer->worstPhaseTime[k]);
+  }
+  out.println();
+
+  out.print("LOOP TIMING: jitter histogram (");
+  out.print(JITTER_BIN_WIDTH);
+  out.print(" us bins)");
+  for (int k = 0; k < JITTER_BINS; k++)
+  {
+    out.print(" ");
+    out.print(timer->jitterHist[k]);
+  }
+  out.println();
+}
+
+#define LOOP_TIMING_INIT() initLoopTiming(&loopTimer);
+#define LOOP_TIMING_START() loopTimingStart(&loopTimer);
+#define LOOP_TIMING_PHASE(p) loopTimingPhase(&loopTimer, p);
+#define LOOP_TIMING_END() loopTimingEnd(&loopTimer);
+#define LOOP_TIMING_RESET() loopTimingResetAtEnd(&loopTimer);
+#else
+#define LOOP_TIMING_INIT()   // do not include in code
+#define LOOP_TIMING_START()  // do not include in code
+#define LOOP_TIMING_PHASE(p) // do not include in code
+#define LOOP_TIMING_END()    // do not include in code
+#define LOOP_TIMING_RESET()  // do not include in code
+#endif
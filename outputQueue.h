@@ -0,0 +1,468 @@
+// outputQueue.h
+// bounded RAM backlog between the producers of rows (statistics, events, log tables) and the SD card
+//  rows are formatted into a staging buffer (a Print, so the same row functions write to a File,
+//  to Serial or to the queue) and stored in a byte ring of OUTPUT_QUEUE_BYTES as records:
+//    [length low][length high][file id][priority][row text ...]
+//  outputQueueService() (once per pass through loop()) writes records to their files, grouping
+//  consecutive records for the same file into one open/close and spending at most
+//  OUTPUT_QUEUE_DRAIN_MICROS per pass, so a slow card no longer stalls loop()
+//
+//  when an open or write fails the card is marked missing and the backlog is kept; SD.begin() is
+//  retried every OUTPUT_QUEUE_RETRY_INTERVAL and, once the card is back (or reinserted), files that
+//  could not be created are created and the backlog is replayed in order
+//
+//  when a new record does not fit, OUTPUT_QUEUE_POLICY decides what happens:
+//    OUTPUT_POLICY_BLOCK             write the backlog to the card now (drop the new record if the card is missing)
+//    OUTPUT_POLICY_DROP_OLDEST       drop the oldest records
+//    OUTPUT_POLICY_DROP_LOW_PRIORITY drop the oldest records of the lowest priority (stats rows before events,
+//                                    events before headers); drop the new record if everything queued matters more
+//    OUTPUT_POLICY_ROLLUP            as DROP_LOW_PRIORITY, and while the queue is more than 3/4 full stats rows are
+//                                    not queued at all: their samples keep accumulating (not reset) so the next
+//                                    row that is written covers the whole period (rollup only)
+//
+//  counters (queued, written, dropped, high-water mark, card failures and recoveries) are printed
+//  with printOutputQueueStatus() and written to the data file as data streams
+//
+//  enable with ENABLE_OUTPUT_QUEUE in the deviceConfig file (requires USE_SD)
+
+#define OUTPUT_ROLLED_UP 2 // returned instead of queueing a stats row while the queue is rolling up
+
+#ifdef ENABLE_OUTPUT_QUEUE
+
+#define OUTPUT_PRIORITY_STATS 0  // rows of statistics (data file, rate group files, log tables)
+#define OUTPUT_PRIORITY_EVENT 1  // event changes
+#define OUTPUT_PRIORITY_HEADER 2 // file headers
+
+#define OUTPUT_POLICY_BLOCK 0
+#define OUTPUT_POLICY_DROP_OLDEST 1
+#define OUTPUT_POLICY_DROP_LOW_PRIORITY 2
+#define OUTPUT_POLICY_ROLLUP 3
+
+#ifndef OUTPUT_QUEUE_BYTES
+#define OUTPUT_QUEUE_BYTES 8192 // RAM budget for the backlog
+#endif
+#ifndef OUTPUT_QUEUE_POLICY
+#define OUTPUT_QUEUE_POLICY OUTPUT_POLICY_ROLLUP
+#endif
+#ifndef OUTPUT_QUEUE_DRAIN_MICROS
+#define OUTPUT_QUEUE_DRAIN_MICROS 20000 // most time spent writing to the card in one pass through loop()
+#endif
+#ifndef OUTPUT_QUEUE_RETRY_INTERVAL
+#define OUTPUT_QUEUE_RETRY_INTERVAL 5000 // ms between attempts to restart a missing card
+#endif
+#define OUTPUT_QUEUE_RECORD_MAX 2048 // longest record (a log table with all data streams)
+#define OUTPUT_QUEUE_HEADER 4        // bytes of record header
+#define OUTPUT_QUEUE_MAX_FILES 8
+
+// staging buffer that one record is formatted into
+class outputRecordBuffer : public Print
+{
+public:
+  uint8_t text[OUTPUT_QUEUE_RECORD_MAX];
+  int length;
+  int overflow;
+  size_t write(uint8_t c)
+  {
+    if (length < OUTPUT_QUEUE_RECORD_MAX)
+    {
+      text[length++] = c;
+      return 1;
+    }
+    overflow = 1;
+    return 0;
+  }
+  using Print::write;
+};
+
+struct outputQueueFile
+{
+  char *fullFileName; // buffer holding the name of the file (empty until the file is created)
+  char *fileType;     // type and suffix used to create the file if the card was missing (NULL = unknown)
+  char *fileSuffix;
+};
+
+struct outputQueue
+{
+  uint8_t buffer[OUTPUT_QUEUE_BYTES];
+  int head;    // offset of the oldest record
+  int used;    // bytes queued
+  int records; // records queued
+  int policy;
+  int rollup;  // 1 while stats rows are being rolled up (OUTPUT_POLICY_ROLLUP)
+  int sdReady; // 0 while the card is missing
+  unsigned long nextRetry;
+
+  outputQueueFile files[OUTPUT_QUEUE_MAX_FILES];
+  int nFiles;
+  int stageFile; // file and priority of the record in the staging buffer
+  int stagePriority;
+
+  unsigned long queued;       // records accepted
+  unsigned long written;      // records written to the card
+  unsigned long dropped;      // records dropped (by the policy or because they were too long)
+  unsigned long droppedBytes;
+  unsigned long blocked;      // times the producer waited for the card (OUTPUT_POLICY_BLOCK)
+  unsigned long sdFailures;   // failed opens or writes
+  unsigned long recoveries;   // times the card came back
+  int highWater;              // most bytes queued at once
+};
+
+outputQueue sdQueue;
+outputRecordBuffer outputStage;
+
+void outputQueueBegin(outputQueue *queue, int policy, int sdReady)
+{
+  queue->head = 0;
+  queue->used = 0;
+  queue->records = 0;
+  queue->policy = policy;
+  queue->rollup = 0;
+  queue->sdReady = sdReady;
+  queue->nextRetry = millis() + OUTPUT_QUEUE_RETRY_INTERVAL;
+  queue->nFiles = 0;
+  queue->queued = 0;
+  queue->written = 0;
+  queue->dropped = 0;
+  queue->droppedBytes = 0;
+  queue->blocked = 0;
+  queue->sdFailures = 0;
+  queue->recoveries = 0;
+  queue->highWater = 0;
+}
+
+// register a file that records are written to; returns its id
+int outputQueueAddFile(outputQueue *queue, char *fullFileName, char *fileType, char *fileSuffix)
+{
+  for (int f = 0; f < queue->nFiles; f++)
+  {
+    if (queue->files[f].fullFileName == fullFileName)
+    {
+      if (fileType)
+      {
+        queue->files[f].fileType = fileType;
+        queue->files[f].fileSuffix = fileSuffix;
+      }
+      return f;
+    }
+  }
+  if (queue->nFiles == OUTPUT_QUEUE_MAX_FILES)
+  {
+    WARN("too many output queue files", queue->nFiles)
+    return -1;
+  }
+  queue->files[queue->nFiles].fullFileName = fullFileName;
+  queue->files[queue->nFiles].fileType = fileType;
+  queue->files[queue->nFiles].fileSuffix = fileSuffix;
+  queue->nFiles++;
+  return queue->nFiles - 1;
+}
+
+uint8_t outputQueueByte(outputQueue *queue, int offset)
+{
+  return queue->buffer[(queue->head + offset) % OUTPUT_QUEUE_BYTES];
+}
+
+// total size (header + text) of the record at offset
+int outputQueueRecordSize(outputQueue *queue, int offset)
+{
+  return OUTPUT_QUEUE_HEADER + (outputQueueByte(queue, offset) | (outputQueueByte(queue, offset + 1) << 8));
+}
+
+void outputQueueUpdateRollup(outputQueue *queue)
+{
+  if (queue->policy != OUTPUT_POLICY_ROLLUP)
+  {
+    return;
+  }
+  if (queue->used > 3 * OUTPUT_QUEUE_BYTES / 4)
+  {
+    queue->rollup = 1;
+  }
+  else if (queue->used < OUTPUT_QUEUE_BYTES / 4)
+  {
+    queue->rollup = 0;
+  }
+}
+
+// remove the record at offset; the older records before it are moved up to close the gap
+void outputQueueRemove(outputQueue *queue, int offset)
+{
+  int size = outputQueueRecordSize(queue, offset);
+  for (int k = offset - 1; k >= 0; k--)
+  {
+    queue->buffer[(queue->head + k + size) % OUTPUT_QUEUE_BYTES] = queue->buffer[(queue->head + k) % OUTPUT_QUEUE_BYTES];
+  }
+  queue->head = (queue->head + size) % OUTPUT_QUEUE_BYTES;
+  queue->used -= size;
+  queue->records--;
+  outputQueueUpdateRollup(queue);
+}
+
+int outputQueueWrite(outputQueue *queue, unsigned long budgetMicros);
+
+// make room for a record of size bytes and the given priority; returns 1 if there is room
+int outputQueueMakeRoom(outputQueue *queue, int size, int priority)
+{
+  if (size > OUTPUT_QUEUE_BYTES)
+  {
+    return 0;
+  }
+  if (queue->policy == OUTPUT_POLICY_BLOCK && queue->used + size > OUTPUT_QUEUE_BYTES)
+  {
+    queue->blocked++;
+    outputQueueWrite(queue, 0); // wait for the card to take the backlog
+  }
+  while (queue->used + size > OUTPUT_QUEUE_BYTES)
+  {
+    int victim = -1;
+    if (queue->policy == OUTPUT_POLICY_DROP_OLDEST)
+    {
+      victim = 0;
+    }
+    else if (queue->policy == OUTPUT_POLICY_DROP_LOW_PRIORITY || queue->policy == OUTPUT_POLICY_ROLLUP)
+    {
+      // oldest record of the lowest priority that is not above the new record
+      int lowest = priority + 1;
+      for (int offset = 0; offset < queue->used; offset += outputQueueRecordSize(queue, offset))
+      {
+        int recordPriority = outputQueueByte(queue, offset + 3);
+        if (recordPriority < lowest)
+        {
+          lowest = recordPriority;
+          victim = offset;
+        }
+      }
+    }
+    if (victim == -1)
+    {
+      return 0; // nothing can be dropped for this record (or the card is missing with OUTPUT_POLICY_BLOCK)
+    }
+    queue->dropped++;
+    queue->droppedBytes += outputQueueRecordSize(queue, victim);
+    dataCodecDropped(queue->files[outputQueueByte(queue, victim + 2)].fullFileName); // later rows of a compressed file refer to it
+    outputQueueRemove(queue, victim);
+  }
+  return 1;
+}
+
+// start a new record for fullFileName: format the record into the returned Print and then call
+// outputQueueFinishRecord()
+Print &outputQueueStartRecord(outputQueue *queue, char *fullFileName, int priority)
+{
+  queue->stageFile = outputQueueAddFile(queue, fullFileName, NULL, NULL);
+  queue->stagePriority = priority;
+  outputStage.length = 0;
+  outputStage.overflow = 0;
+  return outputStage;
+}
+
+// queue the record in the staging buffer; returns 1 if it was queued, 0 if it was dropped
+int outputQueueFinishRecord(outputQueue *queue)
+{
+  int size = OUTPUT_QUEUE_HEADER + outputStage.length;
+  if (outputStage.overflow || queue->stageFile < 0 || !outputQueueMakeRoom(queue, size, queue->stagePriority))
+  {
+    queue->dropped++;
+    queue->droppedBytes += size;
+    if (queue->stageFile >= 0)
+    {
+      dataCodecDropped(queue->files[queue->stageFile].fullFileName);
+    }
+    return 0;
+  }
+  int tail = (queue->head + queue->used) % OUTPUT_QUEUE_BYTES;
+  uint8_t header[OUTPUT_QUEUE_HEADER] = {(uint8_t)(outputStage.length & 0xFF), (uint8_t)(outputStage.length >> 8),
+                                         (uint8_t)queue->stageFile, (uint8_t)queue->stagePriority};
+  for (int k = 0; k < OUTPUT_QUEUE_HEADER; k++)
+  {
+    queue->buffer[(tail + k) % OUTPUT_QUEUE_BYTES] = header[k];
+  }
+  for (int k = 0; k < outputStage.length; k++)
+  {
+    queue->buffer[(tail + OUTPUT_QUEUE_HEADER + k) % OUTPUT_QUEUE_BYTES] = outputStage.text[k];
+  }
+  queue->used += size;
+  queue->records++;
+  queue->queued++;
+  if (queue->used > queue->highWater)
+  {
+    queue->highWater = queue->used;
+  }
+  outputQueueUpdateRollup(queue);
+  return 1;
+}
+
+void outputQueueCardFailed(outputQueue *queue)
+{
+  for (int f = 0; f < queue->nFiles; f++)
+  {
+    releaseLogFile(queue->files[f].fullFileName); // files kept open by group commit are reopened after recovery
+  }
+  queue->sdReady = 0;
+  queue->sdFailures++;
+  queue->nextRetry = millis() + OUTPUT_QUEUE_RETRY_INTERVAL;
+}
+
+#ifdef ENABLE_TIME_INDEX
+// count (second column) of the text row in the oldest record, or -1
+int outputQueueRecordCount(outputQueue *queue)
+{
+  int length = outputQueueRecordSize(queue, 0) - OUTPUT_QUEUE_HEADER;
+  int k = 0;
+  while (k < length && outputQueueByte(queue, OUTPUT_QUEUE_HEADER + k) != ',')
+  {
+    k++;
+  }
+  for (k++; k < length && outputQueueByte(queue, OUTPUT_QUEUE_HEADER + k) == ' '; k++)
+  {
+  }
+  int count = -1;
+  for (; k < length; k++)
+  {
+    uint8_t c = outputQueueByte(queue, OUTPUT_QUEUE_HEADER + k);
+    if (c < '0' || c > '9')
+      break;
+    count = (count < 0 ? 0 : count * 10) + (c - '0');
+  }
+  return count;
+}
+#endif
+
+// write queued records to the card (for at most budgetMicros, 0 = until the queue is empty)
+//  returns the number of records written or -1 if the card failed
+int outputQueueWrite(outputQueue *queue, unsigned long budgetMicros)
+{
+  unsigned long start = micros();
+  int nWritten = 0;
+  while (queue->records > 0 && queue->sdReady)
+  {
+    int fileId = outputQueueByte(queue, 2);
+    File tmpFile = openLogFile(queue->files[fileId].fullFileName);
+    if (!tmpFile)
+    {
+      outputQueueCardFailed(queue);
+      return -1;
+    }
+#ifdef ENABLE_TIME_INDEX
+    int indexed = findTimeIndex(queue->files[fileId].fullFileName) != NULL;
+#endif
+    // write consecutive records for the same file with one open and close
+    while (queue->records > 0 && outputQueueByte(queue, 2) == fileId)
+    {
+#ifdef ENABLE_TIME_INDEX
+      // where the row lands, for its entry in the index
+      unsigned long offset = indexed ? logFileEnd(tmpFile, queue->files[fileId].fullFileName) : 0;
+      int rowCount = indexed ? outputQueueRecordCount(queue) : -1;
+#endif
+      int length = outputQueueRecordSize(queue, 0) - OUTPUT_QUEUE_HEADER;
+      int position = (queue->head + OUTPUT_QUEUE_HEADER) % OUTPUT_QUEUE_BYTES;
+      int first = length < OUTPUT_QUEUE_BYTES - position ? length : OUTPUT_QUEUE_BYTES - position; // text may wrap
+      int count = tmpFile.write(queue->buffer + position, first);
+      if (length > first)
+      {
+        count += tmpFile.write(queue->buffer, length - first);
+      }
+      if (count != length)
+      {
+        closeLogFile(tmpFile, queue->files[fileId].fullFileName);
+        outputQueueCardFailed(queue);
+        return -1;
+      }
+#ifdef ENABLE_TIME_INDEX
+      if (rowCount > 0)
+      {
+        timeIndexRowWritten(queue->files[fileId].fullFileName, rowCount, offset);
+      }
+#endif
+      outputQueueRemove(queue, 0);
+      queue->written++;
+      nWritten++;
+      if (budgetMicros > 0 && micros() - start > budgetMicros)
+      {
+        break;
+      }
+    }
+    closeLogFile(tmpFile, queue->files[fileId].fullFileName);
+    if (budgetMicros > 0 && micros() - start > budgetMicros)
+    {
+      break;
+    }
+  }
+  return nWritten;
+}
+
+// restart the card and create the files that could not be created while it was missing
+int outputQueueRecoverSD(outputQueue *queue)
+{
+  if (!SD.begin(SD_CS))
+  {
+    return -1;
+  }
+  int needDirectory = 1;
+  for (int f = 0; f < queue->nFiles; f++)
+  {
+    if (queue->files[f].fullFileName[0] == 0 && queue->files[f].fileType)
+    {
+      if (needDirectory)
+      {
+        initializeSDFileDirectory();
+        needDirectory = 0;
+      }
+      setup_SD_file(deviceCode, queue->files[f].fileType, queue->files[f].fileSuffix, queue->files[f].fullFileName);
+    }
+  }
+  queue->sdReady = 1;
+  queue->recoveries++;
+  return 1;
+}
+
+// call on every pass through loop(): writes part of the backlog, or retries a missing card
+int outputQueueService(outputQueue *queue)
+{
+  if (queue->records == 0)
+  {
+    return 0;
+  }
+  if (!queue->sdReady)
+  {
+    if (millis() < queue->nextRetry)
+    {
+      return 0;
+    }
+    queue->nextRetry = millis() + OUTPUT_QUEUE_RETRY_INTERVAL;
+    if (outputQueueRecoverSD(queue) < 0)
+    {
+      return 0;
+    }
+    MESSAGE("SD card is back, replaying records", queue->records)
+  }
+  PROFILE_REGION(iProfSDWrite)
+  return outputQueueWrite(queue, OUTPUT_QUEUE_DRAIN_MICROS);
+}
+
+void printOutputQueueStatus(Print &out, outputQueue *queue)
+{
+  out.print("QUEUE: used ");
+  out.print(queue->used);
+  out.print(" of ");
+  out.print(OUTPUT_QUEUE_BYTES);
+  out.print(" bytes (high ");
+  out.print(queue->highWater);
+  out.print("), records ");
+  out.print(queue->records);
+  out.print(", queued ");
+  out.print(queue->queued);
+  out.print(", written ");
+  out.print(queue->written);
+  out.print(", dropped ");
+  out.print(queue->dropped);
+  out.print(", blocked ");
+  out.print(queue->blocked);
+  out.print(", card failures ");
+  out.print(queue->sdFailures);
+  out.print(", recoveries ");
+  out.print(queue->recoveries);
+  out.println(queue->rollup ? ", ROLLUP" : "");
+}
+
+#endif
@@ -0,0 +1,142 @@
+// profiler.h
+// scoped timers for named regions of the code (sensor reads, updateDataSample, event evaluation,
+// CSV formatting, SD writes and Serial writes). each region is a normal data stream, so every
+// timed pass through a region adds one sample (in us) to that stream and the profile is written
+// to the data file with the other streams (no extra I/O)
+//
+//  usage:
+//    PROFILE_REGION(iProfSensor)              // times from here to the end of the enclosing block
+//    PROFILE_REGION_NAMED(timer, iProfFormat) // same, but can be stopped early with
+//    PROFILE_STOP(timer)                      // (for regions that do not match a block)
+//
+//  regions are inclusive: a region that calls into another region (e.g. event evaluation that
+//  writes an event to SD) includes the time of the inner region
+//
+//  the clock is the DWT cycle counter (CYCCNT) on Cortex-M3/M4/M7, clock_gettime() on the host
+//  and micros() on any other board (and on the host with PROFILE_VIRTUAL_CLOCK, so host/testHost
+//  can script the length of each region on the virtual clock)
+//
+//  enable with ENABLE_PROFILER in the deviceConfig file; when it is not defined all of the
+//  PROFILE_ macros expand to nothing and none of this code is compiled
+
+// indices of the data streams for each profiled region (-1 = not profiled)
+int iProfSensor = -1; // reading sensors
+int iProfUpdate = -1; // updateDataSample
+int iProfEvents = -1; // checking pins and thresholds for events (includes reporting them)
+int iProfFormat = -1; // formatting rows of the CSV data file
+int iProfSDWrite = -1; // opening, writing and closing files on the SD card
+int iProfSerial = -1; // writing to Serial
+
+// the clock is shared with the benchmarks (benchmarkStats.h) and the data codec (dataCompress.h)
+#if defined(ENABLE_PROFILER) || defined(ENABLE_BENCHMARK) || defined(ENABLE_COMPRESSED_DATA)
+
+#if defined(ARDUINO) && (defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__))
+// Cortex-M debug registers used to run the cycle counter
+#define PROFILE_DEMCR (*(volatile uint32_t *)0xE000EDFC)
+#define PROFILE_DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define PROFILE_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+
+void initProfileClock()
+{
+  PROFILE_DEMCR |= (1UL << 24); // TRCENA: enable the DWT unit
+  PROFILE_DWT_CYCCNT = 0;
+  PROFILE_DWT_CTRL |= 1UL; // CYCCNTENA: start counting cycles
+}
+
+inline uint32_t profileTicks()
+{
+  return PROFILE_DWT_CYCCNT;
+}
+
+float profileTicksPerMicro()
+{
+  return ((float)SystemCoreClock) / 1000000.;
+}
+#elif !defined(ARDUINO) && !defined(PROFILE_VIRTUAL_CLOCK)
+// host build: nanoseconds from the monotonic clock
+#include <time.h>
+
+void initProfileClock()
+{
+}
+
+inline uint32_t profileTicks()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+
+float profileTicksPerMicro()
+{
+  return 1000.;
+}
+#else
+// other boards (and the virtual clock of the host): fall back to micros()
+void initProfileClock()
+{
+}
+
+inline uint32_t profileTicks()
+{
+  return micros();
+}
+
+float profileTicksPerMicro()
+{
+  return 1.;
+}
+#endif
+#endif
+
+#ifdef ENABLE_PROFILER
+
+// the profile is recorded with updateDataSample() from sampleStats.h (included after this file)
+struct sampleStats;
+int updateDataSample(sampleStats *dataStream, int index, float inputValue, float relTime);
+
+sampleStats *profileData = NULL; // array of data streams that hold the profile
+int profileRecording = 0;        // set while a region is being recorded (so recording is not itself profiled)
+float profileMicrosPerTick = 1.;
+
+void initProfiler(sampleStats *dataStream)
+{
+  initProfileClock();
+  profileMicrosPerTick = 1. / profileTicksPerMicro();
+  profileData = dataStream;
+}
+
+class profileScope
+{
+public:
+  profileScope(int region) : iRegion(region), startTicks(profileTicks()) {}
+  ~profileScope() { stop(); }
+
+  void stop()
+  {
+    if (iRegion < 0 || profileData == NULL || profileRecording)
+    {
+      return;
+    }
+    uint32_t elapsedTicks = profileTicks() - startTicks; // unsigned subtraction handles rollover
+    profileRecording = 1;
+    updateDataSample(profileData, iRegion, ((float)elapsedTicks) * profileMicrosPerTick, 0.);
+    profileRecording = 0;
+    iRegion = -1; // only record once
+  }
+
+private:
+  int iRegion;
+  uint32_t startTicks;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_REGION(iRegion) profileScope PROFILE_CONCAT(profileTimer, __LINE__)(iRegion);
+#define PROFILE_REGION_NAMED(timer, iRegion) profileScope timer(iRegion);
+#define PROFILE_STOP(timer) timer.stop();
+#else
+#define PROFILE_REGION(iRegion)              // do not include in code
+#define PROFILE_REGION_NAMED(timer, iRegion) // do not include in code
+#define PROFILE_STOP(timer)                  // do not include in code
+#endif
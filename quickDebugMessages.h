@@ -1,90 +1,233 @@
-#ifdef ENABLEDEBUG
-// this compiler macro is a quick way to print out data for debugging
-//    when enabled, the line:
-//    DBG([variable name])
-//
-//    for example:
-//    DBG(current_time)
-//
-//    expands to (prior to compiling and DEBUG_LEVEL will be replaced by the value indicated):
-//    if (7 < DEBUG_LEVEL) {
-//      Serial.print("DEBUG: var: ");
-//      Serial.print("current_time");
-//      Serial.print(" = ");
-//      Serial.println(current_time);
-//    }
-
-// DEBUG will always print variable = value when debug is enabled
-#define DEBUG(b)                  \
-    Serial.print("DEBUG: var: "); \
-    Serial.print(#b);             \
-    Serial.print(" = ");          \
-    Serial.println(b);
-
-// DEBUG1 through DEBUG4 will print if their level is less than or equal to DEBUG_LEVEL
-#define DEBUG1(b)                     \
-    if (0 < DEBUG_LEVEL)              \
-    {                                 \
-        Serial.print("DEBUG1: var: "); \
-        Serial.print(#b);             \
-        Serial.print(" = ");          \
-        Serial.println(b);            \
-    }
-#define DEBUG2(b)                     \
-    if (1 < DEBUG_LEVEL)              \
-    {                                 \
-        Serial.print("DEBUG2: var: "); \
-        Serial.print(#b);             \
-        Serial.print(" = ");          \
-        Serial.println(b);            \
-    }
-#define DEBUG3(b)                     \
-    if (2 < DEBUG_LEVEL)              \
-    {                                 \
-        Serial.print("DEBUG3: var: "); \
-        Serial.print(#b);             \
-        Serial.print(" = ");          \
-        Serial.println(b);            \
-    }
-#define DEBUG4(b)                     \
-    if (3 < DEBUG_LEVEL)              \
-    {                                 \
-        Serial.print("DEBUG4: var: "); \
-        Serial.print(#b);             \
-        Serial.print(" = ");          \
-        Serial.println(b);            \
-    }
-//
-// also create  messages
-#define MESSAGE(a, b)                                               \
-    Serial.println("");  \
-    Serial.println("-----------------------------------------"); \
-    Serial.print(a);                                             \
-    Serial.print(" for variable: ");                             \
-    Serial.print(#b);                                            \
-    Serial.print(" = ");                                         \
-    Serial.println(b);                                           \
-    Serial.println("-----------------------------------------"); \
-    Serial.println("");
-
-// also create warning messages
-#define WARN(a, b)                                               \
-    Serial.println("");  \
-    Serial.println("WWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW"); \
-    Serial.print("WARNING: ");                                   \
-    Serial.print(a);                                             \
-    Serial.print(" for variable: ");                             \
-    Serial.print(#b);                                            \
-    Serial.print(" = ");                                         \
-    Serial.println(b);                                           \
-    Serial.println("WWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW"); \
-    Serial.println("");
-#else
-#define DEBUG(b)  // do not include in code
-#define DEBUG1(b) // do not include in code
-#define DEBUG2(b) // do not include in code
-#define DEBUG3(b) // do not include in code
-#define DEBUG4(b) // do not include in code
-#define WARN(a,b) // do not include in code
-#define MESSAGE(a,b) // do not include in code
-#endif
\ No newline at end of file
+// DEBUG_LEVEL sets which of DEBUG1 through DEBUG4 are compiled: DEBUGn is compiled when n <= DEBUG_LEVEL
+//    and is removed entirely (no code, no strings) otherwise. define it before including this file
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 4
+#endif
+
+#ifdef ENABLE_DEFERRED_DEBUG
+// deferred (tokenized) debug messages
+//    with ENABLE_DEFERRED_DEBUG the macros below do not print. each one records a 32 bit token, millis()
+//    and its value in binary into debugLogRing, which takes a few us instead of the ms that a blocking
+//    Serial print takes. debugLog.h writes the records out when loop() is idle as lines
+//      $TTTTTTTT,millis,value
+//    to Serial (or to the SD log file with DEBUG_LOG_TO_SD), and host/detokenize turns them back into the
+//    text the macros print without ENABLE_DEFERRED_DEBUG
+//
+//    the token is the FNV-1a hash of "DEBUG|variable", "DEBUGn|variable", "MESSAGE|text|variable" or
+//    "WARN|text|variable" computed by the compiler, so the text is not in the program at all: the detokenizer
+//    finds the same strings by reading the macro calls in the source files. the text of WARN and MESSAGE
+//    must therefore be a string literal
+//
+//    when the ring is full new records are dropped and counted (printDebugLogStatus)
+
+#ifndef DEBUG_LOG_BYTES
+#define DEBUG_LOG_BYTES 1024 // size of the ring of records in RAM
+#endif
+#define DEBUG_LOG_RECORD_BYTES 9   // token, millis and type before the value
+#define DEBUG_LOG_STRING_BYTES 24  // longest string value kept (longer ones are cut)
+
+// FNV-1a, evaluated by the compiler (debugTokenOf forces it to be a constant)
+constexpr uint32_t debugTokenHash(const char *text, uint32_t hash = 2166136261UL)
+{
+    return *text == 0 ? hash : debugTokenHash(text + 1, (uint32_t)((hash ^ (uint8_t)*text) * 16777619UL));
+}
+template <uint32_t hash>
+struct debugTokenOf
+{
+    static const uint32_t token = hash;
+};
+
+uint8_t debugLogRing[DEBUG_LOG_BYTES];
+unsigned int debugLogHead = 0; // oldest record
+unsigned int debugLogUsed = 0;
+unsigned long debugLogRecorded = 0;
+unsigned long debugLogDropped = 0; // records lost because the ring was full
+unsigned int debugLogHigh = 0;     // most bytes waiting
+
+void debugLogPut(uint8_t value)
+{
+    debugLogRing[(debugLogHead + debugLogUsed) % DEBUG_LOG_BYTES] = value;
+    debugLogUsed++;
+}
+
+void debugLogPut32(uint32_t value)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        debugLogPut((uint8_t)(value >> (8 * k)));
+    }
+}
+
+// start a record whose value takes valueBytes; returns 0 (and counts a drop) if it does not fit
+int debugLogStart(uint32_t token, char type, int valueBytes)
+{
+    if (debugLogUsed + DEBUG_LOG_RECORD_BYTES + valueBytes > DEBUG_LOG_BYTES)
+    {
+        debugLogDropped++;
+        return 0;
+    }
+    debugLogPut32(token);
+    debugLogPut32((uint32_t)millis());
+    debugLogPut((uint8_t)type);
+    return 1;
+}
+
+void debugLogFinish()
+{
+    debugLogRecorded++;
+    if (debugLogUsed > debugLogHigh)
+        debugLogHigh = debugLogUsed;
+}
+
+// one function for each kind of value the macros are given; the type byte tells the reader how
+//    to print the value ('i' signed, 'u' unsigned, 'c' character, 'f' float, 's' string)
+void debugLogRecord(uint32_t token, long value)
+{
+    if (debugLogStart(token, 'i', 4))
+    {
+        debugLogPut32((uint32_t)value);
+        debugLogFinish();
+    }
+}
+
+void debugLogRecord(uint32_t token, unsigned long value)
+{
+    if (debugLogStart(token, 'u', 4))
+    {
+        debugLogPut32((uint32_t)value);
+        debugLogFinish();
+    }
+}
+
+void debugLogRecord(uint32_t token, int value) { debugLogRecord(token, (long)value); }
+void debugLogRecord(uint32_t token, short value) { debugLogRecord(token, (long)value); }
+void debugLogRecord(uint32_t token, unsigned int value) { debugLogRecord(token, (unsigned long)value); }
+void debugLogRecord(uint32_t token, unsigned short value) { debugLogRecord(token, (unsigned long)value); }
+void debugLogRecord(uint32_t token, unsigned char value) { debugLogRecord(token, (unsigned long)value); }
+
+void debugLogRecord(uint32_t token, char value)
+{
+    if (debugLogStart(token, 'c', 1))
+    {
+        debugLogPut((uint8_t)value);
+        debugLogFinish();
+    }
+}
+
+void debugLogRecord(uint32_t token, float value)
+{
+    if (debugLogStart(token, 'f', 4))
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        debugLogPut32(bits);
+        debugLogFinish();
+    }
+}
+
+void debugLogRecord(uint32_t token, double value) { debugLogRecord(token, (float)value); }
+
+void debugLogRecord(uint32_t token, const char *value)
+{
+    int length = 0;
+    while (length < DEBUG_LOG_STRING_BYTES && value[length] != 0)
+        length++;
+    if (debugLogStart(token, 's', 1 + length))
+    {
+        debugLogPut((uint8_t)length);
+        for (int k = 0; k < length; k++)
+            debugLogPut((uint8_t)value[k]);
+        debugLogFinish();
+    }
+}
+
+// record b under the token of the string text
+#define DEBUG_RECORD(text, b) debugLogRecord(debugTokenOf<debugTokenHash(text)>::token, b);
+#endif
+
+#ifdef ENABLEDEBUG
+// this compiler macro is a quick way to print out data for debugging
+//    when enabled, the line:
+//    DBG([variable name])
+//
+//    for example:
+//    DBG(current_time)
+//
+//    expands to:
+//      Serial.print("DEBUG: var: ");
+//      Serial.print("current_time");
+//      Serial.print(" = ");
+//      Serial.println(current_time);
+//
+//    (or to one call of debugLogRecord with ENABLE_DEFERRED_DEBUG)
+
+#ifdef ENABLE_DEFERRED_DEBUG
+#define DEBUG_PRINT(label, name, b) DEBUG_RECORD(label "|" name, b)
+#define MESSAGE(a, b) DEBUG_RECORD("MESSAGE|" a "|" #b, b)
+#define WARN(a, b) DEBUG_RECORD("WARN|" a "|" #b, b)
+#else
+#define DEBUG_PRINT(label, name, b)    \
+    Serial.print(label ": var: ");     \
+    Serial.print(name);                \
+    Serial.print(" = ");               \
+    Serial.println(b);
+
+// also create  messages
+#define MESSAGE(a, b)                                               \
+    Serial.println("");  \
+    Serial.println("-----------------------------------------"); \
+    Serial.print(a);                                             \
+    Serial.print(" for variable: ");                             \
+    Serial.print(#b);                                            \
+    Serial.print(" = ");                                         \
+    Serial.println(b);                                           \
+    Serial.println("-----------------------------------------"); \
+    Serial.println("");
+
+// also create warning messages
+#define WARN(a, b)                                               \
+    Serial.println("");  \
+    Serial.println("WWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW"); \
+    Serial.print("WARNING: ");                                   \
+    Serial.print(a);                                             \
+    Serial.print(" for variable: ");                             \
+    Serial.print(#b);                                            \
+    Serial.print(" = ");                                         \
+    Serial.println(b);                                           \
+    Serial.println("WWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW"); \
+    Serial.println("");
+#endif
+
+// DEBUG will always print variable = value when debug is enabled
+#define DEBUG(b) DEBUG_PRINT("DEBUG", #b, b)
+
+// DEBUG1 through DEBUG4 are only compiled if their level is less than or equal to DEBUG_LEVEL
+#if DEBUG_LEVEL >= 1
+#define DEBUG1(b) DEBUG_PRINT("DEBUG1", #b, b)
+#else
+#define DEBUG1(b) // above DEBUG_LEVEL: not compiled
+#endif
+#if DEBUG_LEVEL >= 2
+#define DEBUG2(b) DEBUG_PRINT("DEBUG2", #b, b)
+#else
+#define DEBUG2(b) // above DEBUG_LEVEL: not compiled
+#endif
+#if DEBUG_LEVEL >= 3
+#define DEBUG3(b) DEBUG_PRINT("DEBUG3", #b, b)
+#else
+#define DEBUG3(b) // above DEBUG_LEVEL: not compiled
+#endif
+#if DEBUG_LEVEL >= 4
+#define DEBUG4(b) DEBUG_PRINT("DEBUG4", #b, b)
+#else
+#define DEBUG4(b) // above DEBUG_LEVEL: not compiled
+#endif
+#else
+#define DEBUG(b)  // do not include in code
+#define DEBUG1(b) // do not include in code
+#define DEBUG2(b) // do not include in code
+#define DEBUG3(b) // do not include in code
+#define DEBUG4(b) // do not include in code
+#define WARN(a,b) // do not include in code
+#define MESSAGE(a,b) // do not include in code
+#endif
@@ -0,0 +1,122 @@
+// rateGroups.h
+// per-stream acquisition and output rates
+//  every data stream belongs to a rate group (sampleStats.rateGroup, 0 by default). each group has
+//  its own acquisition interval (how often its sensors are read) and output interval (how often
+//  its statistics are finalized, written and reset). group 0 is the main group: it is written to
+//  the data file every SAMPLING_PERIOD. every other group is written to its own spreadsheet file
+//  ("Dtype###.csv", e.g. Zslow000.csv) with a header that lists only the streams in that group. a
+//  threshold event is evaluated when the group of the stream it watches is output, so it always
+//  sees the average of a finished interval of that group
+//
+//  updateSampleStats(), resetSampleStats() and printSampleStatSpreadsheetToFile() take the group
+//  to work on, so finalizing one group never touches the accumulators of the others
+//
+//  enable with ENABLE_RATE_GROUPS in the deviceConfig file; when it is not defined every stream is
+//  output on the one SAMPLING_PERIOD (MAIN_RATE_GROUP is -1 = all streams)
+
+// move a data stream into a rate group (does nothing if the group was not created)
+int setRateGroup(sampleStats *dataStream, int index, int group)
+{
+  if (index < 0 || group < 0)
+  {
+    return -1; // data stream or group was not created
+  }
+  dataStream[index].rateGroup = group;
+  return 1;
+}
+
+#ifdef ENABLE_RATE_GROUPS
+
+#define MAIN_RATE_GROUP 0
+#define MAX_RATE_GROUPS 4
+#define RATE_GROUP_TYPE_MAX 6 // file type used in the file name, e.g. "slow"
+
+struct rateGroup
+{
+  char fileType[RATE_GROUP_TYPE_MAX];
+  unsigned long acquireInterval; // time between reads of the sensors in the group (ms), 0 = every pass
+  unsigned long outputInterval;  // time between outputs of the statistics of the group (ms)
+  unsigned long nextAcquire;     // time at which the sensors are next read
+  unsigned long nextOutput;      // time at which the statistics are next output
+  unsigned long timeReference;   // start of the current sample (for trendlines)
+  int nStreams;                  // number of data streams in the group
+  int countLine;                 // number of lines in the SD file of the group
+  char fileName[40];             // SD file of the group (unused for the main group)
+#ifdef ENABLE_LOG_ROTATION
+  logRotation rotation; // rotation of the SD file of the group
+#endif
+};
+
+rateGroup groups[MAX_RATE_GROUPS];
+int nGroups = 0;
+
+// addRateGroup: creates a new rate group and returns its index
+int addRateGroup(rateGroup *localGroup, int *numGroups, char *fileType, unsigned long acquireInterval, unsigned long outputInterval)
+{
+  int newGroupIndex = *numGroups;
+  if (newGroupIndex == MAX_RATE_GROUPS)
+  {
+    WARN("too many rate groups", newGroupIndex)
+    return -1;
+  }
+  *numGroups = *numGroups + 1;
+
+  strncpy(localGroup[newGroupIndex].fileType, fileType, RATE_GROUP_TYPE_MAX - 1);
+  localGroup[newGroupIndex].fileType[RATE_GROUP_TYPE_MAX - 1] = 0;
+  localGroup[newGroupIndex].acquireInterval = acquireInterval;
+  localGroup[newGroupIndex].outputInterval = outputInterval;
+  localGroup[newGroupIndex].nextAcquire = millis();
+  localGroup[newGroupIndex].nextOutput = millis() + outputInterval;
+  localGroup[newGroupIndex].timeReference = millis();
+  localGroup[newGroupIndex].nStreams = 0;
+  localGroup[newGroupIndex].countLine = 0;
+  localGroup[newGroupIndex].fileName[0] = 0;
+  return newGroupIndex;
+}
+
+// count the streams in each group (call once after all streams are added and grouped)
+void countRateGroupStreams(sampleStats *dataStream, int nSamp, rateGroup *localGroup, int numGroups)
+{
+  for (int g = 0; g < numGroups; g++)
+  {
+    localGroup[g].nStreams = 0;
+  }
+  for (int i = 0; i < nSamp; i++)
+  {
+    localGroup[dataStream[i].rateGroup].nStreams++;
+  }
+}
+
+// returns 1 (and schedules the next read) when the sensors of the group are due to be read
+int rateGroupAcquireDue(rateGroup *localGroup, int group, unsigned long now)
+{
+  if (group < 0 || localGroup[group].nStreams == 0 || now < localGroup[group].nextAcquire)
+  {
+    return 0;
+  }
+  localGroup[group].nextAcquire = now + localGroup[group].acquireInterval;
+  return 1;
+}
+
+// returns 1 (and schedules the next output) when the statistics of the group are due to be output
+int rateGroupOutputDue(rateGroup *localGroup, int group, unsigned long now)
+{
+  if (group < 0 || localGroup[group].nStreams == 0 || now <= localGroup[group].nextOutput)
+  {
+    return 0;
+  }
+  localGroup[group].nextOutput = now + localGroup[group].outputInterval;
+  return 1;
+}
+
+// time (s) since the start of the current sample of the group, for trendlines
+float rateGroupRelativeTime(rateGroup *localGroup, int group, unsigned long now)
+{
+  return ((float)(now - localGroup[group].timeReference)) / 1000.;
+}
+
+#else
+
+#define MAIN_RATE_GROUP -1 // all streams
+
+#endif
@@ -1,605 +1,900 @@
-// code to test creation of a structure for storing sensor data
-// *******************************
-// move to sampleStats.h after building and testing
-// *******************************
-// structure used for storing data as it is collected and calculating statistics of the data
-// before output. in this structure, a SAMPLE of data is collected over a time interval,
-// with n (SAMPLE SIZE) data points collected at time increments (that are not necessarily equal)
-
-#ifdef ENABLE_DATA_CHUNKS
-// MAX_RAW_DATA used for storing array of raw data during collection
-//  set MAX_RAW_DATA to 1 to only store most recent value
-#define MAX_RAW_DATA 1000
-#endif
-
-// configure setting for labels (char arrays) for data streams
-#define DATA_NAME_MAX 50
-#define DATA_NAME_SHORT 10
-
-struct sampleStats
-{
-  /* data */
-  int n;            // count of number of data values in this sample
-  float currentVal; // most recent value entered into sample
-
-#ifdef ENABLE_DATA_CHUNKS
-  float rawData[MAX_RAW_DATA]; // optional use during development: array to store raw data
-#endif
-
-  // rawData[n-1] is the most recently collected data point
-  float sumX;                         // sum of all values entered into sample
-  float sumX2;                        // sum of all values squared (before adding to sum)
-  float sumXT;                        // sum of value multiplied by time for trendline
-  float sumT;                         // sum of time values for trendline
-  float sumT2;                        // sum of time squared for trendline
-  char dataName[DATA_NAME_MAX];       // name data stream name
-  char dataNickName[DATA_NAME_SHORT]; // short name of data stream
-  char dataUnits[DATA_NAME_MAX];      // string with units of measurement for data stream
-
-  float average;
-  float standardDeviation;
-
-  int baselineType; // enable calculating a baseline to subtract: 0 = none, 1 = input, 2 = calculate
-  float baseline;
-  float baselineSum;
-  float baselineSumX2;
-  int baselineCount;
-
-  int calcTrendline; // flag indicating calculation of a trendline
-
-  int eventIndex; // associated event to track thresholds (if used)
-
-  int outputStats; // variable indicating what stats to output to spreadsheets
-  // -1 = no output (just a variable for internal calculations)
-  // 0  = only output current value (no statistics)
-  // 1  = only output average
-  // 2  = output average and current
-  // 3  = output average and sample size
-  // 4  = output average and standard deviation
-  // 5  = output all info (including current and sample size)
-
-  // lots more information to be added later
-  // * max value of data in sample
-  // * min value of data in sample
-  // * average of data in sample
-  // ....
-};
-
-#define MAX_SAMPLES 20
-int nSamples = 0;
-sampleStats data[MAX_SAMPLES];
-// data[2].currentVal; // contains current sensor value
-
-// functions that will manipulate information in sampleStats structure
-// will be moved to sampleStats.cpp later
-// may need to declare extern variables
-
-// addDataStream: creates a new data stream and returns the index of that dataStream in the sampleStat
-//        structure array
-int addDataStream(sampleStats *localData, int *numSamples, char *dataName, char *dataNickName, char *dataUnits, int outputType)
-//int addDataStream(char *dataName, char *dataNickName, char *dataUnits)
-{
-  int newSampleIndex = *numSamples;
-  if (newSampleIndex == MAX_SAMPLES)
-  {
-    WARN("too many data streams", newSampleIndex)
-    return -1; // return error code
-  }
-  //nSamples++;
-  *numSamples = *numSamples + 1;
-
-  // initialize key values in data structure
-  localData[newSampleIndex].n = 0;      // initialize the time sample
-  localData[newSampleIndex].sumX = 0.;  // initialize the sum of data
-  localData[newSampleIndex].sumX2 = 0.; // initialie the sum of the squared data
-  localData[newSampleIndex].sumT = 0.;
-  localData[newSampleIndex].sumXT = 0.;               // initialie the sum of the data multiplied by time for trendline
-  localData[newSampleIndex].sumT2 = 0.;               // initialie the sum of the squared time
-  localData[newSampleIndex].outputStats = outputType; // variable indicating what stats to output to spreadsheets
-                                                      // -1 = no output (just a variable for internal calculations)
-                                                      // 0  = only output current value (no statistics)
-                                                      // 1  = only output average
-                                                      // 2  = output average and current
-                                                      // 3  = output average and sample size
-                                                      // 4  = output average and standard deviation
-                                                      // 5  = output all info (including current and sample size)
-
-  localData[newSampleIndex].average = 0.;
-  localData[newSampleIndex].standardDeviation = 0.;
-
-  localData[newSampleIndex].baselineType = 0; // default to not subtracting off baseline
-  localData[newSampleIndex].baseline = 0.;
-  localData[newSampleIndex].baselineSum = 0.; // default to baseline = 0
-  localData[newSampleIndex].baselineCount = 0;
-  localData[newSampleIndex].baselineSumX2 = 0.;
-
-  localData[newSampleIndex].calcTrendline = 0; // default to not calculating trendline
-  localData[newSampleIndex].eventIndex = -1;   // set to -1 as default (no event tracker)
-
-  // perform checks on string lengths
-  int nameLength = strlen(dataName);
-  if (nameLength > (DATA_NAME_MAX - 2))
-  {
-    MESSAGE("name", dataName)
-    WARN("Data name too long", nameLength)
-  }
-  else
-  {
-    strcpy(localData[newSampleIndex].dataName, dataName); // need to add check on length!
-  }
-
-  nameLength = strlen(dataNickName);
-  if (nameLength > (DATA_NAME_MAX - 2))
-  {
-    MESSAGE("name", dataNickName)
-    WARN("Data nickname too long", nameLength)
-  }
-  else
-  {
-    strcpy(localData[newSampleIndex].dataNickName, dataNickName); // need to add check on length!
-  }
-
-  nameLength = strlen(dataUnits);
-  if (nameLength > (DATA_NAME_MAX - 2))
-  {
-    MESSAGE("name", dataUnits)
-    WARN("data units name too long", nameLength)
-  }
-  else
-  {
-    strcpy(localData[newSampleIndex].dataUnits, dataUnits); // need to add check on length!
-  }
-
-  return newSampleIndex;
-}
-
-int updateDataSample(sampleStats *dataStream, int index, float inputValue, float relTime = 0.)
-{
-  // function for adding new data points to a sample
-  // subtract baseline
-  float value = inputValue - dataStream[index].baseline;
-
-  // this function assumes the new data is a floating point number
-  dataStream[index].currentVal = value;
-  dataStream[index].sumX += value;
-  dataStream[index].sumX2 += value * value;
-#ifdef ENABLE_DATA_CHUNKS
-  if ((dataStream[index].n + 1) < MAX_RAW_DATA)
-  {
-    dataStream[index].rawData[dataStream[index].n] = value;
-  }
-  else
-  {
-    WARN("Max sample size exceeded ", dataStream[index].n)
-    return -1;
-  }
-#endif
-  if (dataStream[index].calcTrendline == 1)
-  {
-    dataStream[index].sumT += relTime;
-    dataStream[index].sumXT += value * relTime;
-    dataStream[index].sumT2 += relTime * relTime;
-  }
-
-  dataStream[index].n++; // increment the sample size for time
-
-  return 1;
-}
-
-int printSampleStatTableToSerial(sampleStats *dataStream, int nSamp, char *separator)
-{
-  // print header line
-  Serial.println();
-  Serial.print("---- Sample Data Summary for Device = ");
-  Serial.print(deviceName);
-  Serial.println(" ------------------------");
-  //char separator[]="\t";
-  // for tab separated formatted table, use row headings that are 9-15 characters long
-  Serial.print("DataNames");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    //Serial.print(", ");
-    Serial.print(dataStream[i].dataNickName);
-  }
-  Serial.println();
-  Serial.print("DataUnits");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    Serial.print(dataStream[i].dataUnits);
-  }
-  Serial.println();
-  Serial.print("CurrentData");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    Serial.print(dataStream[i].currentVal);
-  }
-  Serial.println();
-  Serial.print("AverageData");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    if (dataStream[i].n == 0)
-    {
-      Serial.print(dataStream[i].currentVal);
-    }
-    else
-    {
-      Serial.print(dataStream[i].sumX / ((float)dataStream[i].n));
-    }
-  }
-  Serial.println();
-
-  //Serial.print("123456789012345"); // limit row header to 8-15 char
-  Serial.print("StandardDev");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    if (dataStream[i].n < 2 || dataStream[i].outputStats < 4)
-    {
-      Serial.print("N/A");
-    }
-    else
-    {
-      // use computational formula for standard deviation
-      float variance = (dataStream[i].sumX2 - dataStream[i].sumX * dataStream[i].sumX / ((float)dataStream[i].n)) / ((float)dataStream[i].n - 1.);
-      if (variance < 0.)
-      {
-        WARN("negative variance!", variance)
-        WARN("negative variance variable ", i)
-        Serial.print("N/A");
-      }
-      else
-      {
-        Serial.print(sqrt(variance));
-      }
-      //      Serial.print(sqrt(variance));
-    }
-  }
-  Serial.println();
-
-  Serial.print("SampleSize");
-  for (int i = 0; i < nSamp; i++)
-  {
-    Serial.print(separator);
-    Serial.print(dataStream[i].n);
-  }
-  Serial.println();
-  return 1;
-}
-
-#ifdef USE_SD
-int printSampleStatTableToFile(char *fullFileName, sampleStats *dataStream, int nSamp, char *separator)
-{
-  // open file to log information
-  File tmpFile;
-  tmpFile = SD.open(fullFileName, FILE_WRITE);
-  // if the file opened okay, write to it:
-  if (tmpFile)
-  {
-
-    // print header line
-    tmpFile.println();
-    tmpFile.print("---- Sample Data Summary for Device = ");
-    tmpFile.print(deviceName);
-    tmpFile.println(" ------------------------"); //char separator[]="\t";
-    // for tab separated formatted table, use row headings that are 9-15 characters long
-    tmpFile.print("DataNames");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      //Serial.print(", ");
-      tmpFile.print(dataStream[i].dataNickName);
-    }
-    tmpFile.println();
-    tmpFile.print("DataUnits");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      tmpFile.print(dataStream[i].dataUnits);
-    }
-    tmpFile.println();
-    tmpFile.print("CurrentData");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      tmpFile.print(dataStream[i].currentVal);
-    }
-    tmpFile.println();
-    tmpFile.print("AverageData");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      if (dataStream[i].n == 0)
-      {
-        tmpFile.print(dataStream[i].currentVal);
-      }
-      else
-      {
-        tmpFile.print(dataStream[i].sumX / ((float)dataStream[i].n));
-      }
-    }
-    tmpFile.println();
-
-    //Serial.print("123456789012345"); // limit row header to 8-15 char
-    tmpFile.print("StandardDev");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      if (dataStream[i].n < 2 || dataStream[i].outputStats < 4)
-      {
-        tmpFile.print("N/A");
-      }
-      else
-      {
-        // use computational formula for standard deviation
-        float variance = (dataStream[i].sumX2 - dataStream[i].sumX * dataStream[i].sumX / ((float)dataStream[i].n)) / ((float)dataStream[i].n - 1.);
-        if (variance < 0.)
-        {
-          WARN("negative variance!", variance)
-          WARN("negative variance variable ", i)
-          tmpFile.print("N/A");
-        }
-        else
-        {
-          tmpFile.print(sqrt(variance));
-        }
-        //tmpFile.print(sqrt(variance));
-      }
-    }
-    tmpFile.println();
-
-    tmpFile.print("SampleSize");
-    for (int i = 0; i < nSamp; i++)
-    {
-      tmpFile.print(separator);
-      tmpFile.print(dataStream[i].n);
-    }
-    tmpFile.println();
-    tmpFile.close();
-  }
-  else
-  {
-    // if the file didn't open, print an error:
-    Serial.println("error opening data file");
-    return 0;
-  }
-
-  return 1;
-}
-#endif
-
-#ifdef USE_SD
-int printSampleStatSpreadsheetToFile(char *fullFileName, sampleStats *dataStream, int nSamp, char *separator, int count, int headerFlag)
-{
-  // open file to log information
-  File tmpFile;
-  tmpFile = SD.open(fullFileName, FILE_WRITE);
-  // if the file opened okay, write to it:
-  if (tmpFile)
-  {
-
-    // for first column, print Device code
-    tmpFile.print(deviceCode);
-
-    // for second column, print count tracking number of lines
-    tmpFile.print(separator);
-    tmpFile.print(count);
-
-    //char separator[]="\t";
-    // for tab separated formatted table, use row headings that are 9-15 characters long
-    //tmpFile.print("DataNames");
-    for (int i = 0; i < nSamp; i++)
-    {
-      int outputStatValue = dataStream[i].outputStats; // variable indicating what stats to output to spreadsheets
-      // -1 = no output (just a variable for internal calculations)
-      // 0  = only output current value (no statistics)
-      // 1  = only output average
-      // 2  = output average and current
-      // 3  = output average and sample size
-      // 4  = output average and standard deviation
-      // 5  = output all info (including current and sample size)
-
-      if (outputStatValue != -1)
-      {
-
-        if (outputStatValue == 0 || outputStatValue == 2 || outputStatValue == 5)
-        {
-          // print CURRENT value
-          tmpFile.print(separator);
-          if (headerFlag == 1)
-          {
-            tmpFile.print(dataStream[i].dataNickName); // include short variable name
-            tmpFile.print("_cv");                      // include tag indicating type of output
-          }
-          else
-          {
-            tmpFile.print(dataStream[i].currentVal);
-          }
-        }
-
-        if (outputStatValue > 0)
-        {
-          // print AVERAGE value
-          tmpFile.print(separator);
-          if (headerFlag == 1)
-          {
-            tmpFile.print(dataStream[i].dataNickName); // include short variable name
-            tmpFile.print("_av");                      // include tag indicating type of output
-          }
-          else
-          {
-            if (dataStream[i].n == 0)
-            {
-              tmpFile.print(dataStream[i].currentVal);
-            }
-            else
-            {
-              tmpFile.print(dataStream[i].sumX / ((float)dataStream[i].n));
-            }
-          }
-        }
-
-        if (outputStatValue > 3)
-        {
-          // print STANDARD DEVIATION value
-          tmpFile.print(separator);
-          if (headerFlag == 1)
-          {
-            tmpFile.print(dataStream[i].dataNickName); // include short variable name
-            tmpFile.print("_sd");                      // include tag indicating type of output
-          }
-          else
-          {
-            if (dataStream[i].n < 2)
-            {
-              tmpFile.print("N//A");
-            }
-            else
-            {
-              // use computational formula for standard deviation
-              float variance = (dataStream[i].sumX2 - dataStream[i].sumX * dataStream[i].sumX / ((float)dataStream[i].n)) / ((float)dataStream[i].n - 1.);
-              if (variance < 0.)
-              {
-                WARN("negative variance!", variance)
-                WARN("negative variance variable ", i)
-                tmpFile.print("N//A");
-              }
-              else
-              {
-                tmpFile.print(sqrt(variance));
-              }
-            }
-          }
-        }
-
-        if (outputStatValue == 3 || outputStatValue == 5)
-        {
-          // print SAMPLE SIZE
-          tmpFile.print(separator);
-          if (headerFlag == 1)
-          {
-            tmpFile.print(dataStream[i].dataNickName); // include short variable name
-            tmpFile.print("_n");                       // include tag indicating type of output
-          }
-          else
-          {
-            tmpFile.print(dataStream[i].n);
-          }
-        }
-      }
-
-      if (dataStream[i].calcTrendline == 1)
-      {
-        // always print trendline slope and standard deviation if calculated ()
-
-        float Sxx = dataStream[i].sumX2 - (dataStream[i].sumX * dataStream[i].sumX) / ((float)dataStream[i].n);
-        float Sxt = dataStream[i].sumXT - (dataStream[i].sumX * dataStream[i].sumT) / ((float)dataStream[i].n);
-        float Stt = dataStream[i].sumT2 - (dataStream[i].sumT * dataStream[i].sumT) / ((float)dataStream[i].n);
-        float slope = Sxt / Stt; // slope from linear regression trendline
-
-        float SSE = Sxx - Sxt * Sxt / Stt;
-        //        float SSE = (dataStream[i].sumX2 - (dataStream[i].sumXT * dataStream[i].sumXT) / dataStream[i].sumT2);
-        float sigma2 = SSE / ((float)dataStream[i].n - 2.); // should check to make sure n > 2!
-        float stdErr = sqrt(sigma2 / Stt);
-
-        tmpFile.print(separator);
-        if (headerFlag == 1)
-        {
-          tmpFile.print(dataStream[i].dataNickName); // include short variable name
-          tmpFile.print("_dt");                      // include tag indicating derivative with respect to time
-          tmpFile.print(separator);
-          tmpFile.print(dataStream[i].dataNickName); // include short variable name
-          tmpFile.print("_re");                      // include tag indicating residual error
-          tmpFile.print(separator);
-          tmpFile.print(dataStream[i].dataNickName); // include short variable name
-          tmpFile.print("_er");                      // include tag indicating standard error on slope
-        }
-        else
-        {
-          tmpFile.print(slope);
-          tmpFile.print(separator);
-          tmpFile.print(sqrt(sigma2));
-          tmpFile.print(separator);
-          tmpFile.print(stdErr);
-        }
-      }
-    }
-
-    tmpFile.println();
-    tmpFile.close();
-  }
-  else
-  {
-    // if the file didn't open, print an error:
-    Serial.println("error opening data file");
-    return 0;
-  }
-
-  return 1;
-}
-#endif
-
-int resetSampleStats(sampleStats *dataStream, int nSamp)
-{
-
-  for (int i = 0; i < nSamp; i++)
-  {
-    dataStream[i].n = 0;
-    dataStream[i].sumX = 0.;
-    dataStream[i].sumX2 = 0.;
-    dataStream[i].sumT = 0.;
-    dataStream[i].sumT2 = 0.;
-    dataStream[i].sumXT = 0.;
-  }
-
-  return 1;
-}
-
-void updateSampleStats(sampleStats *dataStream, int nSamp)
-{
-  //  Serial.print("AverageData");
-  for (int i = 0; i < nSamp; i++)
-  {
-    //Serial.print(separator);
-    if (dataStream[i].n == 0)
-    {
-      dataStream[i].average = dataStream[i].currentVal;
-    }
-    else
-    {
-      dataStream[i].average = dataStream[i].sumX / ((float)dataStream[i].n);
-    }
-  }
-
-  //Serial.print("123456789012345"); // limit row header to 8-15 char
-  //Serial.print("StandardDev");
-  for (int i = 0; i < nSamp; i++)
-  {
-    //Serial.print(separator);
-    if (dataStream[i].n < 2 || dataStream[i].outputStats < 4)
-    {
-      dataStream[i].standardDeviation = 0.;
-    }
-    else
-    {
-      // use computational formula for standard deviation
-      float variance = (dataStream[i].sumX2 - dataStream[i].sumX * dataStream[i].sumX / ((float)dataStream[i].n)) / ((float)dataStream[i].n - 1.);
-      if (variance < 0.)
-      {
-        WARN("negative variance!", variance)
-        WARN("negative variance variable ", i)
-        //Serial.print("N/A");
-      }
-      else
-      {
-        dataStream[i].standardDeviation = sqrt(variance);
-      }
-      //      Serial.print(sqrt(variance));
-    }
-  }
-
-  return;
-}
+// code to test creation of a structure for storing sensor data
+// *******************************
+// move to sampleStats.h after building and testing
+// *******************************
+// structure used for storing data as it is collected and calculating statistics of the data
+// before output. in this structure, a SAMPLE of data is collected over a time interval,
+// with n (SAMPLE SIZE) data points collected at time increments (that are not necessarily equal)
+
+#ifdef ENABLE_DATA_CHUNKS
+// MAX_RAW_DATA used for storing array of raw data during collection
+//  set MAX_RAW_DATA to 1 to only store most recent value
+#define MAX_RAW_DATA 1000
+#endif
+
+// configure setting for labels (char arrays) for data streams
+#define DATA_NAME_MAX 50
+#define DATA_NAME_SHORT 10
+
+struct sampleStats
+{
+  /* data */
+  int n;            // count of number of data values in this sample
+  float currentVal; // most recent value entered into sample
+
+#ifdef ENABLE_DATA_CHUNKS
+  float rawData[MAX_RAW_DATA]; // optional use during development: array to store raw data
+#endif
+
+  // rawData[n-1] is the most recently collected data point
+  float sumX;                         // sum of all values entered into sample
+  float sumX2;                        // sum of all values squared (before adding to sum)
+  float sumXT;                        // sum of value multiplied by time for trendline
+  float sumT;                         // sum of time values for trendline
+  float sumT2;                        // sum of time squared for trendline
+  char dataName[DATA_NAME_MAX];       // name data stream name
+  char dataNickName[DATA_NAME_SHORT]; // short name of data stream
+  char dataUnits[DATA_NAME_MAX];      // string with units of measurement for data stream
+
+  float average;
+  float standardDeviation;
+
+  int baselineType; // enable calculating a baseline to subtract: 0 = none, 1 = input, 2 = calculate
+  float baseline;
+  float baselineSum;
+  float baselineSumX2;
+  int baselineCount;
+
+  int calcTrendline; // flag indicating calculation of a trendline
+
+  int eventIndex; // associated event to track thresholds (if used)
+
+  int rateGroup; // rate group that sets when the stream is output (0 = main group, see rateGroups.h)
+
+#ifdef ENABLE_CAPTURE
+  int captureIndex; // ring of its raw values in the capture arena (-1 = not captured, see eventCapture.h)
+#endif
+
+  int outputStats; // variable indicating what stats to output to spreadsheets
+  // -1 = no output (just a variable for internal calculations)
+  // 0  = only output current value (no statistics)
+  // 1  = only output average
+  // 2  = output average and current
+  // 3  = output average and sample size
+  // 4  = output average and standard deviation
+  // 5  = output all info (including current and sample size)
+
+  // lots more information to be added later
+  // * max value of data in sample
+  // * min value of data in sample
+  // * average of data in sample
+  // ....
+};
+
+#define MAX_SAMPLES 32 // room for the optional diagnostic streams (loop timing, profiler)
+int nSamples = 0;
+sampleStats data[MAX_SAMPLES];
+// data[2].currentVal; // contains current sensor value
+
+// functions that will manipulate information in sampleStats structure
+// will be moved to sampleStats.cpp later
+// may need to declare extern variables
+
+// addDataStream: creates a new data stream and returns the index of that dataStream in the sampleStat
+//        structure array
+int addDataStream(sampleStats *localData, int *numSamples, char *dataName, char *dataNickName, char *dataUnits, int outputType)
+//int addDataStream(char *dataName, char *dataNickName, char *dataUnits)
+{
+  int newSampleIndex = *numSamples;
+  if (newSampleIndex == MAX_SAMPLES)
+  {
+    WARN("too many data streams", newSampleIndex)
+    return -1; // return error code
+  }
+  //nSamples++;
+  *numSamples = *numSamples + 1;
+
+  // initialize key values in data structure
+  localData[newSampleIndex].n = 0;      // initialize the time sample
+  localData[newSampleIndex].sumX = 0.;  // initialize the sum of data
+  localData[newSampleIndex].sumX2 = 0.; // initialie the sum of the squared data
+  localData[newSampleIndex].sumT = 0.;
+  localData[newSampleIndex].sumXT = 0.;               // initialie the sum of the data multiplied by time for trendline
+  localData[newSampleIndex].sumT2 = 0.;               // initialie the sum of the squared time
+  localData[newSampleIndex].outputStats = outputType; // variable indicating what stats to output to spreadsheets
+                                                      // -1 = no output (just a variable for internal calculations)
+                                                      // 0  = only output current value (no statistics)
+                                                      // 1  = only output average
+                                                      // 2  = output average and current
+                                                      // 3  = output average and sample size
+                                                      // 4  = output average and standard deviation
+                                                      // 5  = output all info (including current and sample size)
+
+  localData[newSampleIndex].average = 0.;
+  localData[newSampleIndex].standardDeviation = 0.;
+
+  localData[newSampleIndex].baselineType = 0; // default to not subtracting off baseline
+  localData[newSampleIndex].baseline = 0.;
+  localData[newSampleIndex].baselineSum = 0.; // default to baseline = 0
+  localData[newSampleIndex].baselineCount = 0;
+  localData[newSampleIndex].baselineSumX2 = 0.;
+
+  localData[newSampleIndex].calcTrendline = 0; // default to not calculating trendline
+  localData[newSampleIndex].eventIndex = -1;   // set to -1 as default (no event tracker)
+  localData[newSampleIndex].rateGroup = 0;     // default to the main rate group
+#ifdef ENABLE_CAPTURE
+  localData[newSampleIndex].captureIndex = -1; // not captured unless added with addCaptureStream()
+#endif
+
+  // perform checks on string lengths
+  int nameLength = strlen(dataName);
+  if (nameLength > (DATA_NAME_MAX - 2))
+  {
+    MESSAGE("name", dataName)
+    WARN("Data name too long", nameLength)
+  }
+  else
+  {
+    strcpy(localData[newSampleIndex].dataName, dataName); // need to add check on length!
+  }
+
+  nameLength = strlen(dataNickName);
+  if (nameLength > (DATA_NAME_MAX - 2))
+  {
+    MESSAGE("name", dataNickName)
+    WARN("Data nickname too long", nameLength)
+  }
+  else
+  {
+    strcpy(localData[newSampleIndex].dataNickName, dataNickName); // need to add check on length!
+  }
+
+  nameLength = strlen(dataUnits);
+  if (nameLength > (DATA_NAME_MAX - 2))
+  {
+    MESSAGE("name", dataUnits)
+    WARN("data units name too long", nameLength)
+  }
+  else
+  {
+    strcpy(localData[newSampleIndex].dataUnits, dataUnits); // need to add check on length!
+  }
+
+  return newSampleIndex;
+}
+
+#ifdef ENABLE_CAPTURE
+// raw values of captured streams also go to their ring (eventCapture.h, included after this file)
+void captureDataSample(int k, float value, uint32_t micros);
+#endif
+
+int updateDataSample(sampleStats *dataStream, int index, float inputValue, float relTime = 0.)
+{
+  if (index < 0)
+  {
+    return -1; // data stream was not created (e.g. its sensor is disabled)
+  }
+  PROFILE_REGION(iProfUpdate)
+  // function for adding new data points to a sample
+  // subtract baseline
+  float value = inputValue - dataStream[index].baseline;
+
+  // this function assumes the new data is a floating point number
+  dataStream[index].currentVal = value;
+  dataStream[index].sumX += value;
+  dataStream[index].sumX2 += value * value;
+#ifdef ENABLE_CAPTURE
+  if (dataStream[index].captureIndex >= 0)
+  {
+    captureDataSample(dataStream[index].captureIndex, inputValue, (uint32_t)monoMicros());
+  }
+#endif
+#ifdef ENABLE_DATA_CHUNKS
+  if ((dataStream[index].n + 1) < MAX_RAW_DATA)
+  {
+    dataStream[index].rawData[dataStream[index].n] = value;
+  }
+  else
+  {
+    WARN("Max sample size exceeded ", dataStream[index].n)
+    return -1;
+  }
+#endif
+  if (dataStream[index].calcTrendline == 1)
+  {
+    dataStream[index].sumT += relTime;
+    dataStream[index].sumXT += value * relTime;
+    dataStream[index].sumT2 += relTime * relTime;
+  }
+
+  dataStream[index].n++; // increment the sample size for time
+
+  return 1;
+}
+
+int updateDataSampleBatch(sampleStats *dataStream, int index, float *inputValues, float *relTimes, int count)
+{
+  // add several data points (e.g. drained from a sensor FIFO) to a sample at once
+  // relTimes holds the time of each data point (only used for trendlines)
+  if (index < 0)
+  {
+    return -1; // data stream was not created (e.g. its sensor is disabled)
+  }
+#ifdef ENABLE_DATA_CHUNKS
+  // raw data is stored one point at a time
+  for (int k = 0; k < count; k++)
+  {
+    if (updateDataSample(dataStream, index, inputValues[k], relTimes[k]) == -1)
+    {
+      return -1;
+    }
+  }
+  return 1;
+#else
+  PROFILE_REGION(iProfUpdate)
+  if (count <= 0)
+  {
+    return 1;
+  }
+  float baseline = dataStream[index].baseline;
+  float sumX = 0.;
+  float sumX2 = 0.;
+  for (int k = 0; k < count; k++)
+  {
+    float value = inputValues[k] - baseline;
+    sumX += value;
+    sumX2 += value * value;
+  }
+  dataStream[index].sumX += sumX;
+  dataStream[index].sumX2 += sumX2;
+  dataStream[index].currentVal = inputValues[count - 1] - baseline;
+
+  if (dataStream[index].calcTrendline == 1)
+  {
+    for (int k = 0; k < count; k++)
+    {
+      float value = inputValues[k] - baseline;
+      dataStream[index].sumT += relTimes[k];
+      dataStream[index].sumXT += value * relTimes[k];
+      dataStream[index].sumT2 += relTimes[k] * relTimes[k];
+    }
+  }
+
+#ifdef ENABLE_CAPTURE
+  if (dataStream[index].captureIndex >= 0)
+  {
+    // the last value was read now, the others relTimes earlier
+    uint32_t now = (uint32_t)monoMicros();
+    for (int k = 0; k < count; k++)
+    {
+      captureDataSample(dataStream[index].captureIndex, inputValues[k], now - (uint32_t)((relTimes[count - 1] - relTimes[k]) * 1000000.));
+    }
+  }
+#endif
+
+  dataStream[index].n += count;
+  return 1;
+#endif
+}
+
+// print a table of the current statistics of all data streams (used for Serial and the log file)
+int printSampleStatTable(Print &out, sampleStats *dataStream, int nSamp, char *separator)
+{
+  // print header line
+  out.println();
+  out.print("---- Sample Data Summary for Device = ");
+  out.print(deviceName);
+  out.println(" ------------------------");
+  //char separator[]="\t";
+  // for tab separated formatted table, use row headings that are 9-15 characters long
+  out.print("DataNames");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    //out.print(", ");
+    out.print(dataStream[i].dataNickName);
+  }
+  out.println();
+  out.print("DataUnits");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    out.print(dataStream[i].dataUnits);
+  }
+  out.println();
+  out.print("CurrentData");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    out.print(dataStream[i].currentVal);
+  }
+  out.println();
+  out.print("AverageData");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    if (dataStream[i].n == 0)
+    {
+      out.print(dataStream[i].currentVal);
+    }
+    else
+    {
+      out.print(mathDivideN(dataStream[i].sumX, dataStream[i].n));
+    }
+  }
+  out.println();
+
+  //out.print("123456789012345"); // limit row header to 8-15 char
+  out.print("StandardDev");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    if (dataStream[i].n < 2 || dataStream[i].outputStats < 4)
+    {
+      out.print("N/A");
+    }
+    else
+    {
+      // use computational formula for standard deviation
+      float variance = mathDivideN(dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n), dataStream[i].n - 1);
+      if (variance < 0.)
+      {
+        WARN("negative variance!", variance)
+        WARN("negative variance variable ", i)
+        out.print("N/A");
+      }
+      else
+      {
+        out.print(mathSqrt(variance));
+      }
+      //      out.print(sqrt(variance));
+    }
+  }
+  out.println();
+
+  out.print("SampleSize");
+  for (int i = 0; i < nSamp; i++)
+  {
+    out.print(separator);
+    out.print(dataStream[i].n);
+  }
+  out.println();
+  return 1;
+}
+
+#ifdef ENABLE_SERIAL_TELEMETRY
+// the statistics go out as a telemetry frame (serialTelemetry.h, included after this file)
+int sendTelemetryStats(sampleStats *dataStream, int nSamp);
+#endif
+
+int printSampleStatTableToSerial(sampleStats *dataStream, int nSamp, char *separator)
+{
+  PROFILE_REGION(iProfSerial)
+#ifdef ENABLE_SERIAL_TELEMETRY
+  (void)separator; // frames are binary
+  return sendTelemetryStats(dataStream, nSamp);
+#else
+  return printSampleStatTable(Serial, dataStream, nSamp, separator);
+#endif
+}
+
+#ifdef USE_SD
+int printSampleStatTableToFile(char *fullFileName, sampleStats *dataStream, int nSamp, char *separator)
+{
+#ifdef ENABLE_OUTPUT_QUEUE
+  // format the table into the output queue; outputQueueService() writes it to the card
+  if (sdQueue.rollup)
+  {
+    return OUTPUT_ROLLED_UP; // the log table only mirrors Serial: skip it while the queue is backed up
+  }
+  printSampleStatTable(outputQueueStartRecord(&sdQueue, fullFileName, OUTPUT_PRIORITY_STATS), dataStream, nSamp, separator);
+  return outputQueueFinishRecord(&sdQueue);
+#else
+  PROFILE_REGION(iProfSDWrite)
+  // open file to log information
+  File tmpFile;
+  tmpFile = openLogFile(fullFileName);
+  // if the file opened okay, write to it:
+  if (tmpFile)
+  {
+    printSampleStatTable(tmpFile, dataStream, nSamp, separator);
+    closeLogFile(tmpFile, fullFileName);
+  }
+  else
+  {
+    // if the file didn't open, print an error:
+    Serial.println("error opening data file");
+    return 0;
+  }
+
+  return 1;
+#endif
+}
+#endif
+
+// print one row of the spreadsheet (or its header when headerFlag = 1)
+//  group = rate group of the streams to print (-1 = all streams)
+void printSampleStatSpreadsheetRow(Print &destination, sampleStats *dataStream, int nSamp, char *separator, int count, int headerFlag, int group = -1)
+{
+#ifdef ENABLE_GROUP_COMMIT
+  crcLinePrint out(destination, headerFlag); // ends the row with its CRC
+#else
+  Print &out = destination;
+#endif
+  // for first column, print Device code
+  out.print(deviceCode);
+
+  // for second column, print count tracking number of lines
+  out.print(separator);
+  out.print(count);
+
+#ifdef ENABLE_ABSOLUTE_TIME
+  // for third column, print the absolute time of the row
+  out.print(separator);
+  if (headerFlag == 1)
+  {
+    out.print("unixTime");
+  }
+  else
+  {
+    printAbsoluteTime(out, &clockBase, monoMicros());
+  }
+#endif
+
+  //char separator[]="\t";
+  // for tab separated formatted table, use row headings that are 9-15 characters long
+  //out.print("DataNames");
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    int outputStatValue = dataStream[i].outputStats; // variable indicating what stats to output to spreadsheets
+    // -1 = no output (just a variable for internal calculations)
+    // 0  = only output current value (no statistics)
+    // 1  = only output average
+    // 2  = output average and current
+    // 3  = output average and sample size
+    // 4  = output average and standard deviation
+    // 5  = output all info (including current and sample size)
+
+    if (outputStatValue != -1)
+    {
+
+      if (outputStatValue == 0 || outputStatValue == 2 || outputStatValue == 5)
+      {
+        // print CURRENT value
+        out.print(separator);
+        if (headerFlag == 1)
+        {
+          out.print(dataStream[i].dataNickName); // include short variable name
+          out.print("_cv");                      // include tag indicating type of output
+        }
+        else
+        {
+          out.print(dataStream[i].currentVal);
+        }
+      }
+
+      if (outputStatValue > 0)
+      {
+        // print AVERAGE value
+        out.print(separator);
+        if (headerFlag == 1)
+        {
+          out.print(dataStream[i].dataNickName); // include short variable name
+          out.print("_av");                      // include tag indicating type of output
+        }
+        else
+        {
+          if (dataStream[i].n == 0)
+          {
+            out.print(dataStream[i].currentVal);
+          }
+          else
+          {
+            out.print(mathDivideN(dataStream[i].sumX, dataStream[i].n));
+          }
+        }
+      }
+
+      if (outputStatValue > 3)
+      {
+        // print STANDARD DEVIATION value
+        out.print(separator);
+        if (headerFlag == 1)
+        {
+          out.print(dataStream[i].dataNickName); // include short variable name
+          out.print("_sd");                      // include tag indicating type of output
+        }
+        else
+        {
+          if (dataStream[i].n < 2)
+          {
+            out.print("N//A");
+          }
+          else
+          {
+            // use computational formula for standard deviation
+            float variance = mathDivideN(dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n), dataStream[i].n - 1);
+            if (variance < 0.)
+            {
+              WARN("negative variance!", variance)
+              WARN("negative variance variable ", i)
+              out.print("N//A");
+            }
+            else
+            {
+              out.print(mathSqrt(variance));
+            }
+          }
+        }
+      }
+
+      if (outputStatValue == 3 || outputStatValue == 5)
+      {
+        // print SAMPLE SIZE
+        out.print(separator);
+        if (headerFlag == 1)
+        {
+          out.print(dataStream[i].dataNickName); // include short variable name
+          out.print("_n");                       // include tag indicating type of output
+        }
+        else
+        {
+          out.print(dataStream[i].n);
+        }
+      }
+    }
+
+    if (dataStream[i].calcTrendline == 1)
+    {
+      // always print trendline slope and standard deviation if calculated ()
+
+      float Sxx = dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n);
+      float Sxt = dataStream[i].sumXT - mathDivideN(dataStream[i].sumX * dataStream[i].sumT, dataStream[i].n);
+      float Stt = dataStream[i].sumT2 - mathDivideN(dataStream[i].sumT * dataStream[i].sumT, dataStream[i].n);
+      float slope = Sxt / Stt; // slope from linear regression trendline
+
+      float SSE = Sxx - Sxt * Sxt / Stt;
+      //        float SSE = (dataStream[i].sumX2 - (dataStream[i].sumXT * dataStream[i].sumXT) / dataStream[i].sumT2);
+      // the residual error needs more samples than the two parameters of the line
+      float residualError = NAN;
+      float stdErr = NAN;
+      if (dataStream[i].n > 2)
+      {
+        float sigma2 = mathDivideN(SSE, dataStream[i].n - 2);
+        residualError = mathSqrt(sigma2);
+        stdErr = mathSqrtOfRatio(sigma2, Stt);
+      }
+
+      out.print(separator);
+      if (headerFlag == 1)
+      {
+        out.print(dataStream[i].dataNickName); // include short variable name
+        out.print("_dt");                      // include tag indicating derivative with respect to time
+        out.print(separator);
+        out.print(dataStream[i].dataNickName); // include short variable name
+        out.print("_re");                      // include tag indicating residual error
+        out.print(separator);
+        out.print(dataStream[i].dataNickName); // include short variable name
+        out.print("_er");                      // include tag indicating standard error on slope
+      }
+      else
+      {
+        out.print(slope);
+        out.print(separator);
+        out.print(residualError);
+        out.print(separator);
+        out.print(stdErr);
+      }
+    }
+  }
+
+  out.println();
+}
+
+#ifdef ENABLE_COMPRESSED_DATA
+// encode one row of the spreadsheet with the file's codec (see dataCompress.h): the same columns as
+// printSampleStatSpreadsheetRow(), as binary values against the previous row
+int printSampleStatCompressedRow(Print &out, dataCodec *codec, sampleStats *dataStream, int nSamp, int count, int group = -1)
+{
+  uint32_t startTicks = profileTicks();
+  dataCodecBeginRow(codec);
+  dataCodecPutInt(codec, count);
+#ifdef ENABLE_ABSOLUTE_TIME
+  dataCodecPutTime(codec, absoluteMicros(&clockBase, monoMicros()) / 1000ULL);
+#endif
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    int outputStatValue = dataStream[i].outputStats;
+    if (outputStatValue != -1)
+    {
+      if (outputStatValue == 0 || outputStatValue == 2 || outputStatValue == 5)
+      {
+        dataCodecPutFloat(codec, dataStream[i].currentVal);
+      }
+      if (outputStatValue > 0)
+      {
+        if (dataStream[i].n == 0)
+        {
+          dataCodecPutFloat(codec, dataStream[i].currentVal);
+        }
+        else
+        {
+          dataCodecPutFloat(codec, mathDivideN(dataStream[i].sumX, dataStream[i].n));
+        }
+      }
+      if (outputStatValue > 3)
+      {
+        // NAN where the text row has N//A
+        float standardDeviation = NAN;
+        if (dataStream[i].n >= 2)
+        {
+          float variance = mathDivideN(dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n), dataStream[i].n - 1);
+          if (variance >= 0.)
+          {
+            standardDeviation = mathSqrt(variance);
+          }
+        }
+        dataCodecPutFloat(codec, standardDeviation);
+      }
+      if (outputStatValue == 3 || outputStatValue == 5)
+      {
+        dataCodecPutInt(codec, dataStream[i].n);
+      }
+    }
+
+    if (dataStream[i].calcTrendline == 1)
+    {
+      float Sxx = dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n);
+      float Sxt = dataStream[i].sumXT - mathDivideN(dataStream[i].sumX * dataStream[i].sumT, dataStream[i].n);
+      float Stt = dataStream[i].sumT2 - mathDivideN(dataStream[i].sumT * dataStream[i].sumT, dataStream[i].n);
+      float slope = Sxt / Stt;
+      float SSE = Sxx - Sxt * Sxt / Stt;
+      float residualError = NAN; // as in the text row: needs more than two samples
+      float stdErr = NAN;
+      if (dataStream[i].n > 2)
+      {
+        float sigma2 = mathDivideN(SSE, dataStream[i].n - 2);
+        residualError = mathSqrt(sigma2);
+        stdErr = mathSqrtOfRatio(sigma2, Stt);
+      }
+      dataCodecPutFloat(codec, slope);
+      dataCodecPutFloat(codec, residualError);
+      dataCodecPutFloat(codec, stdErr);
+    }
+  }
+  dataCodecMicros += ((float)(profileTicks() - startTicks)) / profileTicksPerMicro();
+  return dataCodecFinishRow(codec, out);
+}
+#endif
+
+// format one record of a data file: a text row, or with ENABLE_COMPRESSED_DATA a compressed row
+// (the header stays text, after the line describing the codec)
+void printSampleStatRecord(Print &out, char *fullFileName, sampleStats *dataStream, int nSamp, char *separator, int count, int headerFlag, int group = -1)
+{
+#ifdef ENABLE_COMPRESSED_DATA
+  dataCodec *codec = findDataCodec(fullFileName, headerFlag == 1);
+  if (codec && headerFlag == 1)
+  {
+    printDataCodecHeader(out, codec);
+  }
+  else if (codec)
+  {
+    printSampleStatCompressedRow(out, codec, dataStream, nSamp, count, group);
+    return;
+  }
+#else
+  (void)fullFileName; // every record is a text row
+#endif
+  printSampleStatSpreadsheetRow(out, dataStream, nSamp, separator, count, headerFlag, group);
+}
+
+#ifdef USE_SD
+int printSampleStatSpreadsheetToFile(char *fullFileName, sampleStats *dataStream, int nSamp, char *separator, int count, int headerFlag, int group = -1)
+{
+  // group = rate group of the streams to print (-1 = all streams)
+#ifdef ENABLE_OUTPUT_QUEUE
+  // format the row into the output queue; outputQueueService() writes it to the card
+  if (headerFlag == 0 && sdQueue.rollup)
+  {
+    return OUTPUT_ROLLED_UP; // the queue is too full for stats rows: the caller keeps accumulating the sample
+  }
+  PROFILE_REGION(iProfFormat)
+  if (headerFlag == 0)
+  {
+    timeIndexRowMade(fullFileName, count); // the entry gets its offset when the row is written
+  }
+  printSampleStatRecord(outputQueueStartRecord(&sdQueue, fullFileName, headerFlag == 1 ? OUTPUT_PRIORITY_HEADER : OUTPUT_PRIORITY_STATS),
+                        fullFileName, dataStream, nSamp, separator, count, headerFlag, group);
+  return outputQueueFinishRecord(&sdQueue);
+#else
+  // open file to log information
+  File tmpFile;
+  PROFILE_REGION_NAMED(openTimer, iProfSDWrite)
+  tmpFile = openLogFile(fullFileName);
+  PROFILE_STOP(openTimer)
+  // if the file opened okay, write to it:
+  if (tmpFile)
+  {
+    PROFILE_REGION_NAMED(formatTimer, iProfFormat)
+#ifdef ENABLE_TIME_INDEX
+    unsigned long offset = logFileEnd(tmpFile, fullFileName);
+#endif
+    printSampleStatRecord(tmpFile, fullFileName, dataStream, nSamp, separator, count, headerFlag, group);
+    PROFILE_STOP(formatTimer)
+#ifdef ENABLE_TIME_INDEX
+    if (headerFlag == 0)
+    {
+      timeIndexRowMade(fullFileName, count);
+      timeIndexRowWritten(fullFileName, count, offset);
+    }
+#endif
+    PROFILE_REGION(iProfSDWrite) // closing the file flushes the row to the card
+    closeLogFile(tmpFile, fullFileName);
+  }
+  else
+  {
+    // if the file didn't open, print an error:
+    Serial.println("error opening data file");
+    return 0;
+  }
+
+  return 1;
+#endif
+}
+#endif
+
+int resetSampleStats(sampleStats *dataStream, int nSamp, int group = -1)
+{
+  // group = rate group of the streams to reset (-1 = all streams)
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    dataStream[i].n = 0;
+    dataStream[i].sumX = 0.;
+    dataStream[i].sumX2 = 0.;
+    dataStream[i].sumT = 0.;
+    dataStream[i].sumT2 = 0.;
+    dataStream[i].sumXT = 0.;
+  }
+
+  return 1;
+}
+
+// add the averages of the current sample into the baseline of each stream
+//  group = rate group of the streams to add (-1 = all streams)
+void addSamplesToBaseline(sampleStats *dataStream, int nSamp, int group = -1)
+{
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    if (dataStream[i].n > 0) // only add info into baseline if sample size is 1 or more
+    {
+      dataStream[i].baselineCount++;
+      dataStream[i].baselineSum += dataStream[i].average;
+      dataStream[i].baselineSumX2 += dataStream[i].average * dataStream[i].average;
+    }
+  }
+}
+
+#ifdef ENABLE_PROFILER
+// print the cost of each profiled region during the current sample: number of times the region
+// ran, average and standard deviation of its duration, and total time as a percent of the interval
+void printProfileReport(Print &out, sampleStats *dataStream, unsigned long intervalMillis)
+{
+  int regions[] = {iProfSensor, iProfUpdate, iProfEvents, iProfFormat, iProfSDWrite, iProfSerial};
+  int nRegions = sizeof(regions) / sizeof(regions[0]);
+
+  out.println("PROFILE: region\tn\tavg us\tsd us\ttotal us\tpercent");
+  for (int k = 0; k < nRegions; k++)
+  {
+    int i = regions[k];
+    if (i == -1)
+    {
+      continue;
+    }
+    float average = 0.;
+    float standardDeviation = 0.;
+    if (dataStream[i].n > 0)
+    {
+      average = mathDivideN(dataStream[i].sumX, dataStream[i].n);
+    }
+    if (dataStream[i].n > 1)
+    {
+      float variance = mathDivideN(dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n), dataStream[i].n - 1);
+      if (variance > 0.)
+      {
+        standardDeviation = mathSqrt(variance);
+      }
+    }
+    out.print("PROFILE: ");
+    out.print(dataStream[i].dataNickName);
+    out.print("\t");
+    out.print(dataStream[i].n);
+    out.print("\t");
+    out.print(average);
+    out.print("\t");
+    out.print(standardDeviation);
+    out.print("\t");
+    out.print(dataStream[i].sumX);
+    out.print("\t");
+    out.println(intervalMillis > 0 ? dataStream[i].sumX / (10. * (float)intervalMillis) : 0.);
+  }
+}
+#endif
+
+#ifdef ENABLE_DERIVED_STREAMS
+// derived streams are computed from the other streams (derivedStreams.h, included after this file)
+void evaluateDerivedStreams(sampleStats *dataStream, int nSamp, int group);
+#endif
+
+void updateSampleStats(sampleStats *dataStream, int nSamp, int group = -1)
+{
+  // group = rate group of the streams to update (-1 = all streams)
+#ifdef ENABLE_DERIVED_STREAMS
+  evaluateDerivedStreams(dataStream, nSamp, group);
+#endif
+  //  Serial.print("AverageData");
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    //Serial.print(separator);
+    if (dataStream[i].n == 0)
+    {
+      dataStream[i].average = dataStream[i].currentVal;
+    }
+    else
+    {
+      dataStream[i].average = mathDivideN(dataStream[i].sumX, dataStream[i].n);
+    }
+  }
+
+  //Serial.print("123456789012345"); // limit row header to 8-15 char
+  //Serial.print("StandardDev");
+  for (int i = 0; i < nSamp; i++)
+  {
+    if (group != -1 && dataStream[i].rateGroup != group)
+    {
+      continue;
+    }
+    //Serial.print(separator);
+    if (dataStream[i].n < 2 || dataStream[i].outputStats < 4)
+    {
+      dataStream[i].standardDeviation = 0.;
+    }
+    else
+    {
+      // use computational formula for standard deviation
+      float variance = mathDivideN(dataStream[i].sumX2 - mathDivideN(dataStream[i].sumX * dataStream[i].sumX, dataStream[i].n), dataStream[i].n - 1);
+      if (variance < 0.)
+      {
+        WARN("negative variance!", variance)
+        WARN("negative variance variable ", i)
+        //Serial.print("N/A");
+      }
+      else
+      {
+        dataStream[i].standardDeviation = mathSqrt(variance);
+      }
+      //      Serial.print(sqrt(variance));
+    }
+  }
+
+  return;
+}
@@ -1,3 +1,3 @@
-// include user-specific information in this file that may not be
-// shared freely with other people working on this project 
+// include user-specific information in this file that may not be
+// shared freely with other people working on this project 
 //  e.g. usernames, WiFi router names and passwords, security keys, etc.
\ No newline at end of file
@@ -0,0 +1,400 @@
+// serialTelemetry.h
+// binary framed telemetry on Serial in place of the text tables and event reports
+//  the text table repeats the names and units of every stream and prints each value as text, and
+//  Serial.write blocks once the UART's TX buffer is full, so at 115200 baud the serial output can
+//  take longer than a sample. here each message is a small binary frame that goes into a RAM ring,
+//  and serviceTelemetry() moves only as many bytes to Serial as availableForWrite() says will not
+//  block. when the ring is full a frame is dropped (and counted) rather than waiting
+//
+//  frames: 0x00, COBS(payload + CRC-16 of the payload), 0x00 -- the zero bytes only appear as
+//  delimiters, so a reader that starts in the middle (or sees text from DEBUG messages between
+//  frames) finds the next frame at the next zero. payloads start with a type byte; integers are
+//  little endian, floats are IEEE single precision, strings are a length byte then the characters
+//    'D' device schema      schemaId u16, streams u8, events u8, deviceCode str, deviceName str
+//    's' stream schema      index u8, nickname str, units str, name str
+//    'e' event schema       index u8, nickname str, name str, states u8, state names str...
+//    'T' statistics         schemaId u16, millis u32, streams u8, then for each stream
+//                           current f32, average f32, standard deviation f32 (NaN = N/A), n u32
+//    'E' event              index u8, timeLastChange u32, prior state u8, state u8, duration u32
+//    'G' diagnostics        millis u32, bytes u32, frames u32, dropped u32, ring high u16,
+//                           us in Serial.write u32, ms of serial output u32, ms of data file output u32
+//  the schema (names, units, state names) is only sent after setup() and when the host asks for it
+//  with an 'R' frame (same framing) on Serial; statistics carry the schemaId (CRC-16 of the schema)
+//  so the host can tell that its copy is stale. host/telemetryView prints the same tables as the
+//  text output from a serial device or a capture of one
+//
+//  DEBUG and MESSAGE text written while a frame is half sent lands inside the frame and the frame
+//  is lost (its CRC fails), so keep the debug messages off in quickDebugMessages.h or defer them with
+//  ENABLE_DEFERRED_DEBUG (debugLog.h writes them only between frames)
+//
+//  enable with ENABLE_SERIAL_TELEMETRY in the deviceConfig file
+
+#ifdef ENABLE_SERIAL_TELEMETRY
+
+#define TELEMETRY_RING_BYTES 1024   // frames waiting for Serial
+#define TELEMETRY_PAYLOAD_BYTES 600 // longest payload (statistics of MAX_SAMPLES streams)
+#define TELEMETRY_REQUEST_BYTES 16  // longest frame read from the host
+
+// the payload being built (messages are built one at a time)
+uint8_t telemetryPayload[TELEMETRY_PAYLOAD_BYTES + 2];
+int telemetryPayloadBytes = 0;
+
+uint8_t telemetryRing[TELEMETRY_RING_BYTES];
+int telemetryHead = 0; // next byte to send
+int telemetryUsed = 0; // bytes waiting
+
+uint8_t telemetryRequest[TELEMETRY_REQUEST_BYTES];
+int telemetryRequestBytes = 0;
+
+uint16_t telemetrySchemaId = 0;
+int telemetrySchemaNext = -1; // next part of the schema to send (-1 = none), see serviceTelemetry()
+
+// counters for the diagnostics frame
+unsigned long telemetryBytes = 0;   // bytes handed to Serial
+unsigned long telemetryFrames = 0;  // frames queued
+unsigned long telemetryDropped = 0; // frames dropped because the ring was full
+int telemetryHigh = 0;              // most bytes waiting in the ring
+unsigned long telemetryWriteMicros = 0; // time spent in Serial.write
+unsigned long telemetryDataFileMillis = 0; // time taken by the last data file output (set by loop())
+
+void telemetryBegin(uint8_t type)
+{
+  telemetryPayloadBytes = 0;
+  telemetryPayload[telemetryPayloadBytes++] = type;
+}
+
+void telemetryPutBytes(const void *bytes, int length)
+{
+  if (telemetryPayloadBytes + length > TELEMETRY_PAYLOAD_BYTES)
+  {
+    telemetryPayloadBytes = TELEMETRY_PAYLOAD_BYTES + 1; // marks the payload as too long
+    return;
+  }
+  memcpy(telemetryPayload + telemetryPayloadBytes, bytes, length);
+  telemetryPayloadBytes += length;
+}
+
+void telemetryPutU8(uint8_t value)
+{
+  telemetryPutBytes(&value, 1);
+}
+
+void telemetryPutU16(uint16_t value)
+{
+  uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+  telemetryPutBytes(bytes, 2);
+}
+
+void telemetryPutU32(uint32_t value)
+{
+  uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  telemetryPutBytes(bytes, 4);
+}
+
+void telemetryPutFloat(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  telemetryPutU32(bits);
+}
+
+void telemetryPutString(const char *text)
+{
+  int length = strlen(text);
+  if (length > 255)
+  {
+    length = 255;
+  }
+  telemetryPutU8((uint8_t)length);
+  telemetryPutBytes(text, length);
+}
+
+void telemetryRingPut(uint8_t value)
+{
+  telemetryRing[(telemetryHead + telemetryUsed) % TELEMETRY_RING_BYTES] = value;
+  telemetryUsed++;
+}
+
+// COBS-encode the payload (with its CRC) into the ring; returns 1, or 0 if the frame was dropped
+int telemetryFinish()
+{
+  if (telemetryPayloadBytes > TELEMETRY_PAYLOAD_BYTES)
+  {
+    WARN("telemetry payload too long", telemetryPayloadBytes)
+    telemetryDropped++;
+    return 0;
+  }
+  uint16_t crc = 0xFFFF;
+  for (int k = 0; k < telemetryPayloadBytes; k++)
+  {
+    crc = crc16Update(crc, telemetryPayload[k]);
+  }
+  int length = telemetryPayloadBytes;
+  telemetryPayload[length++] = (uint8_t)(crc >> 8);
+  telemetryPayload[length++] = (uint8_t)(crc & 0xFF);
+  // COBS adds a byte per 254, plus the two delimiters
+  int frameBytes = length + length / 254 + 1 + 2;
+  if (telemetryUsed + frameBytes > TELEMETRY_RING_BYTES)
+  {
+    telemetryDropped++;
+    return 0;
+  }
+  telemetryRingPut(0);
+  int k = 0;
+  while (k <= length)
+  {
+    // a block: its length code, then up to 253 non-zero bytes
+    int run = 0;
+    while (k + run < length && telemetryPayload[k + run] != 0 && run < 254)
+    {
+      run++;
+    }
+    telemetryRingPut((uint8_t)(run + 1));
+    for (int j = 0; j < run; j++)
+    {
+      telemetryRingPut(telemetryPayload[k + j]);
+    }
+    k += run;
+    if (run == 254)
+    {
+      if (k == length)
+      {
+        break; // the last block was full: no implied zero after it
+      }
+      continue;
+    }
+    k++; // skip the zero that ended the block (or step past the end)
+  }
+  telemetryRingPut(0);
+  if (telemetryUsed > telemetryHigh)
+  {
+    telemetryHigh = telemetryUsed;
+  }
+  telemetryFrames++;
+  return 1;
+}
+
+// CRC-16 of the names, units and state names (changes whenever the schema does)
+uint16_t telemetryComputeSchemaId(sampleStats *dataStream, int nSamp, eventTracker *localEvents, int nEventsLocal)
+{
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < nSamp; i++)
+  {
+    for (const char *c = dataStream[i].dataNickName; *c; c++)
+      crc = crc16Update(crc, *c);
+    for (const char *c = dataStream[i].dataUnits; *c; c++)
+      crc = crc16Update(crc, *c);
+    crc = crc16Update(crc, 0);
+  }
+  for (int j = 0; j < nEventsLocal; j++)
+  {
+    for (const char *c = localEvents[j].eventName; *c; c++)
+      crc = crc16Update(crc, *c);
+    crc = crc16Update(crc, (uint8_t)localEvents[j].numStates);
+  }
+  return crc;
+}
+
+// start (or restart) sending the schema; serviceTelemetry() sends it a part at a time
+void requestTelemetrySchema()
+{
+  telemetrySchemaId = telemetryComputeSchemaId(data, nSamples, events, nEvents);
+  telemetrySchemaNext = 0;
+}
+
+// queue the next part of the schema: part 0 is the device, then one per stream, then one per event
+// returns 1 if it was queued (or there is nothing to send), 0 if the ring had no room
+int sendTelemetrySchemaPart()
+{
+  int part = telemetrySchemaNext;
+  if (part < 0)
+  {
+    return 1;
+  }
+  if (part == 0)
+  {
+    telemetryBegin('D');
+    telemetryPutU16(telemetrySchemaId);
+    telemetryPutU8((uint8_t)nSamples);
+    telemetryPutU8((uint8_t)nEvents);
+    telemetryPutString(deviceCode);
+    telemetryPutString(deviceName);
+  }
+  else if (part <= nSamples)
+  {
+    int i = part - 1;
+    telemetryBegin('s');
+    telemetryPutU8((uint8_t)i);
+    telemetryPutString(data[i].dataNickName);
+    telemetryPutString(data[i].dataUnits);
+    telemetryPutString(data[i].dataName);
+  }
+  else
+  {
+    int j = part - 1 - nSamples;
+    telemetryBegin('e');
+    telemetryPutU8((uint8_t)j);
+    telemetryPutString(events[j].eventNickName);
+    telemetryPutString(events[j].eventName);
+    telemetryPutU8((uint8_t)events[j].numStates);
+    for (int k = 0; k < events[j].numStates; k++)
+    {
+      telemetryPutString(events[j].eventStateName[k]);
+    }
+  }
+  if (!telemetryFinish())
+  {
+    telemetryDropped--; // not lost: sent again on the next call
+    return 0;
+  }
+  telemetrySchemaNext = (part + 1 > nSamples + nEvents) ? -1 : part + 1;
+  return 1;
+}
+
+// statistics of all streams (the numbers of printSampleStatTable); returns 1 if queued, 0 if dropped
+int sendTelemetryStats(sampleStats *dataStream, int nSamp)
+{
+  telemetryBegin('T');
+  telemetryPutU16(telemetrySchemaId);
+  telemetryPutU32((uint32_t)millis());
+  telemetryPutU8((uint8_t)nSamp);
+  for (int i = 0; i < nSamp; i++)
+  {
+    float n = (float)dataStream[i].n;
+    float average = dataStream[i].n == 0 ? dataStream[i].currentVal : dataStream[i].sumX / n;
+    float standardDeviation = NAN;
+    if (dataStream[i].n >= 2 && dataStream[i].outputStats >= 4)
+    {
+      float variance = (dataStream[i].sumX2 - dataStream[i].sumX * dataStream[i].sumX / n) / (n - 1.);
+      if (variance >= 0.)
+      {
+        standardDeviation = mathSqrt(variance);
+      }
+    }
+    telemetryPutFloat(dataStream[i].currentVal);
+    telemetryPutFloat(average);
+    telemetryPutFloat(standardDeviation);
+    telemetryPutU32((uint32_t)dataStream[i].n);
+  }
+  return telemetryFinish();
+}
+
+int sendTelemetryEvent(eventTracker *localEvents, int jEvent)
+{
+  telemetryBegin('E');
+  telemetryPutU8((uint8_t)jEvent);
+  telemetryPutU32((uint32_t)localEvents[jEvent].timeLastChange);
+  telemetryPutU8((uint8_t)localEvents[jEvent].priorState);
+  telemetryPutU8((uint8_t)localEvents[jEvent].state);
+  telemetryPutU32((uint32_t)localEvents[jEvent].stateDuration);
+  return telemetryFinish();
+}
+
+// telemetry counters, with the time taken by the serial output and the last data file output (ms)
+int sendTelemetryDiagnostics(unsigned long serialOutputMillis)
+{
+  telemetryBegin('G');
+  telemetryPutU32((uint32_t)millis());
+  telemetryPutU32((uint32_t)telemetryBytes);
+  telemetryPutU32((uint32_t)telemetryFrames);
+  telemetryPutU32((uint32_t)telemetryDropped);
+  telemetryPutU16((uint16_t)telemetryHigh);
+  telemetryPutU32((uint32_t)telemetryWriteMicros);
+  telemetryPutU32((uint32_t)serialOutputMillis);
+  telemetryPutU32((uint32_t)telemetryDataFileMillis);
+  return telemetryFinish();
+}
+
+// decode a COBS frame (without its delimiters) in place; returns the payload length without the
+// CRC, or -1 if the frame is damaged
+int telemetryDecodeFrame(uint8_t *frame, int length)
+{
+  int out = 0;
+  int k = 0;
+  while (k < length)
+  {
+    int code = frame[k++];
+    if (code == 0 || k + code - 1 > length)
+    {
+      return -1;
+    }
+    for (int j = 1; j < code; j++)
+    {
+      frame[out++] = frame[k++];
+    }
+    if (code < 255 && k < length)
+    {
+      frame[out++] = 0;
+    }
+  }
+  if (out < 3)
+  {
+    return -1;
+  }
+  uint16_t crc = 0xFFFF;
+  for (int j = 0; j < out - 2; j++)
+  {
+    crc = crc16Update(crc, frame[j]);
+  }
+  if (frame[out - 2] != (uint8_t)(crc >> 8) || frame[out - 1] != (uint8_t)(crc & 0xFF))
+  {
+    return -1;
+  }
+  return out - 2;
+}
+
+// called every pass through loop(): reads requests from the host, queues the next part of the
+// schema and writes what Serial can take without blocking
+void serviceTelemetry()
+{
+  PROFILE_REGION(iProfSerial)
+  while (Serial.available() > 0)
+  {
+    int c = Serial.read();
+    if (c < 0)
+    {
+      break;
+    }
+    if (c != 0)
+    {
+      if (telemetryRequestBytes < TELEMETRY_REQUEST_BYTES)
+      {
+        telemetryRequest[telemetryRequestBytes] = (uint8_t)c;
+      }
+      telemetryRequestBytes++;
+      continue;
+    }
+    if (telemetryRequestBytes > 0 && telemetryRequestBytes <= TELEMETRY_REQUEST_BYTES)
+    {
+      int length = telemetryDecodeFrame(telemetryRequest, telemetryRequestBytes);
+      if (length >= 1 && telemetryRequest[0] == 'R')
+      {
+        requestTelemetrySchema();
+      }
+    }
+    telemetryRequestBytes = 0;
+  }
+
+  while (telemetrySchemaNext >= 0 && sendTelemetrySchemaPart())
+    ;
+
+  int room = Serial.availableForWrite();
+  while (telemetryUsed > 0 && room > 0)
+  {
+    // the ring may wrap: write the contiguous part first
+    int chunk = TELEMETRY_RING_BYTES - telemetryHead;
+    if (chunk > telemetryUsed)
+      chunk = telemetryUsed;
+    if (chunk > room)
+      chunk = room;
+    unsigned long startMicros = micros();
+    Serial.write(telemetryRing + telemetryHead, chunk);
+    telemetryWriteMicros += micros() - startMicros;
+    telemetryHead = (telemetryHead + chunk) % TELEMETRY_RING_BYTES;
+    telemetryUsed -= chunk;
+    telemetryBytes += chunk;
+    room -= chunk;
+  }
+}
+
+#endif
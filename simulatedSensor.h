@@ -1,34 +1,469 @@
-// *******************************
-// simulatedSensor.h 
-// *******************************
-float simulatedSensor(float intercept, float slope, float range)
-{
-  // function that simulates a sensor that creates random sensor readings
-  // that increase linearly with time, but vary randomly (according to uniform
-  // distribution within range)
-
-  float time = ((float)millis()) / 1000.;                      // time in seconds since program started
-  float randomness = ((float)random(0, 2001) - 1000.) / 1000.; // create a random float between -1. and 1.
-
-  float output = intercept + slope * time + randomness * range;
-  //DEBUG(output)
-  return (output);
-}
-
-float simulatedSensorSine(float intercept, float slope, float range, float amplitude, float period)
-{
-  // function that simulates a sensor that creates random sensor readings
-  // that increase linearly with time, but vary randomly (according to uniform
-  // distribution within range)
-  // intercept and slope define the baseline signal as a linear function baseline(t) = intercept + slope * time(in s)
-  // range defines the magnitude of random error: currently a uniform random error +- that adjusts the calculated value
-  // amplitude an period define a sinusoidal signal that is added to the baseline
-
-  float time = ((float)millis()) / 1000.;                      // time in seconds since program started
-  float randomness = ((float)random(0, 2001) - 1000.) / 1000.; // create a random float between -1. and 1.
-  float sine = amplitude * sin(2 * PI * time / period);        // sinusoidal function
-
-  float output = intercept + slope * time + randomness * range + sine;
-  //DEBUG(output)
-  return (output);
-}
\ No newline at end of file
+// *******************************
+// simulatedSensor.h
+// *******************************
+// simulated sensors for testing the analytics without hardware
+//  a simulated signal is the sum of up to SIM_MAX_COMPONENTS components:
+//    waveforms    SIM_CONSTANT (a), SIM_RAMP (a per s), SIM_SINE, SIM_SQUARE, SIM_TRIANGLE
+//                 (amplitude a, period b in s, phase c in s)
+//    noise        SIM_UNIFORM (+- a), SIM_GAUSSIAN (standard deviation a),
+//                 SIM_DRIFT (random walk, a per square root of s)
+//    events       SIM_SPIKES (a per s on average, one sample of +- b),
+//                 SIM_STEPS (a per s on average, the level moves by +- b and stays there)
+//    replay       SIM_REPLAY (a column of a data file on the SD card, times a, see addSimTrace)
+//  each signal has its own random number generator, seeded from simulationSeed and the signal's
+//  index, so the same seed gives the same data whatever else calls random(). time is the
+//  monotonic microsecond clock (timeBase.h) from simulationBegin(), so signals are smooth at any
+//  sample rate; on the host the clock is virtual and hours of data take seconds
+//
+//  define the signals in setup() after simulationBegin():
+//    int s = addSimSignal(iSimX);              // data stream the signal is written to
+//    addSimComponent(s, SIM_RAMP, 5., 0., 0.);
+//    addSimComponent(s, SIM_GAUSSIAN, 0.5, 0., 0.);
+//  and update them in loop() with updateSimulatedStreams()
+//
+//  replay: addSimTrace() reads the rows of a data file written by this logger (the header row
+//  names the columns, e.g. "Ax_av") and interpolates between them using SIM_TRACE_TIME_COLUMN,
+//  starting over at the end of the file. compressed data files cannot be replayed
+//
+//  enable with ENABLE_SIMULATED_DATA (and SIMULATION_SEED, SIM_TRACE_COLUMN) in the deviceConfig file
+
+#ifndef SIMULATION_SEED
+#define SIMULATION_SEED 1 // same seed, same simulated data
+#endif
+
+unsigned long simulationSeed = SIMULATION_SEED; // hostLogger --sim-seed changes it before setup()
+uint64_t simulationStartMicros = 0;
+uint32_t simulationRandomState = 1; // used by simulatedSensor() and simulatedSensorSine()
+
+// xorshift32 (the state must not be 0)
+uint32_t simRandom(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+// uniform in [-1, 1]
+float simUniform(uint32_t *state)
+{
+  return ((float)(simRandom(state) >> 8)) / 8388607.5 - 1.;
+}
+
+// standard normal (Box-Muller)
+float simGaussian(uint32_t *state)
+{
+  float u1 = ((float)((simRandom(state) >> 8) + 1)) / 16777217.; // (0, 1]
+  float u2 = ((float)(simRandom(state) >> 8)) / 16777216.;
+  return mathSqrt(-2. * log(u1)) * mathCosPeriod(u2, 1.);
+}
+
+// seed for the generator of stream k (never 0)
+uint32_t simSeedFor(unsigned long k)
+{
+  uint32_t seed = (uint32_t)simulationSeed * 2654435761UL + (uint32_t)k * 40503UL + 1;
+  return seed == 0 ? 1 : seed;
+}
+
+// seconds since simulationBegin()
+float simulationSeconds(uint64_t nowMicros)
+{
+  return (float)(((double)(nowMicros - simulationStartMicros)) / 1000000.);
+}
+
+float simulatedSensor(float intercept, float slope, float range)
+{
+  // function that simulates a sensor that creates random sensor readings
+  // that increase linearly with time, but vary randomly (according to uniform
+  // distribution within range)
+
+  float time = simulationSeconds(monoMicros());                 // time in seconds since the simulation started
+  float randomness = simUniform(&simulationRandomState);        // create a random float between -1. and 1.
+
+  float output = intercept + slope * time + randomness * range;
+  //DEBUG(output)
+  return (output);
+}
+
+float simulatedSensorSine(float intercept, float slope, float range, float amplitude, float period)
+{
+  // function that simulates a sensor that creates random sensor readings
+  // that increase linearly with time, but vary randomly (according to uniform
+  // distribution within range)
+  // intercept and slope define the baseline signal as a linear function baseline(t) = intercept + slope * time(in s)
+  // range defines the magnitude of random error: currently a uniform random error +- that adjusts the calculated value
+  // amplitude an period define a sinusoidal signal that is added to the baseline
+
+  float time = simulationSeconds(monoMicros());                 // time in seconds since the simulation started
+  float randomness = simUniform(&simulationRandomState);        // create a random float between -1. and 1.
+  float sine = amplitude * mathSinPeriod(time, period);        // sinusoidal function
+
+  float output = intercept + slope * time + randomness * range + sine;
+  //DEBUG(output)
+  return (output);
+}
+
+#if defined(ENABLE_SIMULATED_DATA) || defined(ENABLE_BENCHMARK)
+
+#ifndef SIM_MAX_SIGNALS
+#define SIM_MAX_SIGNALS 8
+#endif
+#define SIM_MAX_COMPONENTS 6
+#define SIM_MAX_TRACES 2
+#ifndef SIM_TRACE_FILE
+#define SIM_TRACE_FILE "/trace.csv" // data file replayed by SIM_TRACE_COLUMN
+#endif
+#ifndef SIM_TRACE_TIME_COLUMN
+#define SIM_TRACE_TIME_COLUMN "CPUt_cv" // column holding the time of each row in s
+#endif
+#define SIM_TRACE_FIELD 24 // longest field of a trace file
+#ifndef SIM_TRACE_COLUMN
+#define SIM_TRACE_COLUMN "" // no replay
+#endif
+char simTraceColumn[SIM_TRACE_FIELD + 1] = SIM_TRACE_COLUMN; // column replayed as stream tSim (hostLogger --sim-trace sets it)
+
+#define SIM_CONSTANT 0
+#define SIM_RAMP 1
+#define SIM_SINE 2
+#define SIM_SQUARE 3
+#define SIM_TRIANGLE 4
+#define SIM_UNIFORM 5
+#define SIM_GAUSSIAN 6
+#define SIM_DRIFT 7
+#define SIM_SPIKES 8
+#define SIM_STEPS 9
+#define SIM_REPLAY 10
+
+struct simComponent
+{
+  uint8_t kind;
+  float a, b, c; // see the list at the top of the file
+  float level;   // state of SIM_DRIFT and SIM_STEPS; trace index of SIM_REPLAY
+};
+
+struct simSignal
+{
+  int stream; // data stream the signal is written to (-1 = none)
+  int nComponents;
+  simComponent component[SIM_MAX_COMPONENTS];
+  uint32_t randomState;
+  uint64_t lastMicros; // time of the previous value (for the random walk and event rates)
+  float value;         // latest value
+};
+
+#ifdef USE_SD
+struct simTrace
+{
+  File file;
+  int valueColumn;
+  int timeColumn;       // -1: rows are SAMPLING_PERIOD ms apart
+  uint32_t firstRow;    // position of the first row after the header
+  float t0, v0, t1, v1; // rows on either side of the current time
+  float timeOffset;     // added to the times of the file (grows each time it starts over)
+  float lastTime;       // time of the last row read
+  unsigned long rows;
+};
+simTrace simTraces[SIM_MAX_TRACES];
+int nSimTraces = 0;
+#endif
+
+simSignal simSignals[SIM_MAX_SIGNALS];
+int nSimSignals = 0;
+
+// start (or restart) the simulation: time 0 is now and the generators are seeded
+void simulationBegin(unsigned long seed)
+{
+  simulationSeed = seed;
+  simulationStartMicros = monoMicros();
+  simulationRandomState = simSeedFor(SIM_MAX_SIGNALS);
+  nSimSignals = 0;
+#ifdef USE_SD
+  for (int k = 0; k < nSimTraces; k++)
+  {
+    simTraces[k].file.close();
+  }
+  nSimTraces = 0;
+#endif
+}
+
+// add a signal written to data stream iStream; returns its index or -1 if there are too many
+int addSimSignal(int iStream)
+{
+  if (nSimSignals >= SIM_MAX_SIGNALS)
+  {
+    WARN("too many simulated signals", nSimSignals)
+    return -1;
+  }
+  simSignal *signal = &simSignals[nSimSignals];
+  signal->stream = iStream;
+  signal->nComponents = 0;
+  signal->randomState = simSeedFor(nSimSignals);
+  signal->lastMicros = simulationStartMicros;
+  signal->value = 0.;
+  return nSimSignals++;
+}
+
+// add a component to signal sig; returns 1, or -1 if the signal has no room for it
+int addSimComponent(int sig, int kind, float a, float b, float c)
+{
+  if (sig < 0 || simSignals[sig].nComponents >= SIM_MAX_COMPONENTS)
+  {
+    WARN("too many simulated signal components", sig)
+    return -1;
+  }
+  simComponent *component = &simSignals[sig].component[simSignals[sig].nComponents++];
+  component->kind = (uint8_t)kind;
+  component->a = a;
+  component->b = b;
+  component->c = c;
+  component->level = 0.;
+  return 1;
+}
+
+#ifdef USE_SD
+// read one line of a trace: keeps the fields in the value and time columns (with header = 1 it
+// looks for the columns named column and SIM_TRACE_TIME_COLUMN instead); returns 0 at the end of the file
+int readSimTraceLine(simTrace *trace, int header, char *column, char *valueText, char *timeText)
+{
+  char field[SIM_TRACE_FIELD + 1];
+  int length = 0;
+  int k = 0;
+  int any = 0;
+  int c;
+  valueText[0] = 0;
+  timeText[0] = 0;
+  do
+  {
+    c = trace->file.read();
+    if (c >= 0 && c != ',' && c != '\n')
+    {
+      any = 1;
+      if (c != '\r' && c != ' ' && length < SIM_TRACE_FIELD)
+      {
+        field[length++] = (char)c;
+      }
+      continue;
+    }
+    any |= c >= 0;
+    field[length] = 0;
+    if (header)
+    {
+      if (!strcmp(field, column))
+        trace->valueColumn = k;
+      else if (!strcmp(field, SIM_TRACE_TIME_COLUMN))
+        trace->timeColumn = k;
+    }
+    else if (k == trace->valueColumn)
+      strcpy(valueText, field);
+    else if (k == trace->timeColumn)
+      strcpy(timeText, field);
+    length = 0;
+    k++;
+  } while (c >= 0 && c != '\n');
+  return any;
+}
+
+// read the next row of data (lines without a number in the value column, such as the preamble
+// or a row where it is N/A, are skipped); returns 0 at the end of the file
+int readSimTraceRow(simTrace *trace, float *rowTime, float *rowValue)
+{
+  char valueText[SIM_TRACE_FIELD + 1];
+  char timeText[SIM_TRACE_FIELD + 1];
+  while (readSimTraceLine(trace, 0, NULL, valueText, timeText))
+  {
+    char first = valueText[0];
+    if (first != '-' && first != '.' && (first < '0' || first > '9'))
+    {
+      continue;
+    }
+    *rowValue = atof(valueText);
+#ifdef SAMPLING_PERIOD
+    *rowTime = trace->timeColumn >= 0 ? atof(timeText) : trace->rows * (SAMPLING_PERIOD / 1000.);
+#else
+    *rowTime = trace->timeColumn >= 0 ? atof(timeText) : (float)trace->rows;
+#endif
+    trace->rows++;
+    return 1;
+  }
+  return 0;
+}
+
+// the next row of the trace, starting over at the first row at the end of the file
+int advanceSimTrace(simTrace *trace)
+{
+  float rowTime;
+  float rowValue;
+  if (!readSimTraceRow(trace, &rowTime, &rowValue))
+  {
+    if (trace->rows < 2 || !trace->file.seek(trace->firstRow))
+    {
+      return 0; // too short to replay
+    }
+    trace->timeOffset = trace->lastTime + (trace->t1 - trace->t0);
+    trace->rows = 0;
+    if (!readSimTraceRow(trace, &rowTime, &rowValue))
+    {
+      return 0;
+    }
+    trace->timeOffset -= rowTime;
+  }
+  trace->t0 = trace->t1;
+  trace->v0 = trace->v1;
+  trace->t1 = rowTime + trace->timeOffset;
+  trace->v1 = rowValue;
+  trace->lastTime = trace->t1;
+  return 1;
+}
+
+// replay column of the data file fileName (on the SD card) as part of signal sig, scaled by scale;
+// returns the trace index or -1 if the file or column cannot be found
+int addSimTrace(int sig, char *fileName, char *column, float scale)
+{
+  if (nSimTraces >= SIM_MAX_TRACES)
+  {
+    WARN("too many simulated traces", nSimTraces)
+    return -1;
+  }
+  simTrace *trace = &simTraces[nSimTraces];
+  trace->file = SD.open(fileName);
+  if (!trace->file)
+  {
+    MESSAGE("cannot open trace", fileName)
+    return -1;
+  }
+  trace->valueColumn = -1;
+  trace->timeColumn = -1;
+  trace->rows = 0;
+  trace->timeOffset = 0.;
+  char valueText[SIM_TRACE_FIELD + 1];
+  char timeText[SIM_TRACE_FIELD + 1];
+  while (trace->valueColumn < 0 && readSimTraceLine(trace, 1, column, valueText, timeText))
+  {
+  }
+  if (trace->valueColumn < 0)
+  {
+    MESSAGE("column not in trace", column)
+    trace->file.close();
+    return -1;
+  }
+  trace->firstRow = trace->file.position();
+  // the first two rows; the replay starts at the time of the first one
+  trace->t1 = 0.;
+  trace->v1 = 0.;
+  if (!advanceSimTrace(trace) || !advanceSimTrace(trace))
+  {
+    MESSAGE("trace too short", fileName)
+    trace->file.close();
+    return -1;
+  }
+  trace->timeOffset = -trace->t0;
+  trace->t1 -= trace->t0;
+  trace->lastTime = trace->t1;
+  trace->t0 = 0.;
+  if (addSimComponent(sig, SIM_REPLAY, scale, 0., 0.) < 0)
+  {
+    trace->file.close();
+    return -1;
+  }
+  simSignals[sig].component[simSignals[sig].nComponents - 1].level = (float)nSimTraces;
+  return nSimTraces++;
+}
+
+float simTraceValue(simTrace *trace, float time)
+{
+  while (time >= trace->t1)
+  {
+    if (!advanceSimTrace(trace))
+    {
+      return trace->v1; // hold the last value
+    }
+  }
+  if (trace->t1 <= trace->t0)
+  {
+    return trace->v1;
+  }
+  return trace->v0 + (trace->v1 - trace->v0) * (time - trace->t0) / (trace->t1 - trace->t0);
+}
+#endif
+
+// value of signal sig at time nowMicros (times must not go backwards)
+float simulatedValue(int sig, uint64_t nowMicros)
+{
+  simSignal *signal = &simSignals[sig];
+  float time = simulationSeconds(nowMicros);
+  float dt = (float)(((double)(nowMicros - signal->lastMicros)) / 1000000.);
+  signal->lastMicros = nowMicros;
+  float output = 0.;
+  for (int k = 0; k < signal->nComponents; k++)
+  {
+    simComponent *component = &signal->component[k];
+    float phase;
+    switch (component->kind)
+    {
+    case SIM_CONSTANT:
+      output += component->a;
+      break;
+    case SIM_RAMP:
+      output += component->a * time;
+      break;
+    case SIM_SINE:
+      output += component->a * mathSinPeriod(time + component->c, component->b);
+      break;
+    case SIM_SQUARE:
+      phase = fmod(time + component->c, component->b) / component->b;
+      output += phase < 0.5 ? component->a : -component->a;
+      break;
+    case SIM_TRIANGLE:
+      phase = fmod(time + component->c, component->b) / component->b;
+      output += component->a * (phase < 0.5 ? 4. * phase - 1. : 3. - 4. * phase);
+      break;
+    case SIM_UNIFORM:
+      output += component->a * simUniform(&signal->randomState);
+      break;
+    case SIM_GAUSSIAN:
+      output += component->a * simGaussian(&signal->randomState);
+      break;
+    case SIM_DRIFT:
+      component->level += component->a * mathSqrt(dt) * simGaussian(&signal->randomState);
+      output += component->level;
+      break;
+    case SIM_SPIKES:
+      if (simRandom(&signal->randomState) < (uint32_t)(4294967295. * fmin(component->a * dt, 1.)))
+      {
+        output += (simRandom(&signal->randomState) & 1) ? component->b : -component->b;
+      }
+      break;
+    case SIM_STEPS:
+      if (simRandom(&signal->randomState) < (uint32_t)(4294967295. * fmin(component->a * dt, 1.)))
+      {
+        component->level += (simRandom(&signal->randomState) & 1) ? component->b : -component->b;
+      }
+      output += component->level;
+      break;
+#ifdef USE_SD
+    case SIM_REPLAY:
+      output += component->a * simTraceValue(&simTraces[(int)component->level], time);
+      break;
+#endif
+    }
+  }
+  signal->value = output;
+  return output;
+}
+
+// write the current value of every signal to its data stream
+void updateSimulatedStreams(sampleStats *dataStream, uint64_t nowMicros, float relativeTime)
+{
+  for (int sig = 0; sig < nSimSignals; sig++)
+  {
+    float value = simulatedValue(sig, nowMicros);
+    if (simSignals[sig].stream >= 0)
+    {
+      updateDataSample(dataStream, simSignals[sig].stream, value, relativeTime);
+    }
+  }
+}
+
+#endif
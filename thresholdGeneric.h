@@ -1,5 +1,5 @@
-// thresholdGeneric.h
-//
-// file to include value of thresholds and other implementation-specific settings
-// for specific field-testing applications
-//
+// thresholdGeneric.h
+//
+// file to include value of thresholds and other implementation-specific settings
+// for specific field-testing applications
+//
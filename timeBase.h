@@ -0,0 +1,211 @@
+// timeBase.h
+// one time base for the logger
+//  - monoMicros(): 64 bit monotonic time in us that extends micros() across its rollover (every
+//    71.6 minutes). it must be called at least once per rollover period (loop() calls it on every pass)
+//  - absolute (unix) time of any monoMicros() value, from an anchor that pairs an RTC reading with
+//    the monotonic clock plus an estimate of the drift between them, so rows and events carry
+//    wall-clock time without reading the RTC over I2C for each one
+//
+//  anchoring: the PCF8523 only reports whole seconds, so an anchor is taken at the moment the RTC
+//  seconds change. timeBaseBegin() (in setup) waits for that edge (up to 1 s). after that, once
+//  every TIME_BASE_REFRESH_INTERVAL timeBaseService() reads the RTC once per pass through loop()
+//  until it sees the next edge, i.e. about one second of RTC reads per refresh interval
+//
+//  drift: the rate of the RTC relative to the monotonic clock is measured between the first anchor
+//  and each new one (once they are at least TIME_BASE_DRIFT_SPAN apart) and is used to extrapolate
+//  from the latest anchor
+//
+//  slew: a new anchor does not step the absolute time. the difference between the time from the
+//  old anchor and from the new one is taken up at TIME_BASE_SLEW_PPM, so the absolute time never
+//  goes backwards (rows stay in order for the time index). a step of more than TIME_BASE_SLEW_MAX
+//  (the RTC was set) is taken at once
+//
+//  the absolute time columns in the data and event files are enabled with ENABLE_ABSOLUTE_TIME in
+//  the deviceConfig file (without USE_RTC they hold the time since startup)
+//
+//  the clock can be replaced (e.g. with a mock clock when testing off-device) by defining
+//  TIME_BASE_MICROS() before this file is included
+
+#ifndef TIME_BASE_MICROS
+#define TIME_BASE_MICROS() micros()
+#endif
+
+uint32_t monoLastMicros = 0; // micros() at the previous call of monoMicros()
+uint64_t monoHighMicros = 0; // time accumulated in earlier rollovers of micros()
+
+uint64_t monoMicros()
+{
+  uint32_t now = (uint32_t)TIME_BASE_MICROS();
+  if (now < monoLastMicros)
+  {
+    monoHighMicros += 0x100000000ULL; // micros() has rolled over
+  }
+  monoLastMicros = now;
+  return monoHighMicros + now;
+}
+
+// monotonic time in seconds (as a double, so no precision is lost over long runs)
+double monoSeconds()
+{
+  return ((double)monoMicros()) / 1000000.;
+}
+
+#if defined(ENABLE_ABSOLUTE_TIME) || defined(ENABLE_BENCHMARK)
+
+#ifndef TIME_BASE_REFRESH_INTERVAL
+#define TIME_BASE_REFRESH_INTERVAL 600000000ULL // us between RTC anchors (10 minutes)
+#endif
+#define TIME_BASE_DRIFT_SPAN 3600000000ULL // shortest time (us) between anchors used to estimate drift (1 hour)
+#define TIME_BASE_EDGE_TIMEOUT 2000000ULL  // give up looking for an RTC seconds edge after this long (us)
+#define TIME_BASE_SLEW_PPM 10000          // rate at which a new anchor is taken up (parts per million)
+#define TIME_BASE_SLEW_MAX 10000000LL     // larger differences (us) are stepped
+
+struct timeBase
+{
+  uint64_t anchorMono;    // monotonic time (us) of the latest anchor
+  uint32_t anchorUnix;    // RTC time (s) at the latest anchor (the anchor is at the start of this second)
+  uint64_t firstMono;     // monotonic time (us) of the first anchor (for the drift estimate)
+  uint32_t firstUnix;     // RTC time (s) at the first anchor
+  int32_t driftPPB;       // rate of the RTC relative to the monotonic clock, minus 1 (parts per billion)
+  int64_t slewMicros;     // time from the previous anchor minus time from the latest, at the latest
+  uint64_t slewSpan;      // monotonic time (us) after the latest anchor over which slewMicros is taken up
+  int refreshing;         // 1 while waiting for the RTC seconds to change
+  uint32_t refreshSecond; // RTC seconds when the refresh started
+  uint64_t refreshStart;  // monotonic time when the refresh started
+  uint64_t nextRefresh;   // monotonic time of the next refresh
+  unsigned long anchors;  // number of anchors taken
+  unsigned long rtcReads; // number of RTC reads made by the time base
+};
+
+timeBase clockBase;
+
+// current RTC time in seconds (time since startup when there is no RTC)
+uint32_t timeBaseReadRTC(timeBase *base)
+{
+  base->rtcReads++;
+#ifdef USE_RTC
+  return rtc.now().unixtime();
+#else
+  return (uint32_t)(monoMicros() / 1000000ULL);
+#endif
+}
+
+// absolute time (us since 1970) of the monotonic time mono
+uint64_t absoluteMicros(timeBase *base, uint64_t mono)
+{
+  int64_t elapsed = (int64_t)(mono - base->anchorMono);
+  int64_t corrected = elapsed + elapsed * base->driftPPB / 1000000000LL;
+  if (elapsed <= 0)
+  {
+    corrected += base->slewMicros;
+  }
+  else if ((uint64_t)elapsed < base->slewSpan)
+  {
+    corrected += base->slewMicros * (int64_t)(base->slewSpan - elapsed) / (int64_t)base->slewSpan;
+  }
+  return ((uint64_t)base->anchorUnix) * 1000000ULL + corrected;
+}
+
+// pair the monotonic time mono with the start of the RTC second unixSeconds and update the drift estimate
+void timeBaseAnchor(timeBase *base, uint64_t mono, uint32_t unixSeconds)
+{
+  uint64_t before = base->anchors > 0 ? absoluteMicros(base, mono) : 0;
+  base->slewMicros = 0;
+  base->slewSpan = 0;
+  if (base->anchors == 0)
+  {
+    base->firstMono = mono;
+    base->firstUnix = unixSeconds;
+  }
+  else if (mono - base->firstMono >= TIME_BASE_DRIFT_SPAN)
+  {
+    int64_t monoElapsed = (int64_t)(mono - base->firstMono);
+    int64_t rtcElapsed = ((int64_t)(unixSeconds - base->firstUnix)) * 1000000LL;
+    base->driftPPB = (int32_t)((rtcElapsed - monoElapsed) * 1000LL * 1000000LL / monoElapsed);
+  }
+  base->anchorMono = mono;
+  base->anchorUnix = unixSeconds;
+  if (base->anchors > 0)
+  {
+    int64_t slew = (int64_t)(before - absoluteMicros(base, mono));
+    if (slew > -TIME_BASE_SLEW_MAX && slew < TIME_BASE_SLEW_MAX)
+    {
+      base->slewMicros = slew;
+      base->slewSpan = (uint64_t)(slew < 0 ? -slew : slew) * 1000000ULL / TIME_BASE_SLEW_PPM;
+    }
+  }
+  base->anchors++;
+}
+
+// print the absolute time of mono as unix seconds with 3 decimals (integer math, no RTC read)
+void printAbsoluteTime(Print &out, timeBase *base, uint64_t mono)
+{
+  uint64_t t = absoluteMicros(base, mono);
+  unsigned long seconds = (unsigned long)(t / 1000000ULL);
+  unsigned int ms = (unsigned int)((t / 1000ULL) % 1000ULL);
+  out.print(seconds);
+  out.print(".");
+  if (ms < 100)
+    out.print("0");
+  if (ms < 10)
+    out.print("0");
+  out.print(ms);
+}
+
+// take the first anchor at an RTC seconds edge (blocks for up to 1 s)
+void timeBaseBegin(timeBase *base)
+{
+  base->driftPPB = 0;
+  base->anchors = 0;
+  base->rtcReads = 0;
+  base->refreshing = 0;
+#ifdef USE_RTC
+  uint32_t startSecond = timeBaseReadRTC(base);
+  uint64_t start = monoMicros();
+  uint32_t second = startSecond;
+  while (second == startSecond && monoMicros() - start < TIME_BASE_EDGE_TIMEOUT)
+  {
+    second = timeBaseReadRTC(base);
+  }
+  timeBaseAnchor(base, monoMicros(), second);
+#else
+  timeBaseAnchor(base, 0, 0);
+#endif
+  base->nextRefresh = base->anchorMono + TIME_BASE_REFRESH_INTERVAL;
+}
+
+// call on every pass through loop(): re-anchors to the RTC once every TIME_BASE_REFRESH_INTERVAL
+//  returns 1 when a new anchor was taken
+int timeBaseService(timeBase *base, uint64_t mono)
+{
+#ifdef USE_RTC
+  if (!base->refreshing)
+  {
+    if (mono < base->nextRefresh)
+    {
+      return 0;
+    }
+    base->refreshing = 1;
+    base->refreshSecond = timeBaseReadRTC(base);
+    base->refreshStart = mono;
+    return 0;
+  }
+  uint32_t second = timeBaseReadRTC(base);
+  if (second != base->refreshSecond)
+  {
+    timeBaseAnchor(base, mono, second);
+    base->refreshing = 0;
+    base->nextRefresh = mono + TIME_BASE_REFRESH_INTERVAL;
+    return 1;
+  }
+  if (mono - base->refreshStart > TIME_BASE_EDGE_TIMEOUT)
+  {
+    WARN("RTC seconds did not change", second)
+    base->refreshing = 0;
+    base->nextRefresh = mono + TIME_BASE_REFRESH_INTERVAL;
+  }
+#endif
+  return 0;
+}
+
+#endif
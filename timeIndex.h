@@ -0,0 +1,278 @@
+// timeIndex.h
+// sidecar index of the data and event files, so the host can seek to a time or a count instead of
+// reading a whole file (host/timeQuery)
+//  every TIME_INDEX_ROWS rows or TIME_INDEX_INTERVAL ms, whichever comes first, the next row of an
+//  indexed file gets an entry in the index file next to it ("/d210118/Zdata000.csv" is indexed in
+//  "/d210118/Zdata000.idx"): millis() when the row was made, its count (second column) and the
+//  byte offset where the row starts in the file
+//
+//  the time and count are noted when the row is formatted (timeIndexRowMade) and the offset when it
+//  reaches the card (timeIndexRowWritten), so rows that wait in the output queue or the event queue
+//  are indexed where they land; a row that is dropped, rolled up or merged before it is written
+//  leaves no entry. entries are kept in RAM and appended TIME_INDEX_BUFFER at a time (or when the
+//  oldest has waited TIME_INDEX_FLUSH_INTERVAL) with one open of the index file
+//
+//  the index file is binary, little endian, 16 bytes per record:
+//    header  "KTIX", version (uint16), record size (uint16), TIME_INDEX_ROWS (uint32), TIME_INDEX_INTERVAL (uint32)
+//    entry   time (uint32 ms), count (uint32), offset (uint32), CRC-16 of those 12 bytes (uint16), 0 (uint16)
+//  entries go to the card after their rows, but a row kept in a file open for group commit may be
+//  lost with the power while its entry is not: host/timeQuery checks each entry against its row
+//  and stops at the first that does not match, so an index is safe to use on a truncated file
+//
+//  rows of a compressed data file (ENABLE_COMPRESSED_DATA) are not indexed
+//
+//  enable with ENABLE_TIME_INDEX in the deviceConfig file (requires USE_SD)
+
+#ifdef ENABLE_TIME_INDEX
+
+#ifndef TIME_INDEX_ROWS
+#define TIME_INDEX_ROWS 16 // rows between entries
+#endif
+#ifndef TIME_INDEX_INTERVAL
+#define TIME_INDEX_INTERVAL 10000 // longest time (ms) between entries
+#endif
+#ifndef TIME_INDEX_BUFFER
+#define TIME_INDEX_BUFFER 8 // entries appended to the index file at once
+#endif
+#ifndef TIME_INDEX_FLUSH_INTERVAL
+#define TIME_INDEX_FLUSH_INTERVAL 60000 // longest time (ms) an entry waits in RAM
+#endif
+#define TIME_INDEX_PENDING 8 // rows formatted but not written yet
+#define TIME_INDEX_MAX_FILES 6
+#define TIME_INDEX_VERSION 1
+#define TIME_INDEX_RECORD_BYTES 16
+
+struct timeIndexEntry
+{
+  uint32_t time;  // millis() when the row was made
+  uint32_t count; // second column of the row
+  uint32_t offset; // byte offset of the row in the file
+};
+
+struct timeIndex
+{
+  char *fullFileName;  // buffer holding the name of the indexed file
+  char indexName[40];  // index file the buffered entries belong to ("" = none yet)
+  int headerWritten;   // the index file has its header
+  int rowsSince;       // rows made since the last entry was due
+  uint32_t lastTime;   // time of the last entry due
+  timeIndexEntry pending[TIME_INDEX_PENDING]; // rows due an entry, waiting for their offset
+  int pendingHead;
+  int pendingUsed;
+  timeIndexEntry buffer[TIME_INDEX_BUFFER]; // entries waiting to be written
+  int buffered;
+  unsigned long firstBuffered; // millis() when the oldest buffered entry was made
+};
+
+timeIndex timeIndexes[TIME_INDEX_MAX_FILES];
+int nTimeIndexes = 0;
+
+// counters for printTimeIndexStatus()
+unsigned long timeIndexEntries = 0;  // entries written to the card
+unsigned long timeIndexMissed = 0;   // rows due an entry that were never written (dropped or merged)
+unsigned long timeIndexDropped = 0;  // entries lost because the buffer was full (card missing)
+unsigned long timeIndexWrites = 0;   // opens of an index file
+unsigned long timeIndexFailures = 0; // opens that failed
+
+// start indexing the file whose name is held in fullFileName; returns its index or -1
+int addTimeIndex(char *fullFileName)
+{
+  if (nTimeIndexes == TIME_INDEX_MAX_FILES)
+  {
+    WARN("too many indexed files", nTimeIndexes)
+    return -1;
+  }
+  timeIndex *index = &timeIndexes[nTimeIndexes];
+  index->fullFileName = fullFileName;
+  index->indexName[0] = 0;
+  index->headerWritten = 0;
+  index->rowsSince = TIME_INDEX_ROWS; // the first row gets an entry
+  index->lastTime = 0;
+  index->pendingHead = 0;
+  index->pendingUsed = 0;
+  index->buffered = 0;
+  nTimeIndexes++;
+  return nTimeIndexes - 1;
+}
+
+timeIndex *findTimeIndex(char *fullFileName)
+{
+  for (int k = 0; k < nTimeIndexes; k++)
+  {
+    if (timeIndexes[k].fullFileName == fullFileName)
+      return &timeIndexes[k];
+  }
+  return NULL;
+}
+
+// name of the index of a file: the same name with the suffix ".idx"
+void makeTimeIndexName(char *indexName, char *fullFileName)
+{
+  snprintf(indexName, 40, "%s", fullFileName);
+  char *dot = strrchr(indexName, '.');
+  if (dot && strchr(dot, '/') == NULL)
+    *dot = 0;
+  strncat(indexName, ".idx", 39 - strlen(indexName));
+}
+
+void putTimeIndexWord(uint8_t *bytes, uint32_t value, int size)
+{
+  for (int k = 0; k < size; k++)
+  {
+    bytes[k] = (uint8_t)(value >> (8 * k));
+  }
+}
+
+// append the buffered entries (and the header of a new index file); returns 1, or -1 if the
+// index file could not be opened (the entries stay buffered)
+int writeTimeIndex(timeIndex *index)
+{
+  if (index->buffered == 0 && index->headerWritten)
+  {
+    return 1;
+  }
+  File indexFile = SD.open(index->indexName, FILE_WRITE);
+  if (!indexFile)
+  {
+    timeIndexFailures++;
+    return -1;
+  }
+  timeIndexWrites++;
+  uint8_t record[TIME_INDEX_RECORD_BYTES];
+  if (!index->headerWritten)
+  {
+    memcpy(record, "KTIX", 4);
+    putTimeIndexWord(record + 4, TIME_INDEX_VERSION, 2);
+    putTimeIndexWord(record + 6, TIME_INDEX_RECORD_BYTES, 2);
+    putTimeIndexWord(record + 8, TIME_INDEX_ROWS, 4);
+    putTimeIndexWord(record + 12, TIME_INDEX_INTERVAL, 4);
+    indexFile.write(record, TIME_INDEX_RECORD_BYTES);
+    index->headerWritten = 1;
+  }
+  for (int k = 0; k < index->buffered; k++)
+  {
+    putTimeIndexWord(record, index->buffer[k].time, 4);
+    putTimeIndexWord(record + 4, index->buffer[k].count, 4);
+    putTimeIndexWord(record + 8, index->buffer[k].offset, 4);
+    uint16_t crc = 0xFFFF;
+    for (int j = 0; j < 12; j++)
+    {
+      crc = crc16Update(crc, record[j]);
+    }
+    putTimeIndexWord(record + 12, crc, 2);
+    putTimeIndexWord(record + 14, 0, 2);
+    indexFile.write(record, TIME_INDEX_RECORD_BYTES);
+  }
+  indexFile.close();
+  timeIndexEntries += index->buffered;
+  index->buffered = 0;
+  return 1;
+}
+
+// call on every pass through loop(): writes the entries of an index when its buffer is full or
+// its oldest entry has waited TIME_INDEX_FLUSH_INTERVAL
+void serviceTimeIndex()
+{
+  for (int k = 0; k < nTimeIndexes; k++)
+  {
+    timeIndex *index = &timeIndexes[k];
+    if (index->buffered > 0 && (index->buffered == TIME_INDEX_BUFFER || millis() - index->firstBuffered >= TIME_INDEX_FLUSH_INTERVAL))
+      writeTimeIndex(index);
+  }
+}
+
+void printTimeIndexStatus(Print &out)
+{
+  out.print("time index: ");
+  out.print(timeIndexEntries);
+  out.print(" entries in ");
+  out.print(timeIndexWrites);
+  out.print(" writes, ");
+  out.print(timeIndexMissed);
+  out.print(" rows not written, ");
+  out.print(timeIndexDropped);
+  out.print(" entries dropped, ");
+  out.print(timeIndexFailures);
+  out.println(" failed opens");
+}
+
+// called when a row (not a header) of a file is formatted, before it is written or queued
+void timeIndexRowMade(char *fullFileName, int count)
+{
+  timeIndex *index = findTimeIndex(fullFileName);
+  if (!index)
+  {
+    return;
+  }
+  uint32_t now = millis();
+  index->rowsSince++;
+  if (index->rowsSince < TIME_INDEX_ROWS && now - index->lastTime < TIME_INDEX_INTERVAL)
+  {
+    return;
+  }
+  index->rowsSince = 0;
+  index->lastTime = now;
+  if (index->pendingUsed == TIME_INDEX_PENDING)
+  {
+    // the oldest rows are still waiting (card missing): their entry is given up
+    index->pendingHead = (index->pendingHead + 1) % TIME_INDEX_PENDING;
+    index->pendingUsed--;
+    timeIndexMissed++;
+  }
+  timeIndexEntry *entry = &index->pending[(index->pendingHead + index->pendingUsed) % TIME_INDEX_PENDING];
+  entry->time = now;
+  entry->count = (uint32_t)count;
+  index->pendingUsed++;
+}
+
+// called when a row of a file is written to the card at byte offset (count = its second column)
+void timeIndexRowWritten(char *fullFileName, int count, unsigned long offset)
+{
+  timeIndex *index = findTimeIndex(fullFileName);
+  if (!index)
+  {
+    return;
+  }
+  // rows due an entry that were dropped or merged on the way to the card
+  while (index->pendingUsed > 0 && index->pending[index->pendingHead].count < (uint32_t)count)
+  {
+    index->pendingHead = (index->pendingHead + 1) % TIME_INDEX_PENDING;
+    index->pendingUsed--;
+    timeIndexMissed++;
+  }
+  if (index->pendingUsed == 0 || index->pending[index->pendingHead].count != (uint32_t)count)
+  {
+    return;
+  }
+  timeIndexEntry entry = index->pending[index->pendingHead];
+  index->pendingHead = (index->pendingHead + 1) % TIME_INDEX_PENDING;
+  index->pendingUsed--;
+  entry.offset = offset;
+
+  // a rotated file starts an index of its own
+  char indexName[40];
+  makeTimeIndexName(indexName, fullFileName);
+  if (strcmp(indexName, index->indexName) != 0)
+  {
+    if (index->indexName[0] != 0 && writeTimeIndex(index) < 0)
+      timeIndexDropped += index->buffered; // lost with the old index
+    index->buffered = 0;
+    memcpy(index->indexName, indexName, sizeof(indexName));
+    index->headerWritten = 0;
+  }
+  if (index->buffered == TIME_INDEX_BUFFER && writeTimeIndex(index) < 0)
+  {
+    timeIndexDropped++;
+    return;
+  }
+  if (index->buffered == 0)
+  {
+    index->firstBuffered = millis();
+  }
+  index->buffer[index->buffered++] = entry;
+}
+
+#else
+#define timeIndexRowMade(fullFileName, count)            // do not include in code
+#define timeIndexRowWritten(fullFileName, count, offset) // do not include in code
+#endif